@@ -1844,6 +1844,7 @@ namespace asmjit {
 //!
 //!   - \ref ZoneString - Zone allocated string.
 //!   - \ref ZoneHash - Zone allocated hash table.
+//!   - \ref ZoneFlatHash - Zone allocated open addressing hash table.
 //!   - \ref ZoneTree - Zone allocated red-black tree.
 //!   - \ref ZoneList - Zone allocated double-linked list.
 //!   - \ref ZoneStack - Zone allocated stack.
@@ -2023,6 +2024,7 @@ namespace asmjit {
 #include "core/globals.h"
 #include "core/inst.h"
 #include "core/jitallocator.h"
+#include "core/jitreclaimer.h"
 #include "core/jitruntime.h"
 #include "core/logger.h"
 #include "core/operand.h"
@@ -50,6 +50,104 @@ public:
   StringTmp<128> _message;
 };
 
+// ============================================================================
+// [asmjit::InstStorage]
+// ============================================================================
+
+// ZoneVector grows linearly after `Globals::kGrowThreshold`, which would make
+// adding millions of instructions quadratic, so the storage grows its arrays
+// geometrically instead.
+static inline uint32_t InstStorage_grownCapacity(uint32_t capacity, uint32_t after) noexcept {
+  uint64_t n = Support::max<uint64_t>(uint64_t(capacity) * 2u, uint64_t(after), uint64_t(64));
+  return uint32_t(Support::min<uint64_t>(n, uint64_t(Globals::kInvalidId - 1)));
+}
+
+Error InstStorage::add(ZoneAllocator* allocator, const BaseInst& inst, const Operand_* operands, uint32_t opCount, uint32_t* out) noexcept {
+  ASMJIT_ASSERT(opCount <= Globals::kMaxOpCount);
+
+  uint32_t h = _instIds.size();
+  uint32_t opIndex = _operands.size();
+  uint32_t hasExtraReg = uint32_t(inst.hasExtraReg());
+  uint32_t opTotal = opCount + hasExtraReg;
+
+  if (ASMJIT_UNLIKELY(h >= kInvalidHandle - 1 || opIndex > kInvalidHandle - 1 - opTotal))
+    return DebugUtils::errored(kErrorTooManyHandles);
+
+  if (h == _instIds.capacity()) {
+    uint32_t capacity = InstStorage_grownCapacity(h, h + 1);
+    ASMJIT_PROPAGATE(_instIds.reserve(allocator, capacity));
+    ASMJIT_PROPAGATE(_instOptions.reserve(allocator, capacity));
+    ASMJIT_PROPAGATE(_opIndexes.reserve(allocator, capacity));
+    ASMJIT_PROPAGATE(_opInfo.reserve(allocator, capacity));
+    ASMJIT_PROPAGATE(_links.reserve(allocator, capacity));
+  }
+
+  if (_operands.capacity() - opIndex < opTotal)
+    ASMJIT_PROPAGATE(_operands.reserve(allocator, InstStorage_grownCapacity(_operands.capacity(), opIndex + opTotal)));
+
+  _instIds.appendUnsafe(inst.id());
+  _instOptions.appendUnsafe(inst.options());
+  _opIndexes.appendUnsafe(opIndex);
+  _opInfo.appendUnsafe(uint8_t(opCount | (hasExtraReg ? uint32_t(kOpInfoExtraReg) : 0u)));
+  _links.appendUnsafe(Link { kInvalidHandle, kInvalidHandle });
+
+  if (hasExtraReg) {
+    Operand_ reg;
+    reg._initReg(inst.extraReg().signature(), inst.extraReg().id());
+    _operands.appendUnsafe(reg);
+  }
+
+  for (uint32_t i = 0; i < opCount; i++)
+    _operands.appendUnsafe(operands[i]);
+
+  *out = h;
+  return kErrorOk;
+}
+
+void InstStorage::insertAfter(InstBlockNode* block, uint32_t h, uint32_t ref) noexcept {
+  uint32_t next = ref == kInvalidHandle ? block->_firstInst : _links[ref].next;
+
+  _links[h].prev = ref;
+  _links[h].next = next;
+
+  if (ref == kInvalidHandle)
+    block->_firstInst = h;
+  else
+    _links[ref].next = h;
+
+  if (next == kInvalidHandle)
+    block->_lastInst = h;
+  else
+    _links[next].prev = h;
+
+  block->_instCount++;
+}
+
+void InstStorage::append(InstBlockNode* block, uint32_t h) noexcept {
+  insertAfter(block, h, block->_lastInst);
+}
+
+void InstStorage::remove(InstBlockNode* block, uint32_t h) noexcept {
+  ASMJIT_ASSERT(block->_instCount > 0);
+
+  uint32_t prev = _links[h].prev;
+  uint32_t next = _links[h].next;
+
+  if (prev == kInvalidHandle)
+    block->_firstInst = next;
+  else
+    _links[prev].next = next;
+
+  if (next == kInvalidHandle)
+    block->_lastInst = prev;
+  else
+    _links[next].prev = prev;
+
+  _links[h].prev = kInvalidHandle;
+  _links[h].next = kInvalidHandle;
+  block->_instCount--;
+}
+
 // ============================================================================
 // [asmjit::BaseBuilder - Utilities]
 // ============================================================================
@@ -91,6 +189,24 @@ Error BaseBuilder::_newInstNode(InstNode** out, uint32_t instId, uint32_t instOp
   return kErrorOk;
 }
 
+Error BaseBuilder::_newInstNode(Zone* zone, InstNode** out, uint32_t instId, uint32_t instOptions, uint32_t opCount) const noexcept {
+  uint32_t opCapacity = InstNode::capacityOfOpCount(opCount);
+  ASMJIT_ASSERT(opCapacity >= InstNode::kBaseOpCapacity);
+
+  InstNode* node = zone->allocT<InstNode>(InstNode::nodeSizeOfOpCapacity(opCapacity));
+  if (ASMJIT_UNLIKELY(!node)) {
+    *out = nullptr;
+    return DebugUtils::errored(kErrorOutOfMemory);
+  }
+
+  *out = new(node) InstNode(const_cast<BaseBuilder*>(this), instId, instOptions, opCount, opCapacity);
+  return kErrorOk;
+}
+
+Error BaseBuilder::_newInstBlockNode(InstBlockNode** out) {
+  *out = nullptr;
+  return _newNodeT<InstBlockNode>(out);
+}
 
 Error BaseBuilder::_newLabelNode(LabelNode** out) {
   *out = nullptr;
@@ -340,6 +456,49 @@ BaseNode* BaseBuilder::setCursor(BaseNode* node) noexcept {
   return old;
 }
 
+// ============================================================================
+// [asmjit::BaseBuilder - Compact Instruction Storage]
+// ============================================================================
+
+Error BaseBuilder::expandInstBlocks(BaseNode* first, BaseNode* stop) {
+  BaseNode* node = first;
+
+  while (node != stop) {
+    BaseNode* next = node->next();
+
+    if (node->isInstBlock()) {
+      InstBlockNode* block = node->as<InstBlockNode>();
+      BaseNode* prev = block;
+
+      uint32_t h = block->firstInst();
+      while (h != InstStorage::kInvalidHandle) {
+        BaseInst inst = _instStorage.baseInst(h);
+        uint32_t opCount = _instStorage.opCount(h);
+
+        InstNode* instNode;
+        ASMJIT_PROPAGATE(_newInstNode(&instNode, inst.id(), inst.options(), opCount));
+        instNode->setExtraReg(inst.extraReg());
+
+        const Operand* operands = _instStorage.operands(h);
+        for (uint32_t i = 0; i < opCount; i++)
+          instNode->setOp(i, operands[i]);
+        instNode->resetOpRange(opCount, instNode->opCapacity());
+
+        prev = addAfter(instNode, prev);
+        h = _instStorage.next(h);
+      }
+
+      if (_cursor == block)
+        _cursor = prev;
+      removeNode(block);
+    }
+
+    node = next;
+  }
+
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::BaseBuilder - Section]
 // ============================================================================
@@ -635,6 +794,35 @@ Error BaseBuilder::_emit(uint32_t instId, const Operand_& o0, const Operand_& o1
     options &= ~BaseInst::kOptionReserved;
   }
 
+  // Instructions that have an inline comment always use `InstNode`.
+  if (_compactInstStorage && !inlineComment()) {
+    Operand_ opArray[Globals::kMaxOpCount];
+    EmitterUtils::opArrayFromEmitArgs(opArray, o0, o1, o2, opExt);
+
+    BaseInst inst(instId, options, extraReg());
+    resetInstOptions();
+    resetExtraReg();
+
+    // Consecutive instructions share a single block, anything else added
+    // after the cursor (a label for example) terminates it.
+    InstBlockNode* block;
+    if (_cursor && _cursor->isInstBlock()) {
+      block = _cursor->as<InstBlockNode>();
+    }
+    else {
+      ASMJIT_PROPAGATE(_newInstBlockNode(&block));
+      addNode(block);
+    }
+
+    uint32_t h;
+    Error err = _instStorage.add(&_allocator, inst, opArray, opCount, &h);
+    if (ASMJIT_UNLIKELY(err))
+      return reportError(err);
+
+    _instStorage.append(block, h);
+    return kErrorOk;
+  }
+
   uint32_t opCapacity = InstNode::capacityOfOpCount(opCount);
   ASMJIT_ASSERT(opCapacity >= InstNode::kBaseOpCapacity);
 
@@ -783,9 +971,47 @@ Error BaseBuilder::comment(const char* data, size_t size) {
 // [asmjit::BaseBuilder - Serialize]
 // ============================================================================
 
-Error BaseBuilder::serializeTo(BaseEmitter* dst) {
+//! Records offsets of instructions listed in `BuilderLayoutEntry` array during serialization.
+struct BaseBuilder_LayoutRecorder {
+  BuilderLayoutEntry* entries;
+  size_t count;
+  size_t index;
+
+  ASMJIT_INLINE BuilderLayoutEntry* match(BaseNode* node, uint32_t handle) noexcept {
+    if (index < count && entries[index].node == node && entries[index].handle == handle)
+      return &entries[index];
+    return nullptr;
+  }
+
+  ASMJIT_INLINE void recordStart(BuilderLayoutEntry* entry, BaseEmitter* dst) noexcept {
+    BaseAssembler* a = static_cast<BaseAssembler*>(dst);
+    entry->sectionId = a->currentSection()->id();
+    entry->flags = 0;
+    entry->start = a->offset();
+  }
+
+  ASMJIT_INLINE void recordEnd(BuilderLayoutEntry* entry, BaseEmitter* dst) noexcept {
+    entry->end = static_cast<BaseAssembler*>(dst)->offset();
+    index++;
+  }
+
+  //! Emits `inst` in its long form if its short form is out of range in the
+  //! layout, so the layout doesn't fail and `entry` is marked as out of range.
+  ASMJIT_INLINE Error retryLongForm(BuilderLayoutEntry* entry, BaseEmitter* dst, Error err, const BaseInst& inst, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_* opExt) noexcept {
+    if (err != kErrorInvalidDisplacement || !(inst.options() & BaseInst::kOptionShortForm))
+      return err;
+
+    entry->flags |= BuilderLayoutEntry::kFlagShortFormOutOfRange;
+    dst->setInstOptions(inst.options() & ~uint32_t(BaseInst::kOptionShortForm));
+    dst->setExtraReg(inst.extraReg());
+    return dst->_emit(inst.id(), o0, o1, o2, opExt);
+  }
+};
+
+static Error BaseBuilder_serialize(BaseBuilder* self, BaseEmitter* dst, BaseBuilder_LayoutRecorder* layout) {
   Error err = kErrorOk;
-  BaseNode* node_ = _firstNode;
+  BaseNode* node_ = self->firstNode();
+  InstStorage& instStorage = self->_instStorage;
 
   Operand_ opArray[Globals::kMaxOpCount];
 
@@ -794,6 +1020,7 @@ Error BaseBuilder::serializeTo(BaseEmitter* dst) {
 
     if (node_->isInst()) {
       InstNode* node = node_->as<InstNode>();
+      BuilderLayoutEntry* entry = layout ? layout->match(node, InstStorage::kInvalidHandle) : nullptr;
 
       // NOTE: Inlined to remove one additional call per instruction.
       dst->setInstOptions(node->instOptions());
@@ -818,7 +1045,53 @@ Error BaseBuilder::serializeTo(BaseEmitter* dst) {
         opExt = opArray + 3;
       }
 
-      err = dst->_emit(node->id(), op[0], op[1], op[2], opExt);
+      if (entry) {
+        layout->recordStart(entry, dst);
+        err = dst->_emit(node->id(), op[0], op[1], op[2], opExt);
+        err = layout->retryLongForm(entry, dst, err, node->baseInst(), op[0], op[1], op[2], opExt);
+        layout->recordEnd(entry, dst);
+      }
+      else {
+        err = dst->_emit(node->id(), op[0], op[1], op[2], opExt);
+      }
+    }
+    else if (node_->isInstBlock()) {
+      InstBlockNode* node = node_->as<InstBlockNode>();
+      uint32_t h = node->firstInst();
+
+      while (h != InstStorage::kInvalidHandle) {
+        BuilderLayoutEntry* entry = layout ? layout->match(node, h) : nullptr;
+        BaseInst inst = instStorage.baseInst(h);
+        dst->setInstOptions(inst.options());
+        dst->setExtraReg(inst.extraReg());
+
+        // Operands of the next instruction follow in the storage, so always
+        // copy them and reset the rest.
+        const Operand_* op = instStorage.operands(h);
+        uint32_t opCount = instStorage.opCount(h);
+
+        uint32_t i = 0;
+        for (; i < opCount; i++)
+          opArray[i].copyFrom(op[i]);
+        for (; i < Globals::kMaxOpCount; i++)
+          opArray[i].reset();
+
+        const Operand_* opExt = opCount > 3 ? opArray + 3 : EmitterUtils::noExt;
+
+        if (entry) {
+          layout->recordStart(entry, dst);
+          err = dst->_emit(inst.id(), opArray[0], opArray[1], opArray[2], opExt);
+          err = layout->retryLongForm(entry, dst, err, inst, opArray[0], opArray[1], opArray[2], opExt);
+          layout->recordEnd(entry, dst);
+        }
+        else {
+          err = dst->_emit(inst.id(), opArray[0], opArray[1], opArray[2], opExt);
+        }
+
+        if (err) break;
+
+        h = instStorage.next(h);
+      }
     }
     else if (node_->isLabel()) {
       if (node_->isConstPool()) {
@@ -828,6 +1101,13 @@ Error BaseBuilder::serializeTo(BaseEmitter* dst) {
       else {
         LabelNode* node = node_->as<LabelNode>();
         err = dst->bind(node->label());
+
+        // The label is bound even if some links to it are out of range. The
+        // layout continues, these links stay unresolved in the layout and
+        // `BaseBuilder_layoutCheckShortForms()` marks recorded instructions
+        // that use them.
+        if (layout && err == kErrorInvalidDisplacement)
+          err = kErrorOk;
       }
     }
     else if (node_->isAlign()) {
@@ -848,7 +1128,7 @@ Error BaseBuilder::serializeTo(BaseEmitter* dst) {
     }
     else if (node_->isSection()) {
       SectionNode* node = node_->as<SectionNode>();
-      err = dst->section(_code->sectionById(node->id()));
+      err = dst->section(dst->code()->sectionById(node->id()));
     }
     else if (node_->isComment()) {
       CommentNode* node = node_->as<CommentNode>();
@@ -862,6 +1142,302 @@ Error BaseBuilder::serializeTo(BaseEmitter* dst) {
   return err;
 }
 
+Error BaseBuilder::serializeTo(BaseEmitter* dst) {
+  return BaseBuilder_serialize(this, dst, nullptr);
+}
+
+// ============================================================================
+// [asmjit::BaseBuilder - Layout]
+// ============================================================================
+
+//! Initializes `tmp` to mirror sections and labels of `code` and attaches `layoutAssembler` to it.
+static Error BaseBuilder_initLayoutHolder(BaseBuilder* self, CodeHolder* tmp, BaseAssembler* layoutAssembler) noexcept {
+  CodeHolder* code = self->code();
+
+  tmp->reset();
+  ASMJIT_PROPAGATE(tmp->init(code->environment(), code->baseAddress()));
+
+  uint32_t sectionCount = code->sectionCount();
+  for (uint32_t i = 0; i < sectionCount; i++) {
+    Section* src = code->sectionById(i);
+    Section* dst = tmp->textSection();
+
+    if (i != 0)
+      ASMJIT_PROPAGATE(tmp->newSection(&dst, src->name(), SIZE_MAX, src->flags(), src->alignment(), src->order()));
+
+    // Code emitted into `code` before serialization is part of the layout.
+    size_t size = src->bufferSize();
+    if (size) {
+      ASMJIT_PROPAGATE(tmp->reserveBuffer(&dst->_buffer, size));
+      memset(dst->_buffer._data, 0, size);
+      dst->_buffer._size = size;
+    }
+  }
+
+  uint32_t labelCount = code->labelCount();
+  for (uint32_t i = 0; i < labelCount; i++) {
+    LabelEntry* le;
+    ASMJIT_PROPAGATE(tmp->newLabelEntry(&le));
+
+    LabelEntry* src = code->labelEntry(i);
+    if (src->isBound())
+      ASMJIT_PROPAGATE(tmp->bindLabel(Label(i), src->section()->id(), src->offset()));
+  }
+
+  ASMJIT_PROPAGATE(tmp->attach(layoutAssembler));
+  layoutAssembler->addEncodingOptions(self->encodingOptions() & ~uint32_t(BaseEmitter::kEncodingOptionRelaxBranches));
+  layoutAssembler->addValidationOptions(self->validationOptions());
+  return kErrorOk;
+}
+
+static ASMJIT_INLINE BaseInst BaseBuilder_layoutInst(BaseBuilder* self, const BuilderLayoutEntry& entry) noexcept {
+  if (entry.handle == InstStorage::kInvalidHandle)
+    return entry.node->as<InstNode>()->baseInst();
+  else
+    return self->_instStorage.baseInst(entry.handle);
+}
+
+//! Marks recorded instructions that use the short form, but whose target is
+//! not bound in the same section or is out of range in the layout.
+static void BaseBuilder_layoutCheckShortForms(BaseBuilder* self, CodeHolder* layoutCode, BuilderLayoutEntry* entries, size_t count) noexcept {
+  for (size_t i = 0; i < count; i++) {
+    BuilderLayoutEntry& entry = entries[i];
+    if (!(BaseBuilder_layoutInst(self, entry).options() & BaseInst::kOptionShortForm))
+      continue;
+
+    const Operand_* op;
+    uint32_t opCount;
+
+    if (entry.handle == InstStorage::kInvalidHandle) {
+      op = entry.node->as<InstNode>()->operands();
+      opCount = entry.node->as<InstNode>()->opCount();
+    }
+    else {
+      op = self->_instStorage.operands(entry.handle);
+      opCount = self->_instStorage.opCount(entry.handle);
+    }
+
+    if (!opCount || !op[0].isLabel())
+      continue;
+
+    LabelEntry* le = layoutCode->labelEntry(op[0].id());
+    if (!le || !le->isBound() || le->section()->id() != entry.sectionId || !Support::isInt8(int64_t(le->offset()) - int64_t(entry.end)))
+      entry.flags |= BuilderLayoutEntry::kFlagShortFormOutOfRange;
+  }
+}
+
+Error BaseBuilder::layoutTo(CodeHolder* layoutCode, BaseAssembler* layoutAssembler, BuilderLayoutEntry* entries, size_t count) {
+  if (ASMJIT_UNLIKELY(!_code))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(!layoutCode || layoutCode == _code || !layoutAssembler))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  ASMJIT_PROPAGATE(BaseBuilder_initLayoutHolder(this, layoutCode, layoutAssembler));
+
+  BaseBuilder_LayoutRecorder recorder { entries, count, 0 };
+  ASMJIT_PROPAGATE(BaseBuilder_serialize(this, layoutAssembler, &recorder));
+
+  BaseBuilder_layoutCheckShortForms(this, layoutCode, entries, recorder.index);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::BaseBuilder - Branch Relaxation]
+// ============================================================================
+
+//! Maximum number of layouts done by `BaseBuilder::relaxBranches()`.
+static constexpr uint32_t kRelaxMaxIterations = 32;
+
+//! Branch considered by `BaseBuilder::relaxBranches()`, its layout is
+//! recorded by the `BuilderLayoutEntry` of the same index.
+struct BaseBuilder_RelaxEntry {
+  //! Target label id.
+  uint32_t labelId;
+  //! Size of the short form or zero if the instruction cannot be relaxed.
+  uint32_t shortSize;
+  //! Relaxation state, see `BaseBuilder_RelaxState`.
+  uint32_t state;
+};
+
+enum BaseBuilder_RelaxState : uint32_t {
+  kRelaxStateLong = 0,
+  kRelaxStateShort = 1,
+  //! Was short, but the layout made it out of range - never relaxed again.
+  kRelaxStateLocked = 2
+};
+
+static ASMJIT_INLINE void BaseBuilder_relaxSetShortForm(BaseBuilder* self, const BuilderLayoutEntry& entry, bool shortForm) noexcept {
+  uint32_t options = BaseBuilder_layoutInst(self, entry).options();
+  options = shortForm ? options | BaseInst::kOptionShortForm : options & ~uint32_t(BaseInst::kOptionShortForm);
+
+  if (entry.handle == InstStorage::kInvalidHandle)
+    entry.node->as<InstNode>()->setInstOptions(options);
+  else
+    self->_instStorage.setInstOptions(entry.handle, options);
+}
+
+static Error BaseBuilder_relaxCollect(BaseBuilder* self, ZoneAllocator* allocator, ZoneVector<BuilderLayoutEntry>& layout, ZoneVector<BaseBuilder_RelaxEntry>& entries) noexcept {
+  constexpr uint32_t kForcedForm = BaseInst::kOptionShortForm | BaseInst::kOptionLongForm;
+  InstStorage& instStorage = self->_instStorage;
+  BuilderLayoutEntry layoutEntry;
+
+  for (BaseNode* node_ = self->firstNode(); node_; node_ = node_->next()) {
+    if (node_->isInst()) {
+      InstNode* node = node_->as<InstNode>();
+      if (node->opCount() && node->op(0).isLabel() && !(node->instOptions() & kForcedForm)) {
+        layoutEntry.reset(node);
+        ASMJIT_PROPAGATE(layout.append(allocator, layoutEntry));
+        ASMJIT_PROPAGATE(entries.append(allocator, BaseBuilder_RelaxEntry { node->op(0).id(), 0, kRelaxStateLong }));
+      }
+    }
+    else if (node_->isInstBlock()) {
+      InstBlockNode* node = node_->as<InstBlockNode>();
+      for (uint32_t h = node->firstInst(); h != InstStorage::kInvalidHandle; h = instStorage.next(h)) {
+        const Operand_* op = instStorage.operands(h);
+        if (instStorage.opCount(h) && op[0].isLabel() && !(instStorage.instOptions(h) & kForcedForm)) {
+          layoutEntry.reset(node, h);
+          ASMJIT_PROPAGATE(layout.append(allocator, layoutEntry));
+          ASMJIT_PROPAGATE(entries.append(allocator, BaseBuilder_RelaxEntry { op[0].id(), 0, kRelaxStateLong }));
+        }
+      }
+    }
+  }
+
+  return kErrorOk;
+}
+
+//! Measures the size of short forms of all branches. Branches that cannot
+//! use the short form or wouldn't get any shorter are kept as is.
+static Error BaseBuilder_relaxMeasure(BaseBuilder* self, CodeHolder* tmp, BaseAssembler* a, ZoneVector<BuilderLayoutEntry>& layout, ZoneVector<BaseBuilder_RelaxEntry>& entries) noexcept {
+  ASMJIT_PROPAGATE(BaseBuilder_initLayoutHolder(self, tmp, a));
+
+  for (uint32_t i = 0; i < entries.size(); i++) {
+    BuilderLayoutEntry entry = layout[i];
+    BaseInst inst = BaseBuilder_layoutInst(self, entry);
+    const Operand_* op;
+    uint32_t opCount;
+
+    if (entry.handle == InstStorage::kInvalidHandle) {
+      op = entry.node->as<InstNode>()->operands();
+      opCount = entry.node->as<InstNode>()->opCount();
+    }
+    else {
+      op = self->_instStorage.operands(entry.handle);
+      opCount = self->_instStorage.opCount(entry.handle);
+    }
+
+    Operand_ opArray[Globals::kMaxOpCount];
+    for (uint32_t j = 0; j < Globals::kMaxOpCount; j++) {
+      if (j < opCount)
+        opArray[j].copyFrom(op[j]);
+      else
+        opArray[j].reset();
+    }
+    const Operand_* opExt = opCount > 3 ? opArray + 3 : EmitterUtils::noExt;
+
+    // Labels targeted by forward branches are not bound in `tmp` yet, which
+    // makes the assembler use the requested form of each branch.
+    size_t start = a->offset();
+    a->setInstOptions(inst.options());
+    a->setExtraReg(inst.extraReg());
+    if (a->_emit(inst.id(), opArray[0], opArray[1], opArray[2], opExt) != kErrorOk)
+      continue;
+    size_t longSize = a->offset() - start;
+
+    start = a->offset();
+    a->setInstOptions(inst.options() | BaseInst::kOptionShortForm);
+    a->setExtraReg(inst.extraReg());
+    if (a->_emit(inst.id(), opArray[0], opArray[1], opArray[2], opExt) != kErrorOk)
+      continue;
+    size_t shortSize = a->offset() - start;
+
+    if (shortSize < longSize)
+      entries[i].shortSize = uint32_t(shortSize);
+  }
+
+  return kErrorOk;
+}
+
+Error BaseBuilder::relaxBranches(BaseAssembler* layoutAssembler) {
+  if (ASMJIT_UNLIKELY(!_code))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(!layoutAssembler || layoutAssembler->isInitialized()))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  Zone zone(16384 - Zone::kBlockOverhead);
+  ZoneAllocator allocator(&zone);
+  ZoneVector<BuilderLayoutEntry> layout;
+  ZoneVector<BaseBuilder_RelaxEntry> entries;
+
+  ASMJIT_PROPAGATE(BaseBuilder_relaxCollect(this, &allocator, layout, entries));
+  if (entries.empty())
+    return kErrorOk;
+
+  CodeHolder tmp;
+  Error err = BaseBuilder_relaxMeasure(this, &tmp, layoutAssembler, layout, entries);
+
+  uint32_t iteration = 0;
+  bool changed = true;
+
+  while (!err && changed && ++iteration <= kRelaxMaxIterations) {
+    changed = false;
+
+    err = layoutTo(&tmp, layoutAssembler, layout.data(), layout.size());
+    if (err)
+      break;
+
+    for (uint32_t i = 0; i < entries.size(); i++) {
+      BaseBuilder_RelaxEntry& entry = entries[i];
+      const BuilderLayoutEntry& inst = layout[i];
+
+      if (!entry.shortSize || entry.state == kRelaxStateLocked)
+        continue;
+
+      LabelEntry* le = tmp.labelEntry(entry.labelId);
+      bool sameSection = le && le->isBound() && le->section()->id() == inst.sectionId;
+
+      if (entry.state == kRelaxStateShort) {
+        // Alignment can increase distances after other branches were relaxed.
+        // The layout doesn't fail in that case, but marks the branch.
+        if (!sameSection || inst.hasFlag(BuilderLayoutEntry::kFlagShortFormOutOfRange)) {
+          entry.state = kRelaxStateLocked;
+          BaseBuilder_relaxSetShortForm(this, inst, false);
+          changed = true;
+        }
+        continue;
+      }
+
+      // The assembler already uses the short form of branches to bound labels.
+      if (!sameSection || inst.size() <= entry.shortSize)
+        continue;
+
+      // A forward target moves together with the end of the relaxed branch.
+      int64_t displacement = le->offset() >= inst.end
+        ? int64_t(le->offset()) - int64_t(inst.end)
+        : int64_t(le->offset()) - int64_t(inst.start + entry.shortSize);
+
+      if (Support::isInt8(displacement)) {
+        entry.state = kRelaxStateShort;
+        BaseBuilder_relaxSetShortForm(this, inst, true);
+        changed = true;
+      }
+    }
+  }
+
+  tmp.reset();
+
+  // Only a converged layout is guaranteed to be valid, revert everything otherwise.
+  if (err || changed) {
+    for (uint32_t i = 0; i < entries.size(); i++)
+      if (entries[i].state == kRelaxStateShort)
+        BaseBuilder_relaxSetShortForm(this, layout[i], false);
+  }
+
+  return err;
+}
+
 // ============================================================================
 // [asmjit::BaseBuilder - Events]
 // ============================================================================
@@ -869,6 +1445,13 @@ Error BaseBuilder::serializeTo(BaseEmitter* dst) {
 Error BaseBuilder::onAttach(CodeHolder* code) noexcept {
   ASMJIT_PROPAGATE(Base::onAttach(code));
 
+  // Zones are empty when detached, so they can switch to the source of `code`.
+  ZoneBlockSource* blockSource = code->blockSource();
+  _allocator.reset(&_codeZone);
+  _codeZone.setBlockSource(blockSource);
+  _dataZone.setBlockSource(blockSource);
+  _passZone.setBlockSource(blockSource);
+
   SectionNode* initialSection;
   Error err = sectionNodeOf(&initialSection, 0);
 
@@ -898,6 +1481,7 @@ Error BaseBuilder::onDetach(CodeHolder* code) noexcept {
   _dataZone.reset();
   _passZone.reset();
 
+  _instStorage.reset();
   _nodeFlags = 0;
 
   _cursor = nullptr;
@@ -907,6 +1491,19 @@ Error BaseBuilder::onDetach(CodeHolder* code) noexcept {
   return Base::onDetach(code);
 }
 
+// ============================================================================
+// [asmjit::BaseBuilder - Memory Usage]
+// ============================================================================
+
+void BaseBuilder::addMemoryUsage(MemoryUsage* usage) const noexcept {
+  usage->addZone(MemoryUsage::kCategoryEmitterZones, _codeZone);
+  usage->addZone(MemoryUsage::kCategoryEmitterZones, _dataZone);
+  usage->addZone(MemoryUsage::kCategoryPassZones, _passZone);
+
+  size_t dynamicSize = _allocator.dynamicSize();
+  usage->add(MemoryUsage::kCategoryEmitterAllocator, dynamicSize, dynamicSize);
+}
+
 // ============================================================================
 // [asmjit::Pass - Construction / Destruction]
 // ============================================================================
@@ -53,6 +53,7 @@ class Pass;
 
 class BaseNode;
 class InstNode;
+class InstBlockNode;
 class SectionNode;
 class LabelNode;
 class AlignNode;
@@ -66,6 +67,181 @@ class LabelDeltaNode;
 // Only used by Compiler infrastructure.
 class JumpAnnotation;
 
+// ============================================================================
+// [asmjit::InstStorage]
+// ============================================================================
+
+//! Compact instruction storage used by \ref BaseBuilder.
+//!
+//! Instructions are stored in a structure-of-arrays form (instruction ids,
+//! options, operand info, links, and a shared operand pool) and referenced by
+//! 32-bit handles instead of \ref InstNode pointers. Handles are linked by
+//! indexes to form lists, which are owned by \ref InstBlockNode nodes, so each
+//! instruction costs only its operands and 21 bytes of metadata compared to
+//! 128 bytes (or more) required by \ref InstNode on 64-bit targets.
+//!
+//! The storage is only used by \ref BaseBuilder when compact instruction
+//! storage is enabled, see \ref BaseBuilder::setCompactInstStorage().
+//!
+//! \note Operand pointers returned by \ref operands() are only valid until
+//! another instruction is added to the storage.
+class InstStorage {
+public:
+  ASMJIT_NONCOPYABLE(InstStorage)
+
+  //! Index-based link of a single instruction.
+  struct Link {
+    //! Previous instruction handle or \ref kInvalidHandle.
+    uint32_t prev;
+    //! Next instruction handle or \ref kInvalidHandle.
+    uint32_t next;
+  };
+
+  enum : uint32_t {
+    //! Invalid instruction handle, terminates instruction lists.
+    kInvalidHandle = Globals::kInvalidId,
+    //! Mask of operand count stored in `_opInfo`.
+    kOpCountMask = 0x0Fu,
+    //! Instruction has an extra register stored before its operands.
+    kOpInfoExtraReg = 0x10u
+  };
+
+  //! Instruction ids.
+  ZoneVector<uint32_t> _instIds {};
+  //! Instruction options.
+  ZoneVector<uint32_t> _instOptions {};
+  //! Index of the first operand (or the extra register) in `_operands`.
+  ZoneVector<uint32_t> _opIndexes {};
+  //! Operand count combined with `kOpInfo...` flags.
+  ZoneVector<uint8_t> _opInfo {};
+  //! Instruction links.
+  ZoneVector<Link> _links {};
+  //! Operands of all instructions.
+  ZoneVector<Operand_> _operands {};
+
+  //! \name Construction & Destruction
+  //! \{
+
+  inline InstStorage() noexcept {}
+
+  //! Resets the storage, the memory must be released by the owner of the allocator.
+  inline void reset() noexcept {
+    _instIds.reset();
+    _instOptions.reset();
+    _opIndexes.reset();
+    _opInfo.reset();
+    _links.reset();
+    _operands.reset();
+  }
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  //! Returns the number of handles allocated, including unlinked instructions.
+  inline uint32_t size() const noexcept { return _instIds.size(); }
+
+  //! Returns the handle of the instruction that precedes `h`.
+  inline uint32_t prev(uint32_t h) const noexcept { return _links[h].prev; }
+  //! Returns the handle of the instruction that follows `h`.
+  inline uint32_t next(uint32_t h) const noexcept { return _links[h].next; }
+
+  //! Returns the instruction id of `h`.
+  inline uint32_t instId(uint32_t h) const noexcept { return _instIds[h]; }
+  //! Sets the instruction id of `h`.
+  inline void setInstId(uint32_t h, uint32_t instId) noexcept { _instIds[h] = instId; }
+
+  //! Returns the instruction options of `h`.
+  inline uint32_t instOptions(uint32_t h) const noexcept { return _instOptions[h]; }
+  //! Sets the instruction options of `h`.
+  inline void setInstOptions(uint32_t h, uint32_t options) noexcept { _instOptions[h] = options; }
+
+  //! Returns the operand count of `h`.
+  inline uint32_t opCount(uint32_t h) const noexcept { return _opInfo[h] & kOpCountMask; }
+  //! Tests whether `h` has an extra register.
+  inline bool hasExtraReg(uint32_t h) const noexcept { return (_opInfo[h] & kOpInfoExtraReg) != 0; }
+
+  //! Returns operands of `h`.
+  inline Operand* operands(uint32_t h) noexcept {
+    return static_cast<Operand*>(_operands.data() + _opIndexes[h] + uint32_t(hasExtraReg(h)));
+  }
+  //! \overload
+  inline const Operand* operands(uint32_t h) const noexcept {
+    return static_cast<const Operand*>(_operands.data() + _opIndexes[h] + uint32_t(hasExtraReg(h)));
+  }
+
+  //! Returns the instruction `h` as \ref BaseInst (id, options, and extra register).
+  inline BaseInst baseInst(uint32_t h) const noexcept {
+    BaseInst inst(instId(h), instOptions(h));
+    if (hasExtraReg(h)) {
+      const Operand_& reg = _operands[_opIndexes[h]];
+      inst.extraReg().init(reg.signature(), reg.id());
+    }
+    return inst;
+  }
+
+  //! \}
+
+  //! \name Instructions
+  //! \{
+
+  //! Adds a new unlinked instruction to the storage and stores its handle to `out`.
+  ASMJIT_API Error add(ZoneAllocator* allocator, const BaseInst& inst, const Operand_* operands, uint32_t opCount, uint32_t* out) noexcept;
+
+  //! Links instruction `h` after `ref` in `block`, or as the first instruction
+  //! of `block` if `ref` is \ref kInvalidHandle.
+  ASMJIT_API void insertAfter(InstBlockNode* block, uint32_t h, uint32_t ref) noexcept;
+  //! Links instruction `h` at the end of `block`.
+  ASMJIT_API void append(InstBlockNode* block, uint32_t h) noexcept;
+  //! Unlinks instruction `h` from `block`.
+  //!
+  //! The storage of `h` is not reused until the whole storage is reset.
+  ASMJIT_API void remove(InstBlockNode* block, uint32_t h) noexcept;
+
+  //! \}
+};
+
+// ============================================================================
+// [asmjit::BuilderLayoutEntry]
+// ============================================================================
+
+//! Instruction whose offsets are recorded by \ref BaseBuilder::layoutTo().
+struct BuilderLayoutEntry {
+  //! Layout flags.
+  enum Flags : uint32_t {
+    //! The instruction uses \ref BaseInst::kOptionShortForm, but its target
+    //! is out of range of the short form in the layout.
+    kFlagShortFormOutOfRange = 0x00000001u
+  };
+
+  //! Either \ref InstNode or \ref InstBlockNode.
+  BaseNode* node;
+  //! Instruction handle if `node` is \ref InstBlockNode, otherwise \ref InstStorage::kInvalidHandle.
+  uint32_t handle;
+  //! Id of the section the instruction was emitted to.
+  uint32_t sectionId;
+  //! Layout flags, see \ref Flags.
+  uint32_t flags;
+  //! Offset of the first byte of the instruction, relative to its section.
+  size_t start;
+  //! Offset past the last byte of the instruction, relative to its section.
+  size_t end;
+
+  inline void reset(BaseNode* node_, uint32_t handle_ = InstStorage::kInvalidHandle) noexcept {
+    node = node_;
+    handle = handle_;
+    sectionId = Globals::kInvalidId;
+    flags = 0;
+    start = 0;
+    end = 0;
+  }
+
+  inline size_t size() const noexcept { return end - start; }
+  //! Tests whether the given layout `flag` is set.
+  inline bool hasFlag(uint32_t flag) const noexcept { return (flags & flag) != 0; }
+};
+
 // ============================================================================
 // [asmjit::BaseBuilder]
 // ============================================================================
@@ -110,10 +286,15 @@ public:
   //! Last node of the current section.
   BaseNode* _lastNode = nullptr;
 
+  //! Compact instruction storage used by \ref InstBlockNode nodes.
+  InstStorage _instStorage;
+
   //! Flags assigned to each new node.
   uint32_t _nodeFlags = 0;
   //! The sections links are dirty (used internally).
   bool _dirtySectionLinks = false;
+  //! Instructions are stored in \ref InstBlockNode nodes instead of \ref InstNode.
+  bool _compactInstStorage = false;
 
   //! \name Construction & Destruction
   //! \{
@@ -133,6 +314,10 @@ public:
   //! Returns the last node.
   inline BaseNode* lastNode() const noexcept { return _lastNode; }
 
+  //! Returns the zone used to allocate nodes, which can be shared by threads
+  //! through \ref ConcurrentZone.
+  inline Zone* codeZone() noexcept { return &_codeZone; }
+
   //! Allocates and instantiates a new node of type `T` and returns its instance.
   //! If the allocation fails `nullptr` is returned.
   //!
@@ -151,6 +336,14 @@ public:
 
   //! Creates a new \ref InstNode.
   ASMJIT_API Error _newInstNode(InstNode** out, uint32_t instId, uint32_t instOptions, uint32_t opCount);
+  //! Creates a new \ref InstNode in `zone`, which must be either \ref codeZone()
+  //! or a \ref ZoneArena of it.
+  //!
+  //! The Builder is not modified and errors are not reported, thus it can be
+  //! called by multiple threads at once, each using its own `zone`.
+  ASMJIT_API Error _newInstNode(Zone* zone, InstNode** out, uint32_t instId, uint32_t instOptions, uint32_t opCount) const noexcept;
+  //! Creates a new \ref InstBlockNode.
+  ASMJIT_API Error _newInstBlockNode(InstBlockNode** out);
   //! Creates a new \ref LabelNode.
   ASMJIT_API Error _newLabelNode(LabelNode** out);
   //! Creates a new \ref AlignNode.
@@ -197,6 +390,32 @@ public:
 
   //! \}
 
+  //! \name Compact Instruction Storage
+  //! \{
+
+  //! Tests whether new instructions are added to \ref InstBlockNode nodes.
+  inline bool hasCompactInstStorage() const noexcept { return _compactInstStorage; }
+
+  //! Enables or disables compact instruction storage.
+  //!
+  //! When enabled, instructions without an inline comment are not stored as
+  //! \ref InstNode, instead consecutive instructions are stored in a single
+  //! \ref InstBlockNode that references them in \ref instStorage(). This
+  //! decreases memory consumed per instruction considerably, but passes that
+  //! need a node per instruction have to call \ref expandInstBlocks() first.
+  inline void setCompactInstStorage(bool value) noexcept { _compactInstStorage = value; }
+
+  //! Returns the compact instruction storage.
+  inline InstStorage& instStorage() noexcept { return _instStorage; }
+  //! \overload
+  inline const InstStorage& instStorage() const noexcept { return _instStorage; }
+
+  //! Replaces all \ref InstBlockNode nodes in `[first, stop)` range by \ref
+  //! InstNode nodes, so the range can be processed node by node.
+  ASMJIT_API Error expandInstBlocks(BaseNode* first, BaseNode* stop = nullptr);
+
+  //! \}
+
   //! \name Section Management
   //! \{
 
@@ -359,6 +578,49 @@ public:
   //! nodes held by Builder/Compiler into another Builder-like emitter.
   ASMJIT_API Error serializeTo(BaseEmitter* dst);
 
+  //! Relaxes branches to labels by using their short form where possible.
+  //!
+  //! Lays out the code by serializing all nodes into `layoutAssembler`, which
+  //! must be an assembler of the target architecture that is not attached to
+  //! any \ref CodeHolder (it's attached to a temporary one during relaxation).
+  //! Each branch whose target is bound in the same section and is in range of
+  //! the short form gets \ref BaseInst::kOptionShortForm, which changes the
+  //! layout, so the process repeats until it converges. Branches that already
+  //! use either \ref BaseInst::kOptionShortForm or \ref BaseInst::kOptionLongForm
+  //! are left as is.
+  //!
+  //! Since only instruction options are changed, label links, relocations,
+  //! and label deltas are computed by \ref serializeTo() for the final layout.
+  //!
+  //! \note This is done by `finalize()` if \ref kEncodingOptionRelaxBranches is set.
+  ASMJIT_API Error relaxBranches(BaseAssembler* layoutAssembler);
+
+  //! Lays out the code without changing it.
+  //!
+  //! Initializes `layoutCode` to mirror sections and labels of the attached
+  //! \ref CodeHolder (including code already emitted to it), attaches the
+  //! `layoutAssembler` to it, and serializes all nodes. Offsets of instructions
+  //! listed in `entries`, which must be in node order, are recorded, offsets of
+  //! labels can be queried from `layoutCode`. The `layoutAssembler` stays
+  //! attached to `layoutCode` afterwards.
+  //!
+  //! Used by passes that make decisions based on the final layout, see
+  //! \ref relaxBranches().
+  //!
+  //! Displacements that are out of range don't fail the layout. Links to
+  //! labels bound later are left unresolved in `layoutCode`, and recorded
+  //! instructions that use \ref BaseInst::kOptionShortForm are laid out in
+  //! their long form if the short form doesn't fit. Recorded instructions
+  //! that use the short form and whose target is out of its range get
+  //! \ref BuilderLayoutEntry::kFlagShortFormOutOfRange, so callers must check
+  //! the flags of entries to verify the layout, the serialization of such
+  //! code would fail.
+  //!
+  //! \note Labels bound in the attached \ref CodeHolder are bound in the
+  //! layout as well, so the layout fails with \ref kErrorLabelAlreadyBound
+  //! after the nodes were serialized.
+  ASMJIT_API Error layoutTo(CodeHolder* layoutCode, BaseAssembler* layoutAssembler, BuilderLayoutEntry* entries, size_t count);
+
   //! \}
 
   //! \name Events
@@ -369,6 +631,13 @@ public:
 
   //! \}
 
+  //! \name Memory Usage
+  //! \{
+
+  ASMJIT_API void addMemoryUsage(MemoryUsage* usage) const noexcept override;
+
+  //! \}
+
 #ifndef ASMJIT_NO_DEPRECATED
   ASMJIT_DEPRECATED("Use serializeTo() instead, serialize() is now also an instruction.")
   inline Error serialize(BaseEmitter* dst) {
@@ -514,6 +783,8 @@ public:
     kNodeComment = 9,
     //! Node is \ref SentinelNode.
     kNodeSentinel = 10,
+    //! Node is \ref InstBlockNode.
+    kNodeInstBlock = 11,
 
     // [BaseCompiler]
 
@@ -622,6 +893,8 @@ public:
   inline bool isComment() const noexcept { return type() == kNodeComment; }
   //! Tests whether this node is `SentinelNode`.
   inline bool isSentinel() const noexcept { return type() == kNodeSentinel; }
+  //! Tests whether this node is `InstBlockNode`.
+  inline bool isInstBlock() const noexcept { return type() == kNodeInstBlock; }
 
   //! Tests whether this node is `FuncNode`.
   inline bool isFunc() const noexcept { return type() == kNodeFunc; }
@@ -946,6 +1219,64 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::InstBlockNode]
+// ============================================================================
+
+//! Instruction block node.
+//!
+//! References a list of consecutive instructions stored in \ref InstStorage
+//! of the Builder by their 32-bit handles. Created by \ref BaseBuilder when
+//! compact instruction storage is enabled. Instructions can be iterated the
+//! following way:
+//!
+//! ```
+//! const InstStorage& storage = cb->instStorage();
+//! for (uint32_t h = block->firstInst(); h != InstStorage::kInvalidHandle; h = storage.next(h)) {
+//!   BaseInst inst = storage.baseInst(h);
+//!   const Operand* operands = storage.operands(h);
+//!   uint32_t opCount = storage.opCount(h);
+//! }
+//! ```
+class InstBlockNode : public BaseNode {
+public:
+  ASMJIT_NONCOPYABLE(InstBlockNode)
+
+  //! First instruction handle.
+  uint32_t _firstInst;
+  //! Last instruction handle.
+  uint32_t _lastInst;
+  //! Count of instructions in the block.
+  uint32_t _instCount;
+
+  //! \name Construction & Destruction
+  //! \{
+
+  //! Creates a new `InstBlockNode` instance.
+  inline InstBlockNode(BaseBuilder* cb) noexcept
+    : BaseNode(cb, kNodeInstBlock, kFlagIsCode | kFlagIsRemovable),
+      _firstInst(InstStorage::kInvalidHandle),
+      _lastInst(InstStorage::kInvalidHandle),
+      _instCount(0) {}
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  //! Tests whether the block has no instructions.
+  inline bool empty() const noexcept { return _instCount == 0; }
+  //! Returns the count of instructions in the block.
+  inline uint32_t instCount() const noexcept { return _instCount; }
+
+  //! Returns the first instruction handle or \ref InstStorage::kInvalidHandle.
+  inline uint32_t firstInst() const noexcept { return _firstInst; }
+  //! Returns the last instruction handle or \ref InstStorage::kInvalidHandle.
+  inline uint32_t lastInst() const noexcept { return _lastInst; }
+
+  //! \}
+};
+
 // ============================================================================
 // [asmjit::SectionNode]
 // ============================================================================
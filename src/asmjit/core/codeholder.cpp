@@ -28,8 +28,14 @@
 #include "../core/support.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <tuple>
 
+#if defined(ASMJIT_TEST) && defined(ASMJIT_BUILD_X86)
+  #include "../x86/x86assembler.h"
+#endif
+
 ASMJIT_BEGIN_NAMESPACE
 
 // ============================================================================
@@ -43,6 +49,84 @@ static inline uint32_t x86EncodeMod(uint32_t m, uint32_t o, uint32_t rm) noexcep
   return (m << 6) | (o << 3) | rm;
 }
 
+// ============================================================================
+// [asmjit::TaskExecutor]
+// ============================================================================
+
+TaskExecutor::TaskExecutor() noexcept {}
+TaskExecutor::~TaskExecutor() noexcept {}
+
+// ============================================================================
+// [asmjit::ThreadExecutor]
+// ============================================================================
+
+//! Maximum number of threads used by `ThreadExecutor`.
+static constexpr uint32_t kThreadExecutorMaxThreads = 64;
+
+struct ThreadExecutor_Work {
+  TaskExecutor::TaskFunc func;
+  void* data;
+  uint32_t taskCount;
+  std::atomic<uint32_t> nextTask;
+};
+
+static void ThreadExecutor_runTasks(ThreadExecutor_Work* work) noexcept {
+  for (;;) {
+    uint32_t taskIndex = work->nextTask.fetch_add(1, std::memory_order_relaxed);
+    if (taskIndex >= work->taskCount)
+      break;
+    work->func(work->data, taskIndex);
+  }
+}
+
+static bool ThreadExecutor_startThread(std::thread& thread, ThreadExecutor_Work* work) noexcept {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+  try {
+    thread = std::thread(ThreadExecutor_runTasks, work);
+  }
+  catch (...) {
+    return false;
+  }
+#else
+  thread = std::thread(ThreadExecutor_runTasks, work);
+#endif
+  return true;
+}
+
+ThreadExecutor::ThreadExecutor(uint32_t threadCount) noexcept {
+  if (!threadCount)
+    threadCount = Support::max<uint32_t>(std::thread::hardware_concurrency(), 1u);
+  _threadCount = Support::min(threadCount, kThreadExecutorMaxThreads);
+}
+
+ThreadExecutor::~ThreadExecutor() noexcept {}
+
+uint32_t ThreadExecutor::concurrency() const noexcept {
+  return _threadCount;
+}
+
+void ThreadExecutor::run(TaskFunc func, void* data, uint32_t taskCount) noexcept {
+  ThreadExecutor_Work work;
+  work.func = func;
+  work.data = data;
+  work.taskCount = taskCount;
+  work.nextTask.store(0, std::memory_order_relaxed);
+
+  // The calling thread runs tasks too, so it's not counted.
+  uint32_t threadCount = Support::min(_threadCount, taskCount);
+  uint32_t startedCount = 0;
+  std::thread threads[kThreadExecutorMaxThreads];
+
+  // Tasks of threads that failed to start are run by the others.
+  while (startedCount + 1 < threadCount && ThreadExecutor_startThread(threads[startedCount], &work))
+    startedCount++;
+
+  ThreadExecutor_runTasks(&work);
+
+  for (uint32_t i = 0; i < startedCount; i++)
+    threads[i].join();
+}
+
 // ============================================================================
 // [asmjit::LabelLinkIterator]
 // ============================================================================
@@ -85,10 +169,38 @@ public:
 // [asmjit::CodeHolder - Utilities]
 // ============================================================================
 
+static void CodeHolder_updateMemoryUsage(CodeHolder* self) noexcept {
+  MemoryUsage& usage = self->_memoryUsage;
+  usage.resetCurrent();
+
+  usage.addZone(MemoryUsage::kCategoryCodeZone, self->_zone);
+
+  size_t dynamicSize = self->_allocator.dynamicSize();
+  usage.add(MemoryUsage::kCategoryCodeAllocator, dynamicSize, dynamicSize);
+
+  for (const Section* section : self->_sections) {
+    const CodeBuffer& buffer = section->buffer();
+    if (!buffer.isExternal())
+      usage.add(MemoryUsage::kCategoryCodeBuffers, buffer.size(), buffer.capacity());
+  }
+  usage.add(MemoryUsage::kCategoryCodeBuffers, 0, self->_retainedBufferCapacity);
+
+  for (const BaseEmitter* emitter : self->_emitters)
+    emitter->addMemoryUsage(&usage);
+
+  usage.updatePeaks();
+}
+
 static void CodeHolder_resetInternal(CodeHolder* self, uint32_t resetPolicy) noexcept {
   uint32_t i;
   const ZoneVector<BaseEmitter*>& emitters = self->emitters();
 
+  // A soft reset keeps peaks, the memory would be lost by detaching emitters.
+  if (resetPolicy == Globals::kResetSoft)
+    CodeHolder_updateMemoryUsage(self);
+  else
+    self->_memoryUsage.reset();
+
   i = emitters.size();
   while (i)
     self->detach(emitters[--i]);
@@ -99,14 +211,31 @@ static void CodeHolder_resetInternal(CodeHolder* self, uint32_t resetPolicy) noe
   self->_logger = nullptr;
   self->_errorHandler = nullptr;
 
-  // Reset all sections.
+  // Reset all sections, a soft reset keeps the largest buffer for the next `init()`.
   uint32_t numSections = self->_sections.size();
   for (i = 0; i < numSections; i++) {
     Section* section = self->_sections[i];
-    if (section->_buffer.data() && !section->_buffer.isExternal())
-      ::free(section->_buffer._data);
-    section->_buffer._data = nullptr;
-    section->_buffer._capacity = 0;
+    CodeBuffer& buffer = section->_buffer;
+
+    if (buffer.data() && !buffer.isExternal()) {
+      if (resetPolicy == Globals::kResetSoft && buffer.capacity() > self->_retainedBufferCapacity) {
+        ::free(self->_retainedBufferData);
+        self->_retainedBufferData = buffer._data;
+        self->_retainedBufferCapacity = buffer._capacity;
+      }
+      else {
+        ::free(buffer._data);
+      }
+    }
+
+    buffer._data = nullptr;
+    buffer._capacity = 0;
+  }
+
+  if (resetPolicy == Globals::kResetHard) {
+    ::free(self->_retainedBufferData);
+    self->_retainedBufferData = nullptr;
+    self->_retainedBufferCapacity = 0;
   }
 
   // Reset zone allocator and all containers using it.
@@ -118,6 +247,9 @@ static void CodeHolder_resetInternal(CodeHolder* self, uint32_t resetPolicy) noe
   self->_labelEntries.reset();
   self->_sections.reset();
   self->_sectionsByOrder.reset();
+  self->_labelLinkPacks.reset();
+  self->_linkFormats.reset();
+  self->_lastLinkFormatId = 0;
 
   self->_unresolvedLinkCount = 0;
   self->_addressTableSection = nullptr;
@@ -145,8 +277,13 @@ CodeHolder::CodeHolder() noexcept
     _errorHandler(nullptr),
     _zone(16384 - Zone::kBlockOverhead),
     _allocator(&_zone),
+    _lastLinkFormatId(0),
     _unresolvedLinkCount(0),
-    _addressTableSection(nullptr) {}
+    _addressTableSection(nullptr),
+    _retainedBufferData(nullptr),
+    _retainedBufferCapacity(0) {
+  _memoryUsage.reset();
+}
 
 CodeHolder::~CodeHolder() noexcept {
   CodeHolder_resetInternal(this, Globals::kResetHard);
@@ -165,6 +302,15 @@ inline void CodeHolder_setSectionDefaultName(
   section->_name.u32[1] = Support::bytepack32_4x8(uint8_t(c4), uint8_t(c5), uint8_t(c6), uint8_t(c7));
 }
 
+Error CodeHolder::setBlockSource(ZoneBlockSource* source) noexcept {
+  if (isInitialized())
+    return DebugUtils::errored(kErrorAlreadyInitialized);
+
+  _allocator.reset(&_zone);
+  _zone.setBlockSource(source);
+  return kErrorOk;
+}
+
 Error CodeHolder::init(const Environment& environment, uint64_t baseAddress) noexcept {
   // Cannot reinitialize if it's locked or there is one or more emitter attached.
   if (isInitialized())
@@ -181,6 +327,13 @@ Error CodeHolder::init(const Environment& environment, uint64_t baseAddress) noe
     if (ASMJIT_LIKELY(section)) {
       section->_flags = Section::kFlagExec | Section::kFlagConst;
       CodeHolder_setSectionDefaultName(section, '.', 't', 'e', 'x', 't');
+
+      // Reuse the buffer kept by the last soft reset.
+      section->_buffer._data = _retainedBufferData;
+      section->_buffer._capacity = _retainedBufferCapacity;
+      _retainedBufferData = nullptr;
+      _retainedBufferCapacity = 0;
+
       _sections.appendUnsafe(section);
       _sectionsByOrder.appendUnsafe(section);
     }
@@ -204,6 +357,15 @@ void CodeHolder::reset(uint32_t resetPolicy) noexcept {
   CodeHolder_resetInternal(this, resetPolicy);
 }
 
+// ============================================================================
+// [asmjit::CodeHolder - Memory Usage]
+// ============================================================================
+
+void CodeHolder::memoryUsage(MemoryUsage* out) noexcept {
+  CodeHolder_updateMemoryUsage(this);
+  *out = _memoryUsage;
+}
+
 // ============================================================================
 // [asmjit::CodeHolder - Attach / Detach]
 // ============================================================================
@@ -287,35 +449,45 @@ void CodeHolder::setErrorHandler(ErrorHandler* errorHandler) noexcept {
 // [asmjit::CodeHolder - Code Buffer]
 // ============================================================================
 
+// Updates pointers used by assemblers attached to `self` that emit to `cb`.
+static void CodeHolder_onBufferChanged(CodeHolder* self, CodeBuffer* cb) noexcept {
+  for (BaseEmitter* emitter : self->emitters()) {
+    if (emitter->isAssembler()) {
+      BaseAssembler* a = static_cast<BaseAssembler*>(emitter);
+      if (&a->_section->_buffer == cb) {
+        size_t offset = a->offset();
+
+        a->_bufferData = cb->_data;
+        a->_bufferEnd  = cb->_data + cb->_capacity;
+        a->_bufferPtr  = cb->_data + offset;
+      }
+    }
+  }
+}
+
 static Error CodeHolder_reserveInternal(CodeHolder* self, CodeBuffer* cb, size_t n) noexcept {
   uint8_t* oldData = cb->_data;
   uint8_t* newData;
 
-  if (oldData && !cb->isExternal())
+  if (oldData && !cb->isExternal()) {
     newData = static_cast<uint8_t*>(::realloc(oldData, n));
-  else
+  }
+  else {
     newData = static_cast<uint8_t*>(::malloc(n));
 
+    // The content of an external buffer must be preserved, it's not owned by us.
+    if (newData && oldData)
+      memcpy(newData, oldData, cb->_size);
+  }
+
   if (ASMJIT_UNLIKELY(!newData))
     return DebugUtils::errored(kErrorOutOfMemory);
 
   cb->_data = newData;
   cb->_capacity = n;
+  cb->_flags &= ~CodeBuffer::kFlagIsExternal;
 
-  // Update pointers used by assemblers, if attached.
-  for (BaseEmitter* emitter : self->emitters()) {
-    if (emitter->isAssembler()) {
-      BaseAssembler* a = static_cast<BaseAssembler*>(emitter);
-      if (&a->_section->_buffer == cb) {
-        size_t offset = a->offset();
-
-        a->_bufferData = newData;
-        a->_bufferEnd  = newData + n;
-        a->_bufferPtr  = newData + offset;
-      }
-    }
-  }
-
+  CodeHolder_onBufferChanged(self, cb);
   return kErrorOk;
 }
 
@@ -356,6 +528,38 @@ Error CodeHolder::growBuffer(CodeBuffer* cb, size_t n) noexcept {
   return CodeHolder_reserveInternal(this, cb, capacity - Globals::kAllocOverhead);
 }
 
+Error CodeHolder::setExternalBuffer(CodeBuffer* cb, uint8_t* data, size_t capacity) noexcept {
+  size_t size = cb->size();
+
+  // Make the buffer internal again, preserving its content.
+  if (!data) {
+    if (!cb->isExternal())
+      return kErrorOk;
+
+    cb->_flags &= ~CodeBuffer::kFlagIsFixed;
+    return CodeHolder_reserveInternal(this, cb, Support::max<size_t>(size, 1));
+  }
+
+  if (ASMJIT_UNLIKELY(capacity < size))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  uint8_t* oldData = cb->_data;
+  if (oldData != data) {
+    if (size)
+      memcpy(data, oldData, size);
+
+    if (oldData && !cb->isExternal())
+      ::free(oldData);
+  }
+
+  cb->_data = data;
+  cb->_capacity = capacity;
+  cb->_flags = (cb->_flags & ~CodeBuffer::kFlagIsFixed) | CodeBuffer::kFlagIsExternal;
+
+  CodeHolder_onBufferChanged(this, cb);
+  return kErrorOk;
+}
+
 Error CodeHolder::reserveBuffer(CodeBuffer* cb, size_t n) noexcept {
   size_t capacity = cb->capacity();
 
@@ -525,6 +729,173 @@ LabelLink* CodeHolder::newLabelLink(LabelEntry* le, uint32_t sectionId, size_t o
   return link;
 }
 
+// ============================================================================
+// [asmjit::CodeHolder - Label Link Packs]
+// ============================================================================
+
+//! Maximum number of offset formats that can be referenced by packed links.
+static constexpr uint32_t kLinkFormatMaxCount = 256;
+//! Maximum size of a single encoded link (format id + 2 varints).
+static constexpr uint32_t kLinkPackMaxLinkSize = 1 + 10 + 10;
+//! Size of the first pack of each label (including `LabelLinkPack` header).
+static constexpr uint32_t kLinkPackInitialSize = 64;
+//! Maximum size of a pack, kept within pooled `ZoneAllocator` slots.
+static constexpr uint32_t kLinkPackMaxSize = ZoneAllocator::kHiMaxSize;
+
+static ASMJIT_INLINE uint64_t LabelLinkPack_zigzag(int64_t x) noexcept {
+  return (uint64_t(x) << 1) ^ uint64_t(x >> 63);
+}
+
+static ASMJIT_INLINE int64_t LabelLinkPack_unzigzag(uint64_t x) noexcept {
+  return int64_t(x >> 1) ^ -int64_t(x & 1u);
+}
+
+static ASMJIT_INLINE uint8_t* LabelLinkPack_writeVarU(uint8_t* p, uint64_t x) noexcept {
+  while (x >= 0x80u) {
+    *p++ = uint8_t(x | 0x80u);
+    x >>= 7;
+  }
+  *p++ = uint8_t(x);
+  return p;
+}
+
+static ASMJIT_INLINE const uint8_t* LabelLinkPack_readVarU(const uint8_t* p, uint64_t* out) noexcept {
+  uint64_t x = *p++;
+  if (x >= 0x80u) {
+    uint32_t shift = 7;
+    x &= 0x7Fu;
+    uint64_t b;
+    do {
+      b = *p++;
+      x |= (b & 0x7Fu) << shift;
+      shift += 7;
+    } while (b >= 0x80u);
+  }
+  *out = x;
+  return p;
+}
+
+static uint32_t CodeHolder_linkFormatId(CodeHolder* self, const OffsetFormat& format) noexcept {
+  ZoneVector<OffsetFormat>& formats = self->_linkFormats;
+  uint32_t count = formats.size();
+
+  // Most links of the same code use the same format, so try the last one first.
+  uint32_t lastId = self->_lastLinkFormatId;
+  if (lastId < count && memcmp(&formats[lastId], &format, sizeof(OffsetFormat)) == 0)
+    return lastId;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (memcmp(&formats[i], &format, sizeof(OffsetFormat)) == 0) {
+      self->_lastLinkFormatId = i;
+      return i;
+    }
+  }
+
+  if (count >= kLinkFormatMaxCount || formats.append(&self->_allocator, format) != kErrorOk)
+    return Globals::kInvalidId;
+
+  self->_lastLinkFormatId = count;
+  return count;
+}
+
+//! Patches all links of `pack` pointing to `targetOffset`, the offset of each
+//! link is relative to `fromBase`. Links that cannot be patched are converted
+//! to regular `LabelLink`s so they stay unresolved.
+static Error CodeHolder_resolveLinkPack(
+  CodeHolder* self, LabelEntry* le, const LabelLinkPack* pack,
+  uint64_t targetOffset, uint64_t fromBase, Support::FastUInt8 of) noexcept {
+
+  const OffsetFormat* formats = self->_linkFormats.data();
+  CodeBuffer& buf = self->_sections[pack->sectionId]->buffer();
+
+  const uint8_t* p = pack->data();
+  const uint8_t* end = p + pack->size;
+
+  Error err = kErrorOk;
+  uint64_t linkOffset = 0;
+
+  self->_unresolvedLinkCount -= pack->count;
+  while (p != end) {
+    uint32_t formatId = *p++;
+    uint64_t offsetDelta;
+    uint64_t relValue;
+
+    p = LabelLinkPack_readVarU(p, &offsetDelta);
+    p = LabelLinkPack_readVarU(p, &relValue);
+
+    linkOffset += uint64_t(LabelLinkPack_unzigzag(offsetDelta));
+    int64_t rel = LabelLinkPack_unzigzag(relValue);
+
+    const OffsetFormat& format = formats[formatId];
+    ASMJIT_ASSERT(linkOffset < buf.size());
+    ASMJIT_ASSERT(buf.size() - size_t(linkOffset) >= format.regionSize());
+
+    Support::FastUInt8 localOF = of;
+    uint64_t fromOffset = Support::addOverflow<uint64_t>(fromBase, linkOffset, &localOF);
+    int64_t displacement = int64_t(targetOffset - fromOffset + uint64_t(rel));
+
+    if (!localOF && CodeWriterUtils::writeOffset(buf._data + size_t(linkOffset), displacement, format))
+      continue;
+
+    if (ASMJIT_UNLIKELY(!self->newLabelLink(le, pack->sectionId, size_t(linkOffset), intptr_t(rel), format)))
+      return DebugUtils::errored(kErrorOutOfMemory);
+    err = DebugUtils::errored(kErrorInvalidDisplacement);
+  }
+
+  return err;
+}
+
+static ASMJIT_INLINE void CodeHolder_releaseLinkPack(CodeHolder* self, LabelLinkPack* pack) noexcept {
+  self->_allocator.release(pack, sizeof(LabelLinkPack) + pack->capacity);
+}
+
+Error CodeHolder::addLabelLink(LabelEntry* le, uint32_t sectionId, size_t offset, intptr_t rel, const OffsetFormat& format) noexcept {
+  uint32_t labelId = le->id();
+  uint32_t formatId = CodeHolder_linkFormatId(this, format);
+
+  if (ASMJIT_UNLIKELY(formatId == Globals::kInvalidId))
+    return newLabelLink(le, sectionId, offset, rel, format) ? kErrorOk : DebugUtils::errored(kErrorOutOfMemory);
+
+  if (labelId >= _labelLinkPacks.size())
+    ASMJIT_PROPAGATE(_labelLinkPacks.resize(&_allocator, _labelEntries.size()));
+
+  LabelLinkPack* pack = _labelLinkPacks[labelId];
+  if (!pack || pack->sectionId != sectionId || pack->capacity - pack->size < kLinkPackMaxLinkSize) {
+    // Each new pack of the same section doubles the size of the previous one.
+    uint32_t packSize = kLinkPackInitialSize;
+    if (pack && pack->sectionId == sectionId)
+      packSize = Support::min<uint32_t>((pack->capacity + uint32_t(sizeof(LabelLinkPack))) * 2u, kLinkPackMaxSize);
+
+    size_t allocatedSize;
+    LabelLinkPack* newPack = static_cast<LabelLinkPack*>(_allocator.alloc(packSize, allocatedSize));
+
+    if (ASMJIT_UNLIKELY(!newPack))
+      return DebugUtils::errored(kErrorOutOfMemory);
+
+    newPack->next = pack;
+    newPack->sectionId = sectionId;
+    newPack->count = 0;
+    newPack->size = 0;
+    newPack->capacity = uint32_t(allocatedSize - sizeof(LabelLinkPack));
+    newPack->lastOffset = 0;
+
+    pack = newPack;
+    _labelLinkPacks[labelId] = pack;
+  }
+
+  uint8_t* p = pack->data() + pack->size;
+  *p++ = uint8_t(formatId);
+  p = LabelLinkPack_writeVarU(p, LabelLinkPack_zigzag(int64_t(uint64_t(offset) - pack->lastOffset)));
+  p = LabelLinkPack_writeVarU(p, LabelLinkPack_zigzag(int64_t(rel)));
+
+  pack->count++;
+  pack->size = uint32_t(size_t(p - pack->data()));
+  pack->lastOffset = offset;
+
+  _unresolvedLinkCount++;
+  return kErrorOk;
+}
+
 Error CodeHolder::newLabelEntry(LabelEntry** entryOut) noexcept {
   *entryOut = nullptr;
 
@@ -629,12 +1000,12 @@ ASMJIT_API Error CodeHolder::resolveUnresolvedLinks() noexcept {
     if (!le->isBound())
       continue;
 
+    Support::FastUInt8 of = 0;
+    Section* toSection = le->section();
+    uint64_t toOffset = Support::addOverflow(toSection->offset(), le->offset(), &of);
+
     LabelLinkIterator link(le);
     if (link) {
-      Support::FastUInt8 of = 0;
-      Section* toSection = le->section();
-      uint64_t toOffset = Support::addOverflow(toSection->offset(), le->offset(), &of);
-
       do {
         uint32_t linkSectionId = link->sectionId;
         if (link->relocId == Globals::kInvalidId) {
@@ -667,6 +1038,25 @@ ASMJIT_API Error CodeHolder::resolveUnresolvedLinks() noexcept {
         link.next();
       } while (link);
     }
+
+    // Packed links that remained are always cross-section.
+    LabelLinkPack* pack = labelLinkPacks(le->id());
+    if (pack) {
+      _labelLinkPacks[le->id()] = nullptr;
+      do {
+        LabelLinkPack* next = pack->next;
+        Error packErr = CodeHolder_resolveLinkPack(this, le, pack, toOffset, _sections[pack->sectionId]->offset(), of);
+
+        if (ASMJIT_UNLIKELY(packErr == kErrorOutOfMemory))
+          return packErr;
+
+        if (packErr)
+          err = packErr;
+
+        CodeHolder_releaseLinkPack(this, pack);
+        pack = next;
+      } while (pack);
+    }
   }
 
   return err;
@@ -730,6 +1120,34 @@ ASMJIT_API Error CodeHolder::bindLabel(const Label& label, uint32_t toSectionId,
     link.resolveAndNext(this);
   }
 
+  // Patch packed links of the same section in bulk, other packs are kept for
+  // `resolveUnresolvedLinks()`. Links that couldn't be patched are converted
+  // to regular links by `CodeHolder_resolveLinkPack()`.
+  if (le->id() < _labelLinkPacks.size()) {
+    LabelLinkPack** pPrev = &_labelLinkPacks[le->id()];
+    LabelLinkPack* pack = *pPrev;
+
+    while (pack) {
+      LabelLinkPack* next = pack->next;
+      if (pack->sectionId == toSectionId) {
+        Error packErr = CodeHolder_resolveLinkPack(this, le, pack, toOffset, 0, 0);
+
+        if (ASMJIT_UNLIKELY(packErr == kErrorOutOfMemory))
+          return packErr;
+
+        if (packErr)
+          err = packErr;
+
+        *pPrev = next;
+        CodeHolder_releaseLinkPack(this, pack);
+      }
+      else {
+        pPrev = &pack->next;
+      }
+      pack = next;
+    }
+  }
+
   return err;
 }
 
@@ -896,158 +1314,285 @@ size_t CodeHolder::codeSize() const noexcept {
   return size_t(offset);
 }
 
-Error CodeHolder::relocateToBase(uint64_t baseAddress) noexcept {
-  // Base address must be provided.
-  if (ASMJIT_UNLIKELY(baseAddress == Globals::kNoBaseAddress))
-    return DebugUtils::errored(kErrorInvalidArgument);
+// Relocation
+// ----------
+//
+// Relocation entries are independent of each other except of entries of
+// `RelocEntry::kTypeX64AddressEntry` type, which may allocate slots in the
+// address table in the order they are processed. If the code has an address
+// table the parallel relocation processes these entries first by the calling
+// thread, in the same order as the serial relocation does, and then it
+// partitions the rest into ranges that are processed by tasks. Each entry
+// writes only its own region, so the result is the same regardless of the
+// order in which the ranges are processed.
+
+struct CodeHolder_RelocContext {
+  uint64_t baseAddress;
+  uint32_t addressSize;
+  uint32_t addressTableEntryCount;
+  Section* addressTableSection;
+  uint8_t* addressTableEntryData;
+};
 
-  _baseAddress = baseAddress;
-  uint32_t addressSize = _environment.registerSize();
+static Error CodeHolder_relocateEntry(CodeHolder* self, CodeHolder_RelocContext& ctx, const RelocEntry* re) noexcept {
+  uint64_t baseAddress = ctx.baseAddress;
+  uint32_t addressSize = ctx.addressSize;
 
-  Section* addressTableSection = _addressTableSection;
-  uint32_t addressTableEntryCount = 0;
-  uint8_t* addressTableEntryData = nullptr;
+  Section* sourceSection = self->sectionById(re->sourceSectionId());
+  Section* targetSection = nullptr;
 
-  if (addressTableSection) {
-    ASMJIT_PROPAGATE(
-      reserveBuffer(&addressTableSection->_buffer, size_t(addressTableSection->virtualSize())));
-    addressTableEntryData = addressTableSection->_buffer.data();
-  }
+  if (re->targetSectionId() != Globals::kInvalidId)
+    targetSection = self->sectionById(re->targetSectionId());
 
-  // Relocate all recorded locations.
-  for (const RelocEntry* re : _relocations) {
-    // Possibly deleted or optimized-out entry.
-    if (re->relocType() == RelocEntry::kTypeNone)
-      continue;
+  uint64_t value = re->payload();
+  uint64_t sectionOffset = sourceSection->offset();
+  uint64_t sourceOffset = re->sourceOffset();
 
-    Section* sourceSection = sectionById(re->sourceSectionId());
-    Section* targetSection = nullptr;
+  // Make sure that the `RelocEntry` doesn't go out of bounds.
+  size_t regionSize = re->format().regionSize();
+  if (ASMJIT_UNLIKELY(re->sourceOffset() >= sourceSection->bufferSize() ||
+                      sourceSection->bufferSize() - size_t(re->sourceOffset()) < regionSize))
+    return DebugUtils::errored(kErrorInvalidRelocEntry);
 
-    if (re->targetSectionId() != Globals::kInvalidId)
-      targetSection = sectionById(re->targetSectionId());
+  uint8_t* buffer = sourceSection->data();
+  size_t valueOffset = size_t(re->sourceOffset()) + re->format().valueOffset();
+
+  switch (re->relocType()) {
+    case RelocEntry::kTypeExpression: {
+      Expression* expression = (Expression*)(uintptr_t(value));
+      ASMJIT_PROPAGATE(CodeHolder_evaluateExpression(self, expression, &value));
+      break;
+    }
 
-    uint64_t value = re->payload();
-    uint64_t sectionOffset = sourceSection->offset();
-    uint64_t sourceOffset = re->sourceOffset();
+    case RelocEntry::kTypeAbsToAbs: {
+      break;
+    }
 
-    // Make sure that the `RelocEntry` doesn't go out of bounds.
-    size_t regionSize = re->format().regionSize();
-    if (ASMJIT_UNLIKELY(re->sourceOffset() >= sourceSection->bufferSize() ||
-                        sourceSection->bufferSize() - size_t(re->sourceOffset()) < regionSize))
-      return DebugUtils::errored(kErrorInvalidRelocEntry);
+    case RelocEntry::kTypeRelToAbs: {
+      // Value is currently a relative offset from the start of its section.
+      // We have to convert it to an absolute offset (including base address).
+      if (ASMJIT_UNLIKELY(!targetSection))
+        return DebugUtils::errored(kErrorInvalidRelocEntry);
 
-    uint8_t* buffer = sourceSection->data();
-    size_t valueOffset = size_t(re->sourceOffset()) + re->format().valueOffset();
+      //value += baseAddress + sectionOffset + sourceOffset + regionSize;
+      value += baseAddress + targetSection->offset();
+      break;
+    }
 
-    switch (re->relocType()) {
-      case RelocEntry::kTypeExpression: {
-        Expression* expression = (Expression*)(uintptr_t(value));
-        ASMJIT_PROPAGATE(CodeHolder_evaluateExpression(this, expression, &value));
-        break;
-      }
+    case RelocEntry::kTypeAbsToRel: {
+      value -= baseAddress + sectionOffset + sourceOffset + regionSize;
+      if (addressSize > 4 && !Support::isInt32(int64_t(value)))
+        return DebugUtils::errored(kErrorRelocOffsetOutOfRange);
+      break;
+    }
 
-      case RelocEntry::kTypeAbsToAbs: {
-        break;
-      }
+    case RelocEntry::kTypeX64AddressEntry: {
+      if (re->format().valueSize() != 4 || valueOffset < 2)
+        return DebugUtils::errored(kErrorInvalidRelocEntry);
 
-      case RelocEntry::kTypeRelToAbs: {
-        // Value is currently a relative offset from the start of its section.
-        // We have to convert it to an absolute offset (including base address).
-        if (ASMJIT_UNLIKELY(!targetSection))
+      // First try whether a relative 32-bit displacement would work.
+      value -= baseAddress + sectionOffset + sourceOffset + regionSize;
+      if (!Support::isInt32(int64_t(value))) {
+        // Relative 32-bit displacement is not possible, use '.addrtab' section.
+        AddressTableEntry* atEntry = self->_addressTableEntries.get(re->payload());
+        if (ASMJIT_UNLIKELY(!atEntry))
           return DebugUtils::errored(kErrorInvalidRelocEntry);
 
-        //value += baseAddress + sectionOffset + sourceOffset + regionSize;
-        value += baseAddress + targetSection->offset();
-        break;
-      }
+        // Cannot be null as we have just matched the `AddressTableEntry`.
+        Section* addressTableSection = ctx.addressTableSection;
+        ASMJIT_ASSERT(addressTableSection != nullptr);
+
+        if (!atEntry->hasAssignedSlot())
+          atEntry->_slot = ctx.addressTableEntryCount++;
 
-      case RelocEntry::kTypeAbsToRel: {
-        value -= baseAddress + sectionOffset + sourceOffset + regionSize;
-        if (addressSize > 4 && !Support::isInt32(int64_t(value)))
+        size_t atEntryIndex = size_t(atEntry->slot()) * addressSize;
+        uint64_t addrSrc = sectionOffset + sourceOffset + regionSize;
+        uint64_t addrDst = addressTableSection->offset() + uint64_t(atEntryIndex);
+
+        value = addrDst - addrSrc;
+        if (!Support::isInt32(int64_t(value)))
           return DebugUtils::errored(kErrorRelocOffsetOutOfRange);
-        break;
-      }
 
-      case RelocEntry::kTypeX64AddressEntry: {
-        if (re->format().valueSize() != 4 || valueOffset < 2)
+        // Bytes that replace [REX, OPCODE] bytes.
+        uint32_t byte0 = 0xFF;
+        uint32_t byte1 = buffer[valueOffset - 1];
+
+        if (byte1 == 0xE8) {
+          // Patch CALL/MOD byte to FF /2 (-> 0x15).
+          byte1 = x86EncodeMod(0, 2, 5);
+        }
+        else if (byte1 == 0xE9) {
+          // Patch JMP/MOD byte to FF /4 (-> 0x25).
+          byte1 = x86EncodeMod(0, 4, 5);
+        }
+        else {
           return DebugUtils::errored(kErrorInvalidRelocEntry);
+        }
 
-        // First try whether a relative 32-bit displacement would work.
-        value -= baseAddress + sectionOffset + sourceOffset + regionSize;
-        if (!Support::isInt32(int64_t(value))) {
-          // Relative 32-bit displacement is not possible, use '.addrtab' section.
-          AddressTableEntry* atEntry = _addressTableEntries.get(re->payload());
-          if (ASMJIT_UNLIKELY(!atEntry))
-            return DebugUtils::errored(kErrorInvalidRelocEntry);
+        // Patch `jmp/call` instruction.
+        buffer[valueOffset - 2] = uint8_t(byte0);
+        buffer[valueOffset - 1] = uint8_t(byte1);
 
-          // Cannot be null as we have just matched the `AddressTableEntry`.
-          ASMJIT_ASSERT(addressTableSection != nullptr);
+        Support::writeU64uLE(ctx.addressTableEntryData + atEntryIndex, re->payload());
+      }
+      break;
+    }
 
-          if (!atEntry->hasAssignedSlot())
-            atEntry->_slot = addressTableEntryCount++;
+    default:
+      return DebugUtils::errored(kErrorInvalidRelocEntry);
+  }
 
-          size_t atEntryIndex = size_t(atEntry->slot()) * addressSize;
-          uint64_t addrSrc = sectionOffset + sourceOffset + regionSize;
-          uint64_t addrDst = addressTableSection->offset() + uint64_t(atEntryIndex);
+  switch (re->format().valueSize()) {
+    case 1:
+      Support::writeU8(buffer + valueOffset, uint32_t(value & 0xFFu));
+      break;
 
-          value = addrDst - addrSrc;
-          if (!Support::isInt32(int64_t(value)))
-            return DebugUtils::errored(kErrorRelocOffsetOutOfRange);
+    case 2:
+      Support::writeU16uLE(buffer + valueOffset, uint32_t(value & 0xFFFFu));
+      break;
 
-          // Bytes that replace [REX, OPCODE] bytes.
-          uint32_t byte0 = 0xFF;
-          uint32_t byte1 = buffer[valueOffset - 1];
+    case 4:
+      Support::writeU32uLE(buffer + valueOffset, uint32_t(value & 0xFFFFFFFFu));
+      break;
 
-          if (byte1 == 0xE8) {
-            // Patch CALL/MOD byte to FF /2 (-> 0x15).
-            byte1 = x86EncodeMod(0, 2, 5);
-          }
-          else if (byte1 == 0xE9) {
-            // Patch JMP/MOD byte to FF /4 (-> 0x25).
-            byte1 = x86EncodeMod(0, 4, 5);
-          }
-          else {
-            return DebugUtils::errored(kErrorInvalidRelocEntry);
-          }
+    case 8:
+      Support::writeU64uLE(buffer + valueOffset, value);
+      break;
 
-          // Patch `jmp/call` instruction.
-          buffer[valueOffset - 2] = uint8_t(byte0);
-          buffer[valueOffset - 1] = uint8_t(byte1);
+    default:
+      return DebugUtils::errored(kErrorInvalidRelocEntry);
+  }
 
-          Support::writeU64uLE(addressTableEntryData + atEntryIndex, re->payload());
-        }
-        break;
-      }
+  return kErrorOk;
+}
 
-      default:
-        return DebugUtils::errored(kErrorInvalidRelocEntry);
+//! Minimum number of relocation entries processed by a single task.
+static constexpr uint32_t kRelocMinEntriesPerTask = 4096;
+//! Maximum number of tasks used to relocate or copy the code.
+static constexpr uint32_t kMaxParallelTasks = 256;
+
+struct CodeHolder_RelocTasks {
+  CodeHolder* self;
+  CodeHolder_RelocContext* ctx;
+  uint32_t entryCount;
+  uint32_t taskCount;
+  //! Relocation type processed by the calling thread before the tasks run.
+  uint32_t skipType;
+
+  //! The first error of each task and the index of the entry that caused it.
+  Error errors[kMaxParallelTasks];
+  uint32_t errorIndexes[kMaxParallelTasks];
+};
+
+static void ASMJIT_CDECL CodeHolder_relocateRange(void* data, uint32_t taskIndex) noexcept {
+  CodeHolder_RelocTasks* tasks = static_cast<CodeHolder_RelocTasks*>(data);
+  CodeHolder* self = tasks->self;
+
+  uint32_t begin = uint32_t(uint64_t(tasks->entryCount) * taskIndex / tasks->taskCount);
+  uint32_t end = uint32_t(uint64_t(tasks->entryCount) * (taskIndex + 1) / tasks->taskCount);
+  const RelocEntry* const* relocations = self->_relocations.data();
+
+  tasks->errors[taskIndex] = kErrorOk;
+  for (uint32_t i = begin; i < end; i++) {
+    const RelocEntry* re = relocations[i];
+
+    // Possibly deleted or optimized-out entry, or an already processed one.
+    if (re->relocType() == RelocEntry::kTypeNone || re->relocType() == tasks->skipType)
+      continue;
+
+    Error err = CodeHolder_relocateEntry(self, *tasks->ctx, re);
+    if (ASMJIT_UNLIKELY(err)) {
+      tasks->errors[taskIndex] = err;
+      tasks->errorIndexes[taskIndex] = i;
+      break;
     }
+  }
+}
 
-    switch (re->format().valueSize()) {
-      case 1:
-        Support::writeU8(buffer + valueOffset, uint32_t(value & 0xFFu));
-        break;
+Error CodeHolder::relocateToBase(uint64_t baseAddress) noexcept {
+  return relocateToBase(baseAddress, nullptr);
+}
 
-      case 2:
-        Support::writeU16uLE(buffer + valueOffset, uint32_t(value & 0xFFFFu));
-        break;
+Error CodeHolder::relocateToBase(uint64_t baseAddress, TaskExecutor* executor) noexcept {
+  // Base address must be provided.
+  if (ASMJIT_UNLIKELY(baseAddress == Globals::kNoBaseAddress))
+    return DebugUtils::errored(kErrorInvalidArgument);
 
-      case 4:
-        Support::writeU32uLE(buffer + valueOffset, uint32_t(value & 0xFFFFFFFFu));
-        break;
+  _baseAddress = baseAddress;
+
+  CodeHolder_RelocContext ctx;
+  ctx.baseAddress = baseAddress;
+  ctx.addressSize = _environment.registerSize();
+  ctx.addressTableEntryCount = 0;
+  ctx.addressTableSection = _addressTableSection;
+  ctx.addressTableEntryData = nullptr;
+
+  Section* addressTableSection = _addressTableSection;
+  if (addressTableSection) {
+    ASMJIT_PROPAGATE(
+      reserveBuffer(&addressTableSection->_buffer, size_t(addressTableSection->virtualSize())));
+    ctx.addressTableEntryData = addressTableSection->_buffer.data();
+  }
+
+  uint32_t entryCount = _relocations.size();
+  uint32_t taskCount = 0;
+
+  if (executor) {
+    taskCount = Support::min<uint32_t>(entryCount / kRelocMinEntriesPerTask,
+                                       Support::min<uint32_t>(executor->concurrency() * 4u, kMaxParallelTasks));
+  }
 
-      case 8:
-        Support::writeU64uLE(buffer + valueOffset, value);
+  if (taskCount <= 1) {
+    // Relocate all recorded locations.
+    for (const RelocEntry* re : _relocations) {
+      // Possibly deleted or optimized-out entry.
+      if (re->relocType() == RelocEntry::kTypeNone)
+        continue;
+      ASMJIT_PROPAGATE(CodeHolder_relocateEntry(this, ctx, re));
+    }
+  }
+  else {
+    // Address entries first, in the order the serial relocation would process
+    // them. This is only necessary if they can allocate address table slots.
+    Error err = kErrorOk;
+    uint32_t errorIndex = entryCount;
+    uint32_t skipType = addressTableSection ? uint32_t(RelocEntry::kTypeX64AddressEntry) : uint32_t(RelocEntry::kTypeNone);
+
+    for (uint32_t i = 0; addressTableSection && i < entryCount; i++) {
+      const RelocEntry* re = _relocations[i];
+      if (re->relocType() != RelocEntry::kTypeX64AddressEntry)
+        continue;
+
+      err = CodeHolder_relocateEntry(this, ctx, re);
+      if (ASMJIT_UNLIKELY(err)) {
+        errorIndex = i;
         break;
+      }
+    }
 
-      default:
-        return DebugUtils::errored(kErrorInvalidRelocEntry);
+    CodeHolder_RelocTasks tasks;
+    tasks.self = this;
+    tasks.ctx = &ctx;
+    tasks.entryCount = entryCount;
+    tasks.taskCount = taskCount;
+    tasks.skipType = skipType;
+    executor->run(CodeHolder_relocateRange, &tasks, taskCount);
+
+    // Report the error of the first failing entry, like the serial relocation does.
+    for (uint32_t i = 0; i < taskCount; i++) {
+      if (tasks.errors[i] && tasks.errorIndexes[i] < errorIndex) {
+        err = tasks.errors[i];
+        errorIndex = tasks.errorIndexes[i];
+      }
     }
+
+    if (ASMJIT_UNLIKELY(err))
+      return err;
   }
 
   // Fixup the virtual size of the address table if it's the last section.
   if (_sectionsByOrder.last() == addressTableSection) {
-    size_t addressTableSize = addressTableEntryCount * addressSize;
+    size_t addressTableSize = ctx.addressTableEntryCount * ctx.addressSize;
     addressTableSection->_buffer._size = addressTableSize;
     addressTableSection->_virtualSize = addressTableSize;
   }
@@ -1075,7 +1620,67 @@ Error CodeHolder::copySectionData(void* dst, size_t dstSize, uint32_t sectionId,
   return kErrorOk;
 }
 
+// Copying flattened data in parallel partitions the destination buffer into
+// byte ranges. Each task copies and pads the parts of all sections that fall
+// into its range in the same order as the serial copy, so bytes written by
+// more than one section (which is only possible if the code isn't flattened)
+// are written in the same order as well.
+
+//! Minimum number of bytes copied by a single task.
+static constexpr size_t kCopyMinBytesPerTask = 256 * 1024;
+
+struct CodeHolder_CopyTasks {
+  CodeHolder* self;
+  uint8_t* dst;
+  size_t dstSize;
+  size_t end;
+  uint32_t copyOptions;
+  uint32_t taskCount;
+};
+
+static void ASMJIT_CDECL CodeHolder_copyRange(void* data, uint32_t taskIndex) noexcept {
+  CodeHolder_CopyTasks* tasks = static_cast<CodeHolder_CopyTasks*>(data);
+
+  size_t rangeStart = size_t(uint64_t(tasks->dstSize) * taskIndex / tasks->taskCount);
+  size_t rangeEnd = size_t(uint64_t(tasks->dstSize) * (taskIndex + 1) / tasks->taskCount);
+
+  for (Section* section : tasks->self->_sectionsByOrder) {
+    size_t bufferSize = section->bufferSize();
+    size_t offset = size_t(section->offset());
+    size_t paddingSize = 0;
+
+    if ((tasks->copyOptions & CodeHolder::kCopyPadSectionBuffer) && bufferSize < section->virtualSize())
+      paddingSize = Support::min<size_t>(tasks->dstSize - offset, size_t(section->virtualSize())) - bufferSize;
+
+    size_t copyStart = Support::max(offset, rangeStart);
+    size_t copyEnd = Support::min(offset + bufferSize, rangeEnd);
+    if (copyStart < copyEnd)
+      memcpy(tasks->dst + copyStart, section->data() + (copyStart - offset), copyEnd - copyStart);
+
+    size_t padStart = Support::max(offset + bufferSize, rangeStart);
+    size_t padEnd = Support::min(offset + bufferSize + paddingSize, rangeEnd);
+    if (padStart < padEnd)
+      memset(tasks->dst + padStart, 0, padEnd - padStart);
+  }
+
+  if (tasks->copyOptions & CodeHolder::kCopyPadTargetBuffer) {
+    size_t padStart = Support::max(tasks->end, rangeStart);
+    if (padStart < rangeEnd)
+      memset(tasks->dst + padStart, 0, rangeEnd - padStart);
+  }
+}
+
 Error CodeHolder::copyFlattenedData(void* dst, size_t dstSize, uint32_t copyOptions) noexcept {
+  return copyFlattenedData(dst, dstSize, copyOptions, nullptr);
+}
+
+Error CodeHolder::copyFlattenedData(void* dst, size_t dstSize, uint32_t copyOptions, TaskExecutor* executor) noexcept {
+  uint32_t taskCount = 0;
+  if (executor) {
+    taskCount = uint32_t(Support::min<size_t>(dstSize / kCopyMinBytesPerTask,
+                                              Support::min<uint32_t>(executor->concurrency(), kMaxParallelTasks)));
+  }
+
   size_t end = 0;
   for (Section* section : _sectionsByOrder) {
     if (section->offset() > dstSize)
@@ -1087,19 +1692,31 @@ Error CodeHolder::copyFlattenedData(void* dst, size_t dstSize, uint32_t copyOpti
     if (ASMJIT_UNLIKELY(dstSize - offset < bufferSize))
       return DebugUtils::errored(kErrorInvalidArgument);
 
-    uint8_t* dstTarget = static_cast<uint8_t*>(dst) + offset;
     size_t paddingSize = 0;
-    memcpy(dstTarget, section->data(), bufferSize);
-
-    if ((copyOptions & kCopyPadSectionBuffer) && bufferSize < section->virtualSize()) {
+    if ((copyOptions & kCopyPadSectionBuffer) && bufferSize < section->virtualSize())
       paddingSize = Support::min<size_t>(dstSize - offset, size_t(section->virtualSize())) - bufferSize;
+
+    // The parallel copy is done after all sections were verified.
+    if (taskCount <= 1) {
+      uint8_t* dstTarget = static_cast<uint8_t*>(dst) + offset;
+      memcpy(dstTarget, section->data(), bufferSize);
       memset(dstTarget + bufferSize, 0, paddingSize);
     }
 
     end = Support::max(end, offset + bufferSize + paddingSize);
   }
 
-  if (end < dstSize && (copyOptions & kCopyPadTargetBuffer)) {
+  if (taskCount > 1) {
+    CodeHolder_CopyTasks tasks;
+    tasks.self = this;
+    tasks.dst = static_cast<uint8_t*>(dst);
+    tasks.dstSize = dstSize;
+    tasks.end = end;
+    tasks.copyOptions = copyOptions;
+    tasks.taskCount = taskCount;
+    executor->run(CodeHolder_copyRange, &tasks, taskCount);
+  }
+  else if (end < dstSize && (copyOptions & kCopyPadTargetBuffer)) {
     memset(static_cast<uint8_t*>(dst) + end, 0, dstSize - end);
   }
 
@@ -1144,7 +1761,190 @@ UNIT(code_holder) {
   EXPECT(code.sections()[3] == section3);
   EXPECT(code.sectionsByOrder()[3] == section3);
 
+  INFO("Verifying CodeHolder::memoryUsage()");
+  MemoryUsage usage;
+  EXPECT(code.reserveBuffer(&code.textSection()->_buffer, 4096) == kErrorOk);
+  code.textSection()->_buffer._size = 100;
+
+  code.memoryUsage(&usage);
+  EXPECT(usage.categories[MemoryUsage::kCategoryCodeZone].usedSize > 0);
+  EXPECT(usage.categories[MemoryUsage::kCategoryCodeBuffers].usedSize == 100);
+  EXPECT(usage.categories[MemoryUsage::kCategoryCodeBuffers].reservedSize >= 4096);
+  EXPECT(usage.categories[MemoryUsage::kCategoryEmitterZones].reservedSize == 0);
+  EXPECT(usage.total.reservedSize >= usage.total.usedSize);
+  EXPECT(usage.peakTotal.reservedSize == usage.total.reservedSize);
+
+  // A soft reset keeps peaks, the used size drops.
+  size_t peakUsedSize = usage.peakTotal.usedSize;
+  code.reset();
+  code.memoryUsage(&usage);
+  EXPECT(usage.categories[MemoryUsage::kCategoryCodeBuffers].usedSize == 0);
+  EXPECT(usage.total.usedSize < peakUsedSize);
+  EXPECT(usage.peakTotal.usedSize == peakUsedSize);
+
+  // A hard reset releases everything, including peaks.
+  code.reset(Globals::kResetHard);
+  code.memoryUsage(&usage);
+  EXPECT(usage.total.reservedSize == 0);
+  EXPECT(usage.peakTotal.reservedSize == 0);
+}
+
+UNIT(label_link_pack) {
+  constexpr uint32_t kLinkCount = 1000;
+  constexpr uint32_t kLinkStride = 5;
+
+  CodeHolder code;
+  Environment env;
+  env.init(Environment::kArchX64);
+  code.init(env);
+
+  OffsetFormat rel8;
+  OffsetFormat rel32;
+  rel8.resetToDataValue(1);
+  rel32.resetToDataValue(4);
+
+  Section* text = code.textSection();
+  Section* data;
+  EXPECT(code.newSection(&data, ".data", SIZE_MAX, 0, 8) == kErrorOk);
+
+  size_t textSize = kLinkCount * kLinkStride + 64;
+  EXPECT(code.reserveBuffer(&text->_buffer, textSize) == kErrorOk);
+  EXPECT(code.reserveBuffer(&data->_buffer, 64) == kErrorOk);
+  memset(text->_buffer._data, 0, textSize);
+  memset(data->_buffer._data, 0, 64);
+  text->_buffer._size = textSize;
+  data->_buffer._size = 64;
+
+  LabelEntry* le;
+  LabelEntry* leFar;
+  EXPECT(code.newLabelEntry(&le) == kErrorOk);
+  EXPECT(code.newLabelEntry(&leFar) == kErrorOk);
+
+  INFO("Verifying packed links patched by CodeHolder::bindLabel()");
+  for (uint32_t i = 0; i < kLinkCount; i++)
+    EXPECT(code.addLabelLink(le, text->id(), i * kLinkStride + 1, -4, rel32) == kErrorOk);
+  EXPECT(code.addLabelLink(le, text->id(), textSize - 2, -1, rel8) == kErrorOk);
+  EXPECT(code.addLabelLink(le, data->id(), 0, -4, rel32) == kErrorOk);
+  EXPECT(code.unresolvedLinkCount() == kLinkCount + 2);
+  EXPECT(code.labelLinkPacks(le->id()) != nullptr);
+
+  uint64_t target = textSize - 8;
+  EXPECT(code.bindLabel(Label(le->id()), text->id(), target) == kErrorOk);
+  EXPECT(code.unresolvedLinkCount() == 1);
+
+  for (uint32_t i = 0; i < kLinkCount; i++) {
+    size_t offset = i * kLinkStride + 1;
+    int32_t expected = int32_t(int64_t(target) - int64_t(offset) - 4);
+    EXPECT(int32_t(Support::readU32uLE(text->_buffer._data + offset)) == expected);
+  }
+  EXPECT(int8_t(text->_buffer._data[textSize - 2]) == int8_t(int64_t(target) - int64_t(textSize - 2) - 1));
+
+  INFO("Verifying packed links that cannot be patched become regular links");
+  EXPECT(code.addLabelLink(leFar, text->id(), 1, -1, rel8) == kErrorOk);
+  EXPECT(code.addLabelLink(leFar, text->id(), 6, -4, rel32) == kErrorOk);
+  EXPECT(code.bindLabel(Label(leFar->id()), text->id(), textSize) == kErrorInvalidDisplacement);
+  EXPECT(leFar->links() != nullptr);
+  EXPECT(leFar->links()->offset == 1);
+  EXPECT(leFar->links()->next == nullptr);
+  EXPECT(code.unresolvedLinkCount() == 2);
+
+  INFO("Verifying cross-section packed links patched by CodeHolder::resolveUnresolvedLinks()");
+  EXPECT(code.flatten() == kErrorOk);
+  EXPECT(code.resolveUnresolvedLinks() == kErrorInvalidDisplacement);
+  EXPECT(code.unresolvedLinkCount() == 1);
+  EXPECT(code.labelLinkPacks(le->id()) == nullptr);
+
+  int64_t crossDisp = int64_t(text->offset() + target) - int64_t(data->offset()) - 4;
+  EXPECT(int32_t(Support::readU32uLE(data->_buffer._data)) == int32_t(crossDisp));
+}
+
+static void ASMJIT_CDECL CodeHolderTest_countTask(void* data, uint32_t taskIndex) noexcept {
+  static_cast<std::atomic<uint32_t>*>(data)[taskIndex].fetch_add(1, std::memory_order_relaxed);
+}
+
+UNIT(thread_executor) {
+  constexpr uint32_t kTaskCount = 100;
+  std::atomic<uint32_t> counters[kTaskCount];
+
+  for (uint32_t threadCount : { 1u, 3u, 8u }) {
+    INFO("Verifying ThreadExecutor running %u tasks by %u threads", kTaskCount, threadCount);
+    ThreadExecutor executor(threadCount);
+    EXPECT(executor.concurrency() == threadCount);
+
+    for (std::atomic<uint32_t>& counter : counters)
+      counter.store(0, std::memory_order_relaxed);
+
+    executor.run(CodeHolderTest_countTask, counters, kTaskCount);
+    for (uint32_t i = 0; i < kTaskCount; i++)
+      EXPECT(counters[i].load(std::memory_order_relaxed) == 1u);
+  }
 }
+
+#if defined(ASMJIT_BUILD_X86)
+// Emits code having many relocations of all kinds into two sections.
+static Error CodeHolderTest_makeRelocatedCode(CodeHolder& code) noexcept {
+  constexpr uint32_t kItemCount = 20000;
+
+  x86::Assembler a(&code);
+  Section* text = code.textSection();
+  Section* data;
+  ASMJIT_PROPAGATE(code.newSection(&data, ".data", SIZE_MAX, 0, 8));
+
+  Label textLabel = a.newLabel();
+  a.bind(textLabel);
+
+  for (uint32_t i = 0; i < kItemCount; i++) {
+    Label dataLabel = a.newLabel();
+
+    ASMJIT_PROPAGATE(a.section(data));
+    ASMJIT_PROPAGATE(a.bind(dataLabel));
+    ASMJIT_PROPAGATE(a.embedLabel(textLabel));
+    ASMJIT_PROPAGATE(a.embedLabelDelta(dataLabel, textLabel, 4));
+
+    // Far calls need the address table, which is shared by each 16 items.
+    uint64_t target = (i & 1) ? uint64_t(0x10000000u + i * 16u) : uint64_t(0x7FF000000000u + (i & 15u) * 16u);
+
+    ASMJIT_PROPAGATE(a.section(text));
+    ASMJIT_PROPAGATE(a.lea(x86::rax, x86::ptr(dataLabel)));
+    ASMJIT_PROPAGATE(a.mov(x86::ecx, x86::dword_ptr(dataLabel)));
+    ASMJIT_PROPAGATE(a.call(imm(target)));
+  }
+
+  return a.ret();
+}
+
+UNIT(code_holder_relocate_parallel) {
+  constexpr uint64_t kBaseAddress = 0x10000000u;
+  constexpr uint32_t kCopyOptions = CodeHolder::kCopyPadSectionBuffer | CodeHolder::kCopyPadTargetBuffer;
+
+  INFO("Verifying CodeHolder::relocateToBase() and copyFlattenedData() by ThreadExecutor");
+  ThreadExecutor executor(4);
+  ZoneVector<uint8_t> output[2];
+  Zone zone(4096);
+  ZoneAllocator allocator(&zone);
+
+  for (uint32_t i = 0; i < 2; i++) {
+    TaskExecutor* e = i == 0 ? nullptr : &executor;
+
+    CodeHolder code;
+    code.init(Environment(Environment::kArchX64), kBaseAddress);
+
+    EXPECT(CodeHolderTest_makeRelocatedCode(code) == kErrorOk);
+    EXPECT(code.flatten() == kErrorOk);
+    EXPECT(code.relocateToBase(kBaseAddress, e) == kErrorOk);
+
+    // Extra space verifies padding of the target buffer.
+    size_t size = code.codeSize() + 4096;
+    EXPECT(output[i].resize(&allocator, uint32_t(size)) == kErrorOk);
+
+    memset(output[i].data(), 0xCC, size);
+    EXPECT(code.copyFlattenedData(output[i].data(), size, kCopyOptions, e) == kErrorOk);
+  }
+
+  EXPECT(output[0].size() == output[1].size());
+  EXPECT(memcmp(output[0].data(), output[1].data(), output[0].size()) == 0);
+}
+#endif
 #endif
 
 ASMJIT_END_NAMESPACE
@@ -51,6 +51,7 @@ class BaseEmitter;
 class CodeHolder;
 class LabelEntry;
 class Logger;
+class TaskExecutor;
 
 // ============================================================================
 // [asmjit::AlignMode]
@@ -459,6 +460,40 @@ struct LabelLink {
   OffsetFormat format;
 };
 
+// ============================================================================
+// [asmjit::LabelLinkPack]
+// ============================================================================
+
+//! Packed array of label links that don't need a relocation entry.
+//!
+//! Each link is stored as a format id (an index to the format table shared
+//! by all labels of the same \ref CodeHolder), followed by a zigzag varint
+//! delta of its offset (relative to the previous link in the same pack) and
+//! a zigzag varint of its inlined `rel`. A typical forward jump is encoded
+//! in 3 bytes instead of a full \ref LabelLink.
+//!
+//! All links in a pack belong to the same section. Packs of a single label
+//! form a single-linked list, see \ref CodeHolder::labelLinkPacks().
+struct LabelLinkPack {
+  //! Next pack (single-linked list).
+  LabelLinkPack* next;
+  //! Section id of all links in this pack.
+  uint32_t sectionId;
+  //! Number of links stored in this pack.
+  uint32_t count;
+  //! Size of the encoded data [in bytes].
+  uint32_t size;
+  //! Capacity of the encoded data [in bytes].
+  uint32_t capacity;
+  //! Offset of the last link added to this pack.
+  uint64_t lastOffset;
+
+  //! Returns the encoded data, which follow this header.
+  inline uint8_t* data() noexcept { return reinterpret_cast<uint8_t*>(this + 1); }
+  //! \overload
+  inline const uint8_t* data() const noexcept { return reinterpret_cast<const uint8_t*>(this + 1); }
+};
+
 // ============================================================================
 // [asmjit::LabelEntry]
 // ============================================================================
@@ -608,6 +643,151 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::MemoryUsage]
+// ============================================================================
+
+//! Memory held by \ref CodeHolder and emitters attached to it, broken down by
+//! subsystem, see \ref CodeHolder::memoryUsage().
+//!
+//! Used size is the memory that holds data, reserved size is all the memory
+//! held, including memory kept for reuse after a soft reset. Peaks are the
+//! highest values seen by \ref CodeHolder::memoryUsage() and by soft resets
+//! of the code holder since its construction or its last hard reset.
+struct MemoryUsage {
+  //! Subsystem that holds memory.
+  enum Category : uint32_t {
+    //! Zone of \ref CodeHolder (sections, labels, relocations, and expressions).
+    kCategoryCodeZone = 0,
+    //! Dynamic blocks of \ref CodeHolder::allocator() (large label and relocation tables).
+    kCategoryCodeAllocator = 1,
+    //! Section buffers (capacities of \ref CodeBuffer), including a buffer kept by a soft reset.
+    kCategoryCodeBuffers = 2,
+    //! Zones of emitters that hold nodes, data, and virtual registers.
+    kCategoryEmitterZones = 3,
+    //! Dynamic blocks of emitter allocators.
+    kCategoryEmitterAllocator = 4,
+    //! Zones used by passes, including register allocation.
+    kCategoryPassZones = 5,
+
+    //! Count of categories.
+    kCategoryCount = 6
+  };
+
+  //! Used and reserved size of a single category or of all categories.
+  struct Entry {
+    //! Number of bytes that hold data.
+    size_t usedSize;
+    //! Number of bytes held.
+    size_t reservedSize;
+
+    inline void add(size_t used, size_t reserved) noexcept {
+      usedSize += used;
+      reservedSize += reserved;
+    }
+
+    inline void maxOf(const Entry& other) noexcept {
+      usedSize = Support::max(usedSize, other.usedSize);
+      reservedSize = Support::max(reservedSize, other.reservedSize);
+    }
+  };
+
+  //! Memory held by each category.
+  Entry categories[kCategoryCount];
+  //! Peak memory held by each category.
+  Entry peakCategories[kCategoryCount];
+  //! Memory held by all categories.
+  Entry total;
+  //! Peak memory held by all categories.
+  Entry peakTotal;
+
+  inline void reset() noexcept { memset(this, 0, sizeof(*this)); }
+
+  //! Resets current sizes and keeps peaks.
+  inline void resetCurrent() noexcept {
+    memset(categories, 0, sizeof(categories));
+    memset(&total, 0, sizeof(total));
+  }
+
+  //! Adds `used` and `reserved` bytes to the given `category`.
+  inline void add(uint32_t category, size_t used, size_t reserved) noexcept {
+    ASMJIT_ASSERT(category < kCategoryCount);
+    categories[category].add(used, reserved);
+    total.add(used, reserved);
+  }
+
+  //! Adds memory held by `zone` to the given `category`.
+  inline void addZone(uint32_t category, const Zone& zone) noexcept {
+    add(category, zone.usedSize(), zone.reservedSize());
+  }
+
+  //! Updates peaks by current sizes.
+  inline void updatePeaks() noexcept {
+    for (uint32_t i = 0; i < kCategoryCount; i++)
+      peakCategories[i].maxOf(categories[i]);
+    peakTotal.maxOf(total);
+  }
+};
+
+// ============================================================================
+// [asmjit::TaskExecutor]
+// ============================================================================
+
+//! Executes independent tasks in parallel.
+//!
+//! Used by \ref CodeHolder::relocateToBase() and \ref CodeHolder::copyFlattenedData()
+//! to process large code in parallel. Implement this interface to run tasks
+//! by an existing thread pool, or use \ref ThreadExecutor.
+class ASMJIT_VIRTAPI TaskExecutor {
+public:
+  ASMJIT_BASE_CLASS(TaskExecutor)
+
+  //! Task function, `taskIndex` is in `[0, taskCount)` range.
+  typedef void (ASMJIT_CDECL* TaskFunc)(void* data, uint32_t taskIndex);
+
+  //! Creates a new `TaskExecutor` instance.
+  ASMJIT_API TaskExecutor() noexcept;
+  //! Destroys the `TaskExecutor` instance.
+  ASMJIT_API virtual ~TaskExecutor() noexcept;
+
+  //! Returns the number of tasks that can run concurrently, used to partition
+  //! the work.
+  virtual uint32_t concurrency() const noexcept = 0;
+
+  //! Runs `func` for each task in `[0, taskCount)` range and returns when all
+  //! tasks finished. Tasks can run in any order and on any thread, including
+  //! the calling one.
+  virtual void run(TaskFunc func, void* data, uint32_t taskCount) noexcept = 0;
+};
+
+// ============================================================================
+// [asmjit::ThreadExecutor]
+// ============================================================================
+
+//! Task executor that runs tasks by threads it starts for each \ref run() call.
+//!
+//! The calling thread runs tasks too. If a thread cannot be started its tasks
+//! are run by the threads that did start.
+class ASMJIT_VIRTAPI ThreadExecutor : public TaskExecutor {
+public:
+  ASMJIT_NONCOPYABLE(ThreadExecutor)
+
+  //! Number of threads used to run tasks, including the calling thread.
+  uint32_t _threadCount;
+
+  //! Creates a `ThreadExecutor` that runs tasks by `threadCount` threads, or
+  //! by as many threads as the hardware supports if `threadCount` is zero.
+  ASMJIT_API explicit ThreadExecutor(uint32_t threadCount = 0) noexcept;
+  //! Destroys the `ThreadExecutor` instance.
+  ASMJIT_API virtual ~ThreadExecutor() noexcept;
+
+  //! Returns the number of threads used to run tasks, including the calling thread.
+  inline uint32_t threadCount() const noexcept { return _threadCount; }
+
+  ASMJIT_API uint32_t concurrency() const noexcept override;
+  ASMJIT_API void run(TaskFunc func, void* data, uint32_t taskCount) noexcept override;
+};
+
 // ============================================================================
 // [asmjit::CodeHolder]
 // ============================================================================
@@ -653,6 +833,12 @@ public:
   ZoneVector<RelocEntry*> _relocations;
   //! Label name -> LabelEntry (only named labels).
   ZoneHash<LabelEntry> _namedLabels;
+  //! Packed label links indexed by label id (grown on demand).
+  ZoneVector<LabelLinkPack*> _labelLinkPacks;
+  //! Offset formats referenced by packed label links.
+  ZoneVector<OffsetFormat> _linkFormats;
+  //! Index of the last format used by \ref addLabelLink().
+  uint32_t _lastLinkFormatId;
 
   //! Count of label links, which are not resolved.
   size_t _unresolvedLinkCount;
@@ -661,6 +847,14 @@ public:
   //! Address table entries.
   ZoneTree<AddressTableEntry> _addressTableEntries;
 
+  //! Section buffer kept by a soft reset, reused by `.text` of the next `init()`.
+  uint8_t* _retainedBufferData;
+  //! Capacity of `_retainedBufferData`.
+  size_t _retainedBufferCapacity;
+
+  //! Memory usage including peaks, updated by \ref memoryUsage() and by a soft reset.
+  MemoryUsage _memoryUsage;
+
   //! Options that can be used with \ref copySectionData() and \ref copyFlattenedData().
   enum CopyOptions : uint32_t {
     //! If virtual size of a section is greater than the size of its \ref CodeBuffer
@@ -696,6 +890,11 @@ public:
   //! Initializes CodeHolder to hold code described by code `info`.
   ASMJIT_API Error init(const Environment& environment, uint64_t baseAddress = Globals::kNoBaseAddress) noexcept;
   //! Detaches all code-generators attached and resets the `CodeHolder`.
+  //!
+  //! A soft reset keeps the memory of the `CodeHolder` (zone blocks and the
+  //! largest section buffer) for the next `init()`, so a `CodeHolder` that is
+  //! reused to generate many small functions stops allocating memory once it
+  //! reaches the size of the largest one. A hard reset releases everything.
   ASMJIT_API void reset(uint32_t resetPolicy = Globals::kResetSoft) noexcept;
 
   //! \}
@@ -721,6 +920,23 @@ public:
   //! CodeHolder's destructor.
   inline ZoneAllocator* allocator() const noexcept { return const_cast<ZoneAllocator*>(&_allocator); }
 
+  //! Returns the source of zone blocks, null if blocks are allocated by `malloc()`.
+  inline ZoneBlockSource* blockSource() const noexcept { return _zone.blockSource(); }
+
+  //! Sets the source of zone blocks used by the `CodeHolder` and by emitters
+  //! that attach to it later, see \ref ZoneBlockPool.
+  //!
+  //! Can only be called when the `CodeHolder` is not initialized.
+  ASMJIT_API Error setBlockSource(ZoneBlockSource* source) noexcept;
+
+  //! Stores memory held by the `CodeHolder` and all attached emitters to `out`
+  //! and updates peaks.
+  //!
+  //! The cost is proportional to the number of zone blocks and sections, so
+  //! it's cheap enough to be called periodically during code generation to
+  //! enforce a memory budget and to abort a runaway compilation early.
+  ASMJIT_API void memoryUsage(MemoryUsage* out) noexcept;
+
   //! \}
 
   //! \name Code & Architecture
@@ -788,6 +1004,19 @@ public:
   //! behavior of the function is undefined.
   ASMJIT_API Error reserveBuffer(CodeBuffer* cb, size_t n) noexcept;
 
+  //! Makes `cb` use an external buffer `data` having `capacity` bytes.
+  //!
+  //! The current content of `cb` is copied to `data` and the previous buffer
+  //! is released if it was managed by `CodeHolder`. The external buffer is
+  //! never released by `CodeHolder`. If the code outgrows it, the content is
+  //! moved to a buffer managed by `CodeHolder`, so it's always safe to emit
+  //! more code than `capacity`. Attached assemblers are updated accordingly.
+  //!
+  //! If `data` is null the content of an external buffer is moved to a buffer
+  //! managed by `CodeHolder`, which makes it possible to release the external
+  //! buffer without losing the code.
+  ASMJIT_API Error setExternalBuffer(CodeBuffer* cb, uint8_t* data, size_t capacity) noexcept;
+
   //! \}
 
   //! \name Sections
@@ -968,6 +1197,18 @@ public:
   //! Returns `null` if the allocation failed.
   ASMJIT_API LabelLink* newLabelLink(LabelEntry* le, uint32_t sectionId, size_t offset, intptr_t rel, const OffsetFormat& format) noexcept;
 
+  //! Adds a label-link that doesn't need a relocation entry in a packed form,
+  //! see \ref LabelLinkPack. Falls back to \ref newLabelLink() if the link
+  //! cannot be packed.
+  //!
+  //! Packed links are patched in bulk by \ref bindLabel() and \ref resolveUnresolvedLinks().
+  ASMJIT_API Error addLabelLink(LabelEntry* le, uint32_t sectionId, size_t offset, intptr_t rel, const OffsetFormat& format) noexcept;
+
+  //! Returns packed label-links of the given `labelId` (or null if there are none).
+  inline LabelLinkPack* labelLinkPacks(uint32_t labelId) const noexcept {
+    return labelId < _labelLinkPacks.size() ? _labelLinkPacks[labelId] : nullptr;
+  }
+
   //! Resolves cross-section links (`LabelLink`) associated with each label that
   //! was used as a destination in code of a different section. It's only useful
   //! to people that use multiple sections as it will do nothing if the code only
@@ -1024,6 +1265,14 @@ public:
   //! \note This should never be called more than once.
   ASMJIT_API Error relocateToBase(uint64_t baseAddress) noexcept;
 
+  //! Relocates the code to the given `baseAddress` by tasks run by `executor`.
+  //!
+  //! Relocation entries are partitioned into ranges processed in parallel,
+  //! the output is the same as produced by \ref relocateToBase(uint64_t).
+  //! Code having only a few relocations is relocated by the calling thread.
+  //! If `executor` is null this is the same as \ref relocateToBase(uint64_t).
+  ASMJIT_API Error relocateToBase(uint64_t baseAddress, TaskExecutor* executor) noexcept;
+
   //! Copies a single section into `dst`.
   ASMJIT_API Error copySectionData(void* dst, size_t dstSize, uint32_t sectionId, uint32_t copyOptions = 0) noexcept;
 
@@ -1034,6 +1283,12 @@ public:
   //! never write anything outside the provided buffer.
   ASMJIT_API Error copyFlattenedData(void* dst, size_t dstSize, uint32_t copyOptions = 0) noexcept;
 
+  //! Copies all sections into `dst` by tasks run by `executor`, each task
+  //! copies a range of sections.
+  //!
+  //! If `executor` is null this is the same as \ref copyFlattenedData(void*, size_t, uint32_t).
+  ASMJIT_API Error copyFlattenedData(void* dst, size_t dstSize, uint32_t copyOptions, TaskExecutor* executor) noexcept;
+
   //! \}
 
 #ifndef ASMJIT_NO_DEPRECATED
@@ -1054,6 +1309,98 @@ public:
 #endif // !ASMJIT_NO_DEPRECATED
 };
 
+// ============================================================================
+// [asmjit::CodeSession]
+// ============================================================================
+
+//! Reusable pair of \ref CodeHolder and an emitter of type `EmitterT`.
+//!
+//! Each `begin()` reinitializes the code holder and attaches the emitter, and
+//! each `end()` soft-resets both, so the memory used to generate the previous
+//! function (zone blocks, section buffers, emitter zones) is reused by the
+//! next one. After a few iterations a session that generates functions of a
+//! similar size doesn't allocate any memory. Use a \ref ZoneBlockSource
+//! (like \ref ZoneBlockPool) to share zone blocks between sessions.
+//!
+//! ```
+//! using namespace asmjit;
+//!
+//! JitRuntime rt;
+//! CodeSession<x86::Compiler> session;
+//!
+//! for (...) {
+//!   session.begin(rt.environment());
+//!   x86::Compiler& cc = session.emitter();
+//!   ... generate the function ...
+//!   cc.finalize();
+//!   rt.add(&fn, &session.code());
+//!   session.end();
+//! }
+//! ```
+template<typename EmitterT>
+class CodeSession {
+public:
+  ASMJIT_NONCOPYABLE(CodeSession)
+
+  //! Code holder (must be declared before the emitter, which detaches itself
+  //! when destroyed).
+  CodeHolder _code;
+  //! Emitter attached to `_code` between `begin()` and `end()`.
+  EmitterT _emitter;
+
+  //! \name Construction & Destruction
+  //! \{
+
+  //! Creates a session that uses the given block source for all zones of the
+  //! code holder and the emitter, see \ref CodeHolder::setBlockSource().
+  explicit inline CodeSession(ZoneBlockSource* blockSource = nullptr) noexcept {
+    _code.setBlockSource(blockSource);
+  }
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  //! Returns the code holder of the session.
+  inline CodeHolder& code() noexcept { return _code; }
+  //! Returns the emitter of the session.
+  inline EmitterT& emitter() noexcept { return _emitter; }
+  //! Returns the emitter of the session.
+  inline EmitterT* operator->() noexcept { return &_emitter; }
+
+  //! Tests whether the session is between `begin()` and `end()`.
+  inline bool isActive() const noexcept { return _code.isInitialized(); }
+
+  //! \}
+
+  //! \name Session
+  //! \{
+
+  //! Starts generating a new function for the given `environment`.
+  //!
+  //! A session that wasn't ended is ended first.
+  inline Error begin(const Environment& environment, uint64_t baseAddress = Globals::kNoBaseAddress) noexcept {
+    _code.reset(Globals::kResetSoft);
+    ASMJIT_PROPAGATE(_code.init(environment, baseAddress));
+    return _code.attach(&_emitter);
+  }
+
+  //! Ends the session, the memory of the code holder and the emitter is kept
+  //! for the next `begin()`.
+  inline void end() noexcept {
+    _code.reset(Globals::kResetSoft);
+  }
+
+  //! Ends the session and releases the memory held by the code holder, the
+  //! emitter keeps its zones until it's destroyed.
+  inline void release() noexcept {
+    _code.reset(Globals::kResetHard);
+  }
+
+  //! \}
+};
+
 //! \}
 
 ASMJIT_END_NAMESPACE
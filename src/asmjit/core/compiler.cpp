@@ -567,6 +567,7 @@ JumpAnnotation* BaseCompiler::newJumpAnnotation() {
 
 Error BaseCompiler::onAttach(CodeHolder* code) noexcept {
   ASMJIT_PROPAGATE(Base::onAttach(code));
+  _vRegZone.setBlockSource(code->blockSource());
 
   const ArchTraits& archTraits = ArchTraits::byArch(code->arch());
   uint32_t nativeRegType = Environment::is32Bit(code->arch()) ? BaseReg::kTypeGp32 : BaseReg::kTypeGp64;
@@ -592,6 +593,15 @@ Error BaseCompiler::onDetach(CodeHolder* code) noexcept {
   return Base::onDetach(code);
 }
 
+// ============================================================================
+// [asmjit::BaseCompiler - Memory Usage]
+// ============================================================================
+
+void BaseCompiler::addMemoryUsage(MemoryUsage* usage) const noexcept {
+  Base::addMemoryUsage(usage);
+  usage->addZone(MemoryUsage::kCategoryEmitterZones, _vRegZone);
+}
+
 // ============================================================================
 // [asmjit::FuncPass - Construction / Destruction]
 // ============================================================================
@@ -309,6 +309,13 @@ public:
   ASMJIT_API Error onDetach(CodeHolder* code) noexcept override;
 
   //! \}
+
+  //! \name Memory Usage
+  //! \{
+
+  ASMJIT_API void addMemoryUsage(MemoryUsage* usage) const noexcept override;
+
+  //! \}
 };
 
 // ============================================================================
@@ -234,6 +234,18 @@ Error BaseEmitter::_emitOpArray(uint32_t instId, const Operand_* operands, size_
   }
 }
 
+Error BaseEmitter::_emitBatch(const InstRecord* records, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const InstRecord& record = records[i];
+    const Operand_* op = record.operands();
+
+    setInstOptions(record.options());
+    setExtraReg(record.extraReg());
+    ASMJIT_PROPAGATE(_emit(record.id(), op[0], op[1], op[2], op + 3));
+  }
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::BaseEmitter - Emit (High-Level)]
 // ============================================================================
@@ -391,4 +403,23 @@ void BaseEmitter::onSettingsUpdated() noexcept {
   BaseEmitter_updateForcedOptions(this);
 }
 
+// ============================================================================
+// [asmjit::BaseEmitter - Memory Usage]
+// ============================================================================
+
+void BaseEmitter::memoryUsage(MemoryUsage* out) noexcept {
+  if (_code) {
+    _code->memoryUsage(out);
+    return;
+  }
+
+  out->reset();
+  addMemoryUsage(out);
+  out->updatePeaks();
+}
+
+void BaseEmitter::addMemoryUsage(MemoryUsage* usage) const noexcept {
+  DebugUtils::unused(usage);
+}
+
 ASMJIT_END_NAMESPACE
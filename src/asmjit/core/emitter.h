@@ -133,6 +133,12 @@ public:
     //! by taking advantage of implicit zero extension. For example instruction
     //! like `mov r64, imm` and `and r64, imm` can be translated to `mov r32, imm`
     //! and `and r32, imm` when the immediate constant is lesser than `2^31`.
+    //!
+    //! In addition, `test r|m, imm` is narrowed to `test r8|m8, imm8` if the
+    //! immediate is in `[0, 127]` range and sources of commutative AVX
+    //! instructions are swapped if it allows to use a 2-byte VEX prefix, for
+    //! example `vpaddd xmm0, xmm1, xmm8` is encoded as `vpaddd xmm0, xmm8, xmm1`.
+    //! Flags and results of such instructions are the same.
     kEncodingOptionOptimizeForSize = 0x00000001u,
 
     //! Emit optimized code-alignment sequences.
@@ -167,7 +173,35 @@ public:
     //! used to take into consideration prediction hints was P4. Newer processors
     //! implement heuristics for branch prediction and ignore static hints. This
     //! means that this feature can be only used for annotation purposes.
-    kEncodingOptionPredictedJumps = 0x00000010u
+    kEncodingOptionPredictedJumps = 0x00000010u,
+
+    //! Relax branches to labels before serializing Builder/Compiler nodes.
+    //!
+    //! Default: false.
+    //!
+    //! Assembler doesn't know the distance to a label that is not bound yet so
+    //! it always uses the longest form of such jump, unless the short form was
+    //! requested explicitly. When this option is set `finalize()` of Builder
+    //! and Compiler lays out the code first and uses the short form of every
+    //! branch whose target is close enough, see \ref BaseBuilder::relaxBranches().
+    //!
+    //! This option has no effect when used with Assembler.
+    kEncodingOptionRelaxBranches = 0x00000020u,
+
+    //! Flags are not used after instructions that are optimized for size.
+    //!
+    //! Default: false.
+    //!
+    //! X86 Specific
+    //! ------------
+    //!
+    //! Allows \ref kEncodingOptionOptimizeForSize to use shorter forms that
+    //! set flags differently. For example `mov r, 0` is encoded as `xor r32, r32`
+    //! (which clobbers flags) and `add|sub r|m, 128` as `sub|add r|m, -128`
+    //! (which sets a different carry). This option has no effect without
+    //! \ref kEncodingOptionOptimizeForSize and should only be enabled when
+    //! emitting code that doesn't consume flags set by such instructions.
+    kEncodingOptionIgnoreFlags = 0x00000040u
   };
 
 #ifndef ASMJIT_NO_DEPRECATED
@@ -562,11 +596,29 @@ public:
     return _emitOpArray(inst.id(), operands, opCount);
   }
 
+  //! Emits `count` instructions stored in `records` array.
+  //!
+  //! Options and extra register of each instruction are taken from its record,
+  //! options and extra register set on the emitter before calling this function
+  //! are discarded. Emitting stops at the first instruction that fails, all
+  //! instructions that precede it are emitted, and the error is returned (it's
+  //! reported to the error handler the same way as if `emit()` was used).
+  //!
+  //! \note Emitters can override this function to emit the whole batch more
+  //! efficiently, for example \ref x86::Assembler reserves the buffer for all
+  //! instructions once and encodes common forms without per-instruction state
+  //! handling.
+  inline Error emitBatch(const InstRecord* records, size_t count) {
+    return _emitBatch(records, count);
+  }
+
   //! \cond INTERNAL
   //! Emits an instruction - all 6 operands must be defined.
   virtual Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_* oExt) = 0;
   //! Emits instruction having operands stored in array.
   ASMJIT_API virtual Error _emitOpArray(uint32_t instId, const Operand_* operands, size_t opCount);
+  //! Emits instructions stored in an array of records.
+  ASMJIT_API virtual Error _emitBatch(const InstRecord* records, size_t count);
   //! \endcond
 
   //! \}
@@ -686,6 +738,22 @@ public:
 
   //! \}
 
+  //! \name Memory Usage
+  //! \{
+
+  //! Stores memory held by this emitter to `out`. If the emitter is attached
+  //! the memory of \ref CodeHolder and all its emitters is included, see
+  //! \ref CodeHolder::memoryUsage().
+  ASMJIT_API void memoryUsage(MemoryUsage* out) noexcept;
+
+  //! Adds memory held by this emitter to `usage`.
+  //!
+  //! \note This function is virtual and should be overridden by emitters that
+  //! allocate memory on their own, the default implementation does nothing.
+  ASMJIT_API virtual void addMemoryUsage(MemoryUsage* usage) const noexcept;
+
+  //! \}
+
 #ifndef ASMJIT_NO_DEPRECATED
   ASMJIT_DEPRECATED("Use environment() instead")
   inline CodeInfo codeInfo() const noexcept {
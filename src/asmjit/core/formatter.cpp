@@ -326,6 +326,24 @@ Error formatNode(
       break;
     }
 
+    case BaseNode::kNodeInstBlock: {
+      const InstBlockNode* blockNode = node->as<InstBlockNode>();
+      const InstStorage& storage = builder->instStorage();
+
+      uint32_t h = blockNode->firstInst();
+      while (h != InstStorage::kInvalidHandle) {
+        ASMJIT_PROPAGATE(
+          formatInstruction(sb, formatFlags, builder,
+            builder->arch(),
+            storage.baseInst(h), storage.operands(h), storage.opCount(h)));
+
+        h = storage.next(h);
+        if (h != InstStorage::kInvalidHandle)
+          ASMJIT_PROPAGATE(sb.append('\n'));
+      }
+      break;
+    }
+
     case BaseNode::kNodeSection: {
       const SectionNode* sectionNode = node->as<SectionNode>();
       if (builder->_code->isSectionValid(sectionNode->id())) {
@@ -191,6 +191,93 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::InstRecord]
+// ============================================================================
+
+//! Instruction and all its operands stored in a single structure.
+//!
+//! Records are used by \ref BaseEmitter::emitBatch() to emit sequences of
+//! instructions that were prepared in advance (for example code templates that
+//! are replayed many times). Operands that are not used are always none, so a
+//! record can be passed to an emitter without counting its operands first.
+class InstRecord : public BaseInst {
+public:
+  //! Instruction operands, unused operands are none.
+  Operand_ _operands[Globals::kMaxOpCount];
+
+  //! \name Construction & Destruction
+  //! \{
+
+  //! Creates a record of none instruction without operands.
+  inline InstRecord() noexcept
+    : BaseInst() { _initOperands(0); }
+
+  //! Creates a record of instruction `id` with the given `operands`.
+  //!
+  //! Integers passed as operands are converted to \ref Imm operands, the same
+  //! way as done by \ref BaseEmitter::emit().
+  template<typename... Args>
+  inline explicit InstRecord(uint32_t id, Args&&... operands) noexcept
+    : BaseInst(id) {
+    static_assert(sizeof...(Args) <= Globals::kMaxOpCount, "Too many operands");
+    _initOperands(0, Support::ForwardOp<Args>::forward(operands)...);
+  }
+
+  //! \}
+
+  //! \name Operands
+  //! \{
+
+  //! Returns the number of operands (the index of the last operand that is not none plus one).
+  inline uint32_t opCount() const noexcept {
+    uint32_t count = Globals::kMaxOpCount;
+    while (count && _operands[count - 1].isNone())
+      count--;
+    return count;
+  }
+
+  //! Returns operands as an array of \ref Globals::kMaxOpCount items.
+  inline Operand_* operands() noexcept { return _operands; }
+  //! \overload
+  inline const Operand_* operands() const noexcept { return _operands; }
+
+  //! Returns the operand at the given `index`.
+  inline Operand& op(size_t index) noexcept {
+    ASMJIT_ASSERT(index < Globals::kMaxOpCount);
+    return _operands[index].as<Operand>();
+  }
+  //! \overload
+  inline const Operand& op(size_t index) const noexcept {
+    ASMJIT_ASSERT(index < Globals::kMaxOpCount);
+    return _operands[index].as<Operand>();
+  }
+
+  //! Sets the operand at the given `index` to `op`.
+  inline void setOp(size_t index, const Operand_& op) noexcept {
+    ASMJIT_ASSERT(index < Globals::kMaxOpCount);
+    _operands[index].copyFrom(op);
+  }
+
+  //! Resets all operands to none.
+  inline void resetOperands() noexcept { _initOperands(0); }
+
+  //! \}
+
+  //! \cond INTERNAL
+  inline void _initOperands(size_t index) noexcept {
+    while (index < Globals::kMaxOpCount)
+      _operands[index++].reset();
+  }
+
+  template<typename... Args>
+  inline void _initOperands(size_t index, const Operand_& op, Args&&... operands) noexcept {
+    _operands[index].copyFrom(op);
+    _initOperands(index + 1, std::forward<Args>(operands)...);
+  }
+  //! \endcond
+};
+
 // ============================================================================
 // [asmjit::OpRWInfo]
 // ============================================================================
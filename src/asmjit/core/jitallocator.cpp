@@ -33,6 +33,12 @@
 #include "../core/zonelist.h"
 #include "../core/zonetree.h"
 
+#include <atomic>
+
+#if defined(ASMJIT_TEST)
+  #include <thread>
+#endif
+
 ASMJIT_BEGIN_NAMESPACE
 
 // ============================================================================
@@ -51,7 +57,43 @@ enum JitAllocatorConstants : uint32_t {
   kJitAllocatorBaseGranularity = 64,
 
   //! Maximum block size (32MB).
-  kJitAllocatorMaxBlockSize = 1024 * 1024 * 32
+  kJitAllocatorMaxBlockSize = 1024 * 1024 * 32,
+
+  //! Number of buckets used to index blocks of a pool by their largest unused area.
+  //!
+  //! Bucket `i` contains blocks that have the largest unused area within
+  //! `[2^i, 2^(i+1))` range, so 32 buckets cover all possible area sizes.
+  kJitAllocatorBucketCount = 32,
+
+  //! Bucket id of a block, which is not indexed (it's either full or not inserted).
+  kJitAllocatorNoBucket = 0xFFFFFFFFu,
+
+  //! Number of thread caches used when `JitAllocator::kOptionUseThreadCache` is set.
+  //!
+  //! Threads are assigned caches in a round-robin fashion when they use the
+  //! allocator for the first time, so up to this number of threads can use
+  //! the allocator without sharing a lock.
+  kJitAllocatorThreadCacheCount = 16,
+
+  //! Maximum size of an allocation that can be served by a thread cache.
+  kJitAllocatorThreadCacheMaxSize = 4096,
+
+  //! Maximum number of size classes of a thread cache (each class has one
+  //! granularity step, thus the count depends on the allocator granularity).
+  kJitAllocatorThreadCacheMaxClassCount = kJitAllocatorThreadCacheMaxSize / kJitAllocatorBaseGranularity,
+
+  //! Maximum number of free areas a thread cache keeps in a single size class.
+  kJitAllocatorThreadCacheClassCapacity = 32,
+
+  //! Maximum number of bytes a single thread cache keeps in all size classes.
+  kJitAllocatorThreadCacheMaxBytes = 256 * 1024,
+
+  //! Maximum number of areas reserved at once when a size class becomes empty.
+  kJitAllocatorThreadCacheRefillCount = 8,
+
+  //! Number of releases accumulated by a thread cache before they are returned
+  //! to the global pool at once.
+  kJitAllocatorThreadCacheFlushCount = 32
 };
 
 static inline uint32_t JitAllocator_defaultFillPattern() noexcept {
@@ -163,24 +205,33 @@ class JitAllocatorPool {
 public:
   ASMJIT_NONCOPYABLE(JitAllocatorPool)
 
-  inline JitAllocatorPool(uint32_t granularity) noexcept
+  inline JitAllocatorPool(uint32_t granularity, uint32_t placement) noexcept
     : blocks(),
-      cursor(nullptr),
+      buckets {},
+      bucketMask(0),
       blockCount(0),
       granularity(uint16_t(granularity)),
       granularityLog2(uint8_t(Support::ctz(granularity))),
       emptyBlockCount(0),
+      placement(placement),
       totalAreaSize(0),
       totalAreaUsed(0),
-      totalOverheadBytes(0) {}
+      totalOverheadBytes(0),
+      totalLargePageRequestedBytes(0),
+      totalLargePageObtainedBytes(0),
+      counters {} {}
 
+  // NOTE: Counters are cumulative, they are not reset together with blocks.
   inline void reset() noexcept {
     blocks.reset();
-    cursor = nullptr;
+    memset(buckets, 0, sizeof(buckets));
+    bucketMask = 0;
     blockCount = 0;
     totalAreaSize = 0;
     totalAreaUsed = 0;
     totalOverheadBytes = 0;
+    totalLargePageRequestedBytes = 0;
+    totalLargePageObtainedBytes = 0;
   }
 
   inline size_t byteSizeFromAreaSize(uint32_t areaSize) const noexcept { return size_t(areaSize) * granularity; }
@@ -191,10 +242,21 @@ public:
     return alignUp<size_t>(areaSize, kBitWordSizeInBits) / kBitWordSizeInBits;
   }
 
+  //! Returns a bucket id that would index a block having `largestUnusedArea`.
+  static inline uint32_t bucketIdFromAreaSize(uint32_t largestUnusedArea) noexcept {
+    return largestUnusedArea ? 31u - Support::clz(largestUnusedArea) : uint32_t(kJitAllocatorNoBucket);
+  }
+
+  inline void indexBlock(JitAllocatorBlock* block) noexcept;
+  inline void unindexBlock(JitAllocatorBlock* block) noexcept;
+  inline void reindexBlock(JitAllocatorBlock* block) noexcept;
+
   //! Double linked list of blocks.
   ZoneList<JitAllocatorBlock> blocks;
-  //! Where to start looking first.
-  JitAllocatorBlock* cursor;
+  //! Blocks indexed by their largest unused area (double linked lists).
+  JitAllocatorBlock* buckets[kJitAllocatorBucketCount];
+  //! Mask of buckets that are not empty.
+  uint32_t bucketMask;
 
   //! Count of blocks.
   uint32_t blockCount;
@@ -204,6 +266,8 @@ public:
   uint8_t granularityLog2;
   //! Count of empty blocks (either 0 or 1 as we won't keep more blocks empty).
   uint8_t emptyBlockCount;
+  //! Placement of blocks in this pool, see \ref JitAllocator::Placement.
+  uint32_t placement;
 
   //! Number of bits reserved across all blocks.
   size_t totalAreaSize;
@@ -211,6 +275,12 @@ public:
   size_t totalAreaUsed;
   //! Overhead of all blocks (in bytes).
   size_t totalOverheadBytes;
+  //! Size of all blocks that only requested transparent huge pages (in bytes).
+  size_t totalLargePageRequestedBytes;
+  //! Size of all blocks backed by explicitly reserved large pages (in bytes).
+  size_t totalLargePageObtainedBytes;
+  //! Operations performed by this pool.
+  JitAllocator::Counters counters;
 };
 
 // ============================================================================
@@ -228,7 +298,18 @@ public:
     //! Block is dirty (largestUnusedArea, searchStart, searchEnd).
     kFlagDirty = 0x00000002u,
     //! Block is dual-mapped.
-    kFlagDualMapped = 0x00000004u
+    kFlagDualMapped = 0x00000004u,
+    //! Block requested transparent huge pages, which the kernel may ignore.
+    kFlagLargePagesRequested = 0x00000008u,
+    //! Block is being emptied by `compact()` and must not be indexed.
+    kFlagCompactSource = 0x00000010u,
+    //! Block received memory moved by `compact()`.
+    kFlagCompactTarget = 0x00000020u,
+    //! Block is Read+Write and linked in the list of writable blocks.
+    kFlagWritable = 0x00000040u,
+    //! Block is backed by large pages reserved at allocation time (HugeTLB or
+    //! `MEM_LARGE_PAGES`), see \ref VirtMem::kResultLargePages.
+    kFlagLargePagesObtained = 0x00000080u
   };
 
   //! Link to the pool that owns this block.
@@ -245,13 +326,22 @@ public:
   uint32_t _areaSize;
   //! Used area (number of bits in bit-vector used).
   uint32_t _areaUsed;
-  //! The largest unused continuous area in the bit-vector (or `areaSize` to initiate rescan).
+  //! The largest unused continuous area in the bit-vector (only an upper bound if the block is dirty).
   uint32_t _largestUnusedArea;
   //! Start of a search range (for unused bits).
   uint32_t _searchStart;
   //! End of a search range (for unused bits).
   uint32_t _searchEnd;
 
+  //! Bucket of the pool where the block is indexed (or `kJitAllocatorNoBucket`).
+  uint32_t _bucketId;
+  //! Previous and next blocks in the same bucket.
+  JitAllocatorBlock* _bucketNodes[2];
+  //! Next writable block (only if `kFlagWritable` is set).
+  JitAllocatorBlock* _writableNext;
+  //! Number of write scopes that hold the block writable.
+  uint32_t _writeRefCount;
+
   //! Used bit-vector (0 = unused, 1 = used).
   Support::BitWord* _usedBitVector;
   //! Stop bit-vector (0 = don't care, 1 = stop).
@@ -275,6 +365,10 @@ public:
       _largestUnusedArea(areaSize),
       _searchStart(0),
       _searchEnd(areaSize),
+      _bucketId(kJitAllocatorNoBucket),
+      _bucketNodes {},
+      _writableNext(nullptr),
+      _writeRefCount(0),
       _usedBitVector(usedBitVector),
       _stopBitVector(stopBitVector) {}
 
@@ -297,6 +391,45 @@ public:
   inline uint32_t areaAvailable() const noexcept { return _areaSize - _areaUsed; }
   inline uint32_t largestUnusedArea() const noexcept { return _largestUnusedArea; }
 
+  inline void setLargestUnusedArea(uint32_t value) noexcept {
+    _largestUnusedArea = value;
+    _pool->reindexBlock(this);
+  }
+
+  //! Returns the size of the unused run that contains the unused area `[start, end)`.
+  inline uint32_t unusedRunSize(uint32_t start, uint32_t end) const noexcept {
+    using Support::BitWord;
+    using Support::kBitWordSizeInBits;
+
+    // Find the beginning of the run by scanning backwards.
+    uint32_t runStart = start;
+    while (runStart) {
+      uint32_t bitIndex = (runStart - 1) % kBitWordSizeInBits;
+      BitWord bits = _usedBitVector[(runStart - 1) / kBitWordSizeInBits] & (Support::allOnes<BitWord>() >> (kBitWordSizeInBits - 1 - bitIndex));
+
+      if (bits) {
+        runStart = (runStart - 1 - bitIndex) + (kBitWordSizeInBits - Support::clz(bits));
+        break;
+      }
+      runStart -= bitIndex + 1;
+    }
+
+    // Find the end of the run by scanning forward.
+    uint32_t runEnd = end;
+    while (runEnd < _areaSize) {
+      uint32_t bitIndex = runEnd % kBitWordSizeInBits;
+      BitWord bits = _usedBitVector[runEnd / kBitWordSizeInBits] & (Support::allOnes<BitWord>() << bitIndex);
+
+      if (bits) {
+        runEnd = Support::min<uint32_t>(runEnd - bitIndex + Support::ctz(bits), _areaSize);
+        break;
+      }
+      runEnd = Support::min<uint32_t>(runEnd - bitIndex + kBitWordSizeInBits, _areaSize);
+    }
+
+    return runEnd - runStart;
+  }
+
   inline void decreaseUsedArea(uint32_t value) noexcept {
     _areaUsed -= value;
     _pool->totalAreaUsed -= value;
@@ -316,10 +449,12 @@ public:
     if (areaAvailable() == 0) {
       _searchStart = _areaSize;
       _searchEnd = 0;
-      _largestUnusedArea = 0;
       clearFlags(kFlagDirty);
+      setLargestUnusedArea(0);
     }
     else {
+      // The largest unused area is kept as is, it's now an upper bound of the
+      // real value, which will be recalculated when the block is searched.
       if (_searchStart == allocatedAreaStart)
         _searchStart = allocatedAreaEnd;
       if (_searchEnd == allocatedAreaEnd)
@@ -344,12 +479,16 @@ public:
     if (areaUsed() == 0) {
       _searchStart = 0;
       _searchEnd = _areaSize;
-      _largestUnusedArea = _areaSize;
       addFlags(kFlagEmpty);
       clearFlags(kFlagDirty);
+      setLargestUnusedArea(_areaSize);
     }
     else {
-      addFlags(kFlagDirty);
+      // The released area could merge with its neighbors. If the block is not
+      // dirty the largest unused area stays exact, otherwise it's an upper bound.
+      uint32_t runSize = unusedRunSize(releasedAreaStart, releasedAreaEnd);
+      if (runSize > _largestUnusedArea)
+        setLargestUnusedArea(runSize);
     }
   }
 
@@ -372,7 +511,9 @@ public:
     Support::bitVectorSetBit(_stopBitVector, shrunkAreaEnd - 1, false);
     Support::bitVectorSetBit(_stopBitVector, shrunkAreaStart - 1, true);
 
-    addFlags(kFlagDirty);
+    uint32_t runSize = unusedRunSize(shrunkAreaStart, shrunkAreaEnd);
+    if (runSize > _largestUnusedArea)
+      setLargestUnusedArea(runSize);
   }
 
   // RBTree default CMP uses '<' and '>' operators.
@@ -384,29 +525,197 @@ public:
   inline bool operator>(const uint8_t* key) const noexcept { return roPtr() > key; }
 };
 
+// ============================================================================
+// [asmjit::JitAllocator - Pool Index]
+// ============================================================================
+
+inline void JitAllocatorPool::indexBlock(JitAllocatorBlock* block) noexcept {
+  ASMJIT_ASSERT(block->_bucketId == kJitAllocatorNoBucket);
+
+  uint32_t bucketId = bucketIdFromAreaSize(block->largestUnusedArea());
+  if (bucketId == kJitAllocatorNoBucket)
+    return;
+
+  JitAllocatorBlock* head = buckets[bucketId];
+  block->_bucketId = bucketId;
+  block->_bucketNodes[0] = nullptr;
+  block->_bucketNodes[1] = head;
+
+  if (head)
+    head->_bucketNodes[0] = block;
+
+  buckets[bucketId] = block;
+  bucketMask |= Support::bitMask(bucketId);
+}
+
+inline void JitAllocatorPool::unindexBlock(JitAllocatorBlock* block) noexcept {
+  uint32_t bucketId = block->_bucketId;
+  if (bucketId == kJitAllocatorNoBucket)
+    return;
+
+  JitAllocatorBlock* prev = block->_bucketNodes[0];
+  JitAllocatorBlock* next = block->_bucketNodes[1];
+
+  if (prev)
+    prev->_bucketNodes[1] = next;
+  else
+    buckets[bucketId] = next;
+
+  if (next)
+    next->_bucketNodes[0] = prev;
+
+  if (!buckets[bucketId])
+    bucketMask &= ~Support::bitMask(bucketId);
+
+  block->_bucketId = kJitAllocatorNoBucket;
+  block->_bucketNodes[0] = nullptr;
+  block->_bucketNodes[1] = nullptr;
+}
+
+inline void JitAllocatorPool::reindexBlock(JitAllocatorBlock* block) noexcept {
+  if (block->_bucketId == bucketIdFromAreaSize(block->largestUnusedArea()) || block->hasFlag(JitAllocatorBlock::kFlagCompactSource))
+    return;
+
+  unindexBlock(block);
+  indexBlock(block);
+}
+
+// ============================================================================
+// [asmjit::JitAllocator - ThreadCache]
+// ============================================================================
+
+//! Area reserved from the global pool, which is kept by a thread cache.
+struct JitAllocatorCachedArea {
+  void* ro;
+  void* rw;
+};
+
+//! Free areas of the same size kept by a thread cache.
+struct JitAllocatorCacheClass {
+  //! Number of areas in `areas`.
+  uint32_t count;
+  //! Areas (allocated on demand, has `kJitAllocatorThreadCacheClassCapacity` capacity).
+  JitAllocatorCachedArea* areas;
+};
+
+class JitAllocatorThreadCache {
+public:
+  ASMJIT_NONCOPYABLE(JitAllocatorThreadCache)
+
+  inline JitAllocatorThreadCache() noexcept
+    : cachedBytes(0),
+      allocCount(0),
+      releaseCount(0),
+      pendingCount(0),
+      pending {},
+      classes {} {}
+
+  inline ~JitAllocatorThreadCache() noexcept {
+    for (JitAllocatorCacheClass& cacheClass : classes)
+      ::free(cacheClass.areas);
+  }
+
+  inline void reset() noexcept {
+    cachedBytes = 0;
+    pendingCount = 0;
+    for (JitAllocatorCacheClass& cacheClass : classes)
+      cacheClass.count = 0;
+  }
+
+  //! Lock that guards the cache (only contended by threads sharing the cache).
+  Lock lock;
+  //! Number of bytes of all areas kept by size classes.
+  size_t cachedBytes;
+  //! Number of `alloc()` calls served by this cache (cumulative).
+  uint64_t allocCount;
+  //! Number of `release()` calls deferred by this cache (cumulative).
+  uint64_t releaseCount;
+  //! Number of pointers in `pending`.
+  uint32_t pendingCount;
+  //! Released pointers that were not returned to the global pool yet.
+  void* pending[kJitAllocatorThreadCacheFlushCount];
+  //! Size classes - areas in class `i` have `(i + 1) * granularity` bytes.
+  JitAllocatorCacheClass classes[kJitAllocatorThreadCacheMaxClassCount];
+};
+
+// ============================================================================
+// [asmjit::JitAllocator - WriteScope]
+// ============================================================================
+
+//! Write scope of a thread (see `JitAllocator::beginWrite()`) or of an area
+//! allocated by `JitAllocator::allocWritable()`. Each block held by the scope
+//! has its `_writeRefCount` incremented and stays Read+Write until all scopes
+//! that hold it end.
+struct JitAllocatorWriteScope {
+  //! Next write scope of the allocator.
+  JitAllocatorWriteScope* next;
+  //! Thread that owns the scope or zero if the scope is owned by `roPtr`.
+  uint32_t threadId;
+  //! Nesting depth of `beginWrite()` calls (only used by thread scopes).
+  uint32_t depth;
+  //! Area that owns the scope (only used by area scopes).
+  void* roPtr;
+  //! Number of blocks in `blocks`.
+  uint32_t blockCount;
+  //! Capacity of `blocks`.
+  uint32_t blockCapacity;
+  //! Blocks held writable by the scope.
+  JitAllocatorBlock** blocks;
+
+  inline bool isAreaScope() const noexcept { return threadId == 0; }
+
+  inline bool holdsBlock(const JitAllocatorBlock* block) const noexcept {
+    for (uint32_t i = 0; i < blockCount; i++)
+      if (blocks[i] == block)
+        return true;
+    return false;
+  }
+};
+
 // ============================================================================
 // [asmjit::JitAllocator - PrivateImpl]
 // ============================================================================
 
 class JitAllocatorPrivateImpl : public JitAllocator::Impl {
 public:
-  inline JitAllocatorPrivateImpl(JitAllocatorPool* pools, size_t poolCount) noexcept
+  inline JitAllocatorPrivateImpl(JitAllocatorPool* pools, size_t poolCount, size_t placementPoolCount, JitAllocatorThreadCache* threadCaches) noexcept
     : JitAllocator::Impl {},
       pools(pools),
-      poolCount(poolCount) {}
+      poolCount(poolCount),
+      placementPoolCount(placementPoolCount),
+      threadCaches(threadCaches),
+      writeScopes(nullptr),
+      writableBlocks(nullptr),
+      protectionChangeCount(0),
+      counters {} {}
   inline ~JitAllocatorPrivateImpl() noexcept {}
 
   //! Lock for thread safety.
   mutable Lock lock;
   //! System page size (also a minimum block size).
   uint32_t pageSize;
+  //! Large page size (only if `kOptionUseLargePages` is set, otherwise zero).
+  uint32_t largePageSize;
 
   //! Blocks from all pools in RBTree.
   ZoneTree<JitAllocatorBlock> tree;
-  //! Allocator pools.
+  //! Allocator pools, grouped by placement.
   JitAllocatorPool* pools;
-  //! Number of allocator pools.
+  //! Number of allocator pools (all placements).
   size_t poolCount;
+  //! Number of allocator pools of a single placement.
+  size_t placementPoolCount;
+  //! Thread caches (only if `kOptionUseThreadCache` is set, otherwise null).
+  JitAllocatorThreadCache* threadCaches;
+
+  //! Active write scopes (only used by `kOptionWriteProtect`).
+  JitAllocatorWriteScope* writeScopes;
+  //! List of blocks that are Read+Write (only used by `kOptionWriteProtect`).
+  JitAllocatorBlock* writableBlocks;
+  //! Number of changes of block access (only used by `kOptionWriteProtect`).
+  size_t protectionChangeCount;
+  //! Calls of `alloc()`, `release()`, and `shrink()` not served by thread caches.
+  JitAllocator::Counters counters;
 };
 
 static const JitAllocator::Impl JitAllocatorImpl_none {};
@@ -427,10 +736,11 @@ static inline JitAllocatorPrivateImpl* JitAllocatorImpl_new(const JitAllocator::
   uint32_t granularity = params->granularity;
   uint32_t fillPattern = params->fillPattern;
 
-  // Setup pool count to [1..3].
-  size_t poolCount = 1;
+  // Setup pool count to [1..3] per placement.
+  size_t placementPoolCount = 1;
   if (options & JitAllocator::kOptionUseMultiplePools)
-    poolCount = kJitAllocatorMultiPoolCount;;
+    placementPoolCount = kJitAllocatorMultiPoolCount;
+  size_t poolCount = placementPoolCount * JitAllocator::kPlacementCount;
 
   // Setup block size [64kB..256MB].
   if (blockSize < 64 * 1024 || blockSize > 256 * 1024 * 1024 || !Support::isPowerOf2(blockSize))
@@ -440,37 +750,74 @@ static inline JitAllocatorPrivateImpl* JitAllocatorImpl_new(const JitAllocator::
   if (granularity < 64 || granularity > 256 || !Support::isPowerOf2(granularity))
     granularity = kJitAllocatorBaseGranularity;
 
+  // Setup large pages, blocks must be multiples of the large page size.
+  uint32_t largePageSize = 0;
+  if (options & JitAllocator::kOptionUseLargePages) {
+    largePageSize = vmInfo.largePageSize;
+    if (largePageSize > kJitAllocatorMaxBlockSize)
+      largePageSize = 0;
+    blockSize = Support::max(blockSize, largePageSize);
+  }
+
   // Setup fill-pattern.
   if (!(options & JitAllocator::kOptionCustomFillPattern))
     fillPattern = JitAllocator_defaultFillPattern();
 
-  size_t size = sizeof(JitAllocatorPrivateImpl) + sizeof(JitAllocatorPool) * poolCount;
+  // Dual mapping provides W^X on its own, toggling access is not needed. Thread
+  // caches are not compatible with toggling as they serve memory without the
+  // allocator lock, which guards the list of writable blocks.
+  if (options & JitAllocator::kOptionUseDualMapping)
+    options &= ~uint32_t(JitAllocator::kOptionWriteProtect);
+
+  if (options & JitAllocator::kOptionWriteProtect)
+    options &= ~uint32_t(JitAllocator::kOptionUseThreadCache);
+
+  // Setup thread caches [0 or kJitAllocatorThreadCacheCount].
+  size_t threadCacheCount = 0;
+  if (options & JitAllocator::kOptionUseThreadCache)
+    threadCacheCount = kJitAllocatorThreadCacheCount;
+
+  size_t size = sizeof(JitAllocatorPrivateImpl) + sizeof(JitAllocatorPool) * poolCount + sizeof(JitAllocatorThreadCache) * threadCacheCount;
   void* p = ::malloc(size);
   if (ASMJIT_UNLIKELY(!p))
     return nullptr;
 
   JitAllocatorPool* pools = reinterpret_cast<JitAllocatorPool*>((uint8_t*)p + sizeof(JitAllocatorPrivateImpl));
-  JitAllocatorPrivateImpl* impl = new(p) JitAllocatorPrivateImpl(pools, poolCount);
+  JitAllocatorThreadCache* threadCaches = nullptr;
+
+  if (threadCacheCount) {
+    threadCaches = reinterpret_cast<JitAllocatorThreadCache*>(pools + poolCount);
+    for (size_t i = 0; i < threadCacheCount; i++)
+      new(&threadCaches[i]) JitAllocatorThreadCache();
+  }
+
+  JitAllocatorPrivateImpl* impl = new(p) JitAllocatorPrivateImpl(pools, poolCount, placementPoolCount, threadCaches);
 
   impl->options = options;
   impl->blockSize = blockSize;
   impl->granularity = granularity;
   impl->fillPattern = fillPattern;
   impl->pageSize = vmInfo.pageSize;
+  impl->largePageSize = largePageSize;
 
   for (size_t poolId = 0; poolId < poolCount; poolId++)
-    new(&pools[poolId]) JitAllocatorPool(granularity << poolId);
+    new(&pools[poolId]) JitAllocatorPool(granularity << (poolId % placementPoolCount), uint32_t(poolId / placementPoolCount));
 
   return impl;
 }
 
 static inline void JitAllocatorImpl_destroy(JitAllocatorPrivateImpl* impl) noexcept {
+  if (impl->threadCaches) {
+    for (size_t i = 0; i < kJitAllocatorThreadCacheCount; i++)
+      impl->threadCaches[i].~JitAllocatorThreadCache();
+  }
+
   impl->~JitAllocatorPrivateImpl();
   ::free(impl);
 }
 
-static inline size_t JitAllocatorImpl_sizeToPoolId(const JitAllocatorPrivateImpl* impl, size_t size) noexcept {
-  size_t poolId = impl->poolCount - 1;
+static inline size_t JitAllocatorImpl_sizeToPoolId(const JitAllocatorPrivateImpl* impl, size_t size, uint32_t placement) noexcept {
+  size_t poolId = impl->placementPoolCount - 1;
   size_t granularity = size_t(impl->granularity) << poolId;
 
   while (poolId) {
@@ -480,7 +827,7 @@ static inline size_t JitAllocatorImpl_sizeToPoolId(const JitAllocatorPrivateImpl
     granularity >>= 1;
   }
 
-  return poolId;
+  return size_t(placement) * impl->placementPoolCount + poolId;
 }
 
 static inline size_t JitAllocatorImpl_bitVectorSizeToByteSize(uint32_t areaSize) noexcept {
@@ -512,6 +859,147 @@ ASMJIT_FAVOR_SPEED static void JitAllocatorImpl_fillPattern(void* mem, uint32_t
     p[i] = pattern;
 }
 
+// Incremented each time a thread needs an identifier for the first time.
+static std::atomic<uint32_t> JitAllocatorImpl_threadCounter;
+// Thread identifier used to pick a thread cache and to find a write scope of
+// the thread (zero if not assigned yet).
+static thread_local uint32_t JitAllocatorImpl_threadId;
+
+static inline uint32_t JitAllocatorImpl_currentThreadId() noexcept {
+  uint32_t threadId = JitAllocatorImpl_threadId;
+  if (ASMJIT_UNLIKELY(!threadId)) {
+    threadId = ++JitAllocatorImpl_threadCounter;
+    JitAllocatorImpl_threadId = threadId;
+  }
+  return threadId;
+}
+
+// Returns the write scope of the calling thread or null if the thread is not
+// in a write scope. The caller must hold `impl->lock`.
+static JitAllocatorWriteScope* JitAllocatorImpl_threadScope(JitAllocatorPrivateImpl* impl) noexcept {
+  if (!impl->writeScopes)
+    return nullptr;
+
+  uint32_t threadId = JitAllocatorImpl_currentThreadId();
+  for (JitAllocatorWriteScope* scope = impl->writeScopes; scope; scope = scope->next)
+    if (scope->threadId == threadId)
+      return scope;
+  return nullptr;
+}
+
+// Returns the write scope owned by the area at `roPtr` or null if there is no
+// such scope. The caller must hold `impl->lock`.
+static JitAllocatorWriteScope* JitAllocatorImpl_areaScope(JitAllocatorPrivateImpl* impl, void* roPtr) noexcept {
+  for (JitAllocatorWriteScope* scope = impl->writeScopes; scope; scope = scope->next)
+    if (scope->isAreaScope() && scope->roPtr == roPtr)
+      return scope;
+  return nullptr;
+}
+
+static JitAllocatorWriteScope* JitAllocatorImpl_newScope(JitAllocatorPrivateImpl* impl, uint32_t threadId) noexcept {
+  JitAllocatorWriteScope* scope = static_cast<JitAllocatorWriteScope*>(::malloc(sizeof(JitAllocatorWriteScope)));
+  if (ASMJIT_UNLIKELY(!scope))
+    return nullptr;
+
+  scope->next = impl->writeScopes;
+  scope->threadId = threadId;
+  scope->depth = 0;
+  scope->roPtr = nullptr;
+  scope->blockCount = 0;
+  scope->blockCapacity = 0;
+  scope->blocks = nullptr;
+
+  impl->writeScopes = scope;
+  return scope;
+}
+
+// Makes sure that `scope` can hold one more block.
+static Error JitAllocatorImpl_reserveScope(JitAllocatorWriteScope* scope) noexcept {
+  if (scope->blockCount < scope->blockCapacity)
+    return kErrorOk;
+
+  uint32_t newCapacity = Support::max<uint32_t>(scope->blockCapacity * 2u, 4u);
+  JitAllocatorBlock** newBlocks = static_cast<JitAllocatorBlock**>(::realloc(scope->blocks, newCapacity * sizeof(JitAllocatorBlock*)));
+
+  if (ASMJIT_UNLIKELY(!newBlocks))
+    return DebugUtils::errored(kErrorOutOfMemory);
+
+  scope->blocks = newBlocks;
+  scope->blockCapacity = newCapacity;
+  return kErrorOk;
+}
+
+// Tests whether memory for `scope` can be allocated from `block`. Blocks held
+// writable by other scopes are skipped, otherwise the memory would only become
+// executable after all these scopes end. Area scopes only use blocks that are
+// empty, so their memory doesn't keep any other code non-executable. Without a
+// scope only blocks that are not held by any scope can be used.
+static inline bool JitAllocatorImpl_canAllocFrom(const JitAllocatorBlock* block, const JitAllocatorWriteScope* scope) noexcept {
+  if (!block->_writeRefCount)
+    return !scope || !scope->isAreaScope() || !block->areaUsed();
+  return scope && !scope->isAreaScope() && scope->holdsBlock(block);
+}
+
+// Makes `block` Read+Write if `kOptionWriteProtect` is used. If `scope` is not
+// null the block is held writable until the scope ends, otherwise it's made
+// executable by the next `JitAllocatorImpl_protectBlocks()` unless another
+// scope holds it. The caller must hold `impl->lock`.
+static Error JitAllocatorImpl_makeWritable(JitAllocatorPrivateImpl* impl, JitAllocatorBlock* block, JitAllocatorWriteScope* scope = nullptr) noexcept {
+  if (!(impl->options & JitAllocator::kOptionWriteProtect))
+    return kErrorOk;
+
+  if (!block->hasFlag(JitAllocatorBlock::kFlagWritable)) {
+    ASMJIT_PROPAGATE(VirtMem::protect(block->rwPtr(), block->blockSize(), VirtMem::kAccessReadWrite));
+    impl->protectionChangeCount++;
+
+    block->addFlags(JitAllocatorBlock::kFlagWritable);
+    block->_writableNext = impl->writableBlocks;
+    impl->writableBlocks = block;
+  }
+
+  // If the scope cannot grow the block is only writable temporarily, which is
+  // still correct as writes done by the allocator itself end with the call.
+  if (scope && !scope->holdsBlock(block) && JitAllocatorImpl_reserveScope(scope) == kErrorOk) {
+    scope->blocks[scope->blockCount++] = block;
+    block->_writeRefCount++;
+  }
+
+  return kErrorOk;
+}
+
+// Makes all writable blocks that are not held by a write scope Read+Execute
+// again. Blocks that failed to change their access stay in the list. The
+// caller must hold `impl->lock`.
+static Error JitAllocatorImpl_protectBlocks(JitAllocatorPrivateImpl* impl) noexcept {
+  Error err = kErrorOk;
+  JitAllocatorBlock* block = impl->writableBlocks;
+  impl->writableBlocks = nullptr;
+
+  while (block) {
+    JitAllocatorBlock* next = block->_writableNext;
+    Error blockErr = kErrorOk;
+
+    if (!block->_writeRefCount)
+      blockErr = VirtMem::protect(block->roPtr(), block->blockSize(), VirtMem::kAccessRead | VirtMem::kAccessExecute);
+
+    if (block->_writeRefCount || ASMJIT_UNLIKELY(blockErr)) {
+      if (blockErr)
+        err = blockErr;
+      block->_writableNext = impl->writableBlocks;
+      impl->writableBlocks = block;
+    }
+    else {
+      impl->protectionChangeCount++;
+      block->clearFlags(JitAllocatorBlock::kFlagWritable);
+      block->_writableNext = nullptr;
+    }
+
+    block = next;
+  }
+
+  return err;
+}
+
 // Allocate a new `JitAllocatorBlock` for the given `blockSize`.
 //
 // NOTE: The block doesn't have `kFlagEmpty` flag set, because the new block
@@ -533,14 +1021,41 @@ static JitAllocatorBlock* JitAllocatorImpl_newBlock(JitAllocatorPrivateImpl* imp
 
   uint32_t blockFlags = 0;
   if (bitWords != nullptr) {
-    if (impl->options & JitAllocator::kOptionUseDualMapping) {
-      err = VirtMem::allocDualMapping(&virtMem, blockSize, VirtMem::kAccessReadWrite | VirtMem::kAccessExecute);
-      blockFlags |= JitAllocatorBlock::kFlagDualMapped;
+    uint32_t vmFlags = VirtMem::kAccessReadWrite | VirtMem::kAccessExecute;
+
+    // Blocks protected by toggling their access are created writable.
+    if (impl->options & JitAllocator::kOptionWriteProtect) {
+      vmFlags = VirtMem::kAccessReadWrite;
+      blockFlags |= JitAllocatorBlock::kFlagWritable;
     }
-    else {
-      err = VirtMem::alloc(&virtMem.ro, blockSize, VirtMem::kAccessReadWrite | VirtMem::kAccessExecute);
-      virtMem.rw = virtMem.ro;
+
+    // Try large pages first and fall back to regular pages if not available.
+    bool useLargePages = impl->largePageSize && Support::isAligned(blockSize, impl->largePageSize);
+    uint32_t vmResultFlags = 0;
+
+    for (;;) {
+      uint32_t vmLargePages = useLargePages ? uint32_t(VirtMem::kMMapLargePages) : uint32_t(0);
+
+      if (impl->options & JitAllocator::kOptionUseDualMapping) {
+        err = VirtMem::allocDualMapping(&virtMem, blockSize, vmFlags | vmLargePages, &vmResultFlags);
+      }
+      else {
+        err = VirtMem::alloc(&virtMem.ro, blockSize, vmFlags | vmLargePages, &vmResultFlags);
+        virtMem.rw = virtMem.ro;
+      }
+
+      if (err == kErrorOk || !useLargePages)
+        break;
+      useLargePages = false;
     }
+
+    if (impl->options & JitAllocator::kOptionUseDualMapping)
+      blockFlags |= JitAllocatorBlock::kFlagDualMapped;
+
+    if (vmResultFlags & VirtMem::kResultLargePages)
+      blockFlags |= JitAllocatorBlock::kFlagLargePagesObtained;
+    else if (useLargePages)
+      blockFlags |= JitAllocatorBlock::kFlagLargePagesRequested;
   }
 
   // Out of memory.
@@ -555,11 +1070,26 @@ static JitAllocatorBlock* JitAllocatorImpl_newBlock(JitAllocatorPrivateImpl* imp
     JitAllocatorImpl_fillPattern(virtMem.rw, impl->fillPattern, blockSize);
 
   memset(bitWords, 0, size_t(numBitWords) * 2 * sizeof(BitWord));
-  return new(block) JitAllocatorBlock(pool, virtMem, blockSize, blockFlags, bitWords, bitWords + numBitWords, areaSize);
+  block = new(block) JitAllocatorBlock(pool, virtMem, blockSize, blockFlags, bitWords, bitWords + numBitWords, areaSize);
+  pool->counters.blockCreateCount++;
+
+  if (block->hasFlag(JitAllocatorBlock::kFlagWritable)) {
+    block->_writableNext = impl->writableBlocks;
+    impl->writableBlocks = block;
+  }
+
+  return block;
 }
 
 static void JitAllocatorImpl_deleteBlock(JitAllocatorPrivateImpl* impl, JitAllocatorBlock* block) noexcept {
-  DebugUtils::unused(impl);
+  if (block->hasFlag(JitAllocatorBlock::kFlagWritable)) {
+    JitAllocatorBlock** pPrev = &impl->writableBlocks;
+    while (*pPrev != block)
+      pPrev = &(*pPrev)->_writableNext;
+    *pPrev = block->_writableNext;
+  }
+
+  block->pool()->counters.blockDestroyCount++;
 
   if (block->hasFlag(JitAllocatorBlock::kFlagDualMapped))
     VirtMem::releaseDualMapping(&block->_mapping, block->blockSize());
@@ -573,33 +1103,39 @@ static void JitAllocatorImpl_deleteBlock(JitAllocatorPrivateImpl* impl, JitAlloc
 static void JitAllocatorImpl_insertBlock(JitAllocatorPrivateImpl* impl, JitAllocatorBlock* block) noexcept {
   JitAllocatorPool* pool = block->pool();
 
-  if (!pool->cursor)
-    pool->cursor = block;
-
-  // Add to RBTree and List.
+  // Add to RBTree, List, and Index.
   impl->tree.insert(block);
   pool->blocks.append(block);
+  pool->indexBlock(block);
 
   // Update statistics.
   pool->blockCount++;
   pool->totalAreaSize += block->areaSize();
   pool->totalOverheadBytes += sizeof(JitAllocatorBlock) + JitAllocatorImpl_bitVectorSizeToByteSize(block->areaSize()) * 2u;
+
+  if (block->hasFlag(JitAllocatorBlock::kFlagLargePagesRequested))
+    pool->totalLargePageRequestedBytes += block->blockSize();
+  if (block->hasFlag(JitAllocatorBlock::kFlagLargePagesObtained))
+    pool->totalLargePageObtainedBytes += block->blockSize();
 }
 
 static void JitAllocatorImpl_removeBlock(JitAllocatorPrivateImpl* impl, JitAllocatorBlock* block) noexcept {
   JitAllocatorPool* pool = block->pool();
 
-  // Remove from RBTree and List.
-  if (pool->cursor == block)
-    pool->cursor = block->hasPrev() ? block->prev() : block->next();
-
+  // Remove from RBTree, List, and Index.
   impl->tree.remove(block);
   pool->blocks.unlink(block);
+  pool->unindexBlock(block);
 
   // Update statistics.
   pool->blockCount--;
   pool->totalAreaSize -= block->areaSize();
   pool->totalOverheadBytes -= sizeof(JitAllocatorBlock) + JitAllocatorImpl_bitVectorSizeToByteSize(block->areaSize()) * 2u;
+
+  if (block->hasFlag(JitAllocatorBlock::kFlagLargePagesRequested))
+    pool->totalLargePageRequestedBytes -= block->blockSize();
+  if (block->hasFlag(JitAllocatorBlock::kFlagLargePagesObtained))
+    pool->totalLargePageObtainedBytes -= block->blockSize();
 }
 
 static void JitAllocatorImpl_wipeOutBlock(JitAllocatorPrivateImpl* impl, JitAllocatorBlock* block) noexcept {
@@ -612,7 +1148,7 @@ static void JitAllocatorImpl_wipeOutBlock(JitAllocatorPrivateImpl* impl, JitAllo
   uint32_t granularity = pool->granularity;
   size_t numBitWords = pool->bitWordCountFromAreaSize(areaSize);
 
-  if (impl->options & JitAllocator::kOptionFillUnusedMemory) {
+  if ((impl->options & JitAllocator::kOptionFillUnusedMemory) && JitAllocatorImpl_makeWritable(impl, block) == kErrorOk) {
     uint8_t* rwPtr = block->rwPtr();
     for (size_t i = 0; i < numBitWords; i++) {
       Support::BitWordIterator<Support::BitWord> it(block->_usedBitVector[i]);
@@ -635,6 +1171,44 @@ static void JitAllocatorImpl_wipeOutBlock(JitAllocatorPrivateImpl* impl, JitAllo
   block->clearFlags(JitAllocatorBlock::kFlagDirty);
 }
 
+// Ends `scope` and releases the blocks it holds. Blocks that became empty
+// while held are released now if the pool already has an empty block. The
+// caller must hold `impl->lock` and call `JitAllocatorImpl_protectBlocks()`.
+static void JitAllocatorImpl_endScope(JitAllocatorPrivateImpl* impl, JitAllocatorWriteScope* scope) noexcept {
+  for (uint32_t i = 0; i < scope->blockCount; i++) {
+    JitAllocatorBlock* block = scope->blocks[i];
+    JitAllocatorPool* pool = block->pool();
+
+    if (--block->_writeRefCount == 0 && block->hasFlag(JitAllocatorBlock::kFlagEmpty) &&
+        (pool->emptyBlockCount > 1 || (impl->options & JitAllocator::kOptionImmediateRelease))) {
+      pool->emptyBlockCount--;
+      JitAllocatorImpl_removeBlock(impl, block);
+      JitAllocatorImpl_deleteBlock(impl, block);
+    }
+  }
+
+  JitAllocatorWriteScope** pPrev = &impl->writeScopes;
+  while (*pPrev != scope)
+    pPrev = &(*pPrev)->next;
+  *pPrev = scope->next;
+
+  ::free(scope->blocks);
+  ::free(scope);
+}
+
+// Frees all write scopes without touching their blocks.
+static void JitAllocatorImpl_freeScopes(JitAllocatorPrivateImpl* impl) noexcept {
+  JitAllocatorWriteScope* scope = impl->writeScopes;
+  impl->writeScopes = nullptr;
+
+  while (scope) {
+    JitAllocatorWriteScope* next = scope->next;
+    ::free(scope->blocks);
+    ::free(scope);
+    scope = next;
+  }
+}
+
 // ============================================================================
 // [asmjit::JitAllocator - Construction / Destruction]
 // ============================================================================
@@ -665,12 +1239,21 @@ void JitAllocator::reset(uint32_t resetPolicy) noexcept {
   impl->tree.reset();
   size_t poolCount = impl->poolCount;
 
+  // Areas held by thread caches are gone together with their blocks.
+  if (impl->threadCaches) {
+    for (size_t i = 0; i < kJitAllocatorThreadCacheCount; i++)
+      impl->threadCaches[i].reset();
+  }
+
+  // Write scopes end together with the memory they were writing to.
+  JitAllocatorImpl_freeScopes(impl);
+
   for (size_t poolId = 0; poolId < poolCount; poolId++) {
     JitAllocatorPool& pool = impl->pools[poolId];
     JitAllocatorBlock* block = pool.blocks.first();
 
     JitAllocatorBlock* blockToKeep = nullptr;
-    if (resetPolicy != Globals::kResetHard && !(impl->options & kOptionImmediateRelease)) {
+    if (block && resetPolicy != Globals::kResetHard && !(impl->options & kOptionImmediateRelease)) {
       blockToKeep = block;
       block = block->next();
     }
@@ -686,11 +1269,18 @@ void JitAllocator::reset(uint32_t resetPolicy) noexcept {
     if (blockToKeep) {
       blockToKeep->_listNodes[0] = nullptr;
       blockToKeep->_listNodes[1] = nullptr;
+      blockToKeep->_bucketId = kJitAllocatorNoBucket;
+      blockToKeep->_bucketNodes[0] = nullptr;
+      blockToKeep->_bucketNodes[1] = nullptr;
+      blockToKeep->_writeRefCount = 0;
       JitAllocatorImpl_wipeOutBlock(impl, blockToKeep);
       JitAllocatorImpl_insertBlock(impl, blockToKeep);
       pool.emptyBlockCount = 1;
     }
   }
+
+  // Kept blocks are not held by any write scope anymore.
+  JitAllocatorImpl_protectBlocks(impl);
 }
 
 // ============================================================================
@@ -712,87 +1302,262 @@ JitAllocator::Statistics JitAllocator::statistics() const noexcept {
       statistics._reservedSize += size_t(pool.totalAreaSize) * pool.granularity;
       statistics._usedSize     += size_t(pool.totalAreaUsed) * pool.granularity;
       statistics._overheadSize += size_t(pool.totalOverheadBytes);
+      statistics._largePageRequestedSize += size_t(pool.totalLargePageRequestedBytes);
+      statistics._largePageObtainedSize += size_t(pool.totalLargePageObtainedBytes);
     }
+
+    statistics._protectionChangeCount = impl->protectionChangeCount;
   }
 
   return statistics;
 }
 
 // ============================================================================
-// [asmjit::JitAllocator - Alloc / Release]
+// [asmjit::JitAllocator - Telemetry]
 // ============================================================================
 
-Error JitAllocator::alloc(void** roPtrOut, void** rwPtrOut, size_t size) noexcept {
+// Scans unused ranges of `block`, adds them to `histogram` (optional), and
+// returns the size of the largest one in bytes. The caller must hold `impl->lock`.
+static size_t JitAllocatorImpl_scanUnusedRanges(const JitAllocatorBlock* block, size_t* histogram) noexcept {
+  const JitAllocatorPool* pool = block->pool();
+  BitVectorRangeIterator<Support::BitWord, 0> it(block->_usedBitVector, pool->bitWordCountFromAreaSize(block->areaSize()), 0, block->areaSize());
+
+  size_t rangeStart;
+  size_t rangeEnd;
+  size_t largestSize = 0;
+
+  while (it.nextRange(&rangeStart, &rangeEnd)) {
+    size_t rangeSize = pool->byteSizeFromAreaSize(uint32_t(rangeEnd - rangeStart));
+    largestSize = Support::max(largestSize, rangeSize);
+
+    if (histogram) {
+      uint32_t index = Support::min<uint32_t>(Support::bitSizeOf<size_t>() - 1u - Support::clz(rangeSize), JitAllocator::FreeRangeHistogram::kSize - 1u);
+      histogram[index]++;
+    }
+  }
+
+  return largestSize;
+}
+
+Error JitAllocator::snapshot(Snapshot* out) const noexcept {
+  out->reset();
+
   if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
     return DebugUtils::errored(kErrorNotInitialized);
 
   JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
-  constexpr uint32_t kNoIndex = std::numeric_limits<uint32_t>::max();
 
-  *roPtrOut = nullptr;
-  *rwPtrOut = nullptr;
+  // Thread caches are visited first as their locks must not be acquired while
+  // holding the allocator lock.
+  if (impl->threadCaches) {
+    for (size_t i = 0; i < kJitAllocatorThreadCacheCount; i++) {
+      JitAllocatorThreadCache* cache = &impl->threadCaches[i];
+      LockGuard guard(cache->lock);
 
-  // Align to the minimum granularity by default.
-  size = Support::alignUp<size_t>(size, impl->granularity);
-  if (ASMJIT_UNLIKELY(size == 0))
-    return DebugUtils::errored(kErrorInvalidArgument);
+      out->counters.allocCount += cache->allocCount;
+      out->counters.releaseCount += cache->releaseCount;
+      out->cachedSize += cache->cachedBytes;
+    }
+  }
 
-  if (ASMJIT_UNLIKELY(size > std::numeric_limits<uint32_t>::max() / 2))
-    return DebugUtils::errored(kErrorTooLarge);
+  LockGuard guard(impl->lock);
+
+  out->counters.allocCount += impl->counters.allocCount;
+  out->counters.releaseCount += impl->counters.releaseCount;
+  out->counters.shrinkCount += impl->counters.shrinkCount;
+  out->poolCount = uint32_t(impl->poolCount);
+
+  for (size_t poolId = 0; poolId < impl->poolCount; poolId++) {
+    const JitAllocatorPool& pool = impl->pools[poolId];
+    PoolStatistics& poolStats = out->pools[poolId];
+
+    poolStats.placement = pool.placement;
+    poolStats.granularity = pool.granularity;
+    poolStats.blockCount = pool.blockCount;
+    poolStats.emptyBlockCount = pool.emptyBlockCount;
+    poolStats.usedSize = size_t(pool.totalAreaUsed) * pool.granularity;
+    poolStats.reservedSize = size_t(pool.totalAreaSize) * pool.granularity;
+    poolStats.overheadSize = pool.totalOverheadBytes;
+    poolStats.counters = pool.counters;
+
+    out->counters.blockCreateCount += pool.counters.blockCreateCount;
+    out->counters.blockDestroyCount += pool.counters.blockDestroyCount;
+    out->counters.blockSearchCount += pool.counters.blockSearchCount;
+  }
+
+  return kErrorOk;
+}
+
+Error JitAllocator::freeRangeHistogram(FreeRangeHistogram* out) const noexcept {
+  out->reset();
+
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+
+  // The lock is released after each pool so other threads don't wait for
+  // the whole scan.
+  for (size_t poolId = 0; poolId < impl->poolCount; poolId++) {
+    LockGuard guard(impl->lock);
+    const JitAllocatorPool& pool = impl->pools[poolId];
+
+    for (const JitAllocatorBlock* block = pool.blocks.first(); block; block = block->next())
+      JitAllocatorImpl_scanUnusedRanges(block, out->counts);
+  }
+
+  return kErrorOk;
+}
+
+Error JitAllocator::blockStatistics(BlockStatistics* out, size_t capacity, size_t* countOut) const noexcept {
+  *countOut = 0;
+
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
 
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
   LockGuard guard(impl->lock);
-  JitAllocatorPool* pool = &impl->pools[JitAllocatorImpl_sizeToPoolId(impl, size)];
 
-  uint32_t areaIndex = kNoIndex;
-  uint32_t areaSize = uint32_t(pool->areaSizeFromByteSize(size));
+  size_t count = 0;
+  for (size_t poolId = 0; poolId < impl->poolCount; poolId++) {
+    const JitAllocatorPool& pool = impl->pools[poolId];
 
-  // Try to find the requested memory area in existing blocks.
-  JitAllocatorBlock* block = pool->blocks.first();
-  if (block) {
-    JitAllocatorBlock* initial = block;
-    do {
-      JitAllocatorBlock* next = block->hasNext() ? block->next() : pool->blocks.first();
-      if (block->areaAvailable() >= areaSize) {
-        if (block->isDirty() || block->largestUnusedArea() >= areaSize) {
-          BitVectorRangeIterator<Support::BitWord, 0> it(block->_usedBitVector, pool->bitWordCountFromAreaSize(block->areaSize()), block->_searchStart, block->_searchEnd);
-
-          size_t rangeStart = 0;
-          size_t rangeEnd = block->areaSize();
-
-          size_t searchStart = SIZE_MAX;
-          size_t largestArea = 0;
-
-          while (it.nextRange(&rangeStart, &rangeEnd, areaSize)) {
-            size_t rangeSize = rangeEnd - rangeStart;
-            if (rangeSize >= areaSize) {
-              areaIndex = uint32_t(rangeStart);
-              break;
-            }
+    for (const JitAllocatorBlock* block = pool.blocks.first(); block; block = block->next(), count++) {
+      if (count >= capacity)
+        continue;
 
-            searchStart = Support::min(searchStart, rangeStart);
-            largestArea = Support::max(largestArea, rangeSize);
-          }
+      BlockStatistics& blockStats = out[count];
+      blockStats.ro = block->roPtr();
+      blockStats.poolIndex = uint32_t(poolId);
+      blockStats.largePagesRequested = block->hasFlag(JitAllocatorBlock::kFlagLargePagesRequested);
+      blockStats.largePagesObtained = block->hasFlag(JitAllocatorBlock::kFlagLargePagesObtained);
+      blockStats.blockSize = block->blockSize();
+      blockStats.usedSize = pool.byteSizeFromAreaSize(block->areaUsed());
+      blockStats.largestUnusedSize = JitAllocatorImpl_scanUnusedRanges(block, nullptr);
+    }
+  }
+
+  *countOut = count;
+  return kErrorOk;
+}
 
-          if (areaIndex != kNoIndex)
-            break;
+// ============================================================================
+// [asmjit::JitAllocator - Alloc / Release (Internal)]
+// ============================================================================
 
-          if (searchStart != SIZE_MAX) {
-            // Because we have iterated over the entire block, we can now mark the
-            // largest unused area that can be used to cache the next traversal.
-            size_t searchEnd = rangeEnd;
+// Searches `block` for an unused area of `areaSize` and returns its index or
+// `kJitAllocatorNoBucket` if the block doesn't have such area. If the whole
+// search range was scanned the largest unused area of the block is updated
+// so the block is reindexed and won't be searched again for the same size.
+static uint32_t JitAllocatorImpl_searchBlock(JitAllocatorPool* pool, JitAllocatorBlock* block, uint32_t areaSize) noexcept {
+  constexpr uint32_t kNoIndex = kJitAllocatorNoBucket;
+  pool->counters.blockSearchCount++;
 
-            block->_searchStart = uint32_t(searchStart);
-            block->_searchEnd = uint32_t(searchEnd);
-            block->_largestUnusedArea = uint32_t(largestArea);
-            block->clearFlags(JitAllocatorBlock::kFlagDirty);
-          }
-        }
+  // The largest unused area is either exact or an upper bound if the block is dirty.
+  if (block->areaAvailable() < areaSize || block->largestUnusedArea() < areaSize)
+    return kNoIndex;
+
+  BitVectorRangeIterator<Support::BitWord, 0> it(block->_usedBitVector, pool->bitWordCountFromAreaSize(block->areaSize()), block->_searchStart, block->_searchEnd);
+
+  size_t rangeStart = 0;
+  size_t rangeEnd = block->areaSize();
+
+  size_t searchStart = SIZE_MAX;
+  size_t largestArea = 0;
+
+  while (it.nextRange(&rangeStart, &rangeEnd, areaSize)) {
+    size_t rangeSize = rangeEnd - rangeStart;
+    if (rangeSize >= areaSize)
+      return uint32_t(rangeStart);
+
+    searchStart = Support::min(searchStart, rangeStart);
+    largestArea = Support::max(largestArea, rangeSize);
+  }
+
+  if (searchStart != SIZE_MAX) {
+    // Because we have iterated over the entire block, we can now mark the
+    // largest unused area that can be used to cache the next traversal.
+    size_t searchEnd = rangeEnd;
+
+    block->_searchStart = uint32_t(searchStart);
+    block->_searchEnd = uint32_t(searchEnd);
+    block->clearFlags(JitAllocatorBlock::kFlagDirty);
+    block->setLargestUnusedArea(uint32_t(largestArea));
+  }
+
+  return kNoIndex;
+}
+
+// Searches all blocks in the bucket `bucketId` of `pool` that can be used by
+// `scope` for an unused area of `areaSize` and returns its index and the block,
+// or `kJitAllocatorNoBucket`.
+static uint32_t JitAllocatorImpl_searchBucket(JitAllocatorPool* pool, uint32_t bucketId, uint32_t areaSize, JitAllocatorWriteScope* scope, JitAllocatorBlock** blockOut) noexcept {
+  JitAllocatorBlock* block = pool->buckets[bucketId];
+
+  while (block) {
+    // The search can reindex the block, so get the next one first.
+    JitAllocatorBlock* next = block->_bucketNodes[1];
+
+    if (JitAllocatorImpl_canAllocFrom(block, scope)) {
+      uint32_t areaIndex = JitAllocatorImpl_searchBlock(pool, block, areaSize);
+      if (areaIndex != kJitAllocatorNoBucket) {
+        *blockOut = block;
+        return areaIndex;
       }
+    }
 
-      block = next;
-    } while (block != initial);
+    block = next;
+  }
+
+  return kJitAllocatorNoBucket;
+}
+
+// Searches all blocks indexed by `pool` that can be used by `scope` for an
+// unused area of `areaSize` and returns its index and the block, or
+// `kJitAllocatorNoBucket`.
+static uint32_t JitAllocatorImpl_searchPool(JitAllocatorPool* pool, uint32_t areaSize, JitAllocatorWriteScope* scope, JitAllocatorBlock** blockOut) noexcept {
+  constexpr uint32_t kNoIndex = kJitAllocatorNoBucket;
+  uint32_t areaIndex = kNoIndex;
+
+  // Try to find the requested memory area in existing blocks. Blocks are
+  // indexed by their largest unused area, so each block in a bucket starting
+  // at `ceil(log2(areaSize))` has enough room unless it's dirty (in that case
+  // the search either succeeds or moves the block to a lower bucket). Buckets
+  // are visited from the smallest to prefer blocks that are more occupied.
+  uint32_t minBucketId = JitAllocatorPool::bucketIdFromAreaSize(areaSize);
+  uint32_t fitBucketId = minBucketId + uint32_t(!Support::isPowerOf2(areaSize));
+  uint32_t bucketMask = pool->bucketMask & ~Support::lsbMask<uint32_t>(fitBucketId);
+
+  while (bucketMask && areaIndex == kNoIndex) {
+    uint32_t bucketId = Support::ctz(bucketMask);
+    bucketMask &= bucketMask - 1u;
+    areaIndex = JitAllocatorImpl_searchBucket(pool, bucketId, areaSize, scope, blockOut);
   }
 
+  // The bucket of `floor(log2(areaSize))` can contain blocks that are too small,
+  // thus it's only searched if no other bucket had a block with enough room.
+  if (areaIndex == kNoIndex && fitBucketId != minBucketId)
+    areaIndex = JitAllocatorImpl_searchBucket(pool, minBucketId, areaSize, scope, blockOut);
+
+  return areaIndex;
+}
+
+// Allocates an area of `size` bytes, which must be already aligned to the
+// allocator granularity, from blocks of the given `placement`. If `scope` is
+// not null the block is held writable by it. The caller must hold `impl->lock`.
+static Error JitAllocatorImpl_allocArea(JitAllocatorPrivateImpl* impl, size_t size, uint32_t placement, JitAllocatorWriteScope* scope, void** roPtrOut, void** rwPtrOut) noexcept {
+  constexpr uint32_t kNoIndex = kJitAllocatorNoBucket;
+
+  JitAllocatorPool* pool = &impl->pools[JitAllocatorImpl_sizeToPoolId(impl, size, placement)];
+  JitAllocatorBlock* block = nullptr;
+
+  // Holding a block must not fail after the area is allocated.
+  if (scope)
+    ASMJIT_PROPAGATE(JitAllocatorImpl_reserveScope(scope));
+
+  uint32_t areaSize = uint32_t(pool->areaSizeFromByteSize(size));
+  uint32_t areaIndex = JitAllocatorImpl_searchPool(pool, areaSize, scope, &block);
+
   // Allocate a new block if there is no region of a required width.
   if (areaIndex == kNoIndex) {
     size_t blockSize = JitAllocatorImpl_calculateIdealBlockSize(impl, pool, size);
@@ -807,15 +1572,24 @@ Error JitAllocator::alloc(void** roPtrOut, void** rwPtrOut, size_t size) noexcep
 
     JitAllocatorImpl_insertBlock(impl, block);
     block->_searchStart = areaSize;
-    block->_largestUnusedArea = block->areaSize() - areaSize;
+    block->setLargestUnusedArea(block->areaSize() - areaSize);
+
+    // New blocks are created writable, the scope only starts to hold it.
+    JitAllocatorImpl_makeWritable(impl, block, scope);
   }
-  else if (block->hasFlag(JitAllocatorBlock::kFlagEmpty)) {
-    pool->emptyBlockCount--;
-    block->clearFlags(JitAllocatorBlock::kFlagEmpty);
+  else {
+    // The caller writes to the returned memory.
+    ASMJIT_PROPAGATE(JitAllocatorImpl_makeWritable(impl, block, scope));
+
+    if (block->hasFlag(JitAllocatorBlock::kFlagEmpty)) {
+      pool->emptyBlockCount--;
+      block->clearFlags(JitAllocatorBlock::kFlagEmpty);
+    }
   }
 
   // Update statistics.
   block->markAllocatedArea(areaIndex, areaIndex + areaSize);
+  pool->counters.allocCount++;
 
   // Return a pointer to the allocated memory.
   size_t offset = pool->byteSizeFromAreaSize(areaIndex);
@@ -826,38 +1600,44 @@ Error JitAllocator::alloc(void** roPtrOut, void** rwPtrOut, size_t size) noexcep
   return kErrorOk;
 }
 
-Error JitAllocator::release(void* roPtr) noexcept {
-  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
-    return DebugUtils::errored(kErrorNotInitialized);
-
-  if (ASMJIT_UNLIKELY(!roPtr))
-    return DebugUtils::errored(kErrorInvalidArgument);
-
-  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
-  LockGuard guard(impl->lock);
-
+// Returns a block that contains an area starting at `roPtr` and the area
+// boundaries, or null if there is no such block. The caller must hold
+// `impl->lock`.
+static JitAllocatorBlock* JitAllocatorImpl_findArea(JitAllocatorPrivateImpl* impl, void* roPtr, uint32_t* areaStartOut, uint32_t* areaEndOut) noexcept {
   JitAllocatorBlock* block = impl->tree.get(static_cast<uint8_t*>(roPtr));
   if (ASMJIT_UNLIKELY(!block))
-    return DebugUtils::errored(kErrorInvalidState);
+    return nullptr;
 
   // Offset relative to the start of the block.
   JitAllocatorPool* pool = block->pool();
   size_t offset = (size_t)((uint8_t*)roPtr - block->roPtr());
 
   // The first bit representing the allocated area and its size.
-  uint32_t areaIndex = uint32_t(offset >> pool->granularityLog2);
-  uint32_t areaEnd = uint32_t(Support::bitVectorIndexOf(block->_stopBitVector, areaIndex, true)) + 1;
-  uint32_t areaSize = areaEnd - areaIndex;
+  uint32_t areaStart = uint32_t(offset >> pool->granularityLog2);
+  uint32_t areaEnd = uint32_t(Support::bitVectorIndexOf(block->_stopBitVector, areaStart, true)) + 1;
 
-  block->markReleasedArea(areaIndex, areaEnd);
+  *areaStartOut = areaStart;
+  *areaEndOut = areaEnd;
+  return block;
+}
+
+// Releases the area `[areaStart, areaEnd)` of `block` and the block itself if
+// it became empty. The caller must hold `impl->lock`.
+static void JitAllocatorImpl_releaseArea(JitAllocatorPrivateImpl* impl, JitAllocatorBlock* block, uint32_t areaStart, uint32_t areaEnd) noexcept {
+  JitAllocatorPool* pool = block->pool();
+  uint32_t areaSize = areaEnd - areaStart;
+
+  block->markReleasedArea(areaStart, areaEnd);
+  pool->counters.releaseCount++;
 
   // Fill the released memory if the secure mode is enabled.
-  if (impl->options & kOptionFillUnusedMemory)
-    JitAllocatorImpl_fillPattern(block->rwPtr() + areaIndex * pool->granularity, impl->fillPattern, areaSize * pool->granularity);
+  if ((impl->options & JitAllocator::kOptionFillUnusedMemory) && JitAllocatorImpl_makeWritable(impl, block, JitAllocatorImpl_threadScope(impl)) == kErrorOk)
+    JitAllocatorImpl_fillPattern(block->rwPtr() + areaStart * pool->granularity, impl->fillPattern, areaSize * pool->granularity);
 
-  // Release the whole block if it became empty.
+  // Release the whole block if it became empty. Blocks held by write scopes
+  // are released when the last scope that holds them ends.
   if (block->areaUsed() == 0) {
-    if (pool->emptyBlockCount || (impl->options & kOptionImmediateRelease)) {
+    if (!block->_writeRefCount && (pool->emptyBlockCount || (impl->options & JitAllocator::kOptionImmediateRelease))) {
       JitAllocatorImpl_removeBlock(impl, block);
       JitAllocatorImpl_deleteBlock(impl, block);
     }
@@ -865,10 +1645,268 @@ Error JitAllocator::release(void* roPtr) noexcept {
       pool->emptyBlockCount++;
     }
   }
+}
+
+// ============================================================================
+// [asmjit::JitAllocator - Alloc / Release (ThreadCache)]
+// ============================================================================
+
+static inline JitAllocatorThreadCache* JitAllocatorImpl_threadCache(JitAllocatorPrivateImpl* impl) noexcept {
+  return &impl->threadCaches[JitAllocatorImpl_currentThreadId() % kJitAllocatorThreadCacheCount];
+}
+
+static inline JitAllocatorCacheClass& JitAllocatorImpl_cacheClass(JitAllocatorPrivateImpl* impl, JitAllocatorThreadCache* cache, size_t size) noexcept {
+  size_t classId = (size >> Support::ctz(impl->granularity)) - 1u;
+  ASMJIT_ASSERT(classId < kJitAllocatorThreadCacheMaxClassCount);
+  return cache->classes[classId];
+}
+
+static inline bool JitAllocatorImpl_canCacheArea(JitAllocatorThreadCache* cache, JitAllocatorCacheClass& cacheClass, size_t size) noexcept {
+  if (cacheClass.count >= kJitAllocatorThreadCacheClassCapacity || cache->cachedBytes + size > kJitAllocatorThreadCacheMaxBytes)
+    return false;
+
+  if (!cacheClass.areas) {
+    cacheClass.areas = static_cast<JitAllocatorCachedArea*>(::malloc(kJitAllocatorThreadCacheClassCapacity * sizeof(JitAllocatorCachedArea)));
+    if (ASMJIT_UNLIKELY(!cacheClass.areas))
+      return false;
+  }
+
+  return true;
+}
+
+static inline void JitAllocatorImpl_pushCachedArea(JitAllocatorThreadCache* cache, JitAllocatorCacheClass& cacheClass, void* roPtr, void* rwPtr, size_t size) noexcept {
+  cacheClass.areas[cacheClass.count++] = JitAllocatorCachedArea { roPtr, rwPtr };
+  cache->cachedBytes += size;
+}
+
+// Returns all pending releases of `cache` either back to its size classes (if
+// `recycle` is true and there is a room for them) or to the global pool. The
+// caller must hold both `cache->lock` and `impl->lock`.
+static void JitAllocatorImpl_flushPending(JitAllocatorPrivateImpl* impl, JitAllocatorThreadCache* cache, bool recycle) noexcept {
+  for (uint32_t i = 0; i < cache->pendingCount; i++) {
+    uint32_t areaStart;
+    uint32_t areaEnd;
+
+    // Invalid pointers are ignored as there is nobody to report the error to.
+    JitAllocatorBlock* block = JitAllocatorImpl_findArea(impl, cache->pending[i], &areaStart, &areaEnd);
+    if (ASMJIT_UNLIKELY(!block))
+      continue;
+
+    JitAllocatorPool* pool = block->pool();
+    size_t size = pool->byteSizeFromAreaSize(areaEnd - areaStart);
+
+    // Only areas of the default placement can be reused by thread caches.
+    if (recycle && size <= kJitAllocatorThreadCacheMaxSize && pool->placement == JitAllocator::kPlacementDefault) {
+      JitAllocatorCacheClass& cacheClass = JitAllocatorImpl_cacheClass(impl, cache, size);
+      if (JitAllocatorImpl_canCacheArea(cache, cacheClass, size)) {
+        size_t offset = pool->byteSizeFromAreaSize(areaStart);
+
+        if (impl->options & JitAllocator::kOptionFillUnusedMemory)
+          JitAllocatorImpl_fillPattern(block->rwPtr() + offset, impl->fillPattern, size);
+
+        JitAllocatorImpl_pushCachedArea(cache, cacheClass, block->roPtr() + offset, block->rwPtr() + offset, size);
+        continue;
+      }
+    }
+
+    JitAllocatorImpl_releaseArea(impl, block, areaStart, areaEnd);
+  }
+
+  cache->pendingCount = 0;
+}
+
+// Returns all areas held by `cache` to the global pool. The caller must hold
+// both `cache->lock` and `impl->lock`.
+static void JitAllocatorImpl_flushThreadCache(JitAllocatorPrivateImpl* impl, JitAllocatorThreadCache* cache) noexcept {
+  JitAllocatorImpl_flushPending(impl, cache, false);
+
+  for (JitAllocatorCacheClass& cacheClass : cache->classes) {
+    for (uint32_t i = 0; i < cacheClass.count; i++) {
+      uint32_t areaStart;
+      uint32_t areaEnd;
+
+      JitAllocatorBlock* block = JitAllocatorImpl_findArea(impl, cacheClass.areas[i].ro, &areaStart, &areaEnd);
+      ASMJIT_ASSERT(block != nullptr);
+
+      JitAllocatorImpl_releaseArea(impl, block, areaStart, areaEnd);
+    }
+    cacheClass.count = 0;
+  }
+
+  cache->cachedBytes = 0;
+}
+
+// Allocates an area of `size` bytes from `cache` and refills the cache from
+// the global pool if it has no area of the requested size. The caller must
+// hold `cache->lock`.
+static Error JitAllocatorImpl_allocCached(JitAllocatorPrivateImpl* impl, JitAllocatorThreadCache* cache, size_t size, void** roPtrOut, void** rwPtrOut) noexcept {
+  JitAllocatorCacheClass& cacheClass = JitAllocatorImpl_cacheClass(impl, cache, size);
+
+  if (!cacheClass.count) {
+    LockGuard guard(impl->lock);
+
+    // Pending releases could provide the area we need, so return them first.
+    if (cache->pendingCount)
+      JitAllocatorImpl_flushPending(impl, cache, true);
+
+    if (!cacheClass.count) {
+      ASMJIT_PROPAGATE(JitAllocatorImpl_allocArea(impl, size, JitAllocator::kPlacementDefault, nullptr, roPtrOut, rwPtrOut));
+
+      // Reserve more areas of the same size while we hold the global lock.
+      for (uint32_t i = 1; i < kJitAllocatorThreadCacheRefillCount; i++) {
+        void* roPtr;
+        void* rwPtr;
 
+        if (!JitAllocatorImpl_canCacheArea(cache, cacheClass, size) || JitAllocatorImpl_allocArea(impl, size, JitAllocator::kPlacementDefault, nullptr, &roPtr, &rwPtr) != kErrorOk)
+          break;
+
+        JitAllocatorImpl_pushCachedArea(cache, cacheClass, roPtr, rwPtr, size);
+      }
+
+      return kErrorOk;
+    }
+  }
+
+  const JitAllocatorCachedArea& area = cacheClass.areas[--cacheClass.count];
+  cache->cachedBytes -= size;
+
+  *roPtrOut = area.ro;
+  *rwPtrOut = area.rw;
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::JitAllocator - Alloc / Release]
+// ============================================================================
+
+Error JitAllocator::alloc(void** roPtrOut, void** rwPtrOut, size_t size, uint32_t placement) noexcept {
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+
+  *roPtrOut = nullptr;
+  *rwPtrOut = nullptr;
+
+  // Align to the minimum granularity by default.
+  size = Support::alignUp<size_t>(size, impl->granularity);
+  if (ASMJIT_UNLIKELY(size == 0))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  if (ASMJIT_UNLIKELY(size > std::numeric_limits<uint32_t>::max() / 2))
+    return DebugUtils::errored(kErrorTooLarge);
+
+  if (ASMJIT_UNLIKELY(placement >= kPlacementCount))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  if (impl->threadCaches && size <= kJitAllocatorThreadCacheMaxSize && placement == kPlacementDefault) {
+    JitAllocatorThreadCache* cache = JitAllocatorImpl_threadCache(impl);
+    LockGuard guard(cache->lock);
+
+    ASMJIT_PROPAGATE(JitAllocatorImpl_allocCached(impl, cache, size, roPtrOut, rwPtrOut));
+    cache->allocCount++;
+    return kErrorOk;
+  }
+
+  LockGuard guard(impl->lock);
+
+  // Memory allocated outside of a write scope could never be written to.
+  JitAllocatorWriteScope* scope = nullptr;
+  if (impl->options & kOptionWriteProtect) {
+    scope = JitAllocatorImpl_threadScope(impl);
+    if (ASMJIT_UNLIKELY(!scope))
+      return DebugUtils::errored(kErrorInvalidState);
+  }
+
+  ASMJIT_PROPAGATE(JitAllocatorImpl_allocArea(impl, size, placement, scope, roPtrOut, rwPtrOut));
+  impl->counters.allocCount++;
+  return kErrorOk;
+}
+
+Error JitAllocator::allocWritable(void** roPtrOut, void** rwPtrOut, size_t size, uint32_t placement) noexcept {
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+  if (!(impl->options & kOptionWriteProtect))
+    return alloc(roPtrOut, rwPtrOut, size, placement);
+
+  *roPtrOut = nullptr;
+  *rwPtrOut = nullptr;
+
+  size = Support::alignUp<size_t>(size, impl->granularity);
+  if (ASMJIT_UNLIKELY(size == 0))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  if (ASMJIT_UNLIKELY(size > std::numeric_limits<uint32_t>::max() / 2))
+    return DebugUtils::errored(kErrorTooLarge);
+
+  if (ASMJIT_UNLIKELY(placement >= kPlacementCount))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  LockGuard guard(impl->lock);
+
+  JitAllocatorWriteScope* scope = JitAllocatorImpl_newScope(impl, 0);
+  if (ASMJIT_UNLIKELY(!scope))
+    return DebugUtils::errored(kErrorOutOfMemory);
+
+  Error err = JitAllocatorImpl_allocArea(impl, size, placement, scope, roPtrOut, rwPtrOut);
+  if (ASMJIT_UNLIKELY(err)) {
+    JitAllocatorImpl_endScope(impl, scope);
+    return err;
+  }
+
+  scope->roPtr = *roPtrOut;
+  impl->counters.allocCount++;
+  return kErrorOk;
+}
+
+Error JitAllocator::release(void* roPtr) noexcept {
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(!roPtr))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+
+  // Releases are deferred when thread caches are used, they are returned to
+  // the global pool in batches to not take the global lock each time.
+  if (impl->threadCaches) {
+    JitAllocatorThreadCache* cache = JitAllocatorImpl_threadCache(impl);
+    LockGuard guard(cache->lock);
+
+    cache->pending[cache->pendingCount++] = roPtr;
+    cache->releaseCount++;
+    if (cache->pendingCount == kJitAllocatorThreadCacheFlushCount) {
+      LockGuard globalGuard(impl->lock);
+      JitAllocatorImpl_flushPending(impl, cache, true);
+    }
+
+    return kErrorOk;
+  }
+
+  LockGuard guard(impl->lock);
+
+  uint32_t areaStart;
+  uint32_t areaEnd;
+
+  JitAllocatorBlock* block = JitAllocatorImpl_findArea(impl, roPtr, &areaStart, &areaEnd);
+  if (ASMJIT_UNLIKELY(!block))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  // Memory allocated by `allocWritable()` ends its write scope when released.
+  if (block->_writeRefCount) {
+    JitAllocatorWriteScope* scope = JitAllocatorImpl_areaScope(impl, roPtr);
+    if (scope)
+      JitAllocatorImpl_endScope(impl, scope);
+  }
+
+  JitAllocatorImpl_releaseArea(impl, block, areaStart, areaEnd);
+  impl->counters.releaseCount++;
+  return JitAllocatorImpl_protectBlocks(impl);
+}
+
 Error JitAllocator::shrink(void* roPtr, size_t newSize) noexcept {
   if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
     return DebugUtils::errored(kErrorNotInitialized);
@@ -881,19 +1919,15 @@ Error JitAllocator::shrink(void* roPtr, size_t newSize) noexcept {
 
   JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
   LockGuard guard(impl->lock);
-  JitAllocatorBlock* block = impl->tree.get(static_cast<uint8_t*>(roPtr));
 
+  uint32_t areaStart;
+  uint32_t areaEnd;
+
+  JitAllocatorBlock* block = JitAllocatorImpl_findArea(impl, roPtr, &areaStart, &areaEnd);
   if (ASMJIT_UNLIKELY(!block))
     return DebugUtils::errored(kErrorInvalidArgument);
 
-  // Offset relative to the start of the block.
   JitAllocatorPool* pool = block->pool();
-  size_t offset = (size_t)((uint8_t*)roPtr - block->roPtr());
-
-  // The first bit representing the allocated area and its size.
-  uint32_t areaStart = uint32_t(offset >> pool->granularityLog2);
-  uint32_t areaEnd = uint32_t(Support::bitVectorIndexOf(block->_stopBitVector, areaStart, true)) + 1;
-
   uint32_t areaPrevSize = areaEnd - areaStart;
   uint32_t areaShrunkSize = pool->areaSizeFromByteSize(newSize);
 
@@ -903,15 +1937,294 @@ Error JitAllocator::shrink(void* roPtr, size_t newSize) noexcept {
   uint32_t areaDiff = areaPrevSize - areaShrunkSize;
   if (areaDiff) {
     block->markShrunkArea(areaStart + areaShrunkSize, areaEnd);
+    impl->counters.shrinkCount++;
+    pool->counters.shrinkCount++;
 
     // Fill released memory if the secure mode is enabled.
-    if (impl->options & kOptionFillUnusedMemory)
+    if ((impl->options & kOptionFillUnusedMemory) && JitAllocatorImpl_makeWritable(impl, block, JitAllocatorImpl_threadScope(impl)) == kErrorOk)
       JitAllocatorImpl_fillPattern(block->rwPtr() + (areaStart + areaShrunkSize) * pool->granularity, fillPattern(), areaDiff * pool->granularity);
   }
 
+  return JitAllocatorImpl_protectBlocks(impl);
+}
+
+void JitAllocator::flushThreadCaches() noexcept {
+  if (_impl == &JitAllocatorImpl_none)
+    return;
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+  if (!impl->threadCaches)
+    return;
+
+  for (size_t i = 0; i < kJitAllocatorThreadCacheCount; i++) {
+    JitAllocatorThreadCache* cache = &impl->threadCaches[i];
+    LockGuard guard(cache->lock);
+    LockGuard globalGuard(impl->lock);
+    JitAllocatorImpl_flushThreadCache(impl, cache);
+  }
+}
+
+// ============================================================================
+// [asmjit::JitAllocator - Write Protection]
+// ============================================================================
+
+Error JitAllocator::beginWrite() noexcept {
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+  if (!(impl->options & kOptionWriteProtect))
+    return kErrorOk;
+
+  LockGuard guard(impl->lock);
+  JitAllocatorWriteScope* scope = JitAllocatorImpl_threadScope(impl);
+
+  if (!scope) {
+    scope = JitAllocatorImpl_newScope(impl, JitAllocatorImpl_currentThreadId());
+    if (ASMJIT_UNLIKELY(!scope))
+      return DebugUtils::errored(kErrorOutOfMemory);
+  }
+
+  scope->depth++;
   return kErrorOk;
 }
 
+Error JitAllocator::endWrite() noexcept {
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+  if (!(impl->options & kOptionWriteProtect))
+    return kErrorOk;
+
+  LockGuard guard(impl->lock);
+  JitAllocatorWriteScope* scope = JitAllocatorImpl_threadScope(impl);
+
+  if (ASMJIT_UNLIKELY(!scope))
+    return DebugUtils::errored(kErrorInvalidState);
+
+  if (--scope->depth)
+    return kErrorOk;
+
+  JitAllocatorImpl_endScope(impl, scope);
+  return JitAllocatorImpl_protectBlocks(impl);
+}
+
+Error JitAllocator::endWrite(void* roPtr) noexcept {
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+  if (!(impl->options & kOptionWriteProtect))
+    return kErrorOk;
+
+  LockGuard guard(impl->lock);
+  JitAllocatorWriteScope* scope = JitAllocatorImpl_areaScope(impl, roPtr);
+
+  if (ASMJIT_UNLIKELY(!scope))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  JitAllocatorImpl_endScope(impl, scope);
+  return JitAllocatorImpl_protectBlocks(impl);
+}
+
+// ============================================================================
+// [asmjit::JitAllocator - Compaction]
+// ============================================================================
+
+JitAllocator::CompactHandler::CompactHandler() noexcept {}
+JitAllocator::CompactHandler::~CompactHandler() noexcept {}
+
+// Tests whether all areas allocated in `block` can be moved by `handler`.
+static bool JitAllocatorImpl_canMoveBlock(JitAllocatorPool* pool, JitAllocatorBlock* block, JitAllocator::CompactHandler* handler) noexcept {
+  BitVectorRangeIterator<Support::BitWord, 1> it(block->_usedBitVector, pool->bitWordCountFromAreaSize(block->areaSize()));
+
+  size_t rangeStart;
+  size_t rangeEnd;
+
+  while (it.nextRange(&rangeStart, &rangeEnd)) {
+    // A range of used bits can consist of multiple adjacent areas.
+    uint32_t areaStart = uint32_t(rangeStart);
+    while (areaStart < rangeEnd) {
+      uint32_t areaEnd = uint32_t(Support::bitVectorIndexOf(block->_stopBitVector, areaStart, true)) + 1;
+      if (!handler->canMove(block->roPtr() + pool->byteSizeFromAreaSize(areaStart), pool->byteSizeFromAreaSize(areaEnd - areaStart)))
+        return false;
+      areaStart = areaEnd;
+    }
+  }
+
+  return true;
+}
+
+// Moves all areas allocated in `block` to other blocks of its pool. The block
+// must not be indexed, so it cannot be found as a target of its own areas.
+static Error JitAllocatorImpl_moveBlockAreas(JitAllocatorPrivateImpl* impl, JitAllocatorPool* pool, JitAllocatorBlock* block, JitAllocator::CompactHandler* handler) noexcept {
+  BitVectorRangeIterator<Support::BitWord, 1> it(block->_usedBitVector, pool->bitWordCountFromAreaSize(block->areaSize()));
+
+  size_t rangeStart;
+  size_t rangeEnd;
+
+  // Released areas are always behind the iterator, so they don't affect it.
+  while (it.nextRange(&rangeStart, &rangeEnd)) {
+    uint32_t areaStart = uint32_t(rangeStart);
+    while (areaStart < rangeEnd) {
+      uint32_t areaEnd = uint32_t(Support::bitVectorIndexOf(block->_stopBitVector, areaStart, true)) + 1;
+      uint32_t areaSize = areaEnd - areaStart;
+
+      JitAllocatorBlock* target = nullptr;
+      uint32_t targetStart = JitAllocatorImpl_searchPool(pool, areaSize, nullptr, &target);
+
+      // Other blocks are too fragmented, the block cannot be emptied.
+      if (targetStart == kJitAllocatorNoBucket)
+        return kErrorOk;
+
+      ASMJIT_PROPAGATE(JitAllocatorImpl_makeWritable(impl, target));
+
+      if (target->hasFlag(JitAllocatorBlock::kFlagEmpty)) {
+        pool->emptyBlockCount--;
+        target->clearFlags(JitAllocatorBlock::kFlagEmpty);
+      }
+
+      target->markAllocatedArea(targetStart, targetStart + areaSize);
+      target->addFlags(JitAllocatorBlock::kFlagCompactTarget);
+
+      size_t size = pool->byteSizeFromAreaSize(areaSize);
+      size_t srcOffset = pool->byteSizeFromAreaSize(areaStart);
+      size_t dstOffset = pool->byteSizeFromAreaSize(targetStart);
+
+      memcpy(target->rwPtr() + dstOffset, block->rwPtr() + srcOffset, size);
+      Error err = handler->onMove(block->roPtr() + srcOffset, target->roPtr() + dstOffset, target->rwPtr() + dstOffset, size);
+
+      if (ASMJIT_UNLIKELY(err)) {
+        JitAllocatorImpl_releaseArea(impl, target, targetStart, targetStart + areaSize);
+        return err;
+      }
+
+      // The block itself is deleted by the caller when it becomes empty.
+      block->markReleasedArea(areaStart, areaEnd);
+      pool->counters.allocCount++;
+      pool->counters.releaseCount++;
+      if ((impl->options & JitAllocator::kOptionFillUnusedMemory) && JitAllocatorImpl_makeWritable(impl, block) == kErrorOk)
+        JitAllocatorImpl_fillPattern(block->rwPtr() + srcOffset, impl->fillPattern, size);
+
+      areaStart = areaEnd;
+    }
+  }
+
+  return kErrorOk;
+}
+
+// Moves areas of the sparsest blocks of `pool` to denser blocks and releases
+// blocks that became empty. The caller must hold `impl->lock`.
+static Error JitAllocatorImpl_compactPool(JitAllocatorPrivateImpl* impl, JitAllocatorPool* pool, JitAllocator::CompactHandler* handler, size_t* releasedSize) noexcept {
+  uint32_t blockCount = pool->blockCount;
+  if (!blockCount)
+    return kErrorOk;
+
+  JitAllocatorBlock** blocks = static_cast<JitAllocatorBlock**>(::malloc(blockCount * sizeof(JitAllocatorBlock*)));
+  if (ASMJIT_UNLIKELY(!blocks))
+    return DebugUtils::errored(kErrorOutOfMemory);
+
+  uint32_t i = 0;
+  for (JitAllocatorBlock* block = pool->blocks.first(); block; block = block->next())
+    blocks[i++] = block;
+
+  // Empty and the sparsest blocks first.
+  Support::qSort(blocks, blockCount, [](const JitAllocatorBlock* a, const JitAllocatorBlock* b) noexcept {
+    return int(a->areaUsed() > b->areaUsed()) - int(a->areaUsed() < b->areaUsed());
+  });
+
+  // Number of unused areas in blocks that can still receive moved areas.
+  size_t availableAreaSize = pool->totalAreaSize - pool->totalAreaUsed;
+  Error err = kErrorOk;
+
+  for (i = 0; i < blockCount; i++) {
+    JitAllocatorBlock* block = blocks[i];
+    uint32_t areaUsed = block->areaUsed();
+
+    // Blocks that received moved areas are denser than all blocks that follow.
+    if (block->hasFlag(JitAllocatorBlock::kFlagCompactTarget))
+      break;
+
+    availableAreaSize -= block->areaAvailable();
+
+    // Blocks held by write scopes are neither emptied nor released.
+    if (block->_writeRefCount)
+      continue;
+
+    if (areaUsed) {
+      if (areaUsed > availableAreaSize)
+        break;
+
+      if (!JitAllocatorImpl_canMoveBlock(pool, block, handler)) {
+        availableAreaSize += block->areaAvailable();
+        continue;
+      }
+
+      pool->unindexBlock(block);
+      block->addFlags(JitAllocatorBlock::kFlagCompactSource);
+
+      err = JitAllocatorImpl_moveBlockAreas(impl, pool, block, handler);
+      availableAreaSize -= areaUsed - block->areaUsed();
+
+      block->clearFlags(JitAllocatorBlock::kFlagCompactSource);
+      if (block->areaUsed()) {
+        pool->indexBlock(block);
+        availableAreaSize += block->areaAvailable();
+      }
+    }
+    else if (block->hasFlag(JitAllocatorBlock::kFlagEmpty)) {
+      pool->emptyBlockCount--;
+    }
+
+    if (!block->areaUsed()) {
+      *releasedSize += block->blockSize();
+      JitAllocatorImpl_removeBlock(impl, block);
+      JitAllocatorImpl_deleteBlock(impl, block);
+    }
+
+    if (ASMJIT_UNLIKELY(err))
+      break;
+  }
+
+  for (JitAllocatorBlock* block = pool->blocks.first(); block; block = block->next())
+    block->clearFlags(JitAllocatorBlock::kFlagCompactTarget);
+
+  ::free(blocks);
+  return err;
+}
+
+Error JitAllocator::compact(CompactHandler* handler, size_t* releasedSizeOut) noexcept {
+  if (releasedSizeOut)
+    *releasedSizeOut = 0;
+
+  if (ASMJIT_UNLIKELY(_impl == &JitAllocatorImpl_none))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(!handler))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  // Areas held by thread caches are not known to the handler.
+  flushThreadCaches();
+
+  JitAllocatorPrivateImpl* impl = static_cast<JitAllocatorPrivateImpl*>(_impl);
+  LockGuard guard(impl->lock);
+
+  size_t releasedSize = 0;
+  Error err = kErrorOk;
+
+  for (size_t poolId = 0; poolId < impl->poolCount && !err; poolId++)
+    err = JitAllocatorImpl_compactPool(impl, &impl->pools[poolId], handler, &releasedSize);
+
+  Error protectErr = JitAllocatorImpl_protectBlocks(impl);
+  if (!err)
+    err = protectErr;
+
+  if (releasedSizeOut)
+    *releasedSizeOut = releasedSize;
+  return err;
+}
+
 // ============================================================================
 // [asmjit::JitAllocator - Unit]
 // ============================================================================
@@ -1074,6 +2387,11 @@ static void JitAllocatorTest_usage(JitAllocator& allocator) noexcept {
   INFO("    Reserved (VirtMem): %9llu [Bytes]"         , (unsigned long long)(stats.reservedSize()));
   INFO("    Used     (VirtMem): %9llu [Bytes] (%.1f%%)", (unsigned long long)(stats.usedSize()), stats.usedSizeAsPercent());
   INFO("    Overhead (HeapMem): %9llu [Bytes] (%.1f%%)", (unsigned long long)(stats.overheadSize()), stats.overheadSizeAsPercent());
+  INFO("    LargePages (Obt.) : %9llu [Bytes]"         , (unsigned long long)(stats.largePageObtainedSize()));
+  INFO("    LargePages (Req.) : %9llu [Bytes]"         , (unsigned long long)(stats.largePageRequestedSize()));
+
+  EXPECT(stats.largePageObtainedSize() + stats.largePageRequestedSize() <= stats.reservedSize(),
+         "Memory allocated with large pages cannot exceed the reserved memory");
 }
 
 template<typename T, size_t kPatternSize, bool Bit>
@@ -1104,6 +2422,38 @@ static void BitVectorRangeIterator_testRandom(Random& rnd, size_t count) noexcep
   }
 }
 
+// Handler used by compaction tests, it only moves areas stored in `ptrs`.
+class JitAllocatorCompactTestHandler : public JitAllocator::CompactHandler {
+public:
+  void** _ptrs;
+  size_t _count;
+  size_t _moveCount;
+
+  inline JitAllocatorCompactTestHandler(void** ptrs, size_t count) noexcept
+    : _ptrs(ptrs),
+      _count(count),
+      _moveCount(0) {}
+
+  inline void** find(void* p) const noexcept {
+    for (size_t i = 0; i < _count; i++)
+      if (_ptrs[i] == p)
+        return &_ptrs[i];
+    return nullptr;
+  }
+
+  bool canMove(void* ro, size_t size) noexcept override {
+    DebugUtils::unused(size);
+    return find(ro) != nullptr;
+  }
+
+  Error onMove(void* oldRo, void* newRo, void* newRw, size_t size) noexcept override {
+    DebugUtils::unused(newRw, size);
+    *find(oldRo) = newRo;
+    _moveCount++;
+    return kErrorOk;
+  }
+};
+
 UNIT(jit_allocator) {
   size_t kCount = BrokenAPI::hasArg("--quick") ? 1000 : 100000;
 
@@ -1122,6 +2472,9 @@ UNIT(jit_allocator) {
     { "kOptionUseMultiplePools", JitAllocator::kOptionUseMultiplePools, 0, 0 },
     { "kOptionFillUnusedMemory", JitAllocator::kOptionFillUnusedMemory, 0, 0 },
     { "kOptionImmediateRelease", JitAllocator::kOptionImmediateRelease, 0, 0 },
+    { "kOptionUseThreadCache", JitAllocator::kOptionUseThreadCache, 0, 0 },
+    { "kOptionUseLargePages", JitAllocator::kOptionUseLargePages, 0, 0 },
+    { "kOptionUseLargePages | kOptionUseDualMapping", JitAllocator::kOptionUseLargePages | JitAllocator::kOptionUseDualMapping, 0, 0 },
     { "kOptionUseDualMapping | kOptionFillUnusedMemory", JitAllocator::kOptionUseDualMapping | JitAllocator::kOptionFillUnusedMemory, 0, 0 }
   };
 
@@ -1236,8 +2589,262 @@ UNIT(jit_allocator) {
       wrapper.release(ptrArray[kCount - i - 1]);
     JitAllocatorTest_usage(wrapper._allocator);
 
+    wrapper._allocator.flushThreadCaches();
+    EXPECT(wrapper._allocator.statistics().usedSize() == 0,
+           "JitAllocator must not hold any used memory after all blocks were released");
+
     ::free(ptrArray);
   }
+
+  INFO("JitAllocator - hot/cold placement");
+  {
+    JitAllocator allocator;
+    constexpr size_t kPlacementTestCount = 100;
+
+    uint8_t* hotPtrs[kPlacementTestCount];
+    uint8_t* coldPtrs[kPlacementTestCount];
+    void* rwPtr;
+
+    // Interleaved allocations of different placements must not interleave in memory.
+    for (size_t i = 0; i < kPlacementTestCount; i++) {
+      EXPECT(allocator.alloc((void**)&hotPtrs[i], &rwPtr, 64, JitAllocator::kPlacementHot) == kErrorOk);
+      EXPECT(allocator.alloc((void**)&coldPtrs[i], &rwPtr, 64, JitAllocator::kPlacementCold) == kErrorOk);
+    }
+
+    for (size_t i = 1; i < kPlacementTestCount; i++) {
+      EXPECT(hotPtrs[i] == hotPtrs[0] + i * 64, "Hot code must be densely packed");
+      EXPECT(coldPtrs[i] == coldPtrs[0] + i * 64, "Cold code must be densely packed");
+    }
+
+    EXPECT(allocator.statistics().blockCount() == 2);
+    EXPECT(allocator.alloc((void**)&hotPtrs[0], &rwPtr, 64, JitAllocator::kPlacementCount) == kErrorInvalidArgument);
+  }
+
+  INFO("JitAllocator(kOptionWriteProtect) - batched protection changes");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionWriteProtect | JitAllocator::kOptionFillUnusedMemory;
+
+    JitAllocator allocator(&params);
+    constexpr size_t kWriteTestCount = 64;
+
+    void* roPtrs[kWriteTestCount];
+    void* rwPtr;
+
+    for (uint32_t round = 0; round < 2; round++) {
+      EXPECT(allocator.beginWrite() == kErrorOk);
+      for (size_t i = 0; i < kWriteTestCount; i++) {
+        EXPECT(allocator.alloc(&roPtrs[i], &rwPtr, 64) == kErrorOk);
+        EXPECT(roPtrs[i] == rwPtr);
+        memset(rwPtr, int(i), 64);
+      }
+      EXPECT(allocator.endWrite() == kErrorOk);
+
+      for (size_t i = 0; i < kWriteTestCount; i++)
+        EXPECT(static_cast<const uint8_t*>(roPtrs[i])[63] == uint8_t(i));
+
+      // Released memory is filled, which requires a write access as well.
+      EXPECT(allocator.beginWrite() == kErrorOk);
+      for (size_t i = 0; i < kWriteTestCount; i++)
+        EXPECT(allocator.release(roPtrs[i]) == kErrorOk);
+      EXPECT(allocator.endWrite() == kErrorOk);
+    }
+
+    // The block is created writable, each following scope costs one change
+    // to Read+Write and one change back to Read+Execute.
+    EXPECT(allocator.statistics().protectionChangeCount() == 7);
+    EXPECT(allocator.endWrite() == kErrorInvalidState);
+  }
+
+  INFO("JitAllocator(kOptionWriteProtect) - write scopes of areas");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionWriteProtect;
+
+    JitAllocator allocator(&params);
+    void* roPtrs[2];
+    void* rwPtr;
+
+    // Memory allocated outside of a write scope could never be written to.
+    EXPECT(allocator.alloc(&roPtrs[0], &rwPtr, 64) == kErrorInvalidState);
+
+    EXPECT(allocator.beginWrite() == kErrorOk);
+    EXPECT(allocator.alloc(&roPtrs[0], &rwPtr, 64) == kErrorOk);
+    EXPECT(allocator.endWrite() == kErrorOk);
+
+    // An area scope never shares a block with other memory.
+    EXPECT(allocator.allocWritable(&roPtrs[1], &rwPtr, 64) == kErrorOk);
+    EXPECT(allocator.statistics().blockCount() == 2);
+    memset(rwPtr, 0xCC, 64);
+
+    // Other scopes don't use the block held by the area scope.
+    void* roPtr;
+    EXPECT(allocator.beginWrite() == kErrorOk);
+    EXPECT(allocator.alloc(&roPtr, &rwPtr, 64) == kErrorOk);
+    EXPECT(allocator.endWrite() == kErrorOk);
+    EXPECT(allocator.statistics().blockCount() == 2);
+    EXPECT(static_cast<uint8_t*>(roPtr) - static_cast<uint8_t*>(roPtrs[0]) == 64);
+
+    EXPECT(allocator.endWrite(roPtrs[1]) == kErrorOk);
+    EXPECT(allocator.endWrite(roPtrs[1]) == kErrorInvalidArgument);
+    EXPECT(static_cast<const uint8_t*>(roPtrs[1])[63] == 0xCC);
+
+    EXPECT(allocator.release(roPtr) == kErrorOk);
+    EXPECT(allocator.release(roPtrs[0]) == kErrorOk);
+    EXPECT(allocator.release(roPtrs[1]) == kErrorOk);
+  }
+
+  INFO("JitAllocator - telemetry");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionUseMultiplePools;
+
+    JitAllocator allocator(&params);
+    constexpr size_t kTelemetryTestCount = 100;
+
+    void* roPtrs[kTelemetryTestCount];
+    void* rwPtr;
+
+    for (size_t i = 0; i < kTelemetryTestCount; i++)
+      EXPECT(allocator.alloc(&roPtrs[i], &rwPtr, 256) == kErrorOk);
+
+    // Every other release leaves a 256B hole surrounded by used areas.
+    for (size_t i = 0; i < kTelemetryTestCount; i += 2)
+      EXPECT(allocator.release(roPtrs[i]) == kErrorOk);
+    EXPECT(allocator.shrink(roPtrs[1], 128) == kErrorOk);
+
+    JitAllocator::Snapshot snapshot;
+    EXPECT(allocator.snapshot(&snapshot) == kErrorOk);
+
+    EXPECT(snapshot.counters.allocCount == kTelemetryTestCount);
+    EXPECT(snapshot.counters.releaseCount == kTelemetryTestCount / 2);
+    EXPECT(snapshot.counters.shrinkCount == 0);
+    EXPECT(snapshot.counters.blockCreateCount == 1);
+    EXPECT(snapshot.counters.blockDestroyCount == 0);
+    EXPECT(snapshot.counters.blockSearchCount >= kTelemetryTestCount - 1);
+    EXPECT(snapshot.poolCount == 3 * JitAllocator::kPlacementCount);
+
+    // 256B allocations use the pool of 256B granularity, which cannot shrink them.
+    const JitAllocator::PoolStatistics& poolStats = snapshot.pools[2];
+    EXPECT(poolStats.granularity == 256);
+    EXPECT(poolStats.blockCount == 1);
+    EXPECT(poolStats.usedSize == (kTelemetryTestCount / 2) * 256);
+    EXPECT(poolStats.counters.shrinkCount == 0);
+    EXPECT(poolStats.counters.allocCount == kTelemetryTestCount);
+
+    JitAllocator::FreeRangeHistogram histogram;
+    EXPECT(allocator.freeRangeHistogram(&histogram) == kErrorOk);
+    EXPECT(histogram.counts[8] == kTelemetryTestCount / 2);
+
+    JitAllocator::BlockStatistics blockStats[2];
+    size_t blockCount;
+    EXPECT(allocator.blockStatistics(blockStats, 2, &blockCount) == kErrorOk);
+    EXPECT(blockCount == 1);
+    EXPECT(blockStats[0].poolIndex == 2);
+    EXPECT(blockStats[0].usedSize == poolStats.usedSize);
+    EXPECT(blockStats[0].largestUnusedSize == blockStats[0].blockSize - kTelemetryTestCount * 256);
+
+    // Only shrinks that release memory are counted.
+    EXPECT(allocator.alloc(&roPtrs[0], &rwPtr, 512) == kErrorOk);
+    EXPECT(allocator.shrink(roPtrs[0], 256) == kErrorOk);
+    EXPECT(allocator.snapshot(&snapshot) == kErrorOk);
+    EXPECT(snapshot.counters.shrinkCount == 1);
+    EXPECT(snapshot.pools[2].counters.shrinkCount == 1);
+  }
+
+  INFO("JitAllocator - compaction");
+  {
+    JitAllocator allocator;
+    constexpr size_t kCompactTestCount = 2000;
+    constexpr size_t kCompactTestSize = 256;
+
+    void** ptrs = static_cast<void**>(::malloc(sizeof(void*) * kCompactTestCount));
+    EXPECT(ptrs != nullptr);
+
+    for (size_t i = 0; i < kCompactTestCount; i++) {
+      void* rwPtr;
+      EXPECT(allocator.alloc(&ptrs[i], &rwPtr, kCompactTestSize) == kErrorOk);
+      memset(rwPtr, int(i & 0xFF), kCompactTestSize);
+    }
+
+    // Keep every 10th allocation, which leaves all blocks sparsely used.
+    size_t keptCount = 0;
+    for (size_t i = 0; i < kCompactTestCount; i++) {
+      if (i % 10 == 0)
+        ptrs[keptCount++] = ptrs[i];
+      else
+        EXPECT(allocator.release(ptrs[i]) == kErrorOk);
+    }
+
+    JitAllocator::Statistics before = allocator.statistics();
+    JitAllocatorCompactTestHandler handler(ptrs, keptCount);
+
+    size_t releasedSize = 0;
+    EXPECT(allocator.compact(&handler, &releasedSize) == kErrorOk);
+
+    JitAllocator::Statistics after = allocator.statistics();
+    INFO("  Moved %zu areas, released %zu bytes", handler._moveCount, releasedSize);
+
+    EXPECT(releasedSize > 0, "JitAllocator::compact() must release sparsely used blocks");
+    EXPECT(after.blockCount() < before.blockCount());
+    EXPECT(after.reservedSize() == before.reservedSize() - releasedSize);
+    EXPECT(after.usedSize() == before.usedSize());
+
+    for (size_t i = 0; i < keptCount; i++) {
+      const uint8_t* p = static_cast<const uint8_t*>(ptrs[i]);
+      uint8_t expected = uint8_t((i * 10) & 0xFF);
+      for (size_t j = 0; j < kCompactTestSize; j++)
+        EXPECT(p[j] == expected, "Content of a moved area is corrupted");
+      EXPECT(allocator.release(ptrs[i]) == kErrorOk);
+    }
+
+    EXPECT(allocator.statistics().usedSize() == 0);
+    EXPECT(allocator.compact(nullptr) == kErrorInvalidArgument);
+    ::free(ptrs);
+  }
+
+  INFO("JitAllocator(kOptionUseThreadCache) - concurrent alloc/release");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionUseThreadCache;
+
+    JitAllocator allocator(&params);
+    std::thread threads[4];
+    std::atomic<uint32_t> failures(0);
+
+    for (std::thread& thread : threads) {
+      thread = std::thread([&]() {
+        constexpr size_t kThreadCount = 1000;
+        void* roPtrs[kThreadCount];
+        Random prng((uintptr_t)roPtrs);
+
+        for (uint32_t round = 0; round < 10; round++) {
+          for (size_t i = 0; i < kThreadCount; i++) {
+            void* rwPtr;
+            size_t size = (prng.nextUInt32() % 2048) + 8;
+            if (allocator.alloc(&roPtrs[i], &rwPtr, size) != kErrorOk) {
+              failures++;
+              roPtrs[i] = nullptr;
+              continue;
+            }
+            memset(rwPtr, int(i & 0xFF), size);
+          }
+
+          for (size_t i = 0; i < kThreadCount; i++)
+            if (roPtrs[i])
+              allocator.release(roPtrs[i]);
+        }
+      });
+    }
+
+    for (std::thread& thread : threads)
+      thread.join();
+
+    EXPECT(failures == 0, "JitAllocator failed to allocate memory concurrently");
+    allocator.flushThreadCaches();
+    EXPECT(allocator.statistics().usedSize() == 0,
+           "JitAllocator must not hold any used memory after all blocks were released");
+  }
 }
 #endif
 
@@ -112,10 +112,86 @@ public:
     //! either no blocks or have all blocks fully occupied.
     kOptionImmediateRelease = 0x00000008u,
 
+    //! Enables per-thread caches of pre-reserved areas.
+    //!
+    //! Each thread that uses the allocator is assigned one of several caches,
+    //! which keep free areas of small sizes (up to 4kB) grouped by their size.
+    //! Small allocations are served from the cache without taking the global
+    //! allocator lock, and the cache is refilled in batches when it becomes
+    //! empty. Released memory is accumulated in the cache of the releasing
+    //! thread and returned to the global pool (or recycled by the cache) in
+    //! batches as well.
+    //!
+    //! This option is only recommended for applications that allocate and
+    //! release code concurrently from many threads. The memory held by thread
+    //! caches is reported as used by \ref statistics() and it can be returned
+    //! to the allocator explicitly by calling \ref flushThreadCaches().
+    //!
+    //! \remarks Since `release()` is deferred when this option is used, an
+    //! invalid pointer passed to `release()` is only detected (and ignored)
+    //! when the thread cache is flushed. This option is ignored if
+    //! \ref kOptionWriteProtect is used as cached areas are handed out
+    //! without the allocator lock, which guards write scopes.
+    kOptionUseThreadCache = 0x00000010u,
+
+    //! Backs blocks by large pages (huge pages) if they are available.
+    //!
+    //! Code executed from many small pages spread across a large code cache
+    //! causes many iTLB misses, using large pages reduces them. When this
+    //! option is set the block size is at least \ref VirtMem::Info::largePageSize
+    //! and each new block is allocated with \ref VirtMem::kMMapLargePages.
+    //! If large pages are not available the allocator silently falls back to
+    //! regular pages, use \ref Statistics::largePageObtainedSize() to find out
+    //! how much memory is backed by large pages reserved by the system and
+    //! \ref Statistics::largePageRequestedSize() for how much memory only
+    //! requested transparent huge pages.
+    kOptionUseLargePages = 0x00000020u,
+
+    //! Enforces W^X (write xor execute) without dual mapping by toggling the
+    //! access of blocks between Read+Write and Read+Execute.
+    //!
+    //! This option is designed for systems that don't allow memory that is
+    //! both writable and executable and that don't allow dual mapping either
+    //! (\ref kOptionUseDualMapping takes precedence if both are set). Memory
+    //! can only be allocated by \ref alloc() within a write scope of the
+    //! calling thread, see \ref beginWrite() and \ref endWrite(), or by
+    //! \ref allocWritable(), which starts a write scope bound to the returned
+    //! memory. Each scope holds the blocks it made writable and a block is made
+    //! executable again when no scope holds it, so a burst of allocations and
+    //! writes costs at most one protection change in each direction per block.
+    //! Memory is never allocated from blocks held by other scopes, thus ending
+    //! a scope makes all memory it allocated executable.
+    //!
+    //! \remarks Code in a block that is writable cannot be executed, thus code
+    //! in blocks that are held by a write scope should not be executed until
+    //! the scope ends. Thread caches (\ref kOptionUseThreadCache) are not used
+    //! when this option is set.
+    kOptionWriteProtect = 0x00000040u,
+
     //! Use a custom fill pattern, must be combined with `kFlagFillUnusedMemory`.
     kOptionCustomFillPattern = 0x10000000u
   };
 
+  //! Placement hint passed to \ref alloc().
+  //!
+  //! Each placement has its own chain of blocks, so memory allocated with
+  //! different placements never shares a block. Keeping frequently executed
+  //! code apart from code that is executed rarely (or only once) keeps the
+  //! hot code densely packed in few pages, which improves instruction cache
+  //! and iTLB locality. Users that have more tiers of code should map them
+  //! onto these placements.
+  enum Placement : uint32_t {
+    //! Default placement.
+    kPlacementDefault = 0,
+    //! Frequently executed code.
+    kPlacementHot = 1,
+    //! Rarely executed code.
+    kPlacementCold = 2,
+
+    //! Count of placements.
+    kPlacementCount = 3
+  };
+
   //! \name Construction & Destruction
   //! \{
 
@@ -201,8 +277,27 @@ public:
 
   //! Allocate `size` bytes of virtual memory.
   //!
+  //! The memory is allocated from blocks reserved for the given `placement`,
+  //! see \ref Placement. Thread caches (see \ref kOptionUseThreadCache) only
+  //! serve \ref kPlacementDefault allocations.
+  //!
+  //! If \ref kOptionWriteProtect is used the calling thread must be in a write
+  //! scope, otherwise \ref kErrorInvalidState is returned.
+  //!
+  //! \remarks This function is thread-safe.
+  ASMJIT_API Error alloc(void** roPtrOut, void** rwPtrOut, size_t size, uint32_t placement = kPlacementDefault) noexcept;
+
+  //! Like \ref alloc(), but the memory stays writable until \ref endWrite(void*)
+  //! is called with the returned `roPtrOut` or until the memory is released,
+  //! which can happen on any thread.
+  //!
+  //! Only differs from \ref alloc() if \ref kOptionWriteProtect is used, in
+  //! that case the memory is allocated from a block that contains no other
+  //! allocations, so it doesn't keep other code non-executable, and the block
+  //! is not used by other allocations until the write scope ends.
+  //!
   //! \remarks This function is thread-safe.
-  ASMJIT_API Error alloc(void** roPtrOut, void** rwPtrOut, size_t size) noexcept;
+  ASMJIT_API Error allocWritable(void** roPtrOut, void** rwPtrOut, size_t size, uint32_t placement = kPlacementDefault) noexcept;
 
   //! Release a memory returned by `alloc()`.
   //!
@@ -214,6 +309,95 @@ public:
   //! \remarks This function is thread-safe.
   ASMJIT_API Error shrink(void* roPtr, size_t newSize) noexcept;
 
+  //! Returns all memory held by thread caches back to the allocator.
+  //!
+  //! Does nothing if \ref kOptionUseThreadCache option is not used.
+  //!
+  //! \remarks This function is thread-safe.
+  ASMJIT_API void flushThreadCaches() noexcept;
+
+  //! \}
+
+  //! \name Write Protection
+  //! \{
+
+  //! Begins a write scope of the calling thread.
+  //!
+  //! Only has effect if \ref kOptionWriteProtect is used, in that case the
+  //! memory returned by \ref alloc() called by this thread stays writable
+  //! until the outermost write scope of the thread ends by \ref endWrite().
+  //! Write scopes can be nested. Each thread has its own scope, which only
+  //! holds blocks that the thread made writable, so scopes of other threads
+  //! don't prevent the memory from becoming executable.
+  //!
+  //! \remarks This function is thread-safe.
+  ASMJIT_API Error beginWrite() noexcept;
+
+  //! Ends a write scope started by \ref beginWrite() on the calling thread.
+  //!
+  //! If this is the outermost write scope of the thread all blocks held by it
+  //! are made executable again, except blocks still held by other scopes.
+  //! Returns \ref kErrorInvalidState if the thread is not in a write scope.
+  //!
+  //! \remarks This function is thread-safe.
+  ASMJIT_API Error endWrite() noexcept;
+
+  //! Ends a write scope of memory allocated by \ref allocWritable() at `roPtr`.
+  //!
+  //! Returns \ref kErrorInvalidArgument if there is no such write scope.
+  //!
+  //! \remarks This function is thread-safe.
+  ASMJIT_API Error endWrite(void* roPtr) noexcept;
+
+  //! \}
+
+  //! \name Compaction
+  //! \{
+
+  //! Handler used by \ref compact() to move allocated memory.
+  class ASMJIT_VIRTAPI CompactHandler {
+  public:
+    ASMJIT_BASE_CLASS(CompactHandler)
+
+    ASMJIT_API CompactHandler() noexcept;
+    ASMJIT_API virtual ~CompactHandler() noexcept;
+
+    //! Tests whether the allocation at `ro` having `size` bytes can be moved.
+    //!
+    //! Must return false for allocations that are unknown to the handler or
+    //! contain code that cannot be relocated.
+    virtual bool canMove(void* ro, size_t size) noexcept = 0;
+
+    //! Called after the content of the allocation at `oldRo` was copied to
+    //! `newRw` (the writable view of `newRo`).
+    //!
+    //! The handler must make the code work at `newRo` and replace all pointers
+    //! to `oldRo` by `newRo`. Code that was emitted with relocations recorded
+    //! by `CodeHolder` can be fixed by `CodeHolder::relocateToBase(newRo)` and
+    //! by copying its sections to `newRw` again. The handler is responsible
+    //! for flushing the instruction cache if the target requires it.
+    //!
+    //! If an error is returned the new allocation is released, the old one is
+    //! kept, and `compact()` stops and returns the error.
+    virtual Error onMove(void* oldRo, void* newRo, void* newRw, size_t size) noexcept = 0;
+  };
+
+  //! Moves allocations of sparsely used blocks to denser blocks and releases
+  //! blocks that became empty, the number of released bytes is stored to
+  //! `releasedSizeOut` (optional).
+  //!
+  //! Blocks are only emptied if all allocations they contain can be moved,
+  //! see \ref CompactHandler::canMove(). Memory held by thread caches is
+  //! returned to the allocator first. The spare empty block the allocator
+  //! keeps (unless \ref kOptionImmediateRelease is set) is released as well.
+  //!
+  //! \remarks The handler is called with the allocator lock held, thus it
+  //! must not use the allocator. No thread may execute code that is being
+  //! moved, so the compaction should only be used when the owner of the code
+  //! can guarantee that, for example after all threads passed a quiescent
+  //! state (see \ref JitReclaimer).
+  ASMJIT_API Error compact(CompactHandler* handler, size_t* releasedSizeOut = nullptr) noexcept;
+
   //! \}
 
   //! \name Statistics
@@ -229,12 +413,21 @@ public:
     size_t _reservedSize;
     //! Allocation overhead (in bytes) required to maintain all blocks.
     size_t _overheadSize;
+    //! How many of reserved bytes only requested transparent huge pages.
+    size_t _largePageRequestedSize;
+    //! How many of reserved bytes are backed by explicitly reserved large pages.
+    size_t _largePageObtainedSize;
+    //! How many times the access of a block was changed by \ref kOptionWriteProtect.
+    size_t _protectionChangeCount;
 
     inline void reset() noexcept {
       _blockCount = 0;
       _usedSize = 0;
       _reservedSize = 0;
       _overheadSize = 0;
+      _largePageRequestedSize = 0;
+      _largePageObtainedSize = 0;
+      _protectionChangeCount = 0;
     }
 
     //! Returns count of blocks managed by `JitAllocator` at the moment.
@@ -248,6 +441,21 @@ public:
     inline size_t reservedSize() const noexcept { return _reservedSize; }
     //! Returns the number of bytes the allocator needs to manage the allocated memory.
     inline size_t overheadSize() const noexcept { return _overheadSize; }
+    //! Returns the number of reserved bytes in blocks for which transparent
+    //! huge pages were requested by `madvise()`.
+    //!
+    //! \note This is not the number of bytes actually backed by large pages,
+    //! the kernel decides whether and when to back such blocks by huge pages
+    //! (see `AnonHugePages` in `/proc/self/smaps`).
+    inline size_t largePageRequestedSize() const noexcept { return _largePageRequestedSize; }
+    //! Returns the number of reserved bytes in blocks backed by large pages
+    //! reserved at allocation time, which are HugeTLB pages (Linux) or
+    //! `MEM_LARGE_PAGES` (Windows).
+    inline size_t largePageObtainedSize() const noexcept { return _largePageObtainedSize; }
+    //! Returns how many times the access of a block was changed between
+    //! Read+Write and Read+Execute since the allocator was created (only
+    //! non-zero if \ref kOptionWriteProtect is used).
+    inline size_t protectionChangeCount() const noexcept { return _protectionChangeCount; }
 
     inline double usedSizeAsPercent() const noexcept {
       return (double(usedSize()) / (double(reservedSize()) + 1e-16)) * 100.0;
@@ -268,6 +476,135 @@ public:
   ASMJIT_API Statistics statistics() const noexcept;
 
   //! \}
+
+  //! \name Telemetry
+  //! \{
+
+  //! Cumulative counters of allocator operations.
+  struct Counters {
+    //! Number of allocations.
+    uint64_t allocCount;
+    //! Number of releases.
+    uint64_t releaseCount;
+    //! Number of shrinks that released memory.
+    uint64_t shrinkCount;
+    //! Number of blocks created.
+    uint64_t blockCreateCount;
+    //! Number of blocks destroyed.
+    uint64_t blockDestroyCount;
+    //! Number of blocks searched for an unused area.
+    uint64_t blockSearchCount;
+
+    inline void reset() noexcept { memset(this, 0, sizeof(*this)); }
+
+    //! Returns the average number of blocks searched by a single allocation.
+    inline double blockSearchesPerAlloc() const noexcept {
+      return double(blockSearchCount) / (double(allocCount) + 1e-16);
+    }
+  };
+
+  //! Statistics of a single pool (a placement and granularity class).
+  struct PoolStatistics {
+    //! Placement of the pool, see \ref Placement.
+    uint32_t placement;
+    //! Allocation granularity of the pool.
+    uint32_t granularity;
+    //! Number of blocks of the pool.
+    size_t blockCount;
+    //! Number of empty blocks kept by the pool.
+    size_t emptyBlockCount;
+    //! How many bytes are currently used.
+    size_t usedSize;
+    //! How many bytes are reserved by blocks of the pool.
+    size_t reservedSize;
+    //! Allocation overhead (in bytes) required to maintain blocks of the pool.
+    size_t overheadSize;
+    //! Operations performed by the pool, including those that refill or
+    //! flush thread caches.
+    Counters counters;
+  };
+
+  //! Statistics of a single block.
+  struct BlockStatistics {
+    //! Read+Execute address of the block.
+    const void* ro;
+    //! Index of the pool in \ref Snapshot::pools.
+    uint32_t poolIndex;
+    //! Whether the block requested transparent huge pages, see
+    //! \ref Statistics::largePageRequestedSize().
+    bool largePagesRequested;
+    //! Whether the block is backed by explicitly reserved large pages, see
+    //! \ref Statistics::largePageObtainedSize().
+    bool largePagesObtained;
+    //! Size of the block.
+    size_t blockSize;
+    //! How many bytes of the block are currently used.
+    size_t usedSize;
+    //! Size of the largest unused range of the block.
+    size_t largestUnusedSize;
+  };
+
+  //! A snapshot of allocator telemetry, see \ref snapshot().
+  struct Snapshot {
+    enum : uint32_t {
+      //! Maximum number of pools (granularity classes of all placements).
+      kMaxPoolCount = 3 * kPlacementCount
+    };
+
+    //! Calls of \ref alloc(), \ref release(), and \ref shrink(), and the sums
+    //! of block counters of all pools.
+    Counters counters;
+    //! Number of bytes held by thread caches (reported as used).
+    size_t cachedSize;
+    //! Number of valid entries in \ref pools.
+    uint32_t poolCount;
+    //! Statistics of each pool.
+    PoolStatistics pools[kMaxPoolCount];
+
+    inline void reset() noexcept { memset(this, 0, sizeof(*this)); }
+  };
+
+  //! Histogram of unused ranges of all blocks, see \ref freeRangeHistogram().
+  struct FreeRangeHistogram {
+    enum : uint32_t {
+      //! Number of entries of \ref counts.
+      kSize = 32
+    };
+
+    //! Number of unused ranges, entry `i` counts ranges of `[2^i, 2^(i+1))` bytes.
+    size_t counts[kSize];
+
+    inline void reset() noexcept { memset(this, 0, sizeof(*this)); }
+  };
+
+  //! Takes a snapshot of allocator telemetry and stores it to `out`.
+  //!
+  //! Only counters and totals are copied, the cost doesn't depend on the
+  //! amount of memory reserved by the allocator.
+  //!
+  //! \remarks This function is thread-safe. Each thread cache and then the
+  //! allocator itself are locked only to copy their counters, so totals of
+  //! thread caches and pools don't have to match if other threads allocate
+  //! concurrently.
+  ASMJIT_API Error snapshot(Snapshot* out) const noexcept;
+
+  //! Scans unused ranges of all blocks and stores their histogram to `out`.
+  //!
+  //! The scan walks bit-vectors of all blocks, its cost is proportional to the
+  //! reserved memory divided by the granularity and the bit-word size.
+  //!
+  //! \remarks This function is thread-safe. The allocator lock is held while
+  //! blocks of a single pool are scanned, so allocations made by other threads
+  //! meanwhile wait for the scan of that pool.
+  ASMJIT_API Error freeRangeHistogram(FreeRangeHistogram* out) const noexcept;
+
+  //! Stores statistics of up to `capacity` blocks to `out` and the number of
+  //! all blocks to `countOut`, which can be larger than `capacity`.
+  //!
+  //! \remarks This function is thread-safe.
+  ASMJIT_API Error blockStatistics(BlockStatistics* out, size_t capacity, size_t* countOut) const noexcept;
+
+  //! \}
 };
 
 //! \}
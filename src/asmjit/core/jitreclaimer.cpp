@@ -0,0 +1,274 @@
+// AsmJit - Machine code generation for C++
+//
+//  * Official AsmJit Home Page: https://asmjit.com
+//  * Official Github Repository: https://github.com/asmjit/asmjit
+//
+// Copyright (c) 2008-2020 The AsmJit Authors
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+#include "../core/api-build_p.h"
+#ifndef ASMJIT_NO_JIT
+
+#include "../core/jitreclaimer.h"
+#include "../core/osutils_p.h"
+#include "../core/support.h"
+
+#if defined(ASMJIT_TEST)
+  #include <thread>
+#endif
+
+ASMJIT_BEGIN_NAMESPACE
+
+// ============================================================================
+// [asmjit::JitReclaimer - Construction / Destruction]
+// ============================================================================
+
+JitReclaimer::JitReclaimer(JitAllocator* allocator, uint32_t maxThreads) noexcept
+  : _allocator(allocator),
+    _lock(),
+    _epoch(1),
+    _slots(nullptr),
+    _maxThreads(0),
+    _retiredCount(0),
+    _retiredCapacity(0),
+    _reclaimTrigger(kReclaimThreshold),
+    _retired(nullptr) {
+
+  if (!maxThreads)
+    maxThreads = kDefaultMaxThreads;
+
+  _slots = static_cast<Slot*>(::malloc(size_t(maxThreads) * sizeof(Slot)));
+  if (ASMJIT_UNLIKELY(!_slots))
+    return;
+
+  for (uint32_t i = 0; i < maxThreads; i++)
+    new(&_slots[i].epoch) std::atomic<uint64_t>(0);
+  _maxThreads = maxThreads;
+}
+
+JitReclaimer::~JitReclaimer() noexcept {
+  for (size_t i = 0; i < _retiredCount; i++)
+    _allocator->release(_retired[i].ptr);
+
+  ::free(_retired);
+  ::free(_slots);
+}
+
+// ============================================================================
+// [asmjit::JitReclaimer - Accessors]
+// ============================================================================
+
+size_t JitReclaimer::pendingCount() const noexcept {
+  LockGuard guard(_lock);
+  return _retiredCount;
+}
+
+// ============================================================================
+// [asmjit::JitReclaimer - Threads]
+// ============================================================================
+
+Error JitReclaimer::registerThread(uint32_t* slotIdOut) noexcept {
+  *slotIdOut = 0;
+
+  if (ASMJIT_UNLIKELY(!_slots))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  // The thread doesn't execute anything retired before it was registered.
+  for (uint32_t slotId = 0; slotId < _maxThreads; slotId++) {
+    uint64_t expected = 0;
+    if (_slots[slotId].epoch.load() == 0 && _slots[slotId].epoch.compare_exchange_strong(expected, _epoch.load())) {
+      *slotIdOut = slotId;
+      return kErrorOk;
+    }
+  }
+
+  return DebugUtils::errored(kErrorTooManyHandles);
+}
+
+Error JitReclaimer::unregisterThread(uint32_t slotId) noexcept {
+  if (ASMJIT_UNLIKELY(slotId >= _maxThreads || _slots[slotId].epoch.load() == 0))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  _slots[slotId].epoch.store(0);
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::JitReclaimer - Retire & Reclaim]
+// ============================================================================
+
+// Releases retired memory that is not reachable by any registered thread.
+// The caller must hold `self->_lock`.
+static Error JitReclaimer_reclaimRetired(JitReclaimer* self, size_t* releasedOut) noexcept {
+  // Memory retired at epoch `e` is unreachable if all registered threads have
+  // observed epoch `e` (or later) at their last quiescent state.
+  uint64_t minEpoch = std::numeric_limits<uint64_t>::max();
+  for (uint32_t slotId = 0; slotId < self->_maxThreads; slotId++) {
+    uint64_t epoch = self->_slots[slotId].epoch.load();
+    if (epoch)
+      minEpoch = Support::min(minEpoch, epoch);
+  }
+
+  // Retired memory is ordered by epoch, so only a prefix can be released.
+  Error err = kErrorOk;
+  size_t count = self->_retiredCount;
+  size_t released = 0;
+
+  while (released < count && self->_retired[released].epoch <= minEpoch) {
+    Error releaseErr = self->_allocator->release(self->_retired[released].ptr);
+    if (ASMJIT_UNLIKELY(releaseErr))
+      err = releaseErr;
+    released++;
+  }
+
+  if (released) {
+    count -= released;
+    memmove(self->_retired, self->_retired + released, count * sizeof(JitReclaimer::Retired));
+    self->_retiredCount = count;
+  }
+
+  // Don't try again until more memory is retired if nothing can be released.
+  self->_reclaimTrigger = count + JitReclaimer::kReclaimThreshold;
+
+  if (releasedOut)
+    *releasedOut = released;
+  return err;
+}
+
+Error JitReclaimer::retire(void* p) noexcept {
+  if (ASMJIT_UNLIKELY(!p))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  LockGuard guard(_lock);
+
+  if (_retiredCount == _retiredCapacity) {
+    size_t newCapacity = Support::max<size_t>(_retiredCapacity * 2u, kReclaimThreshold);
+    Retired* newRetired = static_cast<Retired*>(::realloc(_retired, newCapacity * sizeof(Retired)));
+
+    if (ASMJIT_UNLIKELY(!newRetired))
+      return DebugUtils::errored(kErrorOutOfMemory);
+
+    _retired = newRetired;
+    _retiredCapacity = newCapacity;
+  }
+
+  // Threads must observe the new epoch before `p` can be released.
+  uint64_t epoch = _epoch.fetch_add(1) + 1;
+  _retired[_retiredCount++] = Retired { p, epoch };
+
+  if (_retiredCount >= _reclaimTrigger)
+    return JitReclaimer_reclaimRetired(this, nullptr);
+
+  return kErrorOk;
+}
+
+Error JitReclaimer::reclaim(size_t* releasedOut) noexcept {
+  LockGuard guard(_lock);
+  return JitReclaimer_reclaimRetired(this, releasedOut);
+}
+
+// ============================================================================
+// [asmjit::JitReclaimer - Unit]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(jit_reclaimer) {
+  JitAllocator allocator;
+
+  INFO("JitReclaimer - quiescent states");
+  {
+    JitReclaimer reclaimer(&allocator);
+
+    uint32_t slotA, slotB;
+    EXPECT(reclaimer.registerThread(&slotA) == kErrorOk);
+    EXPECT(reclaimer.registerThread(&slotB) == kErrorOk);
+    EXPECT(slotA != slotB);
+
+    void* ro;
+    void* rw;
+    size_t released;
+
+    EXPECT(allocator.alloc(&ro, &rw, 64) == kErrorOk);
+    EXPECT(reclaimer.retire(ro) == kErrorOk);
+
+    EXPECT(reclaimer.reclaim(&released) == kErrorOk);
+    EXPECT(released == 0, "Memory cannot be released before threads pass a quiescent state");
+
+    reclaimer.quiescent(slotA);
+    EXPECT(reclaimer.reclaim(&released) == kErrorOk);
+    EXPECT(released == 0, "Memory cannot be released before all threads pass a quiescent state");
+
+    reclaimer.quiescent(slotB);
+    EXPECT(reclaimer.reclaim(&released) == kErrorOk);
+    EXPECT(released == 1);
+    EXPECT(reclaimer.pendingCount() == 0);
+
+    // Unregistered threads don't block reclamation.
+    EXPECT(allocator.alloc(&ro, &rw, 64) == kErrorOk);
+    EXPECT(reclaimer.retire(ro) == kErrorOk);
+    EXPECT(reclaimer.unregisterThread(slotB) == kErrorOk);
+    reclaimer.quiescent(slotA);
+    EXPECT(reclaimer.reclaim(&released) == kErrorOk);
+    EXPECT(released == 1);
+
+    EXPECT(reclaimer.unregisterThread(slotA) == kErrorOk);
+    EXPECT(reclaimer.unregisterThread(slotA) == kErrorInvalidArgument);
+    EXPECT(allocator.statistics().usedSize() == 0);
+  }
+
+  INFO("JitReclaimer - concurrent retire and quiescent states");
+  {
+    JitReclaimer reclaimer(&allocator);
+    std::atomic<uint32_t> done(0);
+    std::thread threads[4];
+
+    for (std::thread& thread : threads) {
+      thread = std::thread([&]() {
+        uint32_t slotId;
+        if (reclaimer.registerThread(&slotId) != kErrorOk)
+          return;
+
+        while (!done.load())
+          reclaimer.quiescent(slotId);
+
+        reclaimer.unregisterThread(slotId);
+      });
+    }
+
+    for (uint32_t i = 0; i < 10000; i++) {
+      void* ro;
+      void* rw;
+      if (allocator.alloc(&ro, &rw, 128) == kErrorOk)
+        reclaimer.retire(ro);
+    }
+
+    done.store(1);
+    for (std::thread& thread : threads)
+      thread.join();
+
+    EXPECT(reclaimer.reclaim() == kErrorOk);
+    EXPECT(reclaimer.pendingCount() == 0);
+    EXPECT(allocator.statistics().usedSize() == 0);
+  }
+}
+#endif
+
+ASMJIT_END_NAMESPACE
+
+#endif
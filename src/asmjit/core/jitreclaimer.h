@@ -0,0 +1,192 @@
+// AsmJit - Machine code generation for C++
+//
+//  * Official AsmJit Home Page: https://asmjit.com
+//  * Official Github Repository: https://github.com/asmjit/asmjit
+//
+// Copyright (c) 2008-2020 The AsmJit Authors
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+#ifndef ASMJIT_CORE_JITRECLAIMER_H_INCLUDED
+#define ASMJIT_CORE_JITRECLAIMER_H_INCLUDED
+
+#include "../core/api-config.h"
+#ifndef ASMJIT_NO_JIT
+
+#include "../core/globals.h"
+#include "../core/jitallocator.h"
+#include "../core/osutils.h"
+
+#include <atomic>
+
+ASMJIT_BEGIN_NAMESPACE
+
+//! \addtogroup asmjit_virtual_memory
+//! \{
+
+// ============================================================================
+// [asmjit::JitReclaimer]
+// ============================================================================
+
+//! Deferred release of JIT code based on quiescent states.
+//!
+//! `JitAllocator::release()` frees memory immediately, so code that may still
+//! be executed by other threads cannot be released without stopping them
+//! first. `JitReclaimer` defers the release until all threads that execute
+//! JIT code have passed a quiescent state - a point at which they don't
+//! execute (and don't hold a pointer to) any code that was retired before.
+//!
+//! Usage:
+//!
+//!   - Each thread that executes JIT code calls \ref registerThread() to get
+//!     its slot and \ref unregisterThread() when it stops executing JIT code.
+//!
+//!   - Threads periodically call \ref quiescent() when they are outside of
+//!     JIT code, for example between processing two tasks.
+//!
+//!   - When a function is replaced, the old pointer is unpublished first and
+//!     then passed to \ref retire(). It's released by the allocator when all
+//!     registered threads have announced a quiescent state after the call to
+//!     `retire()`. Retired functions are reclaimed in batches by \ref reclaim(),
+//!     which is also called by `retire()` when too many functions are pending.
+//!
+//! A registered thread that is blocked for a long time delays reclamation of
+//! all functions retired in the meantime, such thread should either call
+//! `quiescent()` before it blocks or unregister itself.
+//!
+//! \remarks All member functions are thread-safe, `quiescent()` is lock-free.
+class JitReclaimer {
+public:
+  ASMJIT_NONCOPYABLE(JitReclaimer)
+
+  enum Limits : uint32_t {
+    //! Default maximum number of registered threads.
+    kDefaultMaxThreads = 64,
+    //! Number of pending functions that triggers `reclaim()` in `retire()`.
+    kReclaimThreshold = 64
+  };
+
+  //! Thread slot, padded to avoid false sharing between threads.
+  struct Slot {
+    //! The last epoch observed by the thread or zero if the slot is free.
+    std::atomic<uint64_t> epoch;
+    //! Padding.
+    uint8_t reserved[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  //! Retired memory waiting for reclamation.
+  struct Retired {
+    //! Pointer returned by `JitAllocator::alloc()`.
+    void* ptr;
+    //! Epoch at which the memory was retired.
+    uint64_t epoch;
+  };
+
+  //! Allocator that owns all retired memory.
+  JitAllocator* _allocator;
+  //! Lock that guards retired memory.
+  mutable Lock _lock;
+  //! Global epoch.
+  std::atomic<uint64_t> _epoch;
+  //! Thread slots.
+  Slot* _slots;
+  //! Maximum number of thread slots.
+  uint32_t _maxThreads;
+  //! Number of retired items.
+  size_t _retiredCount;
+  //! Capacity of `_retired` array.
+  size_t _retiredCapacity;
+  //! Number of retired items that triggers reclamation in `retire()`.
+  size_t _reclaimTrigger;
+  //! Retired memory, ordered by epoch.
+  Retired* _retired;
+
+  //! \name Construction & Destruction
+  //! \{
+
+  //! Creates a reclaimer that releases memory to `allocator` and accepts at
+  //! most `maxThreads` registered threads.
+  ASMJIT_API explicit JitReclaimer(JitAllocator* allocator, uint32_t maxThreads = kDefaultMaxThreads) noexcept;
+  //! Destroys the reclaimer and releases all retired memory.
+  //!
+  //! \note No thread can execute retired code at this point.
+  ASMJIT_API ~JitReclaimer() noexcept;
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  //! Returns the associated allocator.
+  inline JitAllocator* allocator() const noexcept { return _allocator; }
+  //! Returns the maximum number of registered threads.
+  inline uint32_t maxThreads() const noexcept { return _maxThreads; }
+  //! Returns the current epoch.
+  inline uint64_t epoch() const noexcept { return _epoch.load(); }
+
+  //! Returns the number of retired allocations that were not released yet.
+  ASMJIT_API size_t pendingCount() const noexcept;
+
+  //! \}
+
+  //! \name Threads
+  //! \{
+
+  //! Registers the calling thread and stores its slot to `slotIdOut`.
+  //!
+  //! Returns \ref kErrorTooManyHandles if all slots are in use.
+  ASMJIT_API Error registerThread(uint32_t* slotIdOut) noexcept;
+
+  //! Unregisters a thread that was registered by \ref registerThread().
+  ASMJIT_API Error unregisterThread(uint32_t slotId) noexcept;
+
+  //! Announces that the thread registered as `slotId` doesn't execute any JIT
+  //! code retired so far.
+  inline void quiescent(uint32_t slotId) noexcept {
+    ASMJIT_ASSERT(slotId < _maxThreads);
+    _slots[slotId].epoch.store(_epoch.load());
+  }
+
+  //! \}
+
+  //! \name Retire & Reclaim
+  //! \{
+
+  //! Retires `p` returned by `JitAllocator::alloc()` (or `JitRuntime::add()`
+  //! of a runtime that uses the same allocator). The memory is released after
+  //! all registered threads have passed a quiescent state.
+  ASMJIT_API Error retire(void* p) noexcept;
+
+  //! Type-safe version of `retire()` that accepts function pointers.
+  template<typename Func>
+  inline Error retireFunc(Func p) noexcept { return retire(Support::ptr_cast_impl<void*, Func>(p)); }
+
+  //! Releases all retired memory that is no longer reachable by registered
+  //! threads and returns the number of released allocations in `releasedOut`
+  //! (optional).
+  ASMJIT_API Error reclaim(size_t* releasedOut = nullptr) noexcept;
+
+  //! \}
+};
+
+//! \}
+
+ASMJIT_END_NAMESPACE
+
+#endif
+#endif
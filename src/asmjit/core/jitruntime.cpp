@@ -26,6 +26,7 @@
 
 #include "../core/cpuinfo.h"
 #include "../core/jitruntime.h"
+#include "../core/osutils_p.h"
 
 ASMJIT_BEGIN_NAMESPACE
 
@@ -51,25 +52,284 @@ static inline void JitRuntime_flushInstructionCache(const void* p, size_t size)
 #endif
 }
 
+// Copies all sections of a relocated `code` to `rw` and returns the final code size.
+static size_t JitRuntime_copySections(uint8_t* rw, CodeHolder* code) noexcept {
+  // Recalculate the final code size as some relocations may not require
+  // records in an address table anymore.
+  size_t codeSize = code->codeSize();
+
+  for (Section* section : code->_sections) {
+    size_t offset = size_t(section->offset());
+    size_t bufferSize = size_t(section->bufferSize());
+    size_t virtualSize = size_t(section->virtualSize());
+
+    ASMJIT_ASSERT(offset + bufferSize <= codeSize);
+
+    // Sections emitted directly to `rw` by `reserveDirect()` are in place already.
+    if (section->data() != rw + offset)
+      memcpy(rw + offset, section->data(), bufferSize);
+
+    if (virtualSize > bufferSize) {
+      ASMJIT_ASSERT(offset + virtualSize <= codeSize);
+      memset(rw + offset + bufferSize, 0, virtualSize - bufferSize);
+    }
+  }
+
+  return codeSize;
+}
+
+// Returns the alignment required by the base address of a flattened `code`.
+static uint32_t JitRuntime_codeAlignment(const CodeHolder* code) noexcept {
+  uint32_t alignment = 1;
+  for (const Section* section : code->_sections)
+    alignment = Support::max(alignment, section->alignment());
+  return alignment;
+}
+
 // ============================================================================
 // [asmjit::JitRuntime - Construction / Destruction]
 // ============================================================================
 
 JitRuntime::JitRuntime(const JitAllocator::CreateParams* params) noexcept
-  : _allocator(params) {
+  : _allocator(params),
+    _directLock(),
+    _directReservations(nullptr),
+    _directCount(0),
+    _directCapacity(0) {
   _environment = hostEnvironment();
   _environment.setFormat(Environment::kFormatJIT);
 }
 
-JitRuntime::~JitRuntime() noexcept {}
+JitRuntime::~JitRuntime() noexcept {
+  ::free(_directReservations);
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Reset]
+// ============================================================================
+
+static Error JitRuntime_detachReservation(CodeHolder* code, const JitRuntime::DirectReservation& reservation) noexcept;
+
+void JitRuntime::reset(uint32_t resetPolicy) noexcept {
+  {
+    LockGuard guard(_directLock);
+
+    // Code holders that still emit to a reservation must not refer to memory
+    // released by the allocator. If the content cannot be moved to a buffer
+    // managed by `CodeHolder` (out of memory) the code holder is reset.
+    for (size_t i = 0; i < _directCount; i++) {
+      const DirectReservation& reservation = _directReservations[i];
+      if (JitRuntime_detachReservation(reservation.code, reservation) != kErrorOk)
+        reservation.code->reset();
+    }
+    _directCount = 0;
+  }
+
+  _allocator.reset(resetPolicy);
+}
+
+// ============================================================================
+// [asmjit::JitRuntime - Direct Reservations]
+// ============================================================================
+
+// Removes the direct reservation of `code` and stores it to `out`, returns
+// false if `code` has no reservation.
+static bool JitRuntime_takeReservation(JitRuntime* self, CodeHolder* code, JitRuntime::DirectReservation* out) noexcept {
+  LockGuard guard(self->_directLock);
+
+  for (size_t i = 0; i < self->_directCount; i++) {
+    if (self->_directReservations[i].code == code) {
+      *out = self->_directReservations[i];
+      self->_directReservations[i] = self->_directReservations[--self->_directCount];
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Moves the `.text` section of `code` out of the memory of `reservation`.
+static Error JitRuntime_detachReservation(CodeHolder* code, const JitRuntime::DirectReservation& reservation) noexcept {
+  if (code->isInitialized()) {
+    CodeBuffer& buffer = code->textSection()->buffer();
+    if (buffer.data() == reservation.rw)
+      return code->setExternalBuffer(&buffer, nullptr, 0);
+  }
+  return kErrorOk;
+}
+
+// Makes sure that `code` doesn't use the memory of `reservation` and releases it.
+static Error JitRuntime_releaseReservation(JitRuntime* self, CodeHolder* code, const JitRuntime::DirectReservation& reservation) noexcept {
+  ASMJIT_PROPAGATE(JitRuntime_detachReservation(code, reservation));
+
+  // Also ends the write scope of the reserved memory.
+  return self->_allocator.release(reservation.ro);
+}
+
+// Relocates `code` emitted to `reservation` in place and shrinks it.
+static Error JitRuntime_addInPlace(JitRuntime* self, CodeHolder* code, const JitRuntime::DirectReservation& reservation) noexcept {
+  // `.text` is always the first section, so it starts at the beginning.
+  ASMJIT_ASSERT(code->textSection()->offset() == 0);
+  ASMJIT_PROPAGATE(code->relocateToBase(uintptr_t((void*)reservation.ro)));
+
+  size_t codeSize = JitRuntime_copySections(reservation.rw, code);
+  if (codeSize < reservation.capacity)
+    self->_allocator.shrink(reservation.ro, codeSize);
+
+  // The memory after `.text` holds other sections or is reused by the allocator,
+  // limit the capacity so anything emitted to `code` later moves it to the heap.
+  CodeBuffer& buffer = code->textSection()->buffer();
+  ASMJIT_PROPAGATE(code->setExternalBuffer(&buffer, reservation.rw, buffer.size()));
+
+  // Ends the write scope of the reserved memory, the caller still has its own.
+  self->_allocator.endWrite(reservation.ro);
+  self->flush(reservation.ro, codeSize);
+  return kErrorOk;
+}
+
+Error JitRuntime::reserveDirect(CodeHolder* code, size_t capacity, uint32_t placement) noexcept {
+  if (ASMJIT_UNLIKELY(!code->isInitialized()))
+    return DebugUtils::errored(kErrorNotInitialized);
+
+  if (ASMJIT_UNLIKELY(!capacity))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  LockGuard guard(_directLock);
+
+  for (size_t i = 0; i < _directCount; i++)
+    if (ASMJIT_UNLIKELY(_directReservations[i].code == code))
+      return DebugUtils::errored(kErrorInvalidState);
+
+  if (_directCount == _directCapacity) {
+    size_t newCapacity = Support::max<size_t>(_directCapacity * 2u, 4u);
+    DirectReservation* newReservations = static_cast<DirectReservation*>(::realloc(_directReservations, newCapacity * sizeof(DirectReservation)));
+
+    if (ASMJIT_UNLIKELY(!newReservations))
+      return DebugUtils::errored(kErrorOutOfMemory);
+
+    _directReservations = newReservations;
+    _directCapacity = newCapacity;
+  }
+
+  // The reserved memory must stay writable until the reservation is consumed,
+  // possibly by another thread.
+  uint8_t* ro = nullptr;
+  uint8_t* rw = nullptr;
+  Error err = _allocator.allocWritable((void**)&ro, (void**)&rw, capacity, placement);
+
+  if (!err)
+    err = code->setExternalBuffer(&code->textSection()->buffer(), rw, capacity);
+
+  if (ASMJIT_UNLIKELY(err)) {
+    if (ro)
+      _allocator.release(ro);
+    return err;
+  }
+
+  _directReservations[_directCount++] = DirectReservation { code, ro, rw, capacity };
+  return kErrorOk;
+}
+
+Error JitRuntime::cancelDirect(CodeHolder* code) noexcept {
+  DirectReservation reservation;
+  if (ASMJIT_UNLIKELY(!JitRuntime_takeReservation(this, code, &reservation)))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  return JitRuntime_releaseReservation(this, code, reservation);
+}
 
 // ============================================================================
 // [asmjit::JitRuntime - Interface]
 // ============================================================================
 
 Error JitRuntime::_add(void** dst, CodeHolder* code) noexcept {
+  return _addWithPlacement(dst, code, JitAllocator::kPlacementDefault);
+}
+
+// Implements `_addWithPlacement()`, the caller must be in a write scope.
+static Error JitRuntime_addCode(JitRuntime* self, void** dst, CodeHolder* code, uint32_t placement) noexcept {
+  JitAllocator& allocator = self->_allocator;
+  using DirectReservation = JitRuntime::DirectReservation;
+
+  // Memory reserved by `reserveDirect()` is always consumed by `add()`.
+  DirectReservation reservation;
+  bool hasReservation = JitRuntime_takeReservation(self, code, &reservation);
+
+  Error err = code->flatten();
+  if (!err)
+    err = code->resolveUnresolvedLinks();
+
+  size_t estimatedCodeSize = code->codeSize();
+  if (!err && ASMJIT_UNLIKELY(estimatedCodeSize == 0))
+    err = DebugUtils::errored(kErrorNoCodeGenerated);
+
+  if (hasReservation) {
+    // Use the reserved memory if the code was not moved out of it and if all
+    // sections fit, otherwise release it and continue with a new allocation.
+    if (!err && code->textSection()->data() == reservation.rw && estimatedCodeSize <= reservation.capacity) {
+      err = JitRuntime_addInPlace(self, code, reservation);
+      if (!err) {
+        *dst = reservation.ro;
+        return kErrorOk;
+      }
+    }
+
+    Error releaseErr = JitRuntime_releaseReservation(self, code, reservation);
+    if (!err)
+      err = releaseErr;
+  }
+
+  if (ASMJIT_UNLIKELY(err))
+    return err;
+
+  uint8_t* ro;
+  uint8_t* rw;
+  ASMJIT_PROPAGATE(allocator.alloc((void**)&ro, (void**)&rw, estimatedCodeSize, placement));
+
+  // Relocate the code.
+  err = code->relocateToBase(uintptr_t((void*)ro));
+  if (ASMJIT_UNLIKELY(err)) {
+    allocator.release(ro);
+    return err;
+  }
+
+  // Shrink the memory we allocated in case that some relocations didn't
+  // require records in an address table.
+  size_t codeSize = JitRuntime_copySections(rw, code);
+  if (codeSize < estimatedCodeSize)
+    allocator.shrink(ro, codeSize);
+
+  self->flush(ro, codeSize);
+  *dst = ro;
+
+  return kErrorOk;
+}
+
+Error JitRuntime::_addWithPlacement(void** dst, CodeHolder* code, uint32_t placement) noexcept {
   *dst = nullptr;
 
+  // Nested write scopes are cheap, the memory is only made executable when
+  // the outermost scope ends (only if `kOptionWriteProtect` is used).
+  ASMJIT_PROPAGATE(_allocator.beginWrite());
+  Error err = JitRuntime_addCode(this, dst, code, placement);
+  Error protectErr = _allocator.endWrite();
+
+  if (ASMJIT_UNLIKELY(!err && protectErr)) {
+    _allocator.release(*dst);
+    *dst = nullptr;
+    err = protectErr;
+  }
+
+  return err;
+}
+
+static ASMJIT_INLINE void JitRuntime_resetBatch(void** dst, size_t count) noexcept {
+  for (size_t i = 0; i < count; i++)
+    dst[i] = nullptr;
+}
+
+// Flattens `code` and calculates its offset in a batch of `totalSize` bytes.
+static Error JitRuntime_layoutBatchItem(CodeHolder* code, size_t* offsetOut, size_t* totalSize) noexcept {
   ASMJIT_PROPAGATE(code->flatten());
   ASMJIT_PROPAGATE(code->resolveUnresolvedLinks());
 
@@ -77,40 +337,77 @@ Error JitRuntime::_add(void** dst, CodeHolder* code) noexcept {
   if (ASMJIT_UNLIKELY(estimatedCodeSize == 0))
     return DebugUtils::errored(kErrorNoCodeGenerated);
 
-  uint8_t* ro;
-  uint8_t* rw;
-  ASMJIT_PROPAGATE(_allocator.alloc((void**)&ro, (void**)&rw, estimatedCodeSize));
+  size_t offset = Support::alignUp(*totalSize, JitRuntime_codeAlignment(code));
+  if (ASMJIT_UNLIKELY(offset < *totalSize || estimatedCodeSize == SIZE_MAX || SIZE_MAX - offset < estimatedCodeSize))
+    return DebugUtils::errored(kErrorTooLarge);
 
-  // Relocate the code.
-  Error err = code->relocateToBase(uintptr_t((void*)ro));
+  *offsetOut = offset;
+  *totalSize = offset + estimatedCodeSize;
+  return kErrorOk;
+}
+
+Error JitRuntime::addBatch(void** dst, CodeHolder* const* codes, size_t count, uint32_t placement) noexcept {
+  JitRuntime_resetBatch(dst, count);
+
+  if (ASMJIT_UNLIKELY(!count))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  // Flatten all code holders and calculate where each one would be placed.
+  // Offsets are stored in `dst` until the memory is allocated, so `dst` must
+  // be reset on every failure that happens before the final pointers are set.
+  size_t estimatedTotalSize = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t offset = 0;
+    Error err = JitRuntime_layoutBatchItem(codes[i], &offset, &estimatedTotalSize);
+
+    if (ASMJIT_UNLIKELY(err)) {
+      JitRuntime_resetBatch(dst, count);
+      return err;
+    }
+
+    dst[i] = reinterpret_cast<void*>(offset);
+  }
+
+  Error err = _allocator.beginWrite();
   if (ASMJIT_UNLIKELY(err)) {
-    _allocator.release(ro);
+    JitRuntime_resetBatch(dst, count);
     return err;
   }
 
-  // Recalculate the final code size and shrink the memory we allocated for it
-  // in case that some relocations didn't require records in an address table.
-  size_t codeSize = code->codeSize();
+  uint8_t* ro = nullptr;
+  uint8_t* rw = nullptr;
+  err = _allocator.alloc((void**)&ro, (void**)&rw, estimatedTotalSize, placement);
 
-  for (Section* section : code->_sections) {
-    size_t offset = size_t(section->offset());
-    size_t bufferSize = size_t(section->bufferSize());
-    size_t virtualSize = size_t(section->virtualSize());
+  // Relocate and copy the code of all code holders.
+  size_t totalSize = 0;
+  for (size_t i = 0; i < count && !err; i++) {
+    size_t offset = reinterpret_cast<size_t>(dst[i]);
 
-    ASMJIT_ASSERT(offset + bufferSize <= codeSize);
-    memcpy(rw + offset, section->data(), bufferSize);
+    err = codes[i]->relocateToBase(uintptr_t((void*)(ro + offset)));
+    if (!err)
+      totalSize = offset + JitRuntime_copySections(rw + offset, codes[i]);
+  }
 
-    if (virtualSize > bufferSize) {
-      ASMJIT_ASSERT(offset + virtualSize <= codeSize);
-      memset(rw + offset + bufferSize, 0, virtualSize - bufferSize);
-    }
+  // Only the end of the region can be shrunk, gaps between functions stay.
+  if (!err && totalSize < estimatedTotalSize)
+    _allocator.shrink(ro, totalSize);
+
+  Error protectErr = _allocator.endWrite();
+  if (!err)
+    err = protectErr;
+
+  if (ASMJIT_UNLIKELY(err)) {
+    if (ro)
+      _allocator.release(ro);
+
+    JitRuntime_resetBatch(dst, count);
+    return err;
   }
 
-  if (codeSize < estimatedCodeSize)
-    _allocator.shrink(ro, codeSize);
+  flush(ro, totalSize);
 
-  flush(ro, codeSize);
-  *dst = ro;
+  for (size_t i = 0; i < count; i++)
+    dst[i] = ro + reinterpret_cast<size_t>(dst[i]);
 
   return kErrorOk;
 }
@@ -123,6 +420,246 @@ void JitRuntime::flush(const void* p, size_t size) noexcept {
   JitRuntime_flushInstructionCache(p, size);
 }
 
+// ============================================================================
+// [asmjit::JitRuntime - Unit]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+// Appends raw `data` to the `.text` section of `code`.
+static void JitRuntime_appendTestCode(CodeHolder& code, const void* data, size_t size) noexcept {
+  CodeBuffer& buf = code.textSection()->_buffer;
+  EXPECT(code.growBuffer(&buf, size) == kErrorOk);
+  memcpy(buf._data + buf._size, data, size);
+  buf._size += size;
+}
+
+// Initializes `code` for the host and stores raw `data` in its `.text` section.
+static void JitRuntime_initTestCode(CodeHolder& code, const JitRuntime& rt, const void* data, size_t size) noexcept {
+  code.init(rt.environment());
+  JitRuntime_appendTestCode(code, data, size);
+}
+
+// Emits `int f() { return value; }` preceded by `nopCount` NOPs (X86 and X64 only).
+static void JitRuntime_appendTestFunc(CodeHolder& code, size_t nopCount, int value) noexcept {
+  uint8_t nops[256];
+  memset(nops, 0x90, sizeof(nops));
+
+  while (nopCount) {
+    size_t n = Support::min(nopCount, sizeof(nops));
+    JitRuntime_appendTestCode(code, nops, n);
+    nopCount -= n;
+  }
+
+  uint8_t func[6] = { 0xB8, 0, 0, 0, 0, 0xC3 };
+  Support::writeI32u(func + 1, value);
+  JitRuntime_appendTestCode(code, func, sizeof(func));
+}
+
+#if ASMJIT_ARCH_X86
+// Calls a function generated by `JitRuntime_appendTestFunc()`.
+static int JitRuntime_callTestFunc(void* p) noexcept {
+  typedef int (*Func)(void);
+  return ptr_as_func<Func>(p)();
+}
+#endif
+
+// Uses a direct reservation for a function that fits into it and for one
+// that outgrows it, both must work.
+static void JitRuntime_testDirect(JitRuntime& rt) noexcept {
+  static const size_t kNopCount[2] = { 16, 4096 };
+
+  for (size_t i = 0; i < 2; i++) {
+    CodeHolder code;
+    code.init(rt.environment());
+    EXPECT(rt.reserveDirect(&code, 1024) == kErrorOk);
+
+    uint8_t* reserved = code.textSection()->data();
+    JitRuntime_appendTestFunc(code, kNopCount[i], int(i) + 1);
+
+    bool inPlace = code.textSection()->data() == reserved;
+    EXPECT(inPlace == (i == 0), "Code must %s the reserved memory", i == 0 ? "stay in" : "be moved out of");
+
+    void* p;
+    EXPECT(rt._add(&p, &code) == kErrorOk);
+#if ASMJIT_ARCH_X86
+    EXPECT(JitRuntime_callTestFunc(p) == int(i) + 1);
+#endif
+    EXPECT(rt.release(p) == kErrorOk);
+  }
+}
+
+UNIT(jit_runtime) {
+  static const uint8_t kRet[] = { 0xC3 };
+
+  INFO("JitRuntime::addBatch() - failure resets all pointers");
+  {
+    JitRuntime rt;
+    CodeHolder codes[3];
+    CodeHolder* codePtrs[3] = { &codes[0], &codes[1], &codes[2] };
+
+    JitRuntime_initTestCode(codes[0], rt, kRet, sizeof(kRet));
+    JitRuntime_initTestCode(codes[1], rt, kRet, sizeof(kRet));
+    codes[2].init(rt.environment());
+
+    void* dst[3] = { &codes[0], &codes[1], &codes[2] };
+    EXPECT(rt.addBatch(dst, codePtrs, 3) == kErrorNoCodeGenerated);
+    EXPECT(dst[0] == nullptr && dst[1] == nullptr && dst[2] == nullptr);
+    EXPECT(rt.allocator()->statistics().usedSize() == 0);
+
+    EXPECT(rt.addBatch(dst, codePtrs, 2) == kErrorOk);
+    EXPECT(dst[0] != nullptr && dst[1] != nullptr && dst[0] != dst[1]);
+    EXPECT(rt.release(dst[0]) == kErrorOk);
+  }
+
+  INFO("JitRuntime::reserveDirect()");
+  {
+    JitRuntime rt;
+    JitRuntime_testDirect(rt);
+  }
+
+  INFO("JitRuntime::reserveDirect() - kOptionWriteProtect");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionWriteProtect;
+
+    JitRuntime rt(&params);
+    JitRuntime_testDirect(rt);
+  }
+
+  INFO("JitRuntime::add() - emitting after an in-place add()");
+  {
+    JitRuntime rt;
+    CodeHolder code;
+    code.init(rt.environment());
+    EXPECT(rt.reserveDirect(&code, 1024) == kErrorOk);
+    JitRuntime_appendTestFunc(code, 0, 1);
+
+    void* p;
+    EXPECT(rt._add(&p, &code) == kErrorOk);
+    EXPECT(code.textSection()->buffer().capacity() == code.textSection()->buffer().size());
+
+    // Allocates a function that most likely follows `p` in the same block.
+    CodeHolder neighbor;
+    neighbor.init(rt.environment());
+    JitRuntime_appendTestFunc(neighbor, 0, 2);
+
+    void* pNeighbor;
+    EXPECT(rt._add(&pNeighbor, &neighbor) == kErrorOk);
+
+    uint8_t neighborCopy[6];
+    memcpy(neighborCopy, pNeighbor, sizeof(neighborCopy));
+
+    // Emitting to `code` again must not write to the memory of `pNeighbor`.
+    JitRuntime_appendTestFunc(code, 1024, 3);
+    EXPECT(code.textSection()->data() != p);
+    EXPECT(memcmp(pNeighbor, neighborCopy, sizeof(neighborCopy)) == 0,
+           "Emitting after an in-place add() must not modify other allocations");
+#if ASMJIT_ARCH_X86
+    EXPECT(JitRuntime_callTestFunc(p) == 1);
+    EXPECT(JitRuntime_callTestFunc(pNeighbor) == 2);
+#endif
+
+    EXPECT(rt.release(p) == kErrorOk);
+    EXPECT(rt.release(pNeighbor) == kErrorOk);
+  }
+
+  INFO("JitRuntime::add() - while a direct reservation is open (kOptionWriteProtect)");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionWriteProtect;
+
+    JitRuntime rt(&params);
+    CodeHolder direct;
+    direct.init(rt.environment());
+    EXPECT(rt.reserveDirect(&direct, 1024) == kErrorOk);
+    JitRuntime_appendTestFunc(direct, 0, 1);
+
+    // Code added while the reservation is open must be executable.
+    CodeHolder code;
+    code.init(rt.environment());
+    JitRuntime_appendTestFunc(code, 0, 2);
+
+    void* p;
+    EXPECT(rt._add(&p, &code) == kErrorOk);
+    EXPECT(!rt.allocator()->hasOption(JitAllocator::kOptionUseThreadCache));
+#if ASMJIT_ARCH_X86
+    EXPECT(JitRuntime_callTestFunc(p) == 2);
+#endif
+
+    void* pDirect;
+    EXPECT(rt._add(&pDirect, &direct) == kErrorOk);
+#if ASMJIT_ARCH_X86
+    EXPECT(JitRuntime_callTestFunc(pDirect) == 1);
+    EXPECT(JitRuntime_callTestFunc(p) == 2);
+#endif
+
+    EXPECT(rt.release(p) == kErrorOk);
+    EXPECT(rt.release(pDirect) == kErrorOk);
+
+    // Memory cannot be allocated outside of a write scope.
+    void* ro;
+    void* rw;
+    EXPECT(rt.allocator()->alloc(&ro, &rw, 64) == kErrorInvalidState);
+  }
+
+  INFO("JitRuntime::add() - burst in a single write scope (kOptionWriteProtect)");
+  {
+    JitAllocator::CreateParams params {};
+    params.options = JitAllocator::kOptionWriteProtect;
+
+    JitRuntime rt(&params);
+    constexpr size_t kFuncCount = 32;
+    void* funcs[kFuncCount];
+
+    // All functions are added in a single write scope, so the block is only
+    // made executable once at the end.
+    EXPECT(rt.allocator()->beginWrite() == kErrorOk);
+    for (size_t i = 0; i < kFuncCount; i++) {
+      CodeHolder code;
+      code.init(rt.environment());
+      JitRuntime_appendTestFunc(code, 0, int(i));
+      EXPECT(rt._add(&funcs[i], &code) == kErrorOk);
+    }
+    EXPECT(rt.allocator()->endWrite() == kErrorOk);
+
+    for (size_t i = 0; i < kFuncCount; i++) {
+#if ASMJIT_ARCH_X86
+      EXPECT(JitRuntime_callTestFunc(funcs[i]) == int(i));
+#endif
+      EXPECT(rt.release(funcs[i]) == kErrorOk);
+    }
+
+    EXPECT(rt.allocator()->statistics().protectionChangeCount() == 1);
+  }
+
+  INFO("JitRuntime::reset() - detaches code holders from direct reservations");
+  {
+    JitRuntime rt;
+    CodeHolder code;
+    code.init(rt.environment());
+
+    EXPECT(rt.reserveDirect(&code, 1024) == kErrorOk);
+    uint8_t* reserved = code.textSection()->data();
+    JitRuntime_appendTestFunc(code, 0, 42);
+
+    rt.reset();
+    const CodeBuffer& buf = code.textSection()->buffer();
+    EXPECT(buf.data() != reserved);
+    EXPECT(!buf.isExternal());
+    EXPECT(buf.size() == 6 && buf[0] == 0xB8 && buf[1] == 42);
+    EXPECT(rt.cancelDirect(&code) == kErrorInvalidArgument);
+
+    // The code can still be added after the reservation is gone.
+    void* p;
+    EXPECT(rt._add(&p, &code) == kErrorOk);
+#if ASMJIT_ARCH_X86
+    EXPECT(JitRuntime_callTestFunc(p) == 42);
+#endif
+    EXPECT(rt.release(p) == kErrorOk);
+  }
+}
+#endif
+
 ASMJIT_END_NAMESPACE
 
 #endif
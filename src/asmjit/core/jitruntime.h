@@ -29,6 +29,7 @@
 
 #include "../core/codeholder.h"
 #include "../core/jitallocator.h"
+#include "../core/osutils.h"
 #include "../core/target.h"
 
 ASMJIT_BEGIN_NAMESPACE
@@ -48,9 +49,30 @@ class ASMJIT_VIRTAPI JitRuntime : public Target {
 public:
   ASMJIT_NONCOPYABLE(JitRuntime)
 
+  //! Memory reserved by `reserveDirect()` that was not added yet.
+  struct DirectReservation {
+    //! Code holder that emits to the reserved memory.
+    CodeHolder* code;
+    //! Read+execute view of the reserved memory.
+    uint8_t* ro;
+    //! Read+write view of the reserved memory.
+    uint8_t* rw;
+    //! Size of the reserved memory.
+    size_t capacity;
+  };
+
   //! Virtual memory allocator.
   JitAllocator _allocator;
 
+  //! Lock that guards direct reservations.
+  mutable Lock _directLock;
+  //! Direct reservations.
+  DirectReservation* _directReservations;
+  //! Number of direct reservations.
+  size_t _directCount;
+  //! Capacity of `_directReservations` array.
+  size_t _directCapacity;
+
   //! \name Construction & Destruction
   //! \{
 
@@ -59,9 +81,12 @@ public:
   //! Destroys the `JitRuntime` instance.
   ASMJIT_API virtual ~JitRuntime() noexcept;
 
-  inline void reset(uint32_t resetPolicy = Globals::kResetSoft) noexcept {
-    _allocator.reset(resetPolicy);
-  }
+  //! Releases all memory used by the runtime.
+  //!
+  //! Direct reservations are cancelled, the `.text` section of each code
+  //! holder that still emits to a reservation is moved to a buffer managed
+  //! by `CodeHolder` (see \ref cancelDirect()).
+  ASMJIT_API void reset(uint32_t resetPolicy = Globals::kResetSoft) noexcept;
 
   //! \}
 
@@ -85,11 +110,29 @@ public:
   //! The beginning of the memory allocated for the function is returned in `dst`.
   //! If failed `Error` code is returned and `dst` is explicitly set to `nullptr`
   //! (this means that you don't have to set it to null before calling `add()`).
+  //!
+  //! If the allocator uses \ref JitAllocator::kOptionWriteProtect each call
+  //! makes the memory writable and executable again. Wrap a burst of `add()`
+  //! calls by \ref JitAllocator::beginWrite() and \ref JitAllocator::endWrite()
+  //! of \ref allocator() to change the protection of each block only once.
   template<typename Func>
   inline Error add(Func* dst, CodeHolder* code) noexcept {
     return _add(Support::ptr_cast_impl<void**, Func*>(dst), code);
   }
 
+  //! Like `add()`, but places the code into blocks reserved for `placement`,
+  //! see \ref JitAllocator::Placement.
+  //!
+  //! The default placement is handled by `_add()`, other placements by
+  //! `_addWithPlacement()`.
+  template<typename Func>
+  inline Error add(Func* dst, CodeHolder* code, uint32_t placement) noexcept {
+    void** p = Support::ptr_cast_impl<void**, Func*>(dst);
+    if (placement == JitAllocator::kPlacementDefault)
+      return _add(p, code);
+    return _addWithPlacement(p, code, placement);
+  }
+
   //! Releases `p` which was obtained by calling `add()`.
   template<typename Func>
   inline Error release(Func p) noexcept {
@@ -99,9 +142,62 @@ public:
   //! Type-unsafe version of `add()`.
   ASMJIT_API virtual Error _add(void** dst, CodeHolder* code) noexcept;
 
+  //! Type-unsafe version of `add()` that accepts a placement hint.
+  //!
+  //! \note Runtimes that override `_add()` should override this function as
+  //! well, otherwise code added with a non-default placement bypasses them.
+  ASMJIT_API virtual Error _addWithPlacement(void** dst, CodeHolder* code, uint32_t placement) noexcept;
+
+  //! Allocates a single memory region for the code of all `count` code holders
+  //! passed in `codes`, relocates them, and stores the beginning of each
+  //! function in the respective `dst` entry.
+  //!
+  //! This is a faster alternative to calling `add()` for each `CodeHolder` as
+  //! the allocator is only used once and the instruction cache is flushed only
+  //! once for the whole region. Functions are packed one after another and
+  //! each one is only aligned to the largest alignment of its sections.
+  //!
+  //! All functions share the same allocation, which is released by passing
+  //! the first function (`dst[0]`) to `release()`. Other functions must not be
+  //! released individually. If failed, `Error` code is returned and all `dst`
+  //! entries are set to `nullptr`.
+  //!
+  //! The memory is allocated from blocks reserved for `placement`, see
+  //! \ref JitAllocator::Placement.
+  ASMJIT_API Error addBatch(void** dst, CodeHolder* const* codes, size_t count, uint32_t placement = JitAllocator::kPlacementDefault) noexcept;
+
   //! Type-unsafe version of `release()`.
   ASMJIT_API virtual Error _release(void* p) noexcept;
 
+  //! Reserves `capacity` bytes of executable memory and makes its writable
+  //! view the buffer of the `.text` section of `code`, so assemblers attached
+  //! to `code` emit directly to the executable memory.
+  //!
+  //! The next `add()` of `code` relocates the code in place and shrinks the
+  //! reservation to the final code size, there is no intermediate buffer and
+  //! no copy of `.text`. Other sections are copied after `.text` if they fit
+  //! into the reservation. If the code outgrows the reservation it's moved to
+  //! a buffer managed by `CodeHolder` and `add()` falls back to copying it.
+  //! The reservation is consumed by `add()` even if it fails.
+  //!
+  //! After a successful `add()` the `.text` buffer of `code` refers to the
+  //! added function, `code` can be reset or destroyed, but it must not be used
+  //! to emit more code. A reservation that won't be added must be released by
+  //! `cancelDirect()` before `code` is reset or destroyed.
+  //!
+  //! If the allocator uses \ref JitAllocator::kOptionWriteProtect the memory
+  //! is reserved by \ref JitAllocator::allocWritable(), which uses a block that
+  //! contains no other code and that is not used by other allocations until
+  //! the reservation is consumed by `add()` or `cancelDirect()`. Code added
+  //! while the reservation exists is executable as usual.
+  //!
+  //! \note Only `add()` uses the reservation, `addBatch()` copies the code.
+  ASMJIT_API Error reserveDirect(CodeHolder* code, size_t capacity, uint32_t placement = JitAllocator::kPlacementDefault) noexcept;
+
+  //! Releases memory reserved by `reserveDirect()` for `code`. The content of
+  //! the `.text` section is moved to a buffer managed by `CodeHolder`.
+  ASMJIT_API Error cancelDirect(CodeHolder* code) noexcept;
+
   //! Flushes an instruction cache.
   //!
   //! This member function is called after the code has been copied to the
@@ -493,13 +493,17 @@ public:
 // [asmjit::RALiveSpans<T>]
 // ============================================================================
 
-template<typename T>
+//! Sorted live spans of type `T` stored in `VectorT`.
+//!
+//! `VectorT` can be \ref ZoneSmallVector for spans that usually consist of
+//! only a few items, however, such spans must never be swapped.
+template<typename T, typename VectorT = ZoneVector<T>>
 class RALiveSpans {
 public:
-  ASMJIT_NONCOPYABLE(RALiveSpans<T>)
+  ASMJIT_NONCOPYABLE(RALiveSpans)
 
   typedef typename T::DataType DataType;
-  ZoneVector<T> _data;
+  VectorT _data;
 
   //! \name Construction & Destruction
   //! \{
@@ -530,7 +534,7 @@ public:
   //! \name Utilities
   //! \{
 
-  inline void swap(RALiveSpans<T>& other) noexcept { _data.swap(other._data); }
+  inline void swap(RALiveSpans& other) noexcept { _data.swap(other._data); }
 
   //! Open the current live span.
   ASMJIT_INLINE Error openAt(ZoneAllocator* allocator, uint32_t start, uint32_t end) noexcept {
@@ -575,11 +579,13 @@ public:
   inline T& operator[](uint32_t index) noexcept { return _data[index]; }
   inline const T& operator[](uint32_t index) const noexcept { return _data[index]; }
 
-  inline bool intersects(const RALiveSpans<T>& other) const noexcept {
+  template<typename OtherVectorT>
+  inline bool intersects(const RALiveSpans<T, OtherVectorT>& other) const noexcept {
     return intersects(*this, other);
   }
 
-  ASMJIT_INLINE Error nonOverlappingUnionOf(ZoneAllocator* allocator, const RALiveSpans<T>& x, const RALiveSpans<T>& y, const DataType& yData) noexcept {
+  template<typename XVectorT, typename YVectorT>
+  ASMJIT_INLINE Error nonOverlappingUnionOf(ZoneAllocator* allocator, const RALiveSpans<T, XVectorT>& x, const RALiveSpans<T, YVectorT>& y, const DataType& yData) noexcept {
     uint32_t finalSize = x.size() + y.size();
     ASMJIT_PROPAGATE(_data.reserve(allocator, finalSize));
 
@@ -633,7 +639,8 @@ public:
     return kErrorOk;
   }
 
-  static ASMJIT_INLINE bool intersects(const RALiveSpans<T>& x, const RALiveSpans<T>& y) noexcept {
+  template<typename XVectorT, typename YVectorT>
+  static ASMJIT_INLINE bool intersects(const RALiveSpans<T, XVectorT>& x, const RALiveSpans<T, YVectorT>& y) noexcept {
     const T* xSpan = x.data();
     const T* ySpan = y.data();
 
@@ -708,6 +715,8 @@ struct LiveRegData {
 
 typedef RALiveSpan<LiveRegData> LiveRegSpan;
 typedef RALiveSpans<LiveRegSpan> LiveRegSpans;
+//! Live spans of a single \ref RAWorkReg, which are mostly short.
+typedef RALiveSpans<LiveRegSpan, ZoneSmallVector<LiveRegSpan, 2>> WorkRegSpans;
 
 // ============================================================================
 // [asmjit::RATiedReg]
@@ -957,14 +966,14 @@ public:
   uint8_t _hintRegId = BaseReg::kIdBad;
 
   //! Live spans of the `VirtReg`.
-  LiveRegSpans _liveSpans {};
+  WorkRegSpans _liveSpans {};
   //! Live statistics.
   RALiveStats _liveStats {};
 
   //! All nodes that read/write this VirtReg/WorkReg.
-  ZoneVector<BaseNode*> _refs;
+  ZoneSmallVector<BaseNode*, 4> _refs;
   //! All nodes that write to this VirtReg/WorkReg.
-  ZoneVector<BaseNode*> _writes;
+  ZoneSmallVector<BaseNode*, 2> _writes;
 
   enum Ids : uint32_t {
     kIdNone = 0xFFFFFFFFu
@@ -1034,8 +1043,8 @@ public:
   inline bool hasStackSlot() const noexcept { return _stackSlot != nullptr; }
   inline RAStackSlot* stackSlot() const noexcept { return _stackSlot; }
 
-  inline LiveRegSpans& liveSpans() noexcept { return _liveSpans; }
-  inline const LiveRegSpans& liveSpans() const noexcept { return _liveSpans; }
+  inline WorkRegSpans& liveSpans() noexcept { return _liveSpans; }
+  inline const WorkRegSpans& liveSpans() const noexcept { return _liveSpans; }
 
   inline RALiveStats& liveStats() noexcept { return _liveStats; }
   inline const RALiveStats& liveStats() const noexcept { return _liveStats; }
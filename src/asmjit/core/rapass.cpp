@@ -129,6 +129,10 @@ static void RAPass_resetVirtRegData(BaseRAPass* self) noexcept {
 }
 
 Error BaseRAPass::runOnFunction(Zone* zone, Logger* logger, FuncNode* func) {
+  // The register allocator needs a node per instruction, which is not the
+  // case when the compiler uses compact instruction storage.
+  ASMJIT_PROPAGATE(cc()->expandInstBlocks(func, func->endNode()));
+
   _allocator.reset(zone);
 
 #ifndef ASMJIT_NO_LOGGING
@@ -717,61 +721,7 @@ RAAssignment::PhysToWorkMap* BaseRAPass::newPhysToWorkMap() noexcept {
 // ============================================================================
 
 namespace LiveOps {
-  typedef ZoneBitVector::BitWord BitWord;
-
-  struct In {
-    static ASMJIT_INLINE BitWord op(BitWord dst, BitWord out, BitWord gen, BitWord kill) noexcept {
-      DebugUtils::unused(dst);
-      return (out | gen) & ~kill;
-    }
-  };
-
-  template<typename Operator>
-  static ASMJIT_INLINE bool op(BitWord* dst, const BitWord* a, uint32_t n) noexcept {
-    BitWord changed = 0;
-
-    for (uint32_t i = 0; i < n; i++) {
-      BitWord before = dst[i];
-      BitWord after = Operator::op(before, a[i]);
-
-      dst[i] = after;
-      changed |= (before ^ after);
-    }
-
-    return changed != 0;
-  }
-
-  template<typename Operator>
-  static ASMJIT_INLINE bool op(BitWord* dst, const BitWord* a, const BitWord* b, uint32_t n) noexcept {
-    BitWord changed = 0;
-
-    for (uint32_t i = 0; i < n; i++) {
-      BitWord before = dst[i];
-      BitWord after = Operator::op(before, a[i], b[i]);
-
-      dst[i] = after;
-      changed |= (before ^ after);
-    }
-
-    return changed != 0;
-  }
-
-  template<typename Operator>
-  static ASMJIT_INLINE bool op(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept {
-    BitWord changed = 0;
-
-    for (uint32_t i = 0; i < n; i++) {
-      BitWord before = dst[i];
-      BitWord after = Operator::op(before, a[i], b[i], c[i]);
-
-      dst[i] = after;
-      changed |= (before ^ after);
-    }
-
-    return changed != 0;
-  }
-
-  static ASMJIT_INLINE bool recalcInOut(RABlock* block, uint32_t numBitWords, bool initial = false) noexcept {
+  static ASMJIT_INLINE bool recalcInOut(RABlock* block, bool initial = false) noexcept {
     bool changed = initial;
 
     const RABlocks& successors = block->successors();
@@ -779,11 +729,12 @@ namespace LiveOps {
 
     // Calculate `OUT` based on `IN` of all successors.
     for (uint32_t i = 0; i < numSuccessors; i++)
-      changed |= op<Support::Or>(block->liveOut().data(), successors[i]->liveIn().data(), numBitWords);
+      changed |= block->liveOut().orChanged(successors[i]->liveIn());
 
-    // Calculate `IN` based on `OUT`, `GEN`, and `KILL` bits.
+    // Calculate `IN` based on `OUT`, `GEN`, and `KILL` bits. If `OUT` didn't
+    // change then `IN` cannot change either, so it's not recalculated.
     if (changed)
-      changed = op<In>(block->liveIn().data(), block->liveOut().data(), block->gen().data(), block->kill().data(), numBitWords);
+      changed = block->liveIn().assignOrAndNot(block->liveOut(), block->gen(), block->kill());
 
     return changed;
   }
@@ -804,7 +755,6 @@ ASMJIT_FAVOR_SPEED Error BaseRAPass::buildLiveness() noexcept {
 
   uint32_t numVisits = numReachableBlocks;
   uint32_t numWorkRegs = workRegCount();
-  uint32_t numBitWords = ZoneBitVector::_wordsPerBits(numWorkRegs);
 
   if (!numWorkRegs) {
     ASMJIT_RA_LOG_FORMAT("  Done (no virtual registers)\n");
@@ -893,7 +843,7 @@ ASMJIT_FAVOR_SPEED Error BaseRAPass::buildLiveness() noexcept {
 
     for (i = 0; i < numReachableBlocks; i++) {
       RABlock* block = _pov[i];
-      LiveOps::recalcInOut(block, numBitWords, true);
+      LiveOps::recalcInOut(block, true);
       ASMJIT_PROPAGATE(workList.append(block));
     }
 
@@ -902,7 +852,7 @@ ASMJIT_FAVOR_SPEED Error BaseRAPass::buildLiveness() noexcept {
       uint32_t blockId = block->blockId();
 
       workBits.setBit(blockId, false);
-      if (LiveOps::recalcInOut(block, numBitWords)) {
+      if (LiveOps::recalcInOut(block)) {
         const RABlocks& predecessors = block->predecessors();
         uint32_t numPredecessors = predecessors.size();
 
@@ -999,7 +949,7 @@ ASMJIT_FAVOR_SPEED Error BaseRAPass::buildLiveness() noexcept {
           if (tiedReg->isLast() && !block->liveOut().bitAt(workId))
             tiedReg->addFlags(RATiedReg::kKill);
 
-          LiveRegSpans& liveSpans = workReg->liveSpans();
+          WorkRegSpans& liveSpans = workReg->liveSpans();
           bool wasOpen;
           ASMJIT_PROPAGATE(liveSpans.openAt(allocator(), position + !tiedReg->isRead(), endPosition, wasOpen));
 
@@ -1049,7 +999,7 @@ ASMJIT_FAVOR_SPEED Error BaseRAPass::buildLiveness() noexcept {
   for (i = 0; i < numWorkRegs; i++) {
     RAWorkReg* workReg = _workRegs[i];
 
-    LiveRegSpans& spans = workReg->liveSpans();
+    WorkRegSpans& spans = workReg->liveSpans();
     uint32_t width = spans.width();
     float freq = width ? float(double(workReg->_refs.size()) / double(width)) : float(0);
 
@@ -1964,7 +1914,7 @@ ASMJIT_FAVOR_SIZE Error BaseRAPass::_dumpLiveSpans(String& sb) noexcept {
       stats.priority());
     sb.append(": ");
 
-    LiveRegSpans& liveSpans = workReg->liveSpans();
+    WorkRegSpans& liveSpans = workReg->liveSpans();
     for (uint32_t x = 0; x < liveSpans.size(); x++) {
       const LiveRegSpan& liveSpan = liveSpans[x];
       if (x)
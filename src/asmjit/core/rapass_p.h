@@ -114,10 +114,10 @@ public:
   //! Immediate dominator of this block.
   RABlock* _idom = nullptr;
 
-  //! Block predecessors.
-  RABlocks _predecessors {};
-  //! Block successors.
-  RABlocks _successors {};
+  //! Block predecessors (most blocks have at most two).
+  ZoneSmallVector<RABlock*, 2> _predecessors {};
+  //! Block successors (most blocks have at most two).
+  ZoneSmallVector<RABlock*, 2> _successors {};
 
   enum LiveType : uint32_t {
     kLiveIn = 0,
@@ -127,8 +127,9 @@ public:
     kLiveCount = 4
   };
 
-  //! Liveness in/out/use/kill.
-  ZoneBitVector _liveBits[kLiveCount] {};
+  //! Liveness in/out/use/kill, inline storage covers functions having up to
+  //! 32 or 64 (depending on the size of BitWord) work registers.
+  ZoneSmallBitVector<1> _liveBits[kLiveCount] {};
 
   //! Shared assignment it or `Globals::kInvalidId` if this block doesn't
   //! have shared assignment. See `RASharedAssignment` for more details.
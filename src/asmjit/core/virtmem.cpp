@@ -79,6 +79,18 @@ static const uint32_t VirtMem_dualMappingFilter[2] = {
   VirtMem::kAccessExecute
 };
 
+// Checks whether an allocation of `size` bytes can be backed by large pages.
+static Error VirtMem_checkLargePageSize(size_t size) noexcept {
+  VirtMem::Info vmInfo = VirtMem::info();
+  if (!vmInfo.largePageSize)
+    return DebugUtils::errored(kErrorFeatureNotEnabled);
+
+  if (!Support::isAligned<size_t>(size, vmInfo.largePageSize))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::VirtMem - Virtual Memory [Windows]]
 // ============================================================================
@@ -102,6 +114,10 @@ static void VirtMem_getInfo(VirtMem::Info& vmInfo) noexcept {
   ::GetSystemInfo(&systemInfo);
   vmInfo.pageSize = Support::alignUpPowerOf2<uint32_t>(systemInfo.dwPageSize);
   vmInfo.pageGranularity = systemInfo.dwAllocationGranularity;
+
+  // Zero if the processor doesn't support large pages.
+  size_t largePageSize = ::GetLargePageMinimum();
+  vmInfo.largePageSize = Support::isPowerOf2(largePageSize) && largePageSize <= 0x80000000u ? uint32_t(largePageSize) : uint32_t(0);
 }
 
 // Windows specific implementation that uses `VirtualAlloc` and `VirtualFree`.
@@ -127,16 +143,33 @@ static DWORD VirtMem_accessToWinDesiredAccess(uint32_t flags) noexcept {
   return access;
 }
 
-Error VirtMem::alloc(void** p, size_t size, uint32_t flags) noexcept {
+Error VirtMem::alloc(void** p, size_t size, uint32_t flags, uint32_t* resultFlags) noexcept {
   *p = nullptr;
+  if (resultFlags)
+    *resultFlags = 0;
+
   if (size == 0)
     return DebugUtils::errored(kErrorInvalidArgument);
 
   DWORD protectFlags = VirtMem_accessToWinProtectFlags(flags);
-  void* result = ::VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, protectFlags);
+  DWORD allocationType = MEM_COMMIT | MEM_RESERVE;
+
+  if (flags & kMMapLargePages) {
+    ASMJIT_PROPAGATE(VirtMem_checkLargePageSize(size));
+    allocationType |= MEM_LARGE_PAGES;
+  }
 
-  if (!result)
+  void* result = ::VirtualAlloc(nullptr, size, allocationType, protectFlags);
+  if (!result) {
+    // Large pages require `SeLockMemoryPrivilege` and physically contiguous
+    // memory, which is not guaranteed to be available.
+    if (flags & kMMapLargePages)
+      return DebugUtils::errored(kErrorFeatureNotEnabled);
     return DebugUtils::errored(kErrorOutOfMemory);
+  }
+
+  if ((flags & kMMapLargePages) && resultFlags)
+    *resultFlags = kResultLargePages;
 
   *p = result;
   return kErrorOk;
@@ -159,13 +192,20 @@ Error VirtMem::protect(void* p, size_t size, uint32_t flags) noexcept {
   return DebugUtils::errored(kErrorInvalidArgument);
 }
 
-Error VirtMem::allocDualMapping(DualMapping* dm, size_t size, uint32_t flags) noexcept {
+Error VirtMem::allocDualMapping(DualMapping* dm, size_t size, uint32_t flags, uint32_t* resultFlags) noexcept {
   dm->ro = nullptr;
   dm->rw = nullptr;
 
+  if (resultFlags)
+    *resultFlags = 0;
+
   if (size == 0)
     return DebugUtils::errored(kErrorInvalidArgument);
 
+  // Large pages are not supported by file mappings created by this function.
+  if (flags & kMMapLargePages)
+    return DebugUtils::errored(kErrorFeatureNotEnabled);
+
   ScopedHandle handle;
   handle.value = ::CreateFileMappingW(
     INVALID_HANDLE_VALUE,
@@ -265,11 +305,74 @@ public:
   }
 };
 
+#if defined(__linux__)
+// Reads a small text file, used to read kernel settings exposed by sysfs.
+static bool VirtMem_readTextFile(const char* fileName, char* buf, size_t bufSize) noexcept {
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  ssize_t n = read(fd, buf, bufSize - 1);
+  close(fd);
+
+  if (n <= 0)
+    return false;
+
+  buf[n] = '\0';
+  return true;
+}
+
+// Transparent huge pages are only used when the kernel allows them for
+// `madvise()` regions, `anonymous` selects between private anonymous memory
+// and shared memory (used by dual mapping).
+static bool VirtMem_isTransparentHugePageEnabled(bool anonymous) noexcept {
+  static volatile uint32_t globalThpMode[2];
+
+  enum ThpMode : uint32_t {
+    kThpModeUnknown  = 0,
+    kThpModeDisabled = 1,
+    kThpModeEnabled  = 2
+  };
+
+  uint32_t mode = globalThpMode[anonymous];
+  if (mode == kThpModeUnknown) {
+    char buf[128];
+    mode = kThpModeDisabled;
+
+    if (anonymous) {
+      if (VirtMem_readTextFile("/sys/kernel/mm/transparent_hugepage/enabled", buf, sizeof(buf)) &&
+          (strstr(buf, "[always]") || strstr(buf, "[madvise]")))
+        mode = kThpModeEnabled;
+    }
+    else {
+      if (VirtMem_readTextFile("/sys/kernel/mm/transparent_hugepage/shmem_enabled", buf, sizeof(buf)) &&
+          (strstr(buf, "[always]") || strstr(buf, "[within_size]") || strstr(buf, "[advise]") || strstr(buf, "[force]")))
+        mode = kThpModeEnabled;
+    }
+
+    globalThpMode[anonymous] = mode;
+  }
+
+  return mode == kThpModeEnabled;
+}
+#endif
+
 static void VirtMem_getInfo(VirtMem::Info& vmInfo) noexcept {
   uint32_t pageSize = uint32_t(::getpagesize());
 
   vmInfo.pageSize = pageSize;
   vmInfo.pageGranularity = Support::max<uint32_t>(pageSize, 65536);
+  vmInfo.largePageSize = 0;
+
+#if defined(__linux__)
+  // The PMD page size is the size of both transparent and default HugeTLB pages.
+  char buf[32];
+  if (VirtMem_readTextFile("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", buf, sizeof(buf))) {
+    unsigned long long largePageSize = strtoull(buf, nullptr, 10);
+    if (Support::isPowerOf2(largePageSize) && largePageSize > pageSize && largePageSize <= 0x80000000u)
+      vmInfo.largePageSize = uint32_t(largePageSize);
+  }
+#endif
 }
 
 // Some operating systems don't allow /dev/shm to be executable. On Linux this
@@ -392,6 +495,23 @@ static const char* VirtMem_getTmpDir() noexcept {
 }
 #endif
 
+#if defined(__linux__) && defined(SYS_memfd_create)
+// Older headers don't define `MFD_HUGETLB`.
+#ifndef MFD_HUGETLB
+  #define MFD_HUGETLB 0x0004u
+#endif
+
+// Opens anonymous memory backed by HugeTLB pages of the default size.
+static Error VirtMem_openHugeTlbMemory(AnonymousMemory* anonMem) noexcept {
+  anonMem->fd = (int)syscall(SYS_memfd_create, "vmem", MFD_HUGETLB);
+  if (anonMem->fd >= 0)
+    return kErrorOk;
+
+  int e = errno;
+  return DebugUtils::errored(e == EINVAL || e == ENOSYS ? kErrorFeatureNotEnabled : VirtMem_makeErrorFromErrno(e));
+}
+#endif
+
 static Error VirtMem_openAnonymousMemory(AnonymousMemory* anonMem, bool preferTmpOverDevShm) noexcept {
 #if defined(SYS_memfd_create)
   // Linux specific 'memfd_create' - if the syscall returns `ENOSYS` it means
@@ -514,16 +634,93 @@ static Error VirtMem_getShmStrategy(uint32_t* strategyOut) noexcept {
 }
 #endif
 
-Error VirtMem::alloc(void** p, size_t size, uint32_t flags) noexcept {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+// Maps `size` bytes aligned to `alignment` by mapping a larger region first
+// and unmapping the parts that are outside of the aligned range. Transparent
+// huge pages can only back memory aligned to the large page size.
+static void* VirtMem_mmapAligned(size_t size, size_t alignment, int protection, int mmFlags, int fd) noexcept {
+  size_t reservedSize = size + alignment;
+  if (ASMJIT_UNLIKELY(reservedSize < size))
+    return MAP_FAILED;
+
+  uint8_t* reserved = static_cast<uint8_t*>(mmap(nullptr, reservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (reserved == MAP_FAILED)
+    return MAP_FAILED;
+
+  uint8_t* aligned = Support::alignUp(reserved, alignment);
+  void* ptr = mmap(aligned, size, protection, mmFlags | MAP_FIXED, fd, 0);
+
+  if (ptr == MAP_FAILED) {
+    munmap(reserved, reservedSize);
+    return MAP_FAILED;
+  }
+
+  size_t headSize = size_t(aligned - reserved);
+  size_t tailSize = reservedSize - headSize - size;
+
+  if (headSize)
+    munmap(reserved, headSize);
+
+  if (tailSize)
+    munmap(aligned + size, tailSize);
+
+  return ptr;
+}
+#endif
+
+// Allocates private memory backed by large pages, tries HugeTLB pages first
+// and then transparent huge pages. Only HugeTLB pages are reported in `resultFlags`.
+static Error VirtMem_allocLargePages(void** p, size_t size, int protection, int mmFlags, uint32_t* resultFlags) noexcept {
+  ASMJIT_PROPAGATE(VirtMem_checkLargePageSize(size));
+
+#if defined(__linux__)
+  void* ptr = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+  // Fails immediately if there is not enough HugeTLB pages reserved.
+  ptr = mmap(nullptr, size, protection, mmFlags | MAP_HUGETLB, -1, 0);
+  if (ptr != MAP_FAILED && resultFlags)
+    *resultFlags = VirtMem::kResultLargePages;
+#else
+  DebugUtils::unused(resultFlags);
+#endif
+
+#if defined(MADV_HUGEPAGE)
+  if (ptr == MAP_FAILED && VirtMem_isTransparentHugePageEnabled(true)) {
+    ptr = VirtMem_mmapAligned(size, VirtMem::info().largePageSize, protection, mmFlags, -1);
+    if (ptr != MAP_FAILED && madvise(ptr, size, MADV_HUGEPAGE) != 0) {
+      munmap(ptr, size);
+      ptr = MAP_FAILED;
+    }
+  }
+#endif
+
+  if (ptr == MAP_FAILED)
+    return DebugUtils::errored(kErrorFeatureNotEnabled);
+
+  *p = ptr;
+  return kErrorOk;
+#else
+  DebugUtils::unused(p, protection, mmFlags, resultFlags);
+  return DebugUtils::errored(kErrorFeatureNotEnabled);
+#endif
+}
+
+Error VirtMem::alloc(void** p, size_t size, uint32_t flags, uint32_t* resultFlags) noexcept {
   *p = nullptr;
+  if (resultFlags)
+    *resultFlags = 0;
 
   if (size == 0)
     return DebugUtils::errored(kErrorInvalidArgument);
 
   int protection = VirtMem_accessToPosixProtection(flags);
   int mmFlags = MAP_PRIVATE | MAP_ANONYMOUS | VirtMem_appleSpecificMMapFlags(flags);
-  void* ptr = mmap(nullptr, size, protection, mmFlags, -1, 0);
 
+  if (flags & kMMapLargePages)
+    return VirtMem_allocLargePages(p, size, protection, mmFlags, resultFlags);
+
+  void* ptr = mmap(nullptr, size, protection, mmFlags, -1, 0);
   if (ptr == MAP_FAILED)
     return DebugUtils::errored(kErrorOutOfMemory);
 
@@ -547,28 +744,34 @@ Error VirtMem::protect(void* p, size_t size, uint32_t flags) noexcept {
   return DebugUtils::errored(kErrorInvalidArgument);
 }
 
-Error VirtMem::allocDualMapping(DualMapping* dm, size_t size, uint32_t flags) noexcept {
-  dm->ro = nullptr;
-  dm->rw = nullptr;
-
-  if (off_t(size) <= 0)
-    return DebugUtils::errored(size == 0 ? kErrorInvalidArgument : kErrorTooLarge);
-
-  bool preferTmpOverDevShm = (flags & kMappingPreferTmp) != 0;
-  if (!preferTmpOverDevShm) {
-    uint32_t strategy;
-    ASMJIT_PROPAGATE(VirtMem_getShmStrategy(&strategy));
-    preferTmpOverDevShm = (strategy == kShmStrategyTmpDir);
-  }
-
-  AnonymousMemory anonMem;
-  ASMJIT_PROPAGATE(VirtMem_openAnonymousMemory(&anonMem, preferTmpOverDevShm));
+// Resizes `anonMem` to `size` bytes and maps it twice, as RX and RW views. If
+// `thpAlignment` is non-zero both views are aligned to it and transparent huge
+// pages are requested for them.
+static Error VirtMem_mapDualViews(VirtMem::DualMapping* dm, const AnonymousMemory& anonMem, size_t size, uint32_t flags, size_t thpAlignment) noexcept {
   if (ftruncate(anonMem.fd, off_t(size)) != 0)
     return DebugUtils::errored(VirtMem_makeErrorFromErrno(errno));
 
   void* ptr[2];
   for (uint32_t i = 0; i < 2; i++) {
-    ptr[i] = mmap(nullptr, size, VirtMem_accessToPosixProtection(flags & ~VirtMem_dualMappingFilter[i]), MAP_SHARED, anonMem.fd, 0);
+    int protection = VirtMem_accessToPosixProtection(flags & ~VirtMem_dualMappingFilter[i]);
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (thpAlignment) {
+      ptr[i] = VirtMem_mmapAligned(size, thpAlignment, protection, MAP_SHARED, anonMem.fd);
+      if (ptr[i] != MAP_FAILED && madvise(ptr[i], size, MADV_HUGEPAGE) != 0) {
+        munmap(ptr[i], size);
+        ptr[i] = MAP_FAILED;
+        errno = EINVAL;
+      }
+    }
+    else
+#else
+    DebugUtils::unused(thpAlignment);
+#endif
+    {
+      ptr[i] = mmap(nullptr, size, protection, MAP_SHARED, anonMem.fd, 0);
+    }
+
     if (ptr[i] == MAP_FAILED) {
       // Get the error now before `munmap` has a chance to clobber it.
       int e = errno;
@@ -583,6 +786,64 @@ Error VirtMem::allocDualMapping(DualMapping* dm, size_t size, uint32_t flags) no
   return kErrorOk;
 }
 
+// Allocates dual mapping backed by large pages, tries HugeTLB pages first and
+// then transparent huge pages of shared memory. Only HugeTLB pages are reported
+// in `resultFlags`.
+static Error VirtMem_allocDualMappingLargePages(VirtMem::DualMapping* dm, size_t size, uint32_t flags, uint32_t* resultFlags) noexcept {
+  ASMJIT_PROPAGATE(VirtMem_checkLargePageSize(size));
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+  {
+    AnonymousMemory anonMem;
+    if (VirtMem_openHugeTlbMemory(&anonMem) == kErrorOk && VirtMem_mapDualViews(dm, anonMem, size, flags, 0) == kErrorOk) {
+      if (resultFlags)
+        *resultFlags = VirtMem::kResultLargePages;
+      return kErrorOk;
+    }
+  }
+
+#if defined(MADV_HUGEPAGE)
+  if (VirtMem_isTransparentHugePageEnabled(false)) {
+    // Only memory created by `memfd_create()` is shmem, which is required by
+    // transparent huge pages, files in a temporary directory would not work.
+    AnonymousMemory anonMem;
+    if (VirtMem_openAnonymousMemory(&anonMem, false) == kErrorOk && anonMem.fileType == AnonymousMemory::kFileTypeNone &&
+        VirtMem_mapDualViews(dm, anonMem, size, flags, VirtMem::info().largePageSize) == kErrorOk)
+      return kErrorOk;
+  }
+#endif
+#else
+  DebugUtils::unused(dm, flags, resultFlags);
+#endif
+
+  return DebugUtils::errored(kErrorFeatureNotEnabled);
+}
+
+Error VirtMem::allocDualMapping(DualMapping* dm, size_t size, uint32_t flags, uint32_t* resultFlags) noexcept {
+  dm->ro = nullptr;
+  dm->rw = nullptr;
+
+  if (resultFlags)
+    *resultFlags = 0;
+
+  if (off_t(size) <= 0)
+    return DebugUtils::errored(size == 0 ? kErrorInvalidArgument : kErrorTooLarge);
+
+  if (flags & kMMapLargePages)
+    return VirtMem_allocDualMappingLargePages(dm, size, flags, resultFlags);
+
+  bool preferTmpOverDevShm = (flags & kMappingPreferTmp) != 0;
+  if (!preferTmpOverDevShm) {
+    uint32_t strategy;
+    ASMJIT_PROPAGATE(VirtMem_getShmStrategy(&strategy));
+    preferTmpOverDevShm = (strategy == kShmStrategyTmpDir);
+  }
+
+  AnonymousMemory anonMem;
+  ASMJIT_PROPAGATE(VirtMem_openAnonymousMemory(&anonMem, preferTmpOverDevShm));
+  return VirtMem_mapDualViews(dm, anonMem, size, flags, 0);
+}
+
 Error VirtMem::releaseDualMapping(DualMapping* dm, size_t size) noexcept {
   Error err = release(dm->ro, size);
   if (dm->ro != dm->rw)
@@ -62,6 +62,23 @@ enum Flags : uint32_t {
   //! that doesn't expect this behavior.
   kMMapEnableMapJit = 0x00000010u,
 
+  //! Use large pages (also called huge pages) instead of regular pages, which
+  //! reduces the number of TLB misses when a lot of code is executed. The size
+  //! of the allocation must be a multiple of \ref Info::largePageSize.
+  //!
+  //! On Linux the allocation first tries HugeTLB pages (`MAP_HUGETLB` or
+  //! `MFD_HUGETLB` in case of dual mapping), which must be reserved by the
+  //! system, and then transparent huge pages requested by `madvise()` on
+  //! a region aligned to the large page size. On Windows `MEM_LARGE_PAGES`
+  //! is used, which requires `SeLockMemoryPrivilege`.
+  //!
+  //! The allocation fails with \ref kErrorFeatureNotEnabled if large pages
+  //! are not available, it never silently falls back to regular pages, so
+  //! the caller can retry without this flag. Transparent huge pages are only
+  //! requested, the kernel may still back the region by regular pages, see
+  //! \ref kResultLargePages.
+  kMMapLargePages = 0x00000020u,
+
   //! Not an access flag, only used by `allocDualMapping()` to override the
   //! default allocation strategy to always use a 'tmp' directory instead of
   //! "/dev/shm" (on POSIX platforms). Please note that this flag will be
@@ -72,12 +89,23 @@ enum Flags : uint32_t {
   kMappingPreferTmp = 0x80000000u
 };
 
+//! Flags describing memory returned by \ref alloc() and \ref allocDualMapping().
+enum ResultFlags : uint32_t {
+  //! Memory is backed by large pages that were reserved at allocation time,
+  //! either HugeTLB pages (`MAP_HUGETLB` or `MFD_HUGETLB` on Linux) or
+  //! `MEM_LARGE_PAGES` (Windows). Not set if transparent huge pages were only
+  //! requested by `madvise()`, as the kernel may still use regular pages.
+  kResultLargePages = 0x00000001u
+};
+
 //! Virtual memory information.
 struct Info {
   //! Virtual memory page size.
   uint32_t pageSize;
   //! Virtual memory page granularity.
   uint32_t pageGranularity;
+  //! Large page size or zero if large pages are not supported by the system.
+  uint32_t largePageSize;
 };
 
 //! Dual memory mapping used to map an anonymous memory into two memory regions
@@ -100,7 +128,10 @@ ASMJIT_API Info info() noexcept;
 //! \note `size` should be aligned to a page size, use \ref VirtMem::info()
 //! to obtain it. Invalid size will not be corrected by the implementation
 //! and the allocation would not succeed in such case.
-ASMJIT_API Error alloc(void** p, size_t size, uint32_t flags) noexcept;
+//!
+//! If `resultFlags` is not null it receives \ref ResultFlags describing the
+//! allocated memory.
+ASMJIT_API Error alloc(void** p, size_t size, uint32_t flags, uint32_t* resultFlags = nullptr) noexcept;
 
 //! Releases virtual memory previously allocated by \ref  VirtMem::alloc() or
 //! \ref VirtMem::allocDualMapping().
@@ -126,8 +157,11 @@ ASMJIT_API Error protect(void* p, size_t size, uint32_t flags) noexcept;
 //! release the memory returned by `allocDualMapping()` as that would fail on
 //! Windows.
 //!
+//! If `resultFlags` is not null it receives \ref ResultFlags describing the
+//! allocated memory.
+//!
 //! \remarks Both pointers in `dm` would be set to `nullptr` if the function fails.
-ASMJIT_API Error allocDualMapping(DualMapping* dm, size_t size, uint32_t flags) noexcept;
+ASMJIT_API Error allocDualMapping(DualMapping* dm, size_t size, uint32_t flags, uint32_t* resultFlags = nullptr) noexcept;
 
 //! Releases the virtual memory mapping previously allocated by
 //! \ref VirtMem::allocDualMapping().
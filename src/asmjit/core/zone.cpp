@@ -22,9 +22,16 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 #include "../core/api-build_p.h"
+#include "../core/osutils_p.h"
 #include "../core/support.h"
 #include "../core/zone.h"
 
+#include <atomic>
+
+#if defined(ASMJIT_TEST)
+  #include <thread>
+#endif
+
 ASMJIT_BEGIN_NAMESPACE
 
 // ============================================================================
@@ -35,6 +42,32 @@ ASMJIT_BEGIN_NAMESPACE
 // Should be allocated in read-only memory and should never be modified.
 const Zone::Block Zone::_zeroBlock = { nullptr, nullptr, 0 };
 
+// ============================================================================
+// [asmjit::ZoneBlockSource]
+// ============================================================================
+
+ZoneBlockSource::ZoneBlockSource() noexcept {}
+ZoneBlockSource::~ZoneBlockSource() noexcept {}
+
+// ============================================================================
+// [asmjit::Zone - Helpers]
+// ============================================================================
+
+static ASMJIT_INLINE void* Zone_allocBlock(Zone* self, size_t size, size_t* allocatedSize) noexcept {
+  if (self->_blockSource)
+    return self->_blockSource->allocBlock(size, allocatedSize);
+
+  *allocatedSize = size;
+  return ::malloc(size);
+}
+
+static ASMJIT_INLINE void Zone_releaseBlock(Zone* self, Zone::Block* block) noexcept {
+  if (self->_blockSource)
+    self->_blockSource->releaseBlock(block, block->size + Zone::kBlockSize);
+  else
+    ::free(block);
+}
+
 // ============================================================================
 // [asmjit::Zone - Init / Reset]
 // ============================================================================
@@ -49,6 +82,7 @@ void Zone::_init(size_t blockSize, size_t blockAlignment, const Support::Tempora
   constexpr size_t kBlockAlignmentShiftMask = 0x7u;
 
   _assignZeroBlock();
+  _blockSource = nullptr;
   _blockSize = blockSize & kBlockSizeMask;
   _isTemporary = temporary != nullptr;
   _blockAlignmentShift = Support::ctz(blockAlignment) & kBlockAlignmentShiftMask;
@@ -95,14 +129,14 @@ void Zone::reset(uint32_t resetPolicy) noexcept {
         break;
       }
 
-      ::free(cur);
+      Zone_releaseBlock(this, cur);
       cur = prev;
     } while (cur);
 
     cur = next;
     while (cur) {
       next = cur->next;
-      ::free(cur);
+      Zone_releaseBlock(this, cur);
       cur = next;
     }
   }
@@ -113,6 +147,86 @@ void Zone::reset(uint32_t resetPolicy) noexcept {
   }
 }
 
+void Zone::setBlockSource(ZoneBlockSource* source) noexcept {
+  if (_blockSource == source)
+    return;
+
+  reset(Globals::kResetHard);
+  _blockSource = source;
+}
+
+// ============================================================================
+// [asmjit::Zone - Statistics]
+// ============================================================================
+
+size_t Zone::usedSize() const noexcept {
+  const Block* cur = _block;
+  if (cur == &_zeroBlock)
+    return 0;
+
+  size_t size = kBlockSize + (size_t)(_ptr - cur->data());
+  for (cur = cur->prev; cur; cur = cur->prev)
+    size += kBlockSize + cur->size;
+  return size;
+}
+
+size_t Zone::reservedSize() const noexcept {
+  const Block* cur = _block;
+  if (cur == &_zeroBlock)
+    return 0;
+
+  size_t size = 0;
+  for (const Block* prev = cur; prev; prev = prev->prev)
+    size += kBlockSize + prev->size;
+  for (const Block* next = cur->next; next; next = next->next)
+    size += kBlockSize + next->size;
+  return size;
+}
+
+// ============================================================================
+// [asmjit::Zone - Adopt]
+// ============================================================================
+
+Error Zone::adopt(Zone* other) noexcept {
+  if (ASMJIT_UNLIKELY(other == this || isTemporary() || other->isTemporary() || _blockSource != other->_blockSource))
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  Block* otherCur = other->_block;
+  if (otherCur == &_zeroBlock)
+    return kErrorOk;
+
+  Block* first = otherCur;
+  while (first->prev)
+    first = first->prev;
+
+  Block* last = otherCur;
+  while (last->next)
+    last = last->next;
+
+  Block* cur = _block;
+  if (cur == &_zeroBlock) {
+    // Continue allocating from the current block of `other`, blocks after it
+    // are unused.
+    _ptr = other->_ptr;
+    _end = other->_end;
+    _block = otherCur;
+  }
+  else {
+    // Blocks that follow the current block must stay unused (see `_alloc()`),
+    // so all adopted blocks are inserted before it.
+    Block* prev = cur->prev;
+    first->prev = prev;
+    last->next = cur;
+    cur->prev = last;
+
+    if (prev)
+      prev->next = first;
+  }
+
+  other->_assignZeroBlock();
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::Zone - Alloc]
 // ============================================================================
@@ -151,11 +265,16 @@ void* Zone::_alloc(size_t size, size_t alignment) noexcept {
   // new block size, and we also add `kBlockOverhead` to the allocator as it includes
   // members of `Zone::Block` structure.
   newSize += blockAlignmentOverhead;
-  Block* newBlock = static_cast<Block*>(::malloc(newSize + kBlockSize));
+
+  size_t allocatedSize;
+  Block* newBlock = static_cast<Block*>(Zone_allocBlock(this, newSize + kBlockSize, &allocatedSize));
 
   if (ASMJIT_UNLIKELY(!newBlock))
     return nullptr;
 
+  // The block source can provide more memory than requested.
+  newSize = allocatedSize - kBlockSize;
+
   // Align the pointer to `minimumAlignment` and adjust the size of this block
   // accordingly. It's the same as using `minimumAlignment - Support::alignUpDiff()`,
   // just written differently.
@@ -226,10 +345,228 @@ char* Zone::sformat(const char* fmt, ...) noexcept {
   return static_cast<char*>(dup(buf, size));
 }
 
+// ============================================================================
+// [asmjit::ZoneBlockPool - Helpers]
+// ============================================================================
+
+// Returns the size class of a block of `size` bytes, `size` must not be greater
+// than `ZoneBlockPool::kMaxPooledSize`.
+static ASMJIT_INLINE uint32_t ZoneBlockPool_classIdFromSize(size_t size) noexcept {
+  constexpr size_t kMinClassSize = size_t(1) << ZoneBlockPool::kMinClassShift;
+  if (size <= kMinClassSize)
+    return 0;
+  return uint32_t(Support::bitSizeOf<size_t>() - Support::clz(size - 1u)) - uint32_t(ZoneBlockPool::kMinClassShift);
+}
+
+static ASMJIT_INLINE size_t ZoneBlockPool_sizeFromClassId(uint32_t classId) noexcept {
+  return size_t(1) << (classId + ZoneBlockPool::kMinClassShift);
+}
+
+static ZoneBlockPool::FreeBlock* ZoneBlockPool_popShared(ZoneBlockPool* self, uint32_t classId) noexcept {
+  LockGuard guard(self->_lock);
+
+  ZoneBlockPool::FreeBlock* block = self->_freeLists[classId];
+  if (block) {
+    self->_freeLists[classId] = block->next;
+    self->_pooledSize -= ZoneBlockPool_sizeFromClassId(classId);
+  }
+  return block;
+}
+
+static void ZoneBlockPool_pushShared(ZoneBlockPool* self, uint32_t classId, ZoneBlockPool::FreeBlock* block) noexcept {
+  size_t size = ZoneBlockPool_sizeFromClassId(classId);
+  {
+    LockGuard guard(self->_lock);
+    if (self->_pooledSize + size <= self->_maxPooledSize) {
+      block->next = self->_freeLists[classId];
+      self->_freeLists[classId] = block;
+      self->_pooledSize += size;
+      return;
+    }
+  }
+  ::free(block);
+}
+
+// ============================================================================
+// [asmjit::ZoneBlockPool - ThreadCache]
+// ============================================================================
+
+//! Blocks of the global pool cached by a single thread.
+class ZoneBlockPoolThreadCache {
+public:
+  ASMJIT_NONCOPYABLE(ZoneBlockPoolThreadCache)
+
+  enum : uint32_t {
+    //! Number of blocks cached in each size class.
+    kCapacity = 4
+  };
+
+  //! Cached blocks of each size class.
+  ZoneBlockPool::FreeBlock* blocks[ZoneBlockPool::kClassCount][kCapacity];
+  //! Number of cached blocks in each size class.
+  uint32_t counts[ZoneBlockPool::kClassCount];
+
+  inline ZoneBlockPoolThreadCache() noexcept
+    : blocks {},
+      counts {} {}
+
+  inline ~ZoneBlockPoolThreadCache() noexcept { flush(); }
+
+  // Returns all cached blocks to the global pool.
+  void flush() noexcept {
+    ZoneBlockPool* pool = ZoneBlockPool::global();
+    for (uint32_t classId = 0; classId < ZoneBlockPool::kClassCount; classId++) {
+      for (uint32_t i = 0; i < counts[classId]; i++)
+        ZoneBlockPool_pushShared(pool, classId, blocks[classId][i]);
+      counts[classId] = 0;
+    }
+  }
+};
+
+static thread_local ZoneBlockPoolThreadCache ZoneBlockPool_threadCache;
+
+// ============================================================================
+// [asmjit::ZoneBlockPool - Construction / Destruction]
+// ============================================================================
+
+ZoneBlockPool::ZoneBlockPool(size_t maxPooledSize) noexcept
+  : _lock(),
+    _freeLists {},
+    _pooledSize(0),
+    _maxPooledSize(maxPooledSize) {}
+
+ZoneBlockPool::~ZoneBlockPool() noexcept {
+  trim();
+}
+
+// The global pool, constant-initialized so it doesn't depend on thread-safe
+// initialization of function-local statics (`-fno-threadsafe-statics`).
+static std::atomic<ZoneBlockPool*> ZoneBlockPool_globalPool { nullptr };
+
+ZoneBlockPool* ZoneBlockPool::global() noexcept {
+  ZoneBlockPool* pool = ZoneBlockPool_globalPool.load(std::memory_order_acquire);
+  if (ASMJIT_LIKELY(pool))
+    return pool;
+
+  // The global pool is never destroyed, threads can return their cached blocks
+  // to it regardless of the order in which static and thread-local storage is
+  // destroyed at exit. If more threads race to create it only one pool is
+  // published, the others are destroyed before they are used.
+  ZoneBlockPool* newPool = new(std::nothrow) ZoneBlockPool();
+  if (ASMJIT_UNLIKELY(!newPool))
+    return nullptr;
+
+  if (!ZoneBlockPool_globalPool.compare_exchange_strong(pool, newPool, std::memory_order_acq_rel, std::memory_order_acquire)) {
+    delete newPool;
+    return pool;
+  }
+
+  return newPool;
+}
+
+// ============================================================================
+// [asmjit::ZoneBlockPool - Interface]
+// ============================================================================
+
+size_t ZoneBlockPool::pooledSize() const noexcept {
+  LockGuard guard(_lock);
+  return _pooledSize;
+}
+
+void ZoneBlockPool::trim() noexcept {
+  if (this == global())
+    ZoneBlockPool_threadCache.flush();
+
+  FreeBlock* freeLists[kClassCount];
+  {
+    LockGuard guard(_lock);
+    memcpy(freeLists, _freeLists, sizeof(freeLists));
+    memset(_freeLists, 0, sizeof(_freeLists));
+    _pooledSize = 0;
+  }
+
+  for (FreeBlock* block : freeLists) {
+    while (block) {
+      FreeBlock* next = block->next;
+      ::free(block);
+      block = next;
+    }
+  }
+}
+
+void* ZoneBlockPool::allocBlock(size_t size, size_t* allocatedSize) noexcept {
+  if (size > kMaxPooledSize) {
+    *allocatedSize = size;
+    return ::malloc(size);
+  }
+
+  uint32_t classId = ZoneBlockPool_classIdFromSize(size);
+  size_t classSize = ZoneBlockPool_sizeFromClassId(classId);
+  *allocatedSize = classSize;
+
+  if (this == global()) {
+    ZoneBlockPoolThreadCache& cache = ZoneBlockPool_threadCache;
+    if (cache.counts[classId])
+      return cache.blocks[classId][--cache.counts[classId]];
+  }
+
+  FreeBlock* block = ZoneBlockPool_popShared(this, classId);
+  if (block)
+    return block;
+
+  return ::malloc(classSize);
+}
+
+void ZoneBlockPool::releaseBlock(void* p, size_t size) noexcept {
+  if (size > kMaxPooledSize) {
+    ::free(p);
+    return;
+  }
+
+  uint32_t classId = ZoneBlockPool_classIdFromSize(size);
+  ASMJIT_ASSERT(size == ZoneBlockPool_sizeFromClassId(classId));
+
+  FreeBlock* block = static_cast<FreeBlock*>(p);
+  if (this == global()) {
+    ZoneBlockPoolThreadCache& cache = ZoneBlockPool_threadCache;
+    if (cache.counts[classId] < ZoneBlockPoolThreadCache::kCapacity) {
+      cache.blocks[classId][cache.counts[classId]++] = block;
+      return;
+    }
+  }
+
+  ZoneBlockPool_pushShared(this, classId, block);
+}
+
+// ============================================================================
+// [asmjit::ConcurrentZone]
+// ============================================================================
+
+ConcurrentZone::ConcurrentZone(Zone* zone, size_t arenaBlockSize) noexcept
+  : _zone(zone),
+    _arenaBlockSize(arenaBlockSize ? arenaBlockSize : zone->blockSize()) {}
+
+ConcurrentZone::~ConcurrentZone() noexcept {}
+
+Error ConcurrentZone::merge(Zone* arena) noexcept {
+  LockGuard guard(_lock);
+  return _zone->adopt(arena);
+}
+
 // ============================================================================
 // [asmjit::ZoneAllocator - Helpers]
 // ============================================================================
 
+// Dynamic blocks are provided by the block source of the zone, if any, so they
+// can be recycled together with zone blocks.
+static ASMJIT_INLINE void ZoneAllocator_freeDynamicBlock(ZoneAllocator* self, ZoneAllocator::DynamicBlock* block) noexcept {
+  ZoneBlockSource* source = self->_zone->blockSource();
+  if (source)
+    source->releaseBlock(block, block->size);
+  else
+    ::free(block);
+}
+
 #if defined(ASMJIT_BUILD_DEBUG)
 static bool ZoneAllocator_hasDynamicBlock(ZoneAllocator* self, ZoneAllocator::DynamicBlock* block) noexcept {
   ZoneAllocator::DynamicBlock* cur = self->_dynamicBlocks;
@@ -251,7 +588,7 @@ void ZoneAllocator::reset(Zone* zone) noexcept {
   DynamicBlock* block = _dynamicBlocks;
   while (block) {
     DynamicBlock* next = block->next;
-    ::free(block);
+    ZoneAllocator_freeDynamicBlock(this, block);
     block = next;
   }
 
@@ -260,6 +597,17 @@ void ZoneAllocator::reset(Zone* zone) noexcept {
   _zone = zone;
 }
 
+// ============================================================================
+// [asmjit::ZoneAllocator - Statistics]
+// ============================================================================
+
+size_t ZoneAllocator::dynamicSize() const noexcept {
+  size_t size = 0;
+  for (const DynamicBlock* block = _dynamicBlocks; block; block = block->next)
+    size += block->size;
+  return size;
+}
+
 // ============================================================================
 // [asmjit::ZoneAllocator - Alloc / Release]
 // ============================================================================
@@ -321,7 +669,10 @@ void* ZoneAllocator::_alloc(size_t size, size_t& allocatedSize) noexcept {
     if (ASMJIT_UNLIKELY(kBlockOverhead >= SIZE_MAX - size))
       return nullptr;
 
-    void* p = ::malloc(size + kBlockOverhead);
+    size_t blockSize = size + kBlockOverhead;
+    ZoneBlockSource* source = _zone->blockSource();
+
+    void* p = source ? source->allocBlock(blockSize, &blockSize) : ::malloc(blockSize);
     if (ASMJIT_UNLIKELY(!p)) {
       allocatedSize = 0;
       return nullptr;
@@ -336,6 +687,7 @@ void* ZoneAllocator::_alloc(size_t size, size_t& allocatedSize) noexcept {
 
     block->prev = nullptr;
     block->next = next;
+    block->size = blockSize;
     _dynamicBlocks = block;
 
     // Align the pointer to the guaranteed alignment and store `DynamicBlock`
@@ -376,7 +728,257 @@ void ZoneAllocator::_releaseDynamic(void* p, size_t size) noexcept {
   if (next)
     next->prev = prev;
 
-  ::free(block);
+  ZoneAllocator_freeDynamicBlock(this, block);
+}
+
+// ============================================================================
+// [asmjit::Zone - Unit]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(zone_block_pool) {
+  constexpr size_t kZoneBlockSize = 16384 - Zone::kBlockOverhead;
+
+  INFO("Recycling blocks of a Zone");
+  {
+    ZoneBlockPool pool(1024 * 1024);
+    Zone zone(kZoneBlockSize);
+    zone.setBlockSource(&pool);
+
+    for (uint32_t i = 0; i < 16; i++)
+      EXPECT(zone.alloc(4000) != nullptr);
+
+    // Four allocations fit into each 16kB block.
+    zone.reset(Globals::kResetHard);
+    EXPECT(pool.pooledSize() == 4 * 16384);
+
+    Zone other(kZoneBlockSize);
+    other.setBlockSource(&pool);
+    EXPECT(other.alloc(kZoneBlockSize) != nullptr);
+    EXPECT(pool.pooledSize() == 3 * 16384);
+
+    // Blocks larger than the largest class are not pooled.
+    EXPECT(other.alloc(ZoneBlockPool::kMaxPooledSize * 2) != nullptr);
+    other.reset(Globals::kResetHard);
+    EXPECT(pool.pooledSize() == 4 * 16384);
+
+    pool.trim();
+    EXPECT(pool.pooledSize() == 0);
+  }
+
+  INFO("Pooled size limit");
+  {
+    ZoneBlockPool pool(16384);
+    Zone zone(kZoneBlockSize);
+    zone.setBlockSource(&pool);
+
+    EXPECT(zone.alloc(kZoneBlockSize) != nullptr);
+    EXPECT(zone.alloc(kZoneBlockSize) != nullptr);
+
+    zone.reset(Globals::kResetHard);
+    EXPECT(pool.pooledSize() == 16384);
+  }
+
+  INFO("Thread cache of the global pool");
+  {
+    ZoneBlockPool* pool = ZoneBlockPool::global();
+    EXPECT(pool != nullptr);
+
+    void* a;
+    {
+      Zone zone(kZoneBlockSize);
+      zone.setBlockSource(pool);
+      a = zone.alloc(64);
+      EXPECT(a != nullptr);
+    }
+
+    // The block released by the previous zone is reused by the same thread.
+    Zone zone(kZoneBlockSize);
+    zone.setBlockSource(pool);
+    EXPECT(zone.alloc(64) == a);
+  }
+}
+
+// Block source that counts live blocks, used to verify that adopted blocks
+// are released by the zone that adopted them.
+class ZoneTestCountingSource : public ZoneBlockSource {
+public:
+  std::atomic<size_t> _liveCount { 0 };
+
+  void* allocBlock(size_t size, size_t* allocatedSize) noexcept override {
+    _liveCount++;
+    *allocatedSize = size;
+    return ::malloc(size);
+  }
+
+  void releaseBlock(void* p, size_t size) noexcept override {
+    DebugUtils::unused(size);
+    _liveCount--;
+    ::free(p);
+  }
+};
+
+struct ZoneTestItem {
+  ZoneTestItem* next;
+  uint32_t threadId;
+  uint32_t index;
+};
+
+static void ZoneTest_fillArena(ConcurrentZone* concurrentZone, ZoneTestItem** out, uint32_t threadId, uint32_t count) noexcept {
+  ZoneArena arena(concurrentZone);
+  ZoneTestItem* head = nullptr;
+
+  for (uint32_t i = 0; i < count; i++) {
+    ZoneTestItem* item = arena.newT<ZoneTestItem>();
+    if (!item)
+      break;
+
+    item->next = head;
+    item->threadId = threadId;
+    item->index = i;
+    head = item;
+  }
+
+  *out = head;
+}
+
+UNIT(zone_concurrent) {
+  constexpr size_t kZoneBlockSize = 1024 - Zone::kBlockOverhead;
+
+  INFO("Adopting blocks of another Zone");
+  {
+    ZoneTestCountingSource source;
+    Zone zone(kZoneBlockSize);
+    Zone other(kZoneBlockSize);
+
+    zone.setBlockSource(&source);
+    EXPECT(zone.adopt(&other) == kErrorInvalidArgument);
+
+    other.setBlockSource(&source);
+    uint32_t* a = zone.allocT<uint32_t>();
+    uint32_t* b = other.allocT<uint32_t>();
+    EXPECT(a != nullptr && b != nullptr);
+
+    *a = 1;
+    *b = 2;
+    EXPECT(other.alloc(kZoneBlockSize) != nullptr);
+    EXPECT(source._liveCount == 3);
+
+    EXPECT(zone.adopt(&other) == kErrorOk);
+    EXPECT(other.remainingSize() == 0);
+    other.reset(Globals::kResetHard);
+
+    EXPECT(source._liveCount == 3);
+    EXPECT(*a == 1 && *b == 2);
+
+    // A soft reset recycles adopted blocks.
+    zone.reset();
+    for (uint32_t i = 0; i < 3; i++)
+      EXPECT(zone.alloc(kZoneBlockSize) != nullptr);
+    EXPECT(source._liveCount == 3);
+
+    zone.reset(Globals::kResetHard);
+    EXPECT(source._liveCount == 0);
+  }
+
+  INFO("Allocating from multiple threads by using ConcurrentZone");
+  {
+    constexpr uint32_t kThreadCount = 4;
+    constexpr uint32_t kItemCount = 5000;
+
+    ZoneTestCountingSource source;
+    Zone zone(kZoneBlockSize);
+    zone.setBlockSource(&source);
+
+    {
+      ConcurrentZone concurrentZone(&zone);
+      std::thread threads[kThreadCount];
+      ZoneTestItem* lists[kThreadCount] {};
+
+      for (uint32_t i = 0; i < kThreadCount; i++)
+        threads[i] = std::thread(ZoneTest_fillArena, &concurrentZone, &lists[i], i, kItemCount);
+
+      for (uint32_t i = 0; i < kThreadCount; i++)
+        threads[i].join();
+
+      // All items are still valid as their blocks now belong to `zone`.
+      for (uint32_t i = 0; i < kThreadCount; i++) {
+        uint32_t count = 0;
+        for (ZoneTestItem* item = lists[i]; item; item = item->next) {
+          EXPECT(item->threadId == i);
+          EXPECT(item->index == kItemCount - 1 - count);
+          count++;
+        }
+        EXPECT(count == kItemCount);
+      }
+    }
+
+    EXPECT(source._liveCount != 0);
+    zone.reset(Globals::kResetHard);
+    EXPECT(source._liveCount == 0);
+  }
+
+  INFO("Using the global ZoneBlockPool from multiple threads");
+  {
+    constexpr uint32_t kThreadCount = 4;
+
+    std::thread threads[kThreadCount];
+    ZoneBlockPool* pools[kThreadCount] {};
+
+    for (uint32_t i = 0; i < kThreadCount; i++)
+      threads[i] = std::thread([](ZoneBlockPool** out) { *out = ZoneBlockPool::global(); }, &pools[i]);
+
+    for (uint32_t i = 0; i < kThreadCount; i++) {
+      threads[i].join();
+      EXPECT(pools[i] != nullptr && pools[i] == ZoneBlockPool::global());
+    }
+  }
 }
 
+UNIT(zone_statistics) {
+  constexpr size_t kZoneBlockSize = 4096 - Zone::kBlockOverhead;
+  constexpr size_t kBlockTotal = kZoneBlockSize + Zone::kBlockSize;
+
+  INFO("Zone::usedSize() / reservedSize()");
+  {
+    Zone zone(kZoneBlockSize);
+    EXPECT(zone.usedSize() == 0);
+    EXPECT(zone.reservedSize() == 0);
+
+    EXPECT(zone.alloc(100) != nullptr);
+    EXPECT(zone.usedSize() == Zone::kBlockSize + 100);
+    EXPECT(zone.reservedSize() == kBlockTotal);
+
+    EXPECT(zone.alloc(kZoneBlockSize) != nullptr);
+    EXPECT(zone.usedSize() == kBlockTotal * 2);
+    EXPECT(zone.reservedSize() == kBlockTotal * 2);
+
+    // A soft reset keeps all blocks.
+    zone.reset();
+    EXPECT(zone.usedSize() == Zone::kBlockSize);
+    EXPECT(zone.reservedSize() == kBlockTotal * 2);
+
+    zone.reset(Globals::kResetHard);
+    EXPECT(zone.usedSize() == 0);
+    EXPECT(zone.reservedSize() == 0);
+  }
+
+  INFO("ZoneAllocator::dynamicSize()");
+  {
+    Zone zone(kZoneBlockSize);
+    ZoneAllocator allocator(&zone);
+
+    EXPECT(allocator.alloc(64) != nullptr);
+    EXPECT(allocator.dynamicSize() == 0);
+
+    void* p = allocator.alloc(100000);
+    EXPECT(p != nullptr);
+    EXPECT(allocator.dynamicSize() > 100000);
+
+    allocator.release(p, 100000);
+    EXPECT(allocator.dynamicSize() == 0);
+  }
+}
+#endif
+
 ASMJIT_END_NAMESPACE
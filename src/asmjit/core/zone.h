@@ -24,6 +24,7 @@
 #ifndef ASMJIT_CORE_ZONE_H_INCLUDED
 #define ASMJIT_CORE_ZONE_H_INCLUDED
 
+#include "../core/osutils.h"
 #include "../core/support.h"
 
 ASMJIT_BEGIN_NAMESPACE
@@ -31,6 +32,33 @@ ASMJIT_BEGIN_NAMESPACE
 //! \addtogroup asmjit_zone
 //! \{
 
+// ============================================================================
+// [asmjit::ZoneBlockSource]
+// ============================================================================
+
+//! Provides memory blocks to \ref Zone.
+//!
+//! Zone uses `malloc()` and `free()` by default. A block source can be used
+//! to recycle blocks of zones that are created and destroyed frequently, see
+//! \ref ZoneBlockPool.
+class ASMJIT_VIRTAPI ZoneBlockSource {
+public:
+  ASMJIT_BASE_CLASS(ZoneBlockSource)
+
+  ASMJIT_API ZoneBlockSource() noexcept;
+  ASMJIT_API virtual ~ZoneBlockSource() noexcept;
+
+  //! Allocates a block of at least `size` bytes and stores its real size to
+  //! `allocatedSize`. Returns null if out of memory.
+  //!
+  //! The returned memory must be aligned at least to \ref Globals::kAllocAlignment.
+  virtual void* allocBlock(size_t size, size_t* allocatedSize) noexcept = 0;
+
+  //! Releases a block `p` returned by `allocBlock()`, `size` is the size
+  //! returned in its `allocatedSize`.
+  virtual void releaseBlock(void* p, size_t size) noexcept = 0;
+};
+
 // ============================================================================
 // [asmjit::Zone]
 // ============================================================================
@@ -81,6 +109,8 @@ public:
   uint8_t* _end;
   //! Current block.
   Block* _block;
+  //! Source of blocks (`malloc()` and `free()` if null).
+  ZoneBlockSource* _blockSource;
 
   union {
     struct {
@@ -128,6 +158,7 @@ public:
     : _ptr(other._ptr),
       _end(other._end),
       _block(other._block),
+      _blockSource(other._blockSource),
       _packedData(other._packedData) {
     ASMJIT_ASSERT(!other.isTemporary());
     other._block = const_cast<Block*>(&_zeroBlock);
@@ -156,6 +187,15 @@ public:
   //! Tests whether this `Zone` is actually a `ZoneTmp` that uses temporary memory.
   ASMJIT_INLINE bool isTemporary() const noexcept { return _isTemporary != 0; }
 
+  //! Returns the source of blocks, null if blocks are allocated by `malloc()`.
+  ASMJIT_INLINE ZoneBlockSource* blockSource() const noexcept { return _blockSource; }
+
+  //! Sets the source of blocks to `source` (null means `malloc()`).
+  //!
+  //! All blocks allocated by the previous source are released by an implicit
+  //! `reset(Globals::kResetHard)` if the source changes.
+  ASMJIT_API void setBlockSource(ZoneBlockSource* source) noexcept;
+
   //! Returns the default block size.
   ASMJIT_INLINE size_t blockSize() const noexcept { return _blockSize; }
   //! Returns the default block alignment.
@@ -163,6 +203,18 @@ public:
   //! Returns remaining size of the current block.
   ASMJIT_INLINE size_t remainingSize() const noexcept { return (size_t)(_end - _ptr); }
 
+  //! Returns the number of bytes used by blocks up to the current one, which
+  //! includes block headers and unused tails of blocks that were filled.
+  //!
+  //! \note This iterates over all blocks, so it's O(N).
+  ASMJIT_API size_t usedSize() const noexcept;
+
+  //! Returns the number of bytes held by all blocks, including blocks kept
+  //! by a soft reset and the temporary block of \ref ZoneTmp.
+  //!
+  //! \note This iterates over all blocks, so it's O(N).
+  ASMJIT_API size_t reservedSize() const noexcept;
+
   //! Returns the current zone cursor (dangerous).
   //!
   //! This is a function that can be used to get exclusive access to the current
@@ -203,9 +255,18 @@ public:
     std::swap(_ptr, other._ptr);
     std::swap(_end, other._end);
     std::swap(_block, other._block);
+    std::swap(_blockSource, other._blockSource);
     std::swap(_packedData, other._packedData);
   }
 
+  //! Moves all blocks of `other` to this zone, `other` becomes empty.
+  //!
+  //! Memory allocated by `other` stays valid until this zone is reset, and
+  //! the blocks of `other` are recycled by this zone after a soft reset. Both
+  //! zones must use the same block source and none of them can be `ZoneTmp`,
+  //! otherwise `kErrorInvalidArgument` is returned and nothing changes.
+  ASMJIT_API Error adopt(Zone* other) noexcept;
+
   //! Aligns the current pointer to `alignment`.
   ASMJIT_INLINE void align(size_t alignment) noexcept {
     _ptr = Support::min(Support::alignUp(_ptr, alignment), _end);
@@ -379,6 +440,77 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::ZoneBlockPool]
+// ============================================================================
+
+//! Block source that recycles blocks of zones.
+//!
+//! Blocks are grouped into size classes of powers of 2 from 4kB to 1MB, larger
+//! blocks are not pooled. Released blocks are kept in the pool until the
+//! amount of pooled memory reaches the limit passed to the constructor.
+//!
+//! The process-wide pool returned by \ref global() additionally keeps a small
+//! per-thread cache of blocks, so zones created and destroyed by the same
+//! thread don't have to take the pool lock. Use it like this:
+//!
+//! ```
+//! CodeHolder code;
+//! code.setBlockSource(ZoneBlockPool::global());
+//! code.init(rt.environment());
+//!
+//! // Builder and Compiler use the block source of the attached CodeHolder.
+//! x86::Compiler cc(&code);
+//! ```
+//!
+//! \remarks All member functions are thread-safe.
+class ZoneBlockPool : public ZoneBlockSource {
+public:
+  ASMJIT_NONCOPYABLE(ZoneBlockPool)
+
+  enum Limits : size_t {
+    //! Log2 of the smallest size class.
+    kMinClassShift = 12,
+    //! Number of size classes.
+    kClassCount = 9,
+    //! Largest block size that is pooled.
+    kMaxPooledSize = size_t(1) << (kMinClassShift + kClassCount - 1),
+    //! Default limit of pooled memory.
+    kDefaultMaxPooledSize = 16 * 1024 * 1024
+  };
+
+  //! Recycled block (the first bytes of a block in a free list).
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  //! Lock that guards free lists.
+  mutable Lock _lock;
+  //! Free lists of all size classes.
+  FreeBlock* _freeLists[kClassCount];
+  //! Size of all pooled blocks.
+  size_t _pooledSize;
+  //! Limit of pooled memory.
+  size_t _maxPooledSize;
+
+  //! Creates a pool that keeps at most `maxPooledSize` bytes of free blocks.
+  ASMJIT_API explicit ZoneBlockPool(size_t maxPooledSize = kDefaultMaxPooledSize) noexcept;
+  //! Destroys the pool and frees all pooled blocks.
+  ASMJIT_API virtual ~ZoneBlockPool() noexcept;
+
+  //! Returns the process-wide pool, which uses per-thread caches.
+  static ASMJIT_API ZoneBlockPool* global() noexcept;
+
+  //! Returns the size of all pooled blocks (not including per-thread caches).
+  ASMJIT_API size_t pooledSize() const noexcept;
+
+  //! Frees all pooled blocks and blocks cached by the calling thread.
+  ASMJIT_API void trim() noexcept;
+
+  ASMJIT_API void* allocBlock(size_t size, size_t* allocatedSize) noexcept override;
+  ASMJIT_API void releaseBlock(void* p, size_t size) noexcept override;
+};
+
 // ============================================================================
 // [b2d::ZoneTmp]
 // ============================================================================
@@ -403,6 +535,99 @@ public:
     : Zone(blockSize, blockAlignment, Support::Temporary(_storage.data, N)) {}
 };
 
+// ============================================================================
+// [asmjit::ConcurrentZone]
+// ============================================================================
+
+//! Allows multiple threads to allocate memory that belongs to a single \ref
+//! Zone.
+//!
+//! `Zone` is not thread-safe. Instead of sharing it, each thread allocates
+//! from its own \ref ZoneArena, which uses the block source of the shared
+//! zone. When the arena is destroyed its blocks are moved to the shared zone
+//! (see \ref Zone::adopt()), so everything allocated by the thread stays
+//! valid until the shared zone is reset. Nothing is copied.
+//!
+//! This can be used to create nodes of \ref BaseBuilder in parallel and to
+//! link them into the node list afterwards:
+//!
+//! ```
+//! using namespace asmjit;
+//!
+//! ConcurrentZone concurrentZone(cb.codeZone());
+//!
+//! // Executed by each worker thread.
+//! {
+//!   ZoneArena arena(&concurrentZone);
+//!   InstNode* node;
+//!   cb._newInstNode(&arena, &node, x86::Inst::kIdAdd, 0, 2);
+//!   node->setOp(0, x86::eax);
+//!   node->setOp(1, x86::ecx);
+//!   ...
+//! } // Blocks of `arena` are adopted by `cb.codeZone()` here.
+//!
+//! // When all workers are done a single thread links the nodes.
+//! cb.addAfter(node, cb.cursor());
+//! ```
+//!
+//! \note The block source of the shared zone (if any) must be thread-safe,
+//! like \ref ZoneBlockPool, and the shared zone itself must not be used
+//! while arenas are being merged into it.
+class ConcurrentZone {
+public:
+  ASMJIT_NONCOPYABLE(ConcurrentZone)
+
+  //! Shared zone.
+  Zone* _zone;
+  //! Lock that guards `_zone`.
+  mutable Lock _lock;
+  //! Block size of arenas.
+  size_t _arenaBlockSize;
+
+  //! Creates a concurrent zone that merges arenas into `zone`. The block size
+  //! of arenas is `arenaBlockSize` or the block size of `zone` if zero.
+  ASMJIT_API explicit ConcurrentZone(Zone* zone, size_t arenaBlockSize = 0) noexcept;
+  ASMJIT_API ~ConcurrentZone() noexcept;
+
+  //! Returns the shared zone.
+  inline Zone* zone() const noexcept { return _zone; }
+  //! Returns the block size of arenas.
+  inline size_t arenaBlockSize() const noexcept { return _arenaBlockSize; }
+
+  //! Moves all blocks of `arena` to the shared zone (thread-safe).
+  ASMJIT_API Error merge(Zone* arena) noexcept;
+};
+
+// ============================================================================
+// [asmjit::ZoneArena]
+// ============================================================================
+
+//! Per-thread \ref Zone of \ref ConcurrentZone.
+//!
+//! Its blocks are moved to the shared zone when the arena is destroyed or by
+//! an explicit `merge()`, after which the arena can be used again.
+class ZoneArena : public Zone {
+public:
+  ASMJIT_NONCOPYABLE(ZoneArena)
+
+  //! Concurrent zone this arena belongs to.
+  ConcurrentZone* _owner;
+
+  ASMJIT_INLINE explicit ZoneArena(ConcurrentZone* owner) noexcept
+    : Zone(owner->arenaBlockSize()),
+      _owner(owner) {
+    _blockSource = owner->zone()->blockSource();
+  }
+
+  ASMJIT_INLINE ~ZoneArena() noexcept { merge(); }
+
+  //! Returns the concurrent zone this arena belongs to.
+  ASMJIT_INLINE ConcurrentZone* owner() const noexcept { return _owner; }
+
+  //! Moves all blocks allocated so far to the shared zone.
+  ASMJIT_INLINE Error merge() noexcept { return _owner->merge(this); }
+};
+
 // ============================================================================
 // [asmjit::ZoneAllocator]
 // ============================================================================
@@ -458,6 +683,8 @@ public:
   struct DynamicBlock {
     DynamicBlock* prev;
     DynamicBlock* next;
+    //! Size of the whole block.
+    size_t size;
   };
 
   //! \endcond
@@ -510,6 +737,12 @@ public:
   //! is not initialized.
   inline Zone* zone() const noexcept { return _zone; }
 
+  //! Returns the number of bytes held by dynamic blocks, which are used by
+  //! allocations that are too large for slots and are not part of the zone.
+  //!
+  //! \note This iterates over all dynamic blocks, so it's O(N).
+  ASMJIT_API size_t dynamicSize() const noexcept;
+
   //! \}
 
   //! \cond
@@ -266,6 +266,157 @@ ZoneHashNode* ZoneHashBase::_remove(ZoneAllocator* allocator, ZoneHashNode* node
   return nullptr;
 }
 
+// ============================================================================
+// [asmjit::ZoneFlatHashBase - Helpers]
+// ============================================================================
+
+typedef ZoneFlatHashBase::Group ZoneFlatHashGroup;
+
+// Returns the first slot in the probe sequence of `h` that is empty or deleted,
+// there is always at least one as the table never gets completely full.
+static ASMJIT_INLINE uint32_t ZoneFlatHash_findFreeSlot(const ZoneFlatHashBase* self, uint32_t h, ZoneFlatHashGroup** groupOut) noexcept {
+  uint32_t mask = self->_groupCount - 1;
+  uint32_t index = (h >> 7) & mask;
+  uint32_t step = 0;
+
+  for (;;) {
+    ZoneFlatHashGroup* group = &self->_groups[index];
+    uint64_t free = ZoneFlatHashBase::_matchEmptyOrDeleted(ZoneFlatHashBase::_loadCtrl(*group));
+
+    if (free) {
+      *groupOut = group;
+      return Support::ctz(free) >> 3;
+    }
+
+    index = (index + ++step) & mask;
+  }
+}
+
+// Groups are narrow, so the load factor is kept at 3/4 to make groups that
+// have no empty slot (and thus don't terminate probing) rare.
+static ASMJIT_INLINE uint32_t ZoneFlatHash_growthLimit(uint32_t groupCount) noexcept {
+  uint32_t capacity = groupCount * ZoneFlatHashBase::kGroupSize;
+  return capacity - capacity / 4u;
+}
+
+// ============================================================================
+// [asmjit::ZoneFlatHashBase - Rehash]
+// ============================================================================
+
+Error ZoneFlatHashBase::_rehash(ZoneAllocator* allocator, uint32_t newGroupCount) noexcept {
+  ASMJIT_ASSERT(Support::isPowerOf2(newGroupCount));
+  ASMJIT_ASSERT(newGroupCount >= kMinGroupCount);
+  ASMJIT_ASSERT(_size < ZoneFlatHash_growthLimit(newGroupCount));
+
+  void* newData = allocator->alloc(_allocationSize(newGroupCount));
+  if (ASMJIT_UNLIKELY(!newData))
+    return DebugUtils::errored(kErrorOutOfMemory);
+
+  Group* newGroups = Support::alignUp(static_cast<Group*>(newData), kGroupAlignment);
+  for (uint32_t i = 0; i < newGroupCount; i++) {
+    memset(newGroups[i].ctrl, kCtrlEmpty, kGroupSize);
+    memset(newGroups[i].ctrl + kGroupSize, kCtrlSentinel, sizeof(newGroups[i].ctrl) - kGroupSize);
+    memset(newGroups[i].slots, 0, sizeof(newGroups[i].slots));
+  }
+
+  Group* oldGroups = _groups;
+  void* oldData = _data;
+  uint32_t oldGroupCount = _groupCount;
+
+  _groups = newGroups;
+  _data = newData;
+  _groupCount = newGroupCount;
+  _growthLeft = ZoneFlatHash_growthLimit(newGroupCount) - uint32_t(_size);
+
+  for (uint32_t i = 0; i < oldGroupCount; i++) {
+    const Group& oldGroup = oldGroups[i];
+    for (uint32_t j = 0; j < kGroupSize; j++) {
+      if (oldGroup.ctrl[j] & kCtrlEmpty)
+        continue;
+
+      ZoneHashNode* node = oldGroup.slots[j];
+      uint32_t h = _mix(node->_hashCode);
+
+      Group* group;
+      uint32_t slot = ZoneFlatHash_findFreeSlot(this, h, &group);
+
+      group->ctrl[slot] = uint8_t(h & 0x7Fu);
+      group->slots[slot] = node;
+    }
+  }
+
+  if (oldData)
+    allocator->release(oldData, _allocationSize(oldGroupCount));
+
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::ZoneFlatHashBase - Ops]
+// ============================================================================
+
+ZoneHashNode* ZoneFlatHashBase::_insert(ZoneAllocator* allocator, ZoneHashNode* node) noexcept {
+  if (ASMJIT_UNLIKELY(!_growthLeft)) {
+    // Grow if the table is at least half full, otherwise it's full of deleted
+    // slots and rehashing to the same size is enough to purge them.
+    uint32_t newGroupCount = kMinGroupCount;
+    if (_groupCount)
+      newGroupCount = _size >= capacity() / 2u ? _groupCount * 2u : _groupCount;
+
+    if (ASMJIT_UNLIKELY(newGroupCount < _groupCount || _rehash(allocator, newGroupCount) != kErrorOk))
+      return nullptr;
+  }
+
+  uint32_t h = _mix(node->_hashCode);
+
+  Group* group;
+  uint32_t slot = ZoneFlatHash_findFreeSlot(this, h, &group);
+
+  // Reusing a deleted slot doesn't consume a slot that terminates probing.
+  if (group->ctrl[slot] == kCtrlEmpty)
+    _growthLeft--;
+
+  group->ctrl[slot] = uint8_t(h & 0x7Fu);
+  group->slots[slot] = node;
+  _size++;
+
+  return node;
+}
+
+ZoneHashNode* ZoneFlatHashBase::_remove(ZoneAllocator* allocator, ZoneHashNode* node) noexcept {
+  DebugUtils::unused(allocator);
+  if (!_groupCount)
+    return nullptr;
+
+  uint32_t h = _mix(node->_hashCode);
+  uint32_t h2 = h & 0x7Fu;
+  uint32_t mask = _groupCount - 1;
+  uint32_t index = (h >> 7) & mask;
+  uint32_t step = 0;
+
+  for (;;) {
+    Group& group = _groups[index];
+    uint64_t ctrl = _loadCtrl(group);
+    uint64_t matches = _matchH2(ctrl, h2);
+
+    while (matches) {
+      uint32_t slot = Support::ctz(matches) >> 3;
+      if (group.slots[slot] == node) {
+        group.ctrl[slot] = kCtrlDeleted;
+        group.slots[slot] = nullptr;
+        _size--;
+        return node;
+      }
+      matches &= matches - 1;
+    }
+
+    if (_matchEmpty(ctrl))
+      return nullptr;
+
+    index = (index + ++step) & mask;
+  }
+}
+
 // ============================================================================
 // [asmjit::ZoneHash - Unit]
 // ============================================================================
@@ -326,6 +477,83 @@ UNIT(zone_hash) {
 
   EXPECT(hashTable.empty());
 }
+
+UNIT(zone_flat_hash) {
+  uint32_t kCount = BrokenAPI::hasArg("--quick") ? 1000 : 10000;
+
+  Zone zone(4096);
+  ZoneAllocator allocator(&zone);
+
+  ZoneFlatHash<MyHashNode> hashTable;
+  EXPECT(hashTable.get(MyKeyMatcher(0)) == nullptr);
+
+  uint32_t key;
+  INFO("Inserting %u elements to FlatHashTable", unsigned(kCount));
+  for (key = 0; key < kCount; key++) {
+    EXPECT(hashTable.insert(&allocator, zone.newT<MyHashNode>(key)) != nullptr);
+  }
+
+  EXPECT(hashTable.size() == kCount);
+  EXPECT(hashTable.capacity() - hashTable.capacity() / 4 >= kCount);
+
+  uint32_t count = kCount;
+  INFO("Removing %u elements from FlatHashTable and validating each operation", unsigned(kCount));
+  do {
+    MyHashNode* node;
+
+    for (key = 0; key < count; key++) {
+      node = hashTable.get(MyKeyMatcher(key));
+      EXPECT(node != nullptr);
+      EXPECT(node->_key == key);
+    }
+
+    {
+      count--;
+      node = hashTable.get(MyKeyMatcher(count));
+      EXPECT(hashTable.remove(&allocator, node) == node);
+      EXPECT(hashTable.remove(&allocator, node) == nullptr);
+
+      node = hashTable.get(MyKeyMatcher(count));
+      EXPECT(node == nullptr);
+    }
+  } while (count);
+
+  EXPECT(hashTable.empty());
+
+  INFO("Reusing deleted slots of FlatHashTable without growing it");
+  uint32_t capacity = hashTable.capacity();
+  for (uint32_t i = 0; i < 10; i++) {
+    for (key = 0; key < 100; key++)
+      EXPECT(hashTable.insert(&allocator, zone.newT<MyHashNode>(key)) != nullptr);
+
+    for (key = 0; key < 100; key++)
+      EXPECT(hashTable.remove(&allocator, hashTable.get(MyKeyMatcher(key))) != nullptr);
+  }
+  EXPECT(hashTable.empty());
+  EXPECT(hashTable.capacity() == capacity);
+
+  INFO("Looking up FlatHashTable nodes that have colliding hash codes");
+  MyHashNode* colliding[64];
+  for (key = 0; key < 64; key++) {
+    colliding[key] = zone.newT<MyHashNode>(key);
+    colliding[key]->_hashCode = 0x12345678u;
+    EXPECT(hashTable.insert(&allocator, colliding[key]) != nullptr);
+  }
+
+  for (key = 0; key < 64; key++) {
+    struct CollidingKey {
+      inline uint32_t hashCode() const noexcept { return 0x12345678u; }
+      inline bool matches(const MyHashNode* node) const noexcept { return node->_key == _key; }
+      uint32_t _key;
+    };
+
+    EXPECT(hashTable.get(CollidingKey{key}) == colliding[key]);
+  }
+
+  hashTable.release(&allocator);
+  EXPECT(hashTable.empty());
+  EXPECT(hashTable.capacity() == 0);
+}
 #endif
 
 ASMJIT_END_NAMESPACE
@@ -211,6 +211,235 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::ZoneFlatHashBase]
+// ============================================================================
+
+//! Base class used by \ref ZoneFlatHash template.
+//!
+//! Open addressing hash table that stores pointers to \ref ZoneHashNode in
+//! groups of `kGroupSize` slots. Each group occupies a single cache line and
+//! starts with a word of control bytes, one per slot, which is either empty,
+//! deleted, or contains 7 bits of the hash of the node in the slot. Lookups
+//! match all control bytes of a group at once (SWAR), so nodes that don't
+//! match are mostly rejected without touching their memory.
+class ZoneFlatHashBase {
+public:
+  ASMJIT_NONCOPYABLE(ZoneFlatHashBase)
+
+  enum : uint32_t {
+    //! Number of slots in a group.
+    kGroupSize = 7,
+    //! Alignment of groups.
+    kGroupAlignment = 64,
+    //! Minimum number of groups of a non-empty table.
+    kMinGroupCount = 2
+  };
+
+  //! Control byte values, full slots use values from 0 to 127.
+  enum Ctrl : uint8_t {
+    //! Slot is empty, terminates probing.
+    kCtrlEmpty = 0x80u,
+    //! Slot is deleted, doesn't terminate probing.
+    kCtrlDeleted = 0xFEu,
+    //! Control byte that has no slot, never matches.
+    kCtrlSentinel = 0xFFu
+  };
+
+  //! Group of slots that share a word of control bytes.
+  struct Group {
+    uint8_t ctrl[8];
+    ZoneHashNode* slots[kGroupSize];
+  };
+
+  //! Groups (aligned to `kGroupAlignment`).
+  Group* _groups;
+  //! Memory allocated for groups.
+  void* _data;
+  //! Count of records inserted into the hash table.
+  size_t _size;
+  //! Count of groups (either zero or a power of 2).
+  uint32_t _groupCount;
+  //! Count of records that can be inserted before the table must grow.
+  uint32_t _growthLeft;
+
+  //! \name Construction & Destruction
+  //! \{
+
+  inline ZoneFlatHashBase() noexcept {
+    reset();
+  }
+
+  inline ZoneFlatHashBase(ZoneFlatHashBase&& other) noexcept {
+    _groups = other._groups;
+    _data = other._data;
+    _size = other._size;
+    _groupCount = other._groupCount;
+    _growthLeft = other._growthLeft;
+    other.reset();
+  }
+
+  inline void reset() noexcept {
+    _groups = nullptr;
+    _data = nullptr;
+    _size = 0;
+    _groupCount = 0;
+    _growthLeft = 0;
+  }
+
+  inline void release(ZoneAllocator* allocator) noexcept {
+    if (_data)
+      allocator->release(_data, _allocationSize(_groupCount));
+    reset();
+  }
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  inline bool empty() const noexcept { return _size == 0; }
+  inline size_t size() const noexcept { return _size; }
+  //! Returns the number of slots.
+  inline uint32_t capacity() const noexcept { return _groupCount * kGroupSize; }
+
+  //! \}
+
+  //! \name Utilities
+  //! \{
+
+  inline void _swap(ZoneFlatHashBase& other) noexcept {
+    std::swap(_groups, other._groups);
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_groupCount, other._groupCount);
+    std::swap(_growthLeft, other._growthLeft);
+  }
+
+  //! \cond INTERNAL
+  static constexpr uint64_t kLsbs = 0x0101010101010101u;
+  static constexpr uint64_t kMsbs = 0x8080808080808080u;
+
+  //! Scrambles `hashCode`, low 7 bits are stored in the control byte and the
+  //! remaining bits select the first group to probe.
+  static inline uint32_t _mix(uint32_t hashCode) noexcept {
+    uint32_t h = hashCode;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    return h;
+  }
+
+  static inline size_t _allocationSize(uint32_t groupCount) noexcept {
+    return size_t(groupCount) * sizeof(Group) + kGroupAlignment;
+  }
+
+  //! Loads control bytes of `group`, byte `i` is always at bits `[i * 8, i * 8 + 7]`.
+  static inline uint64_t _loadCtrl(const Group& group) noexcept {
+    return Support::readU64aLE(group.ctrl);
+  }
+
+  //! Returns a mask that has the MSB set in each byte that matches `h2`. It
+  //! can report a false positive in a byte that follows a match, which is
+  //! fine as all candidates are verified.
+  static inline uint64_t _matchH2(uint64_t ctrl, uint32_t h2) noexcept {
+    uint64_t x = ctrl ^ (kLsbs * h2);
+    return (x - kLsbs) & ~x & kMsbs;
+  }
+
+  static inline uint64_t _matchEmpty(uint64_t ctrl) noexcept {
+    return ctrl & (~ctrl << 6) & kMsbs;
+  }
+
+  static inline uint64_t _matchEmptyOrDeleted(uint64_t ctrl) noexcept {
+    return ctrl & ~(ctrl << 7) & kMsbs;
+  }
+
+  ASMJIT_API Error _rehash(ZoneAllocator* allocator, uint32_t newGroupCount) noexcept;
+  ASMJIT_API ZoneHashNode* _insert(ZoneAllocator* allocator, ZoneHashNode* node) noexcept;
+  ASMJIT_API ZoneHashNode* _remove(ZoneAllocator* allocator, ZoneHashNode* node) noexcept;
+  //! \endcond
+
+  //! \}
+};
+
+// ============================================================================
+// [asmjit::ZoneFlatHash]
+// ============================================================================
+
+//! Open addressing variant of \ref ZoneHash.
+//!
+//! Uses the same nodes and the same key interface as \ref ZoneHash, thus it
+//! can be used as a drop-in replacement. A lookup usually reads a single
+//! cache line of the table and only visits nodes whose control byte matches,
+//! whereas \ref ZoneHash visits every node in a bucket. The `_hashNext`
+//! member of nodes is not used.
+//!
+//! The flat table only pays off for large tables with random lookups, which
+//! miss caches. Small tables and tables where consecutive lookups use similar
+//! keys are faster with \ref ZoneHash, which is why \ref CodeHolder keeps it
+//! for named labels.
+//!
+//! Unlike \ref ZoneHash, `insert()` returns null if the table cannot grow.
+template<typename NodeT>
+class ZoneFlatHash : public ZoneFlatHashBase {
+public:
+  ASMJIT_NONCOPYABLE(ZoneFlatHash<NodeT>)
+
+  typedef NodeT Node;
+
+  //! \name Construction & Destruction
+  //! \{
+
+  inline ZoneFlatHash() noexcept
+    : ZoneFlatHashBase() {}
+
+  inline ZoneFlatHash(ZoneFlatHash&& other) noexcept
+    : ZoneFlatHashBase(std::move(other)) {}
+
+  //! \}
+
+  //! \name Utilities
+  //! \{
+
+  inline void swap(ZoneFlatHash& other) noexcept { ZoneFlatHashBase::_swap(other); }
+
+  template<typename KeyT>
+  inline NodeT* get(const KeyT& key) const noexcept {
+    if (ASMJIT_UNLIKELY(!_groupCount))
+      return nullptr;
+
+    uint32_t h = _mix(key.hashCode());
+    uint32_t h2 = h & 0x7Fu;
+    uint32_t mask = _groupCount - 1;
+    uint32_t index = (h >> 7) & mask;
+    uint32_t step = 0;
+
+    for (;;) {
+      const Group& group = _groups[index];
+      uint64_t ctrl = _loadCtrl(group);
+      uint64_t matches = _matchH2(ctrl, h2);
+
+      while (matches) {
+        NodeT* node = static_cast<NodeT*>(group.slots[Support::ctz(matches) >> 3]);
+        if (node && key.matches(node))
+          return node;
+        matches &= matches - 1;
+      }
+
+      if (_matchEmpty(ctrl))
+        return nullptr;
+
+      index = (index + ++step) & mask;
+    }
+  }
+
+  inline NodeT* insert(ZoneAllocator* allocator, NodeT* node) noexcept { return static_cast<NodeT*>(_insert(allocator, node)); }
+  inline NodeT* remove(ZoneAllocator* allocator, NodeT* node) noexcept { return static_cast<NodeT*>(_remove(allocator, node)); }
+
+  //! \}
+};
+
 //! \}
 
 ASMJIT_END_NAMESPACE
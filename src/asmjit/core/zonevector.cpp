@@ -22,10 +22,26 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 #include "../core/api-build_p.h"
+#include "../core/cpuinfo.h"
 #include "../core/support.h"
 #include "../core/zone.h"
 #include "../core/zonevector.h"
 
+// SIMD kernels are only provided for X86 hosts and compilers that allow to
+// use AVX2 intrinsics in functions compiled for a particular target.
+#if ASMJIT_ARCH_X86 && defined(ASMJIT_BUILD_X86) && (defined(_MSC_VER) || defined(__GNUC__))
+  #define ASMJIT_ZONEBITVECTOR_SIMD
+  #include "../x86/x86features.h"
+  #include <atomic>
+  #include <immintrin.h>
+
+  #if defined(__GNUC__)
+    #define ASMJIT_ZONEBITVECTOR_TARGET(TARGET) __attribute__((__target__(TARGET)))
+  #else
+    #define ASMJIT_ZONEBITVECTOR_TARGET(TARGET)
+  #endif
+#endif
+
 ASMJIT_BEGIN_NAMESPACE
 
 // ============================================================================
@@ -87,7 +103,7 @@ Error ZoneVectorBase::_reserve(ZoneAllocator* allocator, uint32_t sizeOfT, uint3
   if (_size)
     memcpy(newData, oldData, size_t(_size) * sizeOfT);
 
-  if (oldData)
+  if (oldData && !_isInline())
     allocator->release(oldData, size_t(oldCapacity) * sizeOfT);
 
   _capacity = uint32_t(allocatedBytes / sizeOfT);
@@ -148,7 +164,7 @@ Error ZoneBitVector::copyFrom(ZoneAllocator* allocator, const ZoneBitVector& oth
     if (ASMJIT_UNLIKELY(allocatedCapacityInBits < allocatedCapacity))
       allocatedCapacityInBits = minimumCapacityInBits;
 
-    if (data)
+    if (data && !_isInline())
       allocator->release(data, _capacity / 8);
     data = newData;
 
@@ -211,7 +227,7 @@ Error ZoneBitVector::_resize(ZoneAllocator* allocator, uint32_t newSize, uint32_
 
     _copyBits(newData, data, _wordsPerBits(oldSize));
 
-    if (data)
+    if (data && !_isInline())
       allocator->release(data, _capacity / 8);
     data = newData;
 
@@ -280,6 +296,231 @@ Error ZoneBitVector::_append(ZoneAllocator* allocator, bool value) noexcept {
   return _resize(allocator, newSize, idealCapacity, value);
 }
 
+// ============================================================================
+// [asmjit::ZoneBitVector - Bulk Ops]
+// ============================================================================
+
+// Bit-vectors used by the register allocator have one bit per virtual register
+// and are processed many times by liveness analysis, so bulk operations use SSE2
+// and AVX2 kernels when available. Kernels use unaligned loads and stores as
+// bit-words are only guaranteed to be aligned to `sizeof(BitWord)`. AVX2 kernels
+// must clear upper halves of YMM registers before returning to non-VEX code.
+typedef ZoneBitVector::BitWord BitWord;
+
+static bool ZoneBitVector_eqScalar(const BitWord* a, const BitWord* b, uint32_t n) noexcept {
+  for (uint32_t i = 0; i < n; i++)
+    if (a[i] != b[i])
+      return false;
+  return true;
+}
+
+static bool ZoneBitVector_orScalar(BitWord* dst, const BitWord* src, uint32_t n) noexcept {
+  BitWord changed = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    BitWord before = dst[i];
+    BitWord after = before | src[i];
+
+    dst[i] = after;
+    changed |= before ^ after;
+  }
+  return changed != 0;
+}
+
+static bool ZoneBitVector_orAndNotScalar(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept {
+  BitWord changed = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    BitWord before = dst[i];
+    BitWord after = (a[i] | b[i]) & ~c[i];
+
+    dst[i] = after;
+    changed |= before ^ after;
+  }
+  return changed != 0;
+}
+
+#if defined(ASMJIT_ZONEBITVECTOR_SIMD)
+struct ZoneBitVectorFuncs {
+  bool (*eq)(const BitWord* a, const BitWord* b, uint32_t n) noexcept;
+  bool (*or_)(BitWord* dst, const BitWord* src, uint32_t n) noexcept;
+  bool (*orAndNot)(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept;
+};
+
+template<uint32_t kVecSize>
+static ASMJIT_INLINE uint32_t ZoneBitVector_simdCount(uint32_t n) noexcept {
+  constexpr uint32_t kWordsPerVec = kVecSize / uint32_t(sizeof(BitWord));
+  return n & ~(kWordsPerVec - 1u);
+}
+
+ASMJIT_ZONEBITVECTOR_TARGET("sse2")
+static bool ZoneBitVector_eqSSE2(const BitWord* a, const BitWord* b, uint32_t n) noexcept {
+  uint32_t end = ZoneBitVector_simdCount<16>(n);
+  uint32_t i = 0;
+
+  for (; i < end; i += 16 / sizeof(BitWord)) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF)
+      return false;
+  }
+
+  return ZoneBitVector_eqScalar(a + i, b + i, n - i);
+}
+
+ASMJIT_ZONEBITVECTOR_TARGET("sse2")
+static bool ZoneBitVector_orSSE2(BitWord* dst, const BitWord* src, uint32_t n) noexcept {
+  uint32_t end = ZoneBitVector_simdCount<16>(n);
+  uint32_t i = 0;
+  __m128i changed = _mm_setzero_si128();
+
+  for (; i < end; i += 16 / sizeof(BitWord)) {
+    __m128i before = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i vs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+    changed = _mm_or_si128(changed, _mm_andnot_si128(before, vs));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(before, vs));
+  }
+
+  bool tailChanged = ZoneBitVector_orScalar(dst + i, src + i, n - i);
+  return tailChanged || _mm_movemask_epi8(_mm_cmpeq_epi8(changed, _mm_setzero_si128())) != 0xFFFF;
+}
+
+ASMJIT_ZONEBITVECTOR_TARGET("sse2")
+static bool ZoneBitVector_orAndNotSSE2(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept {
+  uint32_t end = ZoneBitVector_simdCount<16>(n);
+  uint32_t i = 0;
+  __m128i changed = _mm_setzero_si128();
+
+  for (; i < end; i += 16 / sizeof(BitWord)) {
+    __m128i before = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c + i));
+    __m128i after = _mm_andnot_si128(vc, _mm_or_si128(va, vb));
+
+    changed = _mm_or_si128(changed, _mm_xor_si128(before, after));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), after);
+  }
+
+  bool tailChanged = ZoneBitVector_orAndNotScalar(dst + i, a + i, b + i, c + i, n - i);
+  return tailChanged || _mm_movemask_epi8(_mm_cmpeq_epi8(changed, _mm_setzero_si128())) != 0xFFFF;
+}
+
+ASMJIT_ZONEBITVECTOR_TARGET("avx2")
+static bool ZoneBitVector_eqAVX2(const BitWord* a, const BitWord* b, uint32_t n) noexcept {
+  uint32_t end = ZoneBitVector_simdCount<32>(n);
+  uint32_t i = 0;
+
+  for (; i < end; i += 32 / sizeof(BitWord)) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i diff = _mm256_xor_si256(va, vb);
+    if (!_mm256_testz_si256(diff, diff)) {
+      _mm256_zeroupper();
+      return false;
+    }
+  }
+
+  _mm256_zeroupper();
+  return ZoneBitVector_eqScalar(a + i, b + i, n - i);
+}
+
+ASMJIT_ZONEBITVECTOR_TARGET("avx2")
+static bool ZoneBitVector_orAVX2(BitWord* dst, const BitWord* src, uint32_t n) noexcept {
+  uint32_t end = ZoneBitVector_simdCount<32>(n);
+  uint32_t i = 0;
+  __m256i changed = _mm256_setzero_si256();
+
+  for (; i < end; i += 32 / sizeof(BitWord)) {
+    __m256i before = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+
+    changed = _mm256_or_si256(changed, _mm256_andnot_si256(before, vs));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(before, vs));
+  }
+
+  bool vecChanged = !_mm256_testz_si256(changed, changed);
+  _mm256_zeroupper();
+  return ZoneBitVector_orScalar(dst + i, src + i, n - i) || vecChanged;
+}
+
+ASMJIT_ZONEBITVECTOR_TARGET("avx2")
+static bool ZoneBitVector_orAndNotAVX2(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept {
+  uint32_t end = ZoneBitVector_simdCount<32>(n);
+  uint32_t i = 0;
+  __m256i changed = _mm256_setzero_si256();
+
+  for (; i < end; i += 32 / sizeof(BitWord)) {
+    __m256i before = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i vc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c + i));
+    __m256i after = _mm256_andnot_si256(vc, _mm256_or_si256(va, vb));
+
+    changed = _mm256_or_si256(changed, _mm256_xor_si256(before, after));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), after);
+  }
+
+  bool vecChanged = !_mm256_testz_si256(changed, changed);
+  _mm256_zeroupper();
+  return ZoneBitVector_orAndNotScalar(dst + i, a + i, b + i, c + i, n - i) || vecChanged;
+}
+
+static const ZoneBitVectorFuncs zoneBitVectorFuncsScalar { ZoneBitVector_eqScalar, ZoneBitVector_orScalar, ZoneBitVector_orAndNotScalar };
+static const ZoneBitVectorFuncs zoneBitVectorFuncsSSE2 { ZoneBitVector_eqSSE2, ZoneBitVector_orSSE2, ZoneBitVector_orAndNotSSE2 };
+static const ZoneBitVectorFuncs zoneBitVectorFuncsAVX2 { ZoneBitVector_eqAVX2, ZoneBitVector_orAVX2, ZoneBitVector_orAndNotAVX2 };
+
+// Kernels selected for the host, the pointer is published with release
+// semantics so a thread that loads it also sees the selected table.
+static std::atomic<const ZoneBitVectorFuncs*> zoneBitVectorFuncsHost { nullptr };
+
+static const ZoneBitVectorFuncs& ZoneBitVector_funcs() noexcept {
+  const ZoneBitVectorFuncs* funcs = zoneBitVectorFuncsHost.load(std::memory_order_acquire);
+
+  // Threads that race here select the same kernels.
+  if (ASMJIT_UNLIKELY(!funcs)) {
+    const CpuInfo& cpu = CpuInfo::host();
+
+    funcs = &zoneBitVectorFuncsScalar;
+    if (cpu.hasFeature(x86::Features::kSSE2))
+      funcs = &zoneBitVectorFuncsSSE2;
+    if (cpu.hasFeature(x86::Features::kAVX2))
+      funcs = &zoneBitVectorFuncsAVX2;
+
+    zoneBitVectorFuncsHost.store(funcs, std::memory_order_release);
+  }
+
+  return *funcs;
+}
+
+// Bit-vectors shorter than a single SSE2 register are not worth dispatching.
+static constexpr uint32_t kZoneBitVectorScalarWords = 16 / uint32_t(sizeof(BitWord));
+#endif
+
+// Without SIMD kernels the scalar ones are called directly.
+bool ZoneBitVector::_eqBitWords(const BitWord* a, const BitWord* b, uint32_t n) noexcept {
+#if defined(ASMJIT_ZONEBITVECTOR_SIMD)
+  if (n >= kZoneBitVectorScalarWords)
+    return ZoneBitVector_funcs().eq(a, b, n);
+#endif
+  return ZoneBitVector_eqScalar(a, b, n);
+}
+
+bool ZoneBitVector::_orBitWords(BitWord* dst, const BitWord* src, uint32_t n) noexcept {
+#if defined(ASMJIT_ZONEBITVECTOR_SIMD)
+  if (n >= kZoneBitVectorScalarWords)
+    return ZoneBitVector_funcs().or_(dst, src, n);
+#endif
+  return ZoneBitVector_orScalar(dst, src, n);
+}
+
+bool ZoneBitVector::_orAndNotBitWords(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept {
+#if defined(ASMJIT_ZONEBITVECTOR_SIMD)
+  if (n >= kZoneBitVectorScalarWords)
+    return ZoneBitVector_funcs().orAndNot(dst, a, b, c, n);
+#endif
+  return ZoneBitVector_orAndNotScalar(dst, a, b, c, n);
+}
+
 // ============================================================================
 // [asmjit::ZoneVector / ZoneBitVector - Unit]
 // ============================================================================
@@ -362,6 +603,139 @@ static void test_zone_bitvector(ZoneAllocator* allocator) {
       EXPECT(vec.bitAt(i) == bool(i & 1));
     }
   }
+
+  INFO("ZoneBitVector::orChanged() / assignOrAndNot() / eq()");
+  for (count = 1; count < 1200; count += 37) {
+    ZoneBitVector a, b, c, dst;
+    EXPECT(a.resize(allocator, count) == kErrorOk);
+    EXPECT(b.resize(allocator, count) == kErrorOk);
+    EXPECT(c.resize(allocator, count) == kErrorOk);
+    EXPECT(dst.resize(allocator, count) == kErrorOk);
+
+    for (i = 0; i < count; i++) {
+      a.setBit(i, (i % 3) == 0);
+      b.setBit(i, (i % 5) == 0);
+      c.setBit(i, (i % 7) == 0);
+    }
+
+    EXPECT(dst.assignOrAndNot(a, b, c) == (count > 3));
+    EXPECT(dst.assignOrAndNot(a, b, c) == false);
+    for (i = 0; i < count; i++)
+      EXPECT(dst.bitAt(i) == (((i % 3) == 0 || (i % 5) == 0) && (i % 7) != 0));
+
+    EXPECT(a.orChanged(b) == (count > 5));
+    EXPECT(a.orChanged(b) == false);
+    for (i = 0; i < count; i++)
+      EXPECT(a.bitAt(i) == ((i % 3) == 0 || (i % 5) == 0));
+
+    // Only the last bit differs, which must be found by all kernels.
+    EXPECT(b.copyFrom(allocator, a) == kErrorOk);
+    EXPECT(a.eq(b));
+    b.setBit(count - 1, !b.bitAt(count - 1));
+    EXPECT(!a.eq(b));
+    bool lastBit = a.bitAt(count - 1);
+    EXPECT(a.orChanged(b) == !lastBit);
+
+    a.release(allocator);
+    b.release(allocator);
+    c.release(allocator);
+    dst.release(allocator);
+  }
+}
+
+static void test_zone_small_vector(ZoneAllocator* allocator) {
+  constexpr uint32_t kInlineCount = 4;
+  constexpr uint32_t kMax = 100;
+
+  ZoneSmallVector<int, kInlineCount> vec;
+  const void* inlineData = vec._inlineData;
+
+  INFO("ZoneSmallVector<int, %u>", kInlineCount);
+  EXPECT(vec.empty());
+  EXPECT(vec.capacity() == kInlineCount);
+  EXPECT(vec.data() == inlineData);
+
+  uint32_t i;
+  for (i = 0; i < kInlineCount; i++)
+    EXPECT(vec.append(allocator, int(i)) == kErrorOk);
+  EXPECT(vec.data() == inlineData);
+
+  EXPECT(vec.prepend(allocator, -1) == kErrorOk);
+  EXPECT(vec.data() != inlineData);
+  EXPECT(vec.size() == kInlineCount + 1);
+
+  for (i = 0; i < kInlineCount + 1; i++)
+    EXPECT(vec[i] == int(i) - 1);
+
+  for (i = kInlineCount; i < kMax; i++)
+    EXPECT(vec.append(allocator, int(i)) == kErrorOk);
+  EXPECT(vec.size() == kMax + 1);
+  EXPECT(vec.indexOf(int(kMax - 1)) == kMax);
+
+  vec.release(allocator);
+  EXPECT(vec.empty());
+  EXPECT(vec.data() == inlineData);
+  EXPECT(vec.capacity() == kInlineCount);
+
+  // Releasing a vector that never left its inline storage must not return
+  // the inline storage to the allocator.
+  EXPECT(vec.append(allocator, 1) == kErrorOk);
+  vec.release(allocator);
+  EXPECT(vec.data() == inlineData);
+
+  // A regular vector can be used through a small vector reference.
+  ZoneVector<int>& base = vec;
+  EXPECT(base.reserve(allocator, kInlineCount) == kErrorOk);
+  EXPECT(base.data() == inlineData);
+  EXPECT(base.reserve(allocator, kInlineCount * 2) == kErrorOk);
+  EXPECT(base.data() != inlineData);
+  vec.release(allocator);
+}
+
+static void test_zone_small_bitvector(ZoneAllocator* allocator) {
+  typedef ZoneBitVector::BitWord BitWord;
+  constexpr uint32_t kInlineBits = ZoneBitVector::kBitWordSizeInBits;
+  constexpr uint32_t kMaxCount = 300;
+
+  ZoneSmallBitVector<1> vec;
+  const BitWord* inlineData = vec._inlineData;
+
+  INFO("ZoneSmallBitVector<1>");
+  EXPECT(vec.empty());
+  EXPECT(vec.capacity() == kInlineBits);
+  EXPECT(vec.data() == inlineData);
+
+  EXPECT(vec.resize(allocator, kInlineBits, true) == kErrorOk);
+  EXPECT(vec.data() == inlineData);
+
+  uint32_t i;
+  for (i = 0; i < kInlineBits; i++)
+    EXPECT(vec.bitAt(i) == true);
+
+  EXPECT(vec.resize(allocator, kMaxCount, false) == kErrorOk);
+  EXPECT(vec.data() != inlineData);
+
+  for (i = 0; i < kMaxCount; i++)
+    EXPECT(vec.bitAt(i) == (i < kInlineBits));
+
+  vec.release(allocator);
+  EXPECT(vec.empty());
+  EXPECT(vec.data() == inlineData);
+  EXPECT(vec.capacity() == kInlineBits);
+
+  ZoneBitVector other;
+  EXPECT(other.resize(allocator, kInlineBits / 2, true) == kErrorOk);
+  EXPECT(vec.copyFrom(allocator, other) == kErrorOk);
+  EXPECT(vec.data() == inlineData);
+  EXPECT(vec.eq(other));
+
+  EXPECT(other.resize(allocator, kMaxCount, true) == kErrorOk);
+  EXPECT(vec.copyFrom(allocator, other) == kErrorOk);
+  EXPECT(vec.data() != inlineData);
+  EXPECT(vec.eq(other));
+
+  other.release(allocator);
+  vec.release(allocator);
 }
 
 UNIT(zone_vector) {
@@ -371,6 +745,8 @@ UNIT(zone_vector) {
   test_zone_vector<int>(&allocator, "int");
   test_zone_vector<int64_t>(&allocator, "int64_t");
   test_zone_bitvector(&allocator);
+  test_zone_small_vector(&allocator);
+  test_zone_small_bitvector(&allocator);
 }
 #endif
 
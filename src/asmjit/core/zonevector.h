@@ -72,11 +72,21 @@ protected:
 
   inline void _release(ZoneAllocator* allocator, uint32_t sizeOfT) noexcept {
     if (_data != nullptr) {
-      allocator->release(_data, _capacity * sizeOfT);
+      if (!_isInline())
+        allocator->release(_data, _capacity * sizeOfT);
       reset();
     }
   }
 
+  //! Tests whether the vector uses the inline storage of \ref ZoneSmallVector,
+  //! which always immediately follows `ZoneVectorBase`.
+  //!
+  //! Data of a regular vector could be allocated right after the vector itself,
+  //! in that case they are never returned to the allocator, which is harmless.
+  inline bool _isInline() const noexcept {
+    return _data == static_cast<const void*>(this + 1);
+  }
+
   ASMJIT_API Error _grow(ZoneAllocator* allocator, uint32_t sizeOfT, uint32_t n) noexcept;
   ASMJIT_API Error _resize(ZoneAllocator* allocator, uint32_t sizeOfT, uint32_t n) noexcept;
   ASMJIT_API Error _reserve(ZoneAllocator* allocator, uint32_t sizeOfT, uint32_t n) noexcept;
@@ -422,6 +432,77 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::ZoneSmallVector<T, N>]
+// ============================================================================
+
+//! \ref ZoneVector that has an inline storage for `N` items.
+//!
+//! Items are stored inline until the vector grows beyond `N` items, then they
+//! are moved to memory provided by \ref ZoneAllocator like in \ref ZoneVector.
+//! Useful for many vectors that mostly hold just a few items.
+//!
+//! `ZoneSmallVector` can be used as `ZoneVector<T>`, however, it must never be
+//! moved or swapped as its data can point to the vector itself.
+template<typename T, uint32_t N>
+class ZoneSmallVector : public ZoneVector<T> {
+public:
+  ASMJIT_NONCOPYABLE(ZoneSmallVector)
+
+  static_assert(N > 0, "ZoneSmallVector must have an inline storage");
+  static_assert(alignof(T) <= alignof(ZoneVectorBase), "Inline storage must immediately follow ZoneVectorBase");
+
+  //! Inline storage.
+  alignas(T) uint8_t _inlineData[sizeof(T) * N];
+
+  //! \name Construction & Destruction
+  //! \{
+
+  inline ZoneSmallVector() noexcept
+    : ZoneVector<T>() {
+    _resetInline();
+    ASMJIT_ASSERT(this->_isInline());
+  }
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  //! Returns the number of items that can be stored inline.
+  static constexpr uint32_t inlineCapacity() noexcept { return N; }
+
+  //! \}
+
+  //! \name Utilities
+  //! \{
+
+  //! Resets the vector to use its inline storage.
+  inline void reset() noexcept {
+    this->_size = 0;
+    _resetInline();
+  }
+
+  inline void _resetInline() noexcept {
+    this->_data = _inlineData;
+    this->_capacity = N;
+  }
+
+  //! \}
+
+  //! \name Memory Management
+  //! \{
+
+  //! Releases the memory held by the vector back to the `allocator`, the
+  //! vector uses its inline storage afterwards.
+  inline void release(ZoneAllocator* allocator) noexcept {
+    ZoneVector<T>::release(allocator);
+    _resetInline();
+  }
+
+  //! \}
+};
+
 // ============================================================================
 // [asmjit::ZoneBitVector]
 // ============================================================================
@@ -528,6 +609,12 @@ public:
     _capacity = 0;
   }
 
+  //! Tests whether the bit-vector uses the inline storage of \ref ZoneSmallBitVector,
+  //! see \ref ZoneVectorBase::_isInline().
+  inline bool _isInline() const noexcept {
+    return _data == reinterpret_cast<const BitWord*>(this + 1);
+  }
+
   inline void truncate(uint32_t newSize) noexcept {
     _size = Support::min(_size, newSize);
     _clearUnusedBits();
@@ -653,19 +740,36 @@ public:
   }
 
   inline bool eq(const ZoneBitVector& other) const noexcept {
-    if (_size != other._size)
-      return false;
+    return _size == other._size && _eqBitWords(_data, other._data, sizeInBitWords());
+  }
 
-    const BitWord* aData = _data;
-    const BitWord* bData = other._data;
-    uint32_t numBitWords = _wordsPerBits(_size);
+  //! Performs a logical bitwise OR between bits specified in this array and bits
+  //! in `other` and returns whether any bit has changed. Both arrays must have
+  //! the same size.
+  inline bool orChanged(const ZoneBitVector& other) noexcept {
+    ASMJIT_ASSERT(_size == other._size);
+    return _orBitWords(_data, other._data, sizeInBitWords());
+  }
 
-    for (uint32_t i = 0; i < numBitWords; i++)
-      if (aData[i] != bData[i])
-        return false;
-    return true;
+  //! Assigns `(a | b) & ~c` to this array and returns whether any bit has
+  //! changed. All arrays must have the same size.
+  inline bool assignOrAndNot(const ZoneBitVector& a, const ZoneBitVector& b, const ZoneBitVector& c) noexcept {
+    ASMJIT_ASSERT(_size == a._size && _size == b._size && _size == c._size);
+    return _orAndNotBitWords(_data, a._data, b._data, c._data, sizeInBitWords());
   }
 
+  //! \cond INTERNAL
+  //!
+  //! Bulk operations on raw bit-words. They use SIMD kernels when the host CPU
+  //! supports them (selected at runtime), otherwise they fall back to scalar
+  //! loops.
+
+  ASMJIT_API static bool _eqBitWords(const BitWord* a, const BitWord* b, uint32_t n) noexcept;
+  ASMJIT_API static bool _orBitWords(BitWord* dst, const BitWord* src, uint32_t n) noexcept;
+  ASMJIT_API static bool _orAndNotBitWords(BitWord* dst, const BitWord* a, const BitWord* b, const BitWord* c, uint32_t n) noexcept;
+
+  //! \endcond
+
   //! \}
 
   //! \name Memory Management
@@ -673,7 +777,8 @@ public:
 
   inline void release(ZoneAllocator* allocator) noexcept {
     if (!_data) return;
-    allocator->release(_data, _capacity / 8);
+    if (!_isInline())
+      allocator->release(_data, _capacity / 8);
     reset();
   }
 
@@ -707,6 +812,63 @@ public:
   //! \}
 };
 
+// ============================================================================
+// [asmjit::ZoneSmallBitVector<N>]
+// ============================================================================
+
+//! \ref ZoneBitVector that has an inline storage for `N` bit-words.
+//!
+//! Like \ref ZoneSmallVector it must never be moved or swapped.
+template<uint32_t N>
+class ZoneSmallBitVector : public ZoneBitVector {
+public:
+  ASMJIT_NONCOPYABLE(ZoneSmallBitVector)
+
+  static_assert(N > 0, "ZoneSmallBitVector must have an inline storage");
+
+  //! Inline storage.
+  BitWord _inlineData[N];
+
+  //! \name Construction & Destruction
+  //! \{
+
+  inline ZoneSmallBitVector() noexcept
+    : ZoneBitVector() {
+    _resetInline();
+    ASMJIT_ASSERT(_isInline());
+  }
+
+  //! \}
+
+  //! \name Utilities
+  //! \{
+
+  //! Resets the bit-vector to use its inline storage.
+  inline void reset() noexcept {
+    _size = 0;
+    _resetInline();
+  }
+
+  inline void _resetInline() noexcept {
+    _data = _inlineData;
+    _capacity = N * kBitWordSizeInBits;
+  }
+
+  //! \}
+
+  //! \name Memory Management
+  //! \{
+
+  //! Releases the memory held by the bit-vector back to the `allocator`, the
+  //! bit-vector uses its inline storage afterwards.
+  inline void release(ZoneAllocator* allocator) noexcept {
+    ZoneBitVector::release(allocator);
+    _resetInline();
+  }
+
+  //! \}
+};
+
 //! \}
 
 ASMJIT_END_NAMESPACE
@@ -106,6 +106,7 @@
 #include "core.h"
 
 #include "asmjit-scope-begin.h"
+#include "x86/x86alignpass.h"
 #include "x86/x86assembler.h"
 #include "x86/x86builder.h"
 #include "x86/x86compiler.h"
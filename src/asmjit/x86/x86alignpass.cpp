@@ -0,0 +1,999 @@
+// AsmJit - Machine code generation for C++
+//
+//  * Official AsmJit Home Page: https://asmjit.com
+//  * Official Github Repository: https://github.com/asmjit/asmjit
+//
+// Copyright (c) 2008-2020 The AsmJit Authors
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "../core/api-build_p.h"
+#if defined(ASMJIT_BUILD_X86) && !defined(ASMJIT_NO_BUILDER)
+
+#include "../core/emitterutils_p.h"
+#include "../core/support.h"
+#include "../x86/x86alignpass.h"
+#include "../x86/x86assembler.h"
+#include "../x86/x86instdb_p.h"
+
+#if defined(ASMJIT_TEST)
+  #include "../core/jitruntime.h"
+  #include "../x86/x86builder.h"
+#endif
+
+ASMJIT_BEGIN_SUB_NAMESPACE(x86)
+
+// ============================================================================
+// [asmjit::x86::AlignPass - Utilities]
+// ============================================================================
+
+//! Maximum number of layouts done by a single run.
+static constexpr uint32_t kAlignMaxIterations = 8;
+//! Maximum number of preceding instructions considered for prefix padding.
+static constexpr uint32_t kAlignMaxPaddedInsts = 8;
+//! Maximum padding [in bytes] that can be requested.
+static constexpr uint32_t kAlignMaxPadding = 63;
+static_assert(AlignPass::kMaxLoopAlignment - 1 <= kAlignMaxPadding, "Padding of loop headers must fit kAlignMaxPadding");
+//! Maximum size of a single NOP instruction emitted by the pass.
+static constexpr uint32_t kAlignMaxNopSize = 9;
+
+enum AlignUnitType : uint32_t {
+  kAlignUnitLoop = 0,
+  kAlignUnitBranch = 1
+};
+
+//! Location that has to be aligned, either a loop header or a jump, which
+//! could be preceded by an instruction it's fused with.
+struct AlignPass_Unit {
+  //! Unit type, see `AlignUnitType`.
+  uint32_t type;
+  //! Layout index of the first instruction of the unit (or of the loop).
+  uint32_t first;
+  //! Layout index of the jump (or of the backward jump of the loop).
+  uint32_t last;
+  //! Label of the loop header.
+  uint32_t labelId;
+  //! Node that precedes the padding.
+  BaseNode* node;
+};
+
+//! Instruction options that make an instruction longer, see `AlignPass_padByPrefix()`.
+struct AlignPass_Growth {
+  InstNode* node;
+  uint32_t options[4];
+  uint32_t growth[4];
+  uint32_t count;
+};
+
+//! Groups of instructions that are fused with the same conditional jumps.
+enum AlignFuseGroup : uint32_t {
+  kAlignFuseTest = 0x01u,  //!< `test|and`.
+  kAlignFuseCmp = 0x02u,   //!< `cmp|add|sub`.
+  kAlignFuseInc = 0x04u    //!< `inc|dec`.
+};
+
+//! Returns groups of instructions the conditional jump `jcc` is fused with.
+static ASMJIT_INLINE uint32_t AlignPass_fusibleGroups(const InstNode* jcc) noexcept {
+  switch (jcc->id()) {
+    // ZF and SF != OF.
+    case Inst::kIdJe:
+    case Inst::kIdJz:
+    case Inst::kIdJne:
+    case Inst::kIdJnz:
+    case Inst::kIdJl:
+    case Inst::kIdJnge:
+    case Inst::kIdJge:
+    case Inst::kIdJnl:
+    case Inst::kIdJle:
+    case Inst::kIdJng:
+    case Inst::kIdJg:
+    case Inst::kIdJnle:
+      return kAlignFuseTest | kAlignFuseCmp | kAlignFuseInc;
+
+    // CF, which is not modified by `inc|dec`.
+    case Inst::kIdJa:
+    case Inst::kIdJnbe:
+    case Inst::kIdJae:
+    case Inst::kIdJnb:
+    case Inst::kIdJnc:
+    case Inst::kIdJb:
+    case Inst::kIdJnae:
+    case Inst::kIdJc:
+    case Inst::kIdJbe:
+    case Inst::kIdJna:
+      return kAlignFuseTest | kAlignFuseCmp;
+
+    // OF, SF, and PF.
+    case Inst::kIdJo:
+    case Inst::kIdJno:
+    case Inst::kIdJs:
+    case Inst::kIdJns:
+    case Inst::kIdJp:
+    case Inst::kIdJpe:
+    case Inst::kIdJnp:
+    case Inst::kIdJpo:
+      return kAlignFuseTest;
+
+    default:
+      return 0;
+  }
+}
+
+//! Tests whether `node` is fused with the conditional jump `jcc` that follows it.
+static ASMJIT_INLINE bool AlignPass_isFusible(const InstNode* node, const InstNode* jcc) noexcept {
+  uint32_t group;
+  switch (node->id()) {
+    case Inst::kIdTest:
+    case Inst::kIdAnd:
+      group = kAlignFuseTest;
+      break;
+    case Inst::kIdCmp:
+    case Inst::kIdAdd:
+    case Inst::kIdSub:
+      group = kAlignFuseCmp;
+      break;
+    case Inst::kIdInc:
+    case Inst::kIdDec:
+      group = kAlignFuseInc;
+      break;
+    default:
+      return false;
+  }
+
+  if (!(AlignPass_fusibleGroups(jcc) & group))
+    return false;
+
+  // Neither MEM+IMM nor RIP-relative forms are fused.
+  bool hasMem = false;
+  bool hasImm = false;
+
+  for (uint32_t i = 0; i < node->opCount(); i++) {
+    const Operand& op = node->op(i);
+    if (op.isMem()) {
+      const Mem& mem = op.as<Mem>();
+      if (mem.hasBaseLabel() || mem.baseType() == Reg::kTypeRip)
+        return false;
+      hasMem = true;
+    }
+    hasImm |= op.isImm();
+  }
+
+  return !(hasMem && hasImm);
+}
+
+static ASMJIT_INLINE uint32_t AlignPass_controlType(const InstNode* node) noexcept {
+  return Inst::isDefinedId(node->id()) ? InstDB::infoById(node->id()).controlType() : uint32_t(Inst::kControlNone);
+}
+
+//! Returns the number of bytes required to move `offset` to satisfy `unit`
+//! that spans `[offset, offset + size)`.
+static ASMJIT_INLINE uint32_t AlignPass_requiredPadding(uint32_t options, bool fused, uint64_t offset, uint64_t size) noexcept {
+  uint64_t end = offset + size;
+
+  if (options & AlignPass::kOptionJccErratum) {
+    if ((offset >> 5) != ((end - 1) >> 5) || (end & 31u) == 0)
+      return uint32_t(Support::alignUp<uint64_t>(offset, 32) - offset);
+  }
+
+  if (fused && (options & AlignPass::kOptionKeepFusedPairs)) {
+    if ((offset >> 6) != ((end - 1) >> 6))
+      return uint32_t(Support::alignUp<uint64_t>(offset, 64) - offset);
+  }
+
+  return 0;
+}
+
+static Error AlignPass_emitNode(BaseAssembler* a, const InstNode* node, uint32_t options, size_t* sizeOut) noexcept {
+  Operand_ opArray[Globals::kMaxOpCount];
+  uint32_t opCount = node->opCount();
+
+  for (uint32_t i = 0; i < Globals::kMaxOpCount; i++) {
+    if (i < opCount)
+      opArray[i].copyFrom(node->op(i));
+    else
+      opArray[i].reset();
+  }
+
+  size_t start = a->offset();
+  a->setInstOptions(options);
+  a->setExtraReg(node->extraReg());
+  ASMJIT_PROPAGATE(a->_emit(node->id(), opArray[0], opArray[1], opArray[2], opCount > 3 ? opArray + 3 : EmitterUtils::noExt));
+
+  *sizeOut = a->offset() - start;
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::x86::AlignPass - Construction / Destruction]
+// ============================================================================
+
+AlignPass::AlignPass(const CpuInfo& cpuInfo) noexcept
+  : AlignPass(optionsOf(cpuInfo)) {}
+
+AlignPass::AlignPass(uint32_t options) noexcept
+  : Pass("AlignPass"),
+    _options(options),
+    _loopAlignment(32),
+    _maxLoopSize(128),
+    _alignedLoopCount(0),
+    _paddedBranchCount(0),
+    _prefixPaddingSize(0),
+    _nopPaddingSize(0) {}
+
+// ============================================================================
+// [asmjit::x86::AlignPass - Accessors]
+// ============================================================================
+
+uint32_t AlignPass::optionsOf(const CpuInfo& cpuInfo) noexcept {
+  if (!Environment::isFamilyX86(cpuInfo.arch()))
+    return 0;
+
+  uint32_t options = kOptionAlignLoops | kOptionKeepFusedPairs | kOptionPrefixPadding;
+
+  // Skylake, Cascade Lake, Kaby Lake, Coffee Lake, Whiskey Lake, Amber Lake,
+  // and Comet Lake are affected by the JCC erratum.
+  if (cpuInfo.isVendor("GenuineIntel") && cpuInfo.familyId() == 0x06) {
+    switch (cpuInfo.modelId()) {
+      case 0x4E:
+      case 0x55:
+      case 0x5E:
+      case 0x8E:
+      case 0x9E:
+      case 0xA5:
+      case 0xA6:
+        options |= kOptionJccErratum;
+        break;
+    }
+  }
+
+  return options;
+}
+
+Error AlignPass::setLoopAlignment(uint32_t alignment) noexcept {
+  // The padding of a loop header must not exceed `kAlignMaxPadding`.
+  if (!Support::isPowerOf2(alignment) || alignment > kMaxLoopAlignment)
+    return DebugUtils::errored(kErrorInvalidArgument);
+
+  _loopAlignment = alignment;
+  return kErrorOk;
+}
+
+// ============================================================================
+// [asmjit::x86::AlignPass - Run]
+// ============================================================================
+
+//! State of a single run of `AlignPass`.
+class AlignPassContext {
+public:
+  AlignPass* _pass;
+  BaseBuilder* _cb;
+  ZoneAllocator _allocator;
+
+  CodeHolder _layoutCode;
+  Assembler _layoutAssembler;
+
+  ZoneVector<BuilderLayoutEntry> _layout;
+  ZoneVector<AlignPass_Unit> _units;
+
+  //! Option changes and nodes added by the last iteration, which can be reverted.
+  struct OptionChange { InstNode* node; uint32_t options; };
+  ZoneVector<OptionChange> _optionChanges;
+  ZoneVector<BaseNode*> _addedNodes;
+
+  //! Statistics of the last iteration, committed once its layout is verified.
+  uint32_t _pendingLoops = 0;
+  uint32_t _pendingBranches = 0;
+  uint32_t _pendingPrefixSize = 0;
+  uint32_t _pendingNopSize = 0;
+
+  //! NOP forms indexed by their size (first operand is the memory operand or none).
+  Operand_ _nopOperand[kAlignMaxNopSize + 1];
+  bool _nopAvailable[kAlignMaxNopSize + 1];
+
+  AlignPassContext(AlignPass* pass, Zone* zone) noexcept
+    : _pass(pass),
+      _cb(pass->_cb),
+      _allocator(zone) {}
+
+  Error init() noexcept;
+  Error collect() noexcept;
+  Error layout() noexcept;
+
+  void commit() noexcept;
+  void revert() noexcept;
+
+  Error padByPrefix(BaseNode* ref, uint32_t padding, bool* padded) noexcept;
+  Error padByNops(BaseNode* ref, uint32_t padding) noexcept;
+  Error padByAlign(BaseNode* ref, uint32_t alignment) noexcept;
+
+  Error run() noexcept;
+};
+
+Error AlignPassContext::init() noexcept {
+  // NOP forms are verified by the assembler, so only forms that have the
+  // expected size are used.
+  bool is64Bit = _cb->environment().is64Bit();
+  Gp base = is64Bit ? Gp(rax) : Gp(eax);
+
+  Mem nopMem[] = {
+    dword_ptr(base),                // 0F 1F 00
+    dword_ptr(base, 1),             // 0F 1F 40 01
+    dword_ptr(base, base, 0, 1),    // 0F 1F 44 00 01
+    word_ptr(base, base, 0, 1),     // 66 0F 1F 44 00 01
+    dword_ptr(base, 256),           // 0F 1F 80 00 01 00 00
+    dword_ptr(base, base, 0, 256),  // 0F 1F 84 00 00 01 00 00
+    word_ptr(base, base, 0, 256)    // 66 0F 1F 84 00 00 01 00 00
+  };
+
+  for (uint32_t i = 0; i <= kAlignMaxNopSize; i++)
+    _nopAvailable[i] = false;
+
+  _nopAvailable[1] = true;
+  _nopOperand[1].reset();
+
+  ASMJIT_PROPAGATE(_layoutCode.init(_cb->environment()));
+  ASMJIT_PROPAGATE(_layoutCode.attach(&_layoutAssembler));
+
+  for (const Mem& mem : nopMem) {
+    size_t start = _layoutAssembler.offset();
+    if (_layoutAssembler.nop(mem) != kErrorOk)
+      continue;
+
+    size_t size = _layoutAssembler.offset() - start;
+    if (size <= kAlignMaxNopSize && !_nopAvailable[size]) {
+      _nopAvailable[size] = true;
+      _nopOperand[size] = mem;
+    }
+  }
+
+  _layoutCode.reset();
+  return kErrorOk;
+}
+
+Error AlignPassContext::collect() noexcept {
+  BaseBuilder* cb = _cb;
+  ZoneAllocator* allocator = &_allocator;
+  BuilderLayoutEntry entry;
+
+  // Assign positions, which are layout indexes of instructions. Other nodes
+  // get the index of the instruction that follows them.
+  uint32_t index = 0;
+  for (BaseNode* node = cb->firstNode(); node; node = node->next()) {
+    node->setPosition(index);
+    if (node->isInst()) {
+      entry.reset(node);
+      ASMJIT_PROPAGATE(_layout.append(allocator, entry));
+      index++;
+    }
+  }
+
+  const ZoneVector<LabelNode*>& labelNodes = cb->labelNodes();
+  BaseNode* prevInst = nullptr;
+
+  for (BaseNode* node_ = cb->firstNode(); node_; node_ = node_->next()) {
+    if (!node_->isInst()) {
+      if (!node_->isComment())
+        prevInst = nullptr;
+      continue;
+    }
+
+    InstNode* node = node_->as<InstNode>();
+    uint32_t controlType = AlignPass_controlType(node);
+
+    if (controlType != Inst::kControlNone) {
+      uint32_t i = node->position();
+      AlignPass_Unit unit { kAlignUnitBranch, i, i, Globals::kInvalidId, node };
+
+      if (controlType == Inst::kControlBranch && prevInst && AlignPass_isFusible(prevInst->as<InstNode>(), node)) {
+        unit.first = i - 1;
+        unit.node = prevInst;
+      }
+      if (_pass->hasOption(AlignPass::kOptionJccErratum) || (unit.first != unit.last && _pass->hasOption(AlignPass::kOptionKeepFusedPairs)))
+        ASMJIT_PROPAGATE(_units.append(allocator, unit));
+
+      // A jump to a label that precedes it closes a loop.
+      if (node->opCount() && node->op(0).isLabel()) {
+        uint32_t labelId = node->op(0).id();
+        LabelNode* labelNode = labelId < labelNodes.size() ? labelNodes[labelId] : nullptr;
+
+        if (labelNode && labelNode->position() <= i && _pass->hasOption(AlignPass::kOptionAlignLoops)) {
+          AlignPass_Unit loop { kAlignUnitLoop, labelNode->position(), i, labelId, labelNode };
+          ASMJIT_PROPAGATE(_units.append(allocator, loop));
+        }
+      }
+    }
+
+    prevInst = node;
+  }
+
+  // Units are processed in layout order, a loop header precedes the first
+  // instruction of the loop.
+  Support::qSort(_units.data(), _units.size(), [](const AlignPass_Unit& a, const AlignPass_Unit& b) noexcept {
+    if (a.first != b.first) return a.first < b.first ? -1 : 1;
+    if (a.type != b.type) return a.type < b.type ? -1 : 1;
+    return a.last < b.last ? -1 : a.last > b.last ? 1 : 0;
+  });
+
+  return kErrorOk;
+}
+
+Error AlignPassContext::layout() noexcept {
+  ASMJIT_PROPAGATE(_cb->layoutTo(&_layoutCode, &_layoutAssembler, _layout.data(), _layout.size()));
+
+  // The layout doesn't fail if a short branch is out of range, it's marked.
+  for (const BuilderLayoutEntry& entry : _layout)
+    if (entry.hasFlag(BuilderLayoutEntry::kFlagShortFormOutOfRange))
+      return DebugUtils::errored(kErrorInvalidDisplacement);
+
+  return kErrorOk;
+}
+
+void AlignPassContext::commit() noexcept {
+  _pass->_alignedLoopCount += _pendingLoops;
+  _pass->_paddedBranchCount += _pendingBranches;
+  _pass->_prefixPaddingSize += _pendingPrefixSize;
+  _pass->_nopPaddingSize += _pendingNopSize;
+
+  _pendingLoops = 0;
+  _pendingBranches = 0;
+  _pendingPrefixSize = 0;
+  _pendingNopSize = 0;
+
+  _optionChanges.reset();
+  _addedNodes.reset();
+}
+
+void AlignPassContext::revert() noexcept {
+  for (const OptionChange& change : _optionChanges)
+    change.node->setInstOptions(change.options);
+
+  for (BaseNode* node : _addedNodes)
+    _cb->removeNode(node);
+
+  _pendingLoops = 0;
+  _pendingBranches = 0;
+  _pendingPrefixSize = 0;
+  _pendingNopSize = 0;
+
+  _optionChanges.reset();
+  _addedNodes.reset();
+}
+
+//! Pads by making instructions that precede `ref` longer. The sizes are
+//! measured by the layout assembler, so only valid encodings are used.
+Error AlignPassContext::padByPrefix(BaseNode* ref, uint32_t padding, bool* padded) noexcept {
+  *padded = false;
+  if (padding > kAlignMaxPadding)
+    return kErrorOk;
+
+  bool is64Bit = _cb->environment().is64Bit();
+  AlignPass_Growth items[kAlignMaxPaddedInsts];
+  uint32_t itemCount = 0;
+
+  for (BaseNode* node_ = ref->prev(); node_ && itemCount < kAlignMaxPaddedInsts; node_ = node_->prev()) {
+    if (node_->isComment())
+      continue;
+
+    if (!node_->isInst())
+      break;
+
+    InstNode* node = node_->as<InstNode>();
+    if (AlignPass_controlType(node) != Inst::kControlNone || !Inst::isDefinedId(node->id()))
+      break;
+
+    uint32_t baseOptions = node->instOptions();
+    size_t baseSize;
+    if (AlignPass_emitNode(&_layoutAssembler, node, baseOptions, &baseSize) != kErrorOk)
+      break;
+
+    const InstDB::InstInfo& instInfo = InstDB::infoById(node->id());
+    uint32_t candidates[3];
+    uint32_t candidateCount = 0;
+
+    candidates[candidateCount++] = Inst::kOptionLongForm;
+    if (instInfo.isVex())
+      candidates[candidateCount++] = Inst::kOptionVex3;
+    else if (is64Bit && !instInfo.isEvex())
+      candidates[candidateCount++] = Inst::kOptionRex;
+
+    AlignPass_Growth& item = items[itemCount];
+    item.node = node;
+    item.count = 0;
+
+    for (uint32_t i = 0; i < candidateCount; i++) {
+      for (uint32_t j = i; j < candidateCount; j++) {
+        uint32_t options = baseOptions | candidates[i] | candidates[j];
+        size_t size;
+
+        if (options == baseOptions || AlignPass_emitNode(&_layoutAssembler, node, options, &size) != kErrorOk || size <= baseSize)
+          continue;
+
+        uint32_t growth = uint32_t(size - baseSize);
+        bool duplicate = false;
+
+        for (uint32_t k = 0; k < item.count; k++)
+          duplicate |= item.growth[k] == growth;
+
+        if (!duplicate && growth <= padding) {
+          item.options[item.count] = options;
+          item.growth[item.count] = growth;
+          item.count++;
+        }
+      }
+    }
+
+    if (item.count)
+      itemCount++;
+  }
+
+  if (!itemCount)
+    return kErrorOk;
+
+  // Find a combination of growths that matches `padding` exactly, `choice`
+  // stores the option index + 1 of each item (or zero if not used) that
+  // first reached the sum.
+  uint8_t reachedBy[kAlignMaxPaddedInsts + 1][kAlignMaxPadding + 1];
+  memset(reachedBy, 0, sizeof(reachedBy));
+  reachedBy[0][0] = 1;
+
+  for (uint32_t i = 0; i < itemCount; i++) {
+    for (uint32_t sum = 0; sum <= padding; sum++) {
+      if (!reachedBy[i][sum])
+        continue;
+
+      if (!reachedBy[i + 1][sum])
+        reachedBy[i + 1][sum] = 1;
+
+      for (uint32_t k = 0; k < items[i].count; k++) {
+        uint32_t next = sum + items[i].growth[k];
+        if (next <= padding && !reachedBy[i + 1][next])
+          reachedBy[i + 1][next] = uint8_t(k + 2);
+      }
+    }
+  }
+
+  if (!reachedBy[itemCount][padding])
+    return kErrorOk;
+
+  uint32_t sum = padding;
+  for (uint32_t i = itemCount; i > 0; i--) {
+    uint32_t choice = reachedBy[i][sum];
+    if (choice < 2)
+      continue;
+
+    const AlignPass_Growth& item = items[i - 1];
+    ASMJIT_PROPAGATE(_optionChanges.append(&_allocator, OptionChange { item.node, item.node->instOptions() }));
+
+    item.node->setInstOptions(item.options[choice - 2]);
+    sum -= item.growth[choice - 2];
+  }
+
+  ASMJIT_ASSERT(sum == 0);
+  _pendingPrefixSize += padding;
+  *padded = true;
+  return kErrorOk;
+}
+
+Error AlignPassContext::padByNops(BaseNode* ref, uint32_t padding) noexcept {
+  uint32_t remaining = padding;
+
+  while (remaining) {
+    uint32_t size = Support::min(remaining, kAlignMaxNopSize);
+    while (!_nopAvailable[size])
+      size--;
+
+    InstNode* node;
+    ASMJIT_PROPAGATE(_cb->_newInstNode(&node, Inst::kIdNop, 0, size == 1 ? 0 : 1));
+    uint32_t opCount = node->opCount();
+    if (opCount)
+      node->setOp(0, _nopOperand[size]);
+    node->resetOpRange(opCount, node->opCapacity());
+
+    _cb->addBefore(node, ref);
+    ASMJIT_PROPAGATE(_addedNodes.append(&_allocator, node));
+    remaining -= size;
+  }
+
+  _pendingNopSize += padding;
+  return kErrorOk;
+}
+
+Error AlignPassContext::padByAlign(BaseNode* ref, uint32_t alignment) noexcept {
+  AlignNode* node;
+  ASMJIT_PROPAGATE(_cb->_newAlignNode(&node, kAlignCode, alignment));
+
+  _cb->addBefore(node, ref);
+  return _addedNodes.append(&_allocator, node);
+}
+
+Error AlignPassContext::run() noexcept {
+  AlignPass* pass = _pass;
+  uint32_t options = pass->options();
+  uint32_t loopAlignment = pass->loopAlignment();
+
+  if (_units.empty())
+    return kErrorOk;
+
+  for (uint32_t iteration = 0; ; iteration++) {
+    Error err = layout();
+    if (err) {
+      // The first layout reports errors of the code itself, otherwise the
+      // last padding made a relaxed branch out of range.
+      if (iteration == 0)
+        return err;
+
+      revert();
+      break;
+    }
+
+    commit();
+    if (iteration == kAlignMaxIterations)
+      break;
+
+    // Units are padded in order, the offset of each one is adjusted by the
+    // padding that was added before it in the same section.
+    bool changed = false;
+    uint64_t shift = 0;
+    uint32_t sectionId = Globals::kInvalidId;
+
+    for (const AlignPass_Unit& unit : _units) {
+      const BuilderLayoutEntry& first = _layout[unit.first];
+      const BuilderLayoutEntry& last = _layout[unit.last];
+
+      if (last.sectionId != sectionId) {
+        sectionId = last.sectionId;
+        shift = 0;
+      }
+
+      if (unit.type == kAlignUnitLoop) {
+        LabelEntry* le = _layoutCode.labelEntry(unit.labelId);
+        if (!le || !le->isBound() || le->section()->id() != sectionId || last.end - le->offset() > pass->maxLoopSize())
+          continue;
+
+        uint64_t header = le->offset() + shift;
+        uint32_t padding = uint32_t(Support::alignUp<uint64_t>(header, loopAlignment) - header);
+        if (!padding)
+          continue;
+
+        // Loops that share the header are aligned once.
+        BaseNode* prev = unit.node->prev();
+        if (prev && prev->isAlign() && prev->as<AlignNode>()->alignment() >= loopAlignment)
+          continue;
+
+        bool padded = false;
+        if (options & AlignPass::kOptionPrefixPadding)
+          ASMJIT_PROPAGATE(padByPrefix(unit.node, padding, &padded));
+
+        if (!padded)
+          ASMJIT_PROPAGATE(padByAlign(unit.node, loopAlignment));
+
+        _pendingLoops++;
+        shift += padding;
+        changed = true;
+      }
+      else {
+        uint32_t padding = AlignPass_requiredPadding(options, unit.first != unit.last, first.start + shift, last.end - first.start);
+        if (!padding || padding > kAlignMaxPadding)
+          continue;
+
+        bool padded = false;
+        if (options & AlignPass::kOptionPrefixPadding)
+          ASMJIT_PROPAGATE(padByPrefix(unit.node, padding, &padded));
+
+        if (!padded)
+          ASMJIT_PROPAGATE(padByNops(unit.node, padding));
+
+        _pendingBranches++;
+        shift += padding;
+        changed = true;
+      }
+    }
+
+    if (!changed)
+      break;
+  }
+
+  return kErrorOk;
+}
+
+Error AlignPass::run(Zone* zone, Logger* logger) {
+  DebugUtils::unused(logger);
+
+  _alignedLoopCount = 0;
+  _paddedBranchCount = 0;
+  _prefixPaddingSize = 0;
+  _nopPaddingSize = 0;
+
+  BaseBuilder* cb = _cb;
+  if (!_options || !Environment::isFamilyX86(cb->arch()))
+    return kErrorOk;
+
+  // Padding is decided per instruction, so the compact storage is expanded.
+  ASMJIT_PROPAGATE(cb->expandInstBlocks(cb->firstNode()));
+
+  if (cb->hasEncodingOption(BaseEmitter::kEncodingOptionRelaxBranches)) {
+    Assembler layoutAssembler;
+    ASMJIT_PROPAGATE(cb->relaxBranches(&layoutAssembler));
+  }
+
+  AlignPassContext ctx(this, zone);
+  ASMJIT_PROPAGATE(ctx.init());
+  ASMJIT_PROPAGATE(ctx.collect());
+  return ctx.run();
+}
+
+// ============================================================================
+// [asmjit::x86::AlignPass - Unit]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+// Code is only executed if the host can run it.
+#if ASMJIT_ARCH_X86 && !defined(ASMJIT_NO_JIT)
+  #define ASMJIT_X86_ALIGNPASS_TEST_JIT
+#endif
+
+static Environment AlignPass_testEnvironment() noexcept {
+#if ASMJIT_ARCH_X86
+  return hostEnvironment();
+#else
+  return Environment(Environment::kArchX64);
+#endif
+}
+
+// Emits a loop preceded by `fillerCount` instructions of different sizes, so
+// each call lays out the code differently, and returns the expected result.
+static int AlignPass_makeLoop(Builder& cb, uint32_t fillerCount, Label* loopLabel) noexcept {
+  Label L_loop = cb.newLabel();
+  Label L_skip = cb.newLabel();
+
+  cb.xor_(eax, eax);
+  cb.xor_(edx, edx);
+  for (uint32_t i = 0; i < fillerCount; i++) {
+    if (i % 3 == 2) {
+      Label L_next = cb.newLabel();
+      cb.test(edx, edx);
+      cb.jz(L_next);
+      cb.bind(L_next);
+    }
+
+    if (i & 1)
+      cb.add(edx, 1);
+    else
+      cb.lea(edx, ptr(edx, 1));
+  }
+
+  cb.mov(ecx, 100);
+  cb.bind(L_loop);
+  cb.add(eax, ecx);
+  cb.cmp(ecx, 50);
+  cb.jne(L_skip);
+  cb.add(eax, 1000);
+  cb.bind(L_skip);
+  cb.dec(ecx);
+  cb.jnz(L_loop);
+  cb.add(eax, edx);
+  cb.ret();
+
+  *loopLabel = L_loop;
+  return 5050 + 1000 + int(fillerCount);
+}
+
+// Tests whether jumps and fused pairs emitted by `AlignPass_makeLoop()` neither
+// cross nor end at a 32-byte boundary.
+static bool AlignPass_checkBranches(Builder& cb) noexcept {
+  BuilderLayoutEntry entries[128];
+  size_t count = 0;
+
+  for (BaseNode* node = cb.firstNode(); node; node = node->next())
+    if (node->isInst() && count < 128)
+      entries[count++].reset(node);
+
+  CodeHolder layoutCode;
+  Assembler layoutAssembler;
+  if (cb.layoutTo(&layoutCode, &layoutAssembler, entries, count) != kErrorOk)
+    return false;
+
+  for (size_t i = 0; i < count; i++) {
+    uint32_t instId = entries[i].node->as<InstNode>()->id();
+    if (instId != Inst::kIdJz && instId != Inst::kIdJne && instId != Inst::kIdJnz && instId != Inst::kIdRet)
+      continue;
+
+    // All conditional jumps are fused with the preceding `test`, `cmp`, or `dec`.
+    size_t start = instId == Inst::kIdRet ? entries[i].start : entries[i - 1].start;
+    size_t end = entries[i].end;
+
+    if ((start >> 5) != ((end - 1) >> 5) || (end & 31u) == 0)
+      return false;
+  }
+
+  return true;
+}
+
+// Places `inst + jcc` at offset 63 and returns the number of pairs padded by
+// the pass, which only keeps fused pairs together.
+static uint32_t AlignPass_padSplitPair(uint32_t instId, uint32_t jccId) noexcept {
+  CodeHolder code;
+  code.init(Environment(Environment::kArchX64));
+
+  Builder cb(&code);
+  AlignPass* pass = cb.newPassT<AlignPass>(uint32_t(AlignPass::kOptionKeepFusedPairs));
+  cb.addPass(pass);
+
+  Label L_end = cb.newLabel();
+  for (uint32_t i = 0; i < 63; i++)
+    cb.nop();
+
+  if (instId == Inst::kIdInc || instId == Inst::kIdDec)
+    cb.emit(instId, ecx);
+  else
+    cb.emit(instId, ecx, 1);
+  cb.emit(jccId, L_end);
+  cb.bind(L_end);
+  cb.ret();
+
+  EXPECT(cb.finalize() == kErrorOk);
+  return pass->paddedBranchCount();
+}
+
+UNIT(x86_align_pass) {
+  constexpr uint32_t kAllOptions = AlignPass::kOptionAlignLoops |
+                                   AlignPass::kOptionKeepFusedPairs |
+                                   AlignPass::kOptionJccErratum;
+
+#if defined(ASMJIT_X86_ALIGNPASS_TEST_JIT)
+  typedef int (*Func)(void);
+  JitRuntime rt;
+#endif
+
+  INFO("x86::AlignPass - loops and branches");
+  {
+    uint32_t paddingSize[2] {};
+
+    for (uint32_t prefixPadding = 0; prefixPadding < 2; prefixPadding++) {
+      for (uint32_t fillerCount = 0; fillerCount < 32; fillerCount++) {
+        CodeHolder code;
+        code.init(AlignPass_testEnvironment());
+
+        Builder cb(&code);
+        AlignPass* pass = cb.newPassT<AlignPass>(kAllOptions | (prefixPadding ? uint32_t(AlignPass::kOptionPrefixPadding) : 0u));
+        cb.addPass(pass);
+
+        Label L_loop;
+        int expected = AlignPass_makeLoop(cb, fillerCount, &L_loop);
+
+        // The same as `finalize()`, but the layout is checked before serialization.
+        EXPECT(cb.runPasses() == kErrorOk);
+        EXPECT(AlignPass_checkBranches(cb), "A jump crosses a 32-byte boundary (filler=%u)", fillerCount);
+
+        Assembler a(&code);
+        EXPECT(cb.serializeTo(&a) == kErrorOk);
+        EXPECT(code.labelOffset(L_loop) % 32 == 0, "Loop header is not aligned (filler=%u)", fillerCount);
+
+        paddingSize[prefixPadding] += pass->prefixPaddingSize() + pass->nopPaddingSize();
+
+#if defined(ASMJIT_X86_ALIGNPASS_TEST_JIT)
+        Func fn;
+        EXPECT(rt.add(&fn, &code) == kErrorOk);
+
+        int result = fn();
+        EXPECT(result == expected, "Function (filler=%u) returned %d, expected %d", fillerCount, result, expected);
+        rt.release(fn);
+#else
+        DebugUtils::unused(expected);
+#endif
+      }
+    }
+
+    INFO("  Padding: %u bytes (NOPs), %u bytes (with longer encodings)", paddingSize[0], paddingSize[1]);
+  }
+
+  INFO("x86::AlignPass - setLoopAlignment()");
+  {
+    AlignPass pass(kAllOptions);
+    EXPECT(pass.setLoopAlignment(128) == kErrorInvalidArgument);
+    EXPECT(pass.setLoopAlignment(48) == kErrorInvalidArgument);
+    EXPECT(pass.setLoopAlignment(0) == kErrorInvalidArgument);
+    EXPECT(pass.loopAlignment() == 32);
+
+    for (uint32_t fillerCount = 0; fillerCount < 8; fillerCount++) {
+      CodeHolder code;
+      code.init(AlignPass_testEnvironment());
+
+      Builder cb(&code);
+      AlignPass* p = cb.newPassT<AlignPass>(uint32_t(AlignPass::kOptionAlignLoops | AlignPass::kOptionPrefixPadding));
+      EXPECT(p->setLoopAlignment(AlignPass::kMaxLoopAlignment) == kErrorOk);
+      cb.addPass(p);
+
+      Label L_loop;
+      AlignPass_makeLoop(cb, fillerCount, &L_loop);
+      EXPECT(cb.finalize() == kErrorOk);
+      EXPECT(code.labelOffset(L_loop) % AlignPass::kMaxLoopAlignment == 0, "Loop header is not aligned (filler=%u)", fillerCount);
+    }
+  }
+
+  INFO("x86::AlignPass - only fused pairs are kept together");
+  {
+    EXPECT(AlignPass_padSplitPair(Inst::kIdCmp, Inst::kIdJb) == 1);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdCmp, Inst::kIdJl) == 1);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdCmp, Inst::kIdJs) == 0);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdCmp, Inst::kIdJo) == 0);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdAdd, Inst::kIdJp) == 0);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdTest, Inst::kIdJs) == 1);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdAnd, Inst::kIdJo) == 1);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdDec, Inst::kIdJnz) == 1);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdDec, Inst::kIdJg) == 1);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdInc, Inst::kIdJb) == 0);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdInc, Inst::kIdJbe) == 0);
+    EXPECT(AlignPass_padSplitPair(Inst::kIdInc, Inst::kIdJns) == 0);
+  }
+
+  INFO("x86::AlignPass - relaxed branches with an alignment between a branch and its target");
+  {
+    CodeHolder code;
+    code.init(Environment(Environment::kArchX64));
+
+    Builder cb(&code);
+    cb.addEncodingOptions(BaseEmitter::kEncodingOptionRelaxBranches);
+    cb.addPassT<AlignPass>(kAllOptions);
+
+    Label L1 = cb.newLabel();
+    Label L2 = cb.newLabel();
+
+    cb.jmp(L2);
+    cb.bind(L2);
+    cb.jmp(L1);
+    for (uint32_t i = 0; i < 125; i++)
+      cb.db(0x90);
+    cb.align(kAlignCode, 4);
+    cb.bind(L1);
+    cb.ret();
+
+    EXPECT(cb.finalize() == kErrorOk);
+  }
+
+  INFO("x86::AlignPass - padding that would make a relaxed branch out of range is not applied");
+  {
+    for (uint32_t nopCount = 80; nopCount <= 128; nopCount++) {
+      CodeHolder code;
+      code.init(Environment(Environment::kArchX64));
+
+      Builder cb(&code);
+      cb.addEncodingOptions(BaseEmitter::kEncodingOptionRelaxBranches);
+      cb.addPassT<AlignPass>(uint32_t(AlignPass::kOptionAlignLoops));
+
+      Label L_loop = cb.newLabel();
+      Label L_end = cb.newLabel();
+
+      cb.jmp(L_end);
+      for (uint32_t i = 0; i < nopCount; i++)
+        cb.db(0x90);
+      cb.mov(ecx, 10);
+      cb.bind(L_loop);
+      cb.dec(ecx);
+      cb.jnz(L_loop);
+      cb.bind(L_end);
+      cb.ret();
+
+      EXPECT(cb.finalize() == kErrorOk, "Failed to finalize with %u NOPs", nopCount);
+    }
+  }
+}
+#endif
+
+ASMJIT_END_SUB_NAMESPACE
+
+#endif // ASMJIT_BUILD_X86 && !ASMJIT_NO_BUILDER
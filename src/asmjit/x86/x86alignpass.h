@@ -0,0 +1,174 @@
+// AsmJit - Machine code generation for C++
+//
+//  * Official AsmJit Home Page: https://asmjit.com
+//  * Official Github Repository: https://github.com/asmjit/asmjit
+//
+// Copyright (c) 2008-2020 The AsmJit Authors
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef ASMJIT_X86_X86ALIGNPASS_H_INCLUDED
+#define ASMJIT_X86_X86ALIGNPASS_H_INCLUDED
+
+#include "../core/api-config.h"
+#ifndef ASMJIT_NO_BUILDER
+
+#include "../core/builder.h"
+#include "../core/cpuinfo.h"
+
+ASMJIT_BEGIN_SUB_NAMESPACE(x86)
+
+//! \addtogroup asmjit_x86
+//! \{
+
+// ============================================================================
+// [asmjit::x86::AlignPass]
+// ============================================================================
+
+//! Code alignment pass that is aware of the decoder of the target CPU.
+//!
+//! The pass lays out the code (see \ref BaseBuilder::layoutTo()) and pads it
+//! so that:
+//!
+//!   - Headers of small loops are aligned to \ref loopAlignment().
+//!   - Macro-fusible `cmp|test|add|sub|and|inc|dec + jcc` pairs don't cross
+//!     a 64-byte boundary (a split pair is not fused). Only pairs that the CPU
+//!     fuses are considered, `inc|dec` are not fused with jumps that test CF,
+//!     and `cmp|add|sub|inc|dec` with jumps that test OF, SF, or PF.
+//!   - Jumps and fused pairs don't cross or end at a 32-byte boundary, which
+//!     works around the JCC erratum of Skylake-derived Intel CPUs, where such
+//!     instructions cannot be cached by the decoded ICache.
+//!
+//! If possible, the padding is done by using longer encodings of instructions
+//! that precede the padded location (a REX prefix, a 3-byte VEX prefix, or a
+//! 32-bit immediate instead of an 8-bit one) so no NOPs are executed. Headers
+//! of loops that cannot be padded this way get an \ref AlignNode and other
+//! locations get multi-byte NOPs.
+//!
+//! The pass should be added as the last pass, after the code doesn't change
+//! anymore:
+//!
+//! ```
+//! using namespace asmjit;
+//!
+//! x86::Compiler cc(&code);
+//! cc.addPassT<x86::AlignPass>(CpuInfo::host());
+//! ```
+//!
+//! \note If \ref BaseEmitter::kEncodingOptionRelaxBranches is set, the pass
+//! relaxes branches before the alignment. The padding is never applied if it
+//! would make a relaxed branch out of range.
+class ASMJIT_VIRTAPI AlignPass : public Pass {
+public:
+  ASMJIT_NONCOPYABLE(AlignPass)
+  typedef Pass Base;
+
+  //! Alignment options.
+  enum Options : uint32_t {
+    //! Align headers of loops that are not larger than \ref maxLoopSize().
+    kOptionAlignLoops = 0x00000001u,
+    //! Don't split macro-fusible pairs across 64-byte boundaries.
+    kOptionKeepFusedPairs = 0x00000002u,
+    //! Don't let jumps and fused pairs cross or end at 32-byte boundaries.
+    kOptionJccErratum = 0x00000004u,
+    //! Prefer longer encodings of preceding instructions over NOPs.
+    kOptionPrefixPadding = 0x00000008u
+  };
+
+  //! Alignment limits.
+  enum Limits : uint32_t {
+    //! Maximum alignment of loop headers.
+    kMaxLoopAlignment = 64
+  };
+
+  //! Alignment options, see \ref Options.
+  uint32_t _options;
+  //! Alignment of loop headers.
+  uint32_t _loopAlignment;
+  //! Maximum size of a loop [in bytes] to align its header.
+  uint32_t _maxLoopSize;
+
+  //! Number of aligned loop headers.
+  uint32_t _alignedLoopCount;
+  //! Number of padded jumps and fused pairs.
+  uint32_t _paddedBranchCount;
+  //! Number of padding bytes added by longer encodings.
+  uint32_t _prefixPaddingSize;
+  //! Number of padding bytes added by NOPs (excluding \ref AlignNode).
+  uint32_t _nopPaddingSize;
+
+  //! \name Construction & Destruction
+  //! \{
+
+  //! Creates the pass with options suitable for the given CPU.
+  ASMJIT_API explicit AlignPass(const CpuInfo& cpuInfo) noexcept;
+  //! Creates the pass with explicit `options`, see \ref Options.
+  ASMJIT_API explicit AlignPass(uint32_t options) noexcept;
+
+  //! \}
+
+  //! \name Accessors
+  //! \{
+
+  //! Returns alignment options, see \ref Options.
+  inline uint32_t options() const noexcept { return _options; }
+  //! Tests whether the given alignment `option` is enabled.
+  inline bool hasOption(uint32_t option) const noexcept { return (_options & option) != 0; }
+
+  //! Returns the alignment of loop headers (32 by default).
+  inline uint32_t loopAlignment() const noexcept { return _loopAlignment; }
+  //! Sets the alignment of loop headers, must be a power of 2 not greater than
+  //! \ref kMaxLoopAlignment, otherwise \ref kErrorInvalidArgument is returned
+  //! and the alignment is not changed.
+  ASMJIT_API Error setLoopAlignment(uint32_t alignment) noexcept;
+
+  //! Returns the maximum size of a loop to have its header aligned (128 by default).
+  inline uint32_t maxLoopSize() const noexcept { return _maxLoopSize; }
+  //! Sets the maximum size of a loop to have its header aligned.
+  inline void setMaxLoopSize(uint32_t size) noexcept { _maxLoopSize = size; }
+
+  //! Returns the number of loop headers aligned by the last run.
+  inline uint32_t alignedLoopCount() const noexcept { return _alignedLoopCount; }
+  //! Returns the number of jumps and fused pairs padded by the last run.
+  inline uint32_t paddedBranchCount() const noexcept { return _paddedBranchCount; }
+  //! Returns the number of bytes padded by longer encodings by the last run.
+  inline uint32_t prefixPaddingSize() const noexcept { return _prefixPaddingSize; }
+  //! Returns the number of bytes padded by NOPs by the last run.
+  inline uint32_t nopPaddingSize() const noexcept { return _nopPaddingSize; }
+
+  //! Returns options suitable for the given CPU.
+  //!
+  //! Loops are aligned and fused pairs kept together on all CPUs, the JCC
+  //! erratum workaround is only enabled on the affected Intel CPUs.
+  static ASMJIT_API uint32_t optionsOf(const CpuInfo& cpuInfo) noexcept;
+
+  //! \}
+
+  //! \name Pass Interface
+  //! \{
+
+  ASMJIT_API Error run(Zone* zone, Logger* logger) override;
+
+  //! \}
+};
+
+//! \}
+
+ASMJIT_END_SUB_NAMESPACE
+
+#endif // !ASMJIT_NO_BUILDER
+#endif // ASMJIT_X86_X86ALIGNPASS_H_INCLUDED
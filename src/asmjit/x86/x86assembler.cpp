@@ -322,6 +322,71 @@ static ASMJIT_INLINE bool x86IsJmpOrCall(uint32_t instId) noexcept {
   return instId == Inst::kIdJmp || instId == Inst::kIdCall;
 }
 
+//! Tests whether sources of a VEX instruction (that uses 0F opcode map) can be
+//! swapped without changing its result.
+static ASMJIT_INLINE bool x86IsCommutativeVex(uint32_t instId) noexcept {
+  switch (instId) {
+    case Inst::kIdVandpd:
+    case Inst::kIdVandps:
+    case Inst::kIdVorpd:
+    case Inst::kIdVorps:
+    case Inst::kIdVxorpd:
+    case Inst::kIdVxorps:
+    case Inst::kIdVpand:
+    case Inst::kIdVpor:
+    case Inst::kIdVpxor:
+    case Inst::kIdVpaddb:
+    case Inst::kIdVpaddw:
+    case Inst::kIdVpaddd:
+    case Inst::kIdVpaddq:
+    case Inst::kIdVpaddsb:
+    case Inst::kIdVpaddsw:
+    case Inst::kIdVpaddusb:
+    case Inst::kIdVpaddusw:
+    case Inst::kIdVpavgb:
+    case Inst::kIdVpavgw:
+    case Inst::kIdVpcmpeqb:
+    case Inst::kIdVpcmpeqw:
+    case Inst::kIdVpcmpeqd:
+    case Inst::kIdVpmaddwd:
+    case Inst::kIdVpmaxsw:
+    case Inst::kIdVpmaxub:
+    case Inst::kIdVpminsw:
+    case Inst::kIdVpminub:
+    case Inst::kIdVpmulhuw:
+    case Inst::kIdVpmulhw:
+    case Inst::kIdVpmullw:
+    case Inst::kIdVpmuludq:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+//! Tests whether `add|sub r|m, 128` can be encoded as `sub|add r|m, -128`, which
+//! uses an 8-bit immediate, but sets a different carry.
+static ASMJIT_INLINE bool x86CanNegateArithImm(uint32_t instId, uint32_t options, uint32_t encodingOptions) noexcept {
+  const uint32_t kRequiredOptions = BaseEmitter::kEncodingOptionOptimizeForSize | BaseEmitter::kEncodingOptionIgnoreFlags;
+  return (instId == Inst::kIdAdd || instId == Inst::kIdSub) &&
+         (encodingOptions & kRequiredOptions) == kRequiredOptions &&
+         !(options & Inst::kOptionLongForm);
+}
+
+//! Tests whether `test r|m, imm` can be narrowed to `test r8|m8, imm8`.
+static ASMJIT_INLINE bool x86CanNarrowTestImm(int64_t immValue, uint32_t options, uint32_t encodingOptions) noexcept {
+  return Support::isBetween<int64_t>(immValue, 0, 127) &&
+         (encodingOptions & BaseEmitter::kEncodingOptionOptimizeForSize) != 0 &&
+         !(options & Inst::kOptionLongForm);
+}
+
+//! Swaps `add` (/0) and `sub` (/5) and negates the immediate (which must be 128).
+static ASMJIT_INLINE void x86NegateArithImm(uint32_t& opReg, int64_t& immValue, FastUInt8& immSize) noexcept {
+  opReg ^= 0x5;
+  immValue = -128;
+  immSize = 1;
+}
+
 static ASMJIT_INLINE bool x86IsImplicitMem(const Operand_& op, uint32_t base) noexcept {
   return op.isMem() && op.as<Mem>().baseId() == base && !op.as<Mem>().hasOffset();
 }
@@ -544,6 +609,362 @@ Assembler::Assembler(CodeHolder* code) noexcept : BaseAssembler() {
 }
 Assembler::~Assembler() noexcept {}
 
+// ============================================================================
+// [asmjit::x86::Assembler - Emit (Fast Path)]
+// ============================================================================
+
+// The most common forms of some instructions are encoded by `x86EmitFast()`,
+// which uses precomputed opcodes and doesn't go through the generic encoder.
+// The fast path is only used if there are no instruction options, no extra
+// register, and no logging or validation, its output must be identical to
+// the output of the generic encoder.
+enum X86FastForm : uint32_t {
+  kX86FastNone    = 0, //!< Not handled by the fast path.
+  kX86FastGpArith = 1, //!< `op r, r|m` and `op m, r` (32-bit or 64-bit GP).
+  kX86FastGpTest  = 2, //!< `test r|m, r` (32-bit or 64-bit GP).
+  kX86FastGpLea   = 3, //!< `lea r, m` (32-bit or 64-bit GP).
+  kX86FastJcc     = 4, //!< `jcc label`.
+  kX86FastJmp     = 5, //!< `jmp label`.
+  kX86FastVexRvm  = 6, //!< `op x|y, x|y, x|y|m` (VEX, 0F map).
+  kX86FastVexMov  = 7  //!< `op x|y, x|y|m` and `op m, x|y` (VEX, 0F map).
+};
+
+//! Precomputed encoding of an instruction handled by the fast path.
+struct X86FastInst {
+  uint8_t form;                    //!< Form, see `X86FastForm`.
+  uint8_t opcode;                  //!< Opcode of `r, r|m` form (`r|m, r` form of TEST, condition code of JCC).
+  uint8_t opcodeMR;                //!< Opcode of `m, r` form.
+  uint8_t pp;                      //!< VEX.pp field.
+};
+
+#define ASMJIT_X86_FAST_INSTS(V)                                                      \
+  V(Add    , kX86FastGpArith, 0x03, 0x01, 0) V(Or     , kX86FastGpArith, 0x0B, 0x09, 0) \
+  V(Adc    , kX86FastGpArith, 0x13, 0x11, 0) V(Sbb    , kX86FastGpArith, 0x1B, 0x19, 0) \
+  V(And    , kX86FastGpArith, 0x23, 0x21, 0) V(Sub    , kX86FastGpArith, 0x2B, 0x29, 0) \
+  V(Xor    , kX86FastGpArith, 0x33, 0x31, 0) V(Cmp    , kX86FastGpArith, 0x3B, 0x39, 0) \
+  V(Mov    , kX86FastGpArith, 0x8B, 0x89, 0) V(Test   , kX86FastGpTest , 0x85, 0x85, 0) \
+  V(Lea    , kX86FastGpLea  , 0x8D, 0x00, 0) V(Jmp    , kX86FastJmp    , 0x00, 0x00, 0) \
+  V(Jo     , kX86FastJcc    , 0x00, 0x00, 0) V(Jno    , kX86FastJcc    , 0x01, 0x00, 0) \
+  V(Jb     , kX86FastJcc    , 0x02, 0x00, 0) V(Jc     , kX86FastJcc    , 0x02, 0x00, 0) \
+  V(Jnae   , kX86FastJcc    , 0x02, 0x00, 0) V(Jae    , kX86FastJcc    , 0x03, 0x00, 0) \
+  V(Jnb    , kX86FastJcc    , 0x03, 0x00, 0) V(Jnc    , kX86FastJcc    , 0x03, 0x00, 0) \
+  V(Je     , kX86FastJcc    , 0x04, 0x00, 0) V(Jz     , kX86FastJcc    , 0x04, 0x00, 0) \
+  V(Jne    , kX86FastJcc    , 0x05, 0x00, 0) V(Jnz    , kX86FastJcc    , 0x05, 0x00, 0) \
+  V(Jbe    , kX86FastJcc    , 0x06, 0x00, 0) V(Jna    , kX86FastJcc    , 0x06, 0x00, 0) \
+  V(Ja     , kX86FastJcc    , 0x07, 0x00, 0) V(Jnbe   , kX86FastJcc    , 0x07, 0x00, 0) \
+  V(Js     , kX86FastJcc    , 0x08, 0x00, 0) V(Jns    , kX86FastJcc    , 0x09, 0x00, 0) \
+  V(Jp     , kX86FastJcc    , 0x0A, 0x00, 0) V(Jpe    , kX86FastJcc    , 0x0A, 0x00, 0) \
+  V(Jnp    , kX86FastJcc    , 0x0B, 0x00, 0) V(Jpo    , kX86FastJcc    , 0x0B, 0x00, 0) \
+  V(Jl     , kX86FastJcc    , 0x0C, 0x00, 0) V(Jnge   , kX86FastJcc    , 0x0C, 0x00, 0) \
+  V(Jge    , kX86FastJcc    , 0x0D, 0x00, 0) V(Jnl    , kX86FastJcc    , 0x0D, 0x00, 0) \
+  V(Jle    , kX86FastJcc    , 0x0E, 0x00, 0) V(Jng    , kX86FastJcc    , 0x0E, 0x00, 0) \
+  V(Jg     , kX86FastJcc    , 0x0F, 0x00, 0) V(Jnle   , kX86FastJcc    , 0x0F, 0x00, 0) \
+  V(Vpaddb , kX86FastVexRvm , 0xFC, 0x00, 1) V(Vpaddw , kX86FastVexRvm , 0xFD, 0x00, 1) \
+  V(Vpaddd , kX86FastVexRvm , 0xFE, 0x00, 1) V(Vpaddq , kX86FastVexRvm , 0xD4, 0x00, 1) \
+  V(Vpsubb , kX86FastVexRvm , 0xF8, 0x00, 1) V(Vpsubw , kX86FastVexRvm , 0xF9, 0x00, 1) \
+  V(Vpsubd , kX86FastVexRvm , 0xFA, 0x00, 1) V(Vpsubq , kX86FastVexRvm , 0xFB, 0x00, 1) \
+  V(Vpand  , kX86FastVexRvm , 0xDB, 0x00, 1) V(Vpandn , kX86FastVexRvm , 0xDF, 0x00, 1) \
+  V(Vpor   , kX86FastVexRvm , 0xEB, 0x00, 1) V(Vpxor  , kX86FastVexRvm , 0xEF, 0x00, 1) \
+  V(Vpmullw, kX86FastVexRvm , 0xD5, 0x00, 1) V(Vpcmpeqd,kX86FastVexRvm , 0x76, 0x00, 1) \
+  V(Vaddps , kX86FastVexRvm , 0x58, 0x00, 0) V(Vaddpd , kX86FastVexRvm , 0x58, 0x00, 1) \
+  V(Vsubps , kX86FastVexRvm , 0x5C, 0x00, 0) V(Vsubpd , kX86FastVexRvm , 0x5C, 0x00, 1) \
+  V(Vmulps , kX86FastVexRvm , 0x59, 0x00, 0) V(Vmulpd , kX86FastVexRvm , 0x59, 0x00, 1) \
+  V(Vandps , kX86FastVexRvm , 0x54, 0x00, 0) V(Vandpd , kX86FastVexRvm , 0x54, 0x00, 1) \
+  V(Vorps  , kX86FastVexRvm , 0x56, 0x00, 0) V(Vorpd  , kX86FastVexRvm , 0x56, 0x00, 1) \
+  V(Vxorps , kX86FastVexRvm , 0x57, 0x00, 0) V(Vxorpd , kX86FastVexRvm , 0x57, 0x00, 1) \
+  V(Vmovdqu, kX86FastVexMov , 0x6F, 0x7F, 2) V(Vmovdqa, kX86FastVexMov , 0x6F, 0x7F, 1) \
+  V(Vmovups, kX86FastVexMov , 0x10, 0x11, 0) V(Vmovupd, kX86FastVexMov , 0x10, 0x11, 1) \
+  V(Vmovaps, kX86FastVexMov , 0x28, 0x29, 0) V(Vmovapd, kX86FastVexMov , 0x28, 0x29, 1)
+
+enum X86FastInstIndex : uint32_t {
+  kX86FastInstNone = 0,
+#define VALUE(ID, FORM, OPCODE, OPCODE_MR, PP) kX86FastInst##ID,
+  ASMJIT_X86_FAST_INSTS(VALUE)
+#undef VALUE
+  kX86FastInstCount
+};
+
+static const X86FastInst x86FastInstTable[] = {
+  { kX86FastNone, 0x00, 0x00, 0 },
+#define VALUE(ID, FORM, OPCODE, OPCODE_MR, PP) { FORM, OPCODE, OPCODE_MR, PP },
+  ASMJIT_X86_FAST_INSTS(VALUE)
+#undef VALUE
+};
+
+// Table that maps an instruction id to an index to `x86FastInstTable`.
+template<uint32_t X>
+struct X86FastInstIndex_T {
+#define VALUE(ID, FORM, OPCODE, OPCODE_MR, PP) X == Inst::kId##ID ? uint32_t(kX86FastInst##ID) :
+  enum { kValue = ASMJIT_X86_FAST_INSTS(VALUE) uint32_t(kX86FastInstNone) };
+#undef VALUE
+};
+
+#define VALUE(x) uint8_t(X86FastInstIndex_T<x>::kValue)
+static const uint8_t x86FastInstIndex[] = { ASMJIT_LOOKUP_TABLE_1024(VALUE, 0), ASMJIT_LOOKUP_TABLE_1024(VALUE, 1024) };
+#undef VALUE
+
+#undef ASMJIT_X86_FAST_INSTS
+
+static_assert(ASMJIT_ARRAY_SIZE(x86FastInstIndex) >= Inst::_kIdCount, "x86FastInstIndex must cover all instructions");
+static_assert(kX86FastInstCount <= 256, "x86FastInstIndex must fit into uint8_t");
+
+//! Tests whether `op` is a GP register of the given `regType`.
+static ASMJIT_INLINE bool x86IsFastGp(const Operand_& op, uint32_t regType) noexcept {
+  return op.isReg() && op.as<Reg>().type() == regType;
+}
+
+//! Tests whether `op` is XMM or YMM register that doesn't require EVEX.
+static ASMJIT_INLINE bool x86IsFastVec(const Operand_& op) noexcept {
+  return op.isReg() && (op.as<Reg>().isXmm() || op.as<Reg>().isYmm()) && op.id() < 16;
+}
+
+//! Tests whether `op` is `[base + index << shift + disp32]` memory operand that
+//! uses native GP registers and doesn't need any prefix.
+static ASMJIT_INLINE bool x86IsFastMem(const Operand_& op, uint32_t gpType) noexcept {
+  if (!op.isMem())
+    return false;
+
+  const Mem& m = op.as<Mem>();
+  return m.baseType() == gpType &&
+         (!m.hasIndex() || (m.indexType() == gpType && m.indexId() != Gp::kIdSp)) &&
+         !m.hasSegment() && !m.hasBroadcast() && !m.isRegHome();
+}
+
+//! Emits ModR/M, SIB, and displacement of a memory operand accepted by `x86IsFastMem()`.
+static ASMJIT_INLINE void x86EmitFastModSib(X86BufferWriter& writer, uint32_t opReg, const Mem& m) noexcept {
+  uint32_t rbReg = m.baseId() & 0x7;
+  int32_t disp = m.offsetLo32();
+  uint32_t mod = (disp == 0 && rbReg != Gp::kIdBp) ? 0u : Support::isInt8(disp) ? 1u : 2u;
+
+  if (!m.hasIndex() && rbReg != Gp::kIdSp) {
+    writer.emit8(x86EncodeMod(mod, opReg & 0x7, rbReg));
+  }
+  else {
+    uint32_t rxReg = m.hasIndex() ? m.indexId() & 0x7 : uint32_t(Gp::kIdSp);
+    writer.emit8(x86EncodeMod(mod, opReg & 0x7, 4));
+    writer.emit8(x86EncodeSib(m.hasIndex() ? m.shift() : 0u, rxReg, rbReg));
+  }
+
+  if (mod == 1)
+    writer.emit8(uint32_t(disp) & 0xFFu);
+  else if (mod == 2)
+    writer.emit32uLE(uint32_t(disp));
+}
+
+//! Emits 2-byte or 3-byte VEX prefix (0F map, W0) followed by `opcode`. The `rxbMask` contains REX.R|X|B bits.
+static ASMJIT_INLINE void x86EmitFastVex(X86BufferWriter& writer, uint32_t opcode, uint32_t pp, uint32_t l, uint32_t rxbMask, uint32_t vvvv) noexcept {
+  uint32_t lpp = (((vvvv & 0xF) ^ 0xF) << 3) | (l << 2) | pp;
+
+  if (!(rxbMask & 0x3)) {
+    writer.emit8(0xC5);
+    writer.emit8((((rxbMask << 5) & 0x80u) ^ 0x80u) | lpp);
+  }
+  else {
+    writer.emit8(0xC4);
+    writer.emit8(((rxbMask << 5) ^ 0xE0u) | 0x01u);
+    writer.emit8(lpp);
+  }
+  writer.emit8(opcode);
+}
+
+//! Encodes the instruction by using its precomputed encoding `fi`. Returns
+//! false if the operands are not supported by the fast path, in that case
+//! the instruction must be encoded by the generic encoder.
+static ASMJIT_INLINE bool x86EmitFast(Assembler* self, const X86FastInst& fi, uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_* opExt) noexcept {
+  X86BufferWriter writer(self);
+  bool is64Bit = self->is64Bit();
+
+  switch (fi.form) {
+    case kX86FastGpArith:
+    case kX86FastGpTest:
+    case kX86FastGpLea: {
+      if (!o2.isNone())
+        return false;
+
+      // Only native sized memory addresses and 32-bit or 64-bit registers are handled.
+      uint32_t gpType = is64Bit ? uint32_t(Reg::kTypeGpq) : uint32_t(Reg::kTypeGpd);
+      uint32_t opcode = fi.opcode;
+      uint32_t rex = 0;
+      const Operand_* rm;
+      const Operand_* reg;
+
+      if (o0.isReg() && (o1.isReg() || o1.isMem()) && fi.form != kX86FastGpTest) {
+        reg = &o0;
+        rm = &o1;
+      }
+      else if (o0.isReg() && o1.isReg() && fi.form == kX86FastGpTest) {
+        reg = &o1;
+        rm = &o0;
+      }
+      else if (o0.isMem() && o1.isReg() && fi.form != kX86FastGpLea) {
+        opcode = fi.opcodeMR;
+        reg = &o1;
+        rm = &o0;
+      }
+      else {
+        return false;
+      }
+
+      uint32_t regType = reg->as<Reg>().type();
+      if (!(regType == Reg::kTypeGpd || regType == gpType))
+        return false;
+
+      uint32_t opReg = reg->id();
+      rex = (regType == Reg::kTypeGpq ? 0x08u : 0x00u) | ((opReg >> 1) & 0x04u);
+
+      if (rm->isReg()) {
+        if (fi.form == kX86FastGpLea || !x86IsFastGp(*rm, regType))
+          return false;
+
+        uint32_t rbReg = rm->id();
+        rex |= rbReg >> 3;
+
+        writer.emit8If(0x40u | rex, rex != 0);
+        writer.emit8(opcode);
+        writer.emit8(x86EncodeMod(3, opReg & 0x7, rbReg & 0x7));
+      }
+      else {
+        const Mem& m = rm->as<Mem>();
+        if (!x86IsFastMem(m, gpType))
+          return false;
+
+        rex |= ((m.baseId() >> 3) & 0x01u) | (m.hasIndex() ? (m.indexId() >> 2) & 0x02u : 0u);
+
+        writer.emit8If(0x40u | rex, rex != 0);
+        writer.emit8(opcode);
+        x86EmitFastModSib(writer, opReg, m);
+      }
+      break;
+    }
+
+    case kX86FastJcc:
+    case kX86FastJmp: {
+      if (!o0.isLabel() || !o1.isNone())
+        return false;
+
+      CodeHolder* code = self->code();
+      LabelEntry* label = code->labelEntry(o0.as<Label>());
+      if (!label)
+        return false;
+
+      uint32_t inst32Size = fi.form == kX86FastJcc ? 6u : 5u;
+      uint32_t opcode8 = fi.form == kX86FastJcc ? 0x70u + fi.opcode : 0xEBu;
+
+      if (label->isBoundTo(self->_section)) {
+        uint64_t ip = uint64_t(writer.offsetFrom(self->_bufferData));
+        uint32_t rel32 = uint32_t((label->offset() - ip - inst32Size) & 0xFFFFFFFFu);
+
+        if (Support::isInt8(int32_t(rel32 + inst32Size - 2))) {
+          writer.emit8(opcode8);
+          writer.emit8(rel32 + inst32Size - 2);
+          break;
+        }
+
+        writer.emit8If(0x0F, fi.form == kX86FastJcc);
+        writer.emit8(fi.form == kX86FastJcc ? 0x80u + fi.opcode : 0xE9u);
+        writer.emit32uLE(rel32);
+      }
+      else {
+        // Non-bound label or label bound to a different section.
+        size_t offset = size_t(writer.offsetFrom(self->_bufferData)) + inst32Size - 4;
+        OffsetFormat of;
+        of.resetToDataValue(4);
+
+        if (code->addLabelLink(label, self->_section->id(), offset, -4, of) != kErrorOk)
+          return false;
+
+        writer.emit8If(0x0F, fi.form == kX86FastJcc);
+        writer.emit8(fi.form == kX86FastJcc ? 0x80u + fi.opcode : 0xE9u);
+        writer.emitZeros(4);
+      }
+      break;
+    }
+
+    case kX86FastVexRvm: {
+      if (!opExt[EmitterUtils::kOp3].isNone() || !x86IsFastVec(o0) || !o1.hasSignature(o0))
+        return false;
+
+      uint32_t l = o0.as<Reg>().isYmm();
+      uint32_t opReg = o0.id();
+      uint32_t vvvv = o1.id();
+
+      if (o2.isReg()) {
+        if (!o2.hasSignature(o0))
+          return false;
+
+        // Keep the commutation done by `kEncodingOptionOptimizeForSize`, see `_emit()`.
+        uint32_t rbReg = o2.id();
+        if (rbReg >= 8 && vvvv < 8 && self->hasEncodingOption(BaseEmitter::kEncodingOptionOptimizeForSize) && x86IsCommutativeVex(instId))
+          std::swap(rbReg, vvvv);
+
+        x86EmitFastVex(writer, fi.opcode, fi.pp, l, ((opReg >> 1) & 0x04u) | (rbReg >> 3), vvvv);
+        writer.emit8(x86EncodeMod(3, opReg & 0x7, rbReg & 0x7));
+      }
+      else {
+        uint32_t gpType = is64Bit ? uint32_t(Reg::kTypeGpq) : uint32_t(Reg::kTypeGpd);
+        if (!x86IsFastMem(o2, gpType))
+          return false;
+
+        const Mem& m = o2.as<Mem>();
+        uint32_t rxb = ((opReg >> 1) & 0x04u) | ((m.baseId() >> 3) & 0x01u) | (m.hasIndex() ? (m.indexId() >> 2) & 0x02u : 0u);
+
+        x86EmitFastVex(writer, fi.opcode, fi.pp, l, rxb, vvvv);
+        x86EmitFastModSib(writer, opReg, m);
+      }
+      break;
+    }
+
+    case kX86FastVexMov: {
+      if (!o2.isNone())
+        return false;
+
+      uint32_t gpType = is64Bit ? uint32_t(Reg::kTypeGpq) : uint32_t(Reg::kTypeGpd);
+      uint32_t opcode = fi.opcode;
+      const Operand_* reg = &o0;
+      const Operand_* rm = &o1;
+
+      if (o0.isMem()) {
+        opcode = fi.opcodeMR;
+        reg = &o1;
+        rm = &o0;
+      }
+
+      if (!x86IsFastVec(*reg))
+        return false;
+
+      uint32_t l = reg->as<Reg>().isYmm();
+      uint32_t opReg = reg->id();
+
+      if (rm->isReg()) {
+        if (!rm->hasSignature(*reg))
+          return false;
+
+        uint32_t rbReg = rm->id();
+        x86EmitFastVex(writer, opcode, fi.pp, l, ((opReg >> 1) & 0x04u) | (rbReg >> 3), 0);
+        writer.emit8(x86EncodeMod(3, opReg & 0x7, rbReg & 0x7));
+      }
+      else {
+        if (!x86IsFastMem(*rm, gpType))
+          return false;
+
+        const Mem& m = rm->as<Mem>();
+        uint32_t rxb = ((opReg >> 1) & 0x04u) | ((m.baseId() >> 3) & 0x01u) | (m.hasIndex() ? (m.indexId() >> 2) & 0x02u : 0u);
+
+        x86EmitFastVex(writer, opcode, fi.pp, l, rxb, 0);
+        x86EmitFastModSib(writer, opReg, m);
+      }
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  self->resetInlineComment();
+  writer.done(self);
+  return true;
+}
+
 // ============================================================================
 // [asmjit::x86::Assembler - Emit (Low-Level)]
 // ============================================================================
@@ -582,11 +1003,18 @@ ASMJIT_FAVOR_SPEED Error Assembler::_emit(uint32_t instId, const Operand_& o0, c
   int64_t immValue = 0;            // Immediate value (must be 64-bit).
   FastUInt8 immSize = 0;           // Immediate size.
 
-  X86BufferWriter writer(this);
-
   if (instId >= Inst::_kIdCount)
     instId = 0;
 
+  // Try the fast path first, which is used only when no special handling is required.
+  uint32_t fastIndex = x86FastInstIndex[instId];
+  if (fastIndex && !(instOptions() | forcedInstOptions()) && !_extraReg.isReg() && remainingSpace() >= 16) {
+    if (x86EmitFast(this, x86FastInstTable[fastIndex], instId, o0, o1, o2, opExt))
+      return kErrorOk;
+  }
+
+  X86BufferWriter writer(this);
+
   const InstDB::InstInfo* instInfo = &InstDB::_instInfoTable[instId];
   const InstDB::CommonInfo* commonInfo = &instInfo->commonInfo();
 
@@ -1072,6 +1500,8 @@ CaseX86M_GPB_MulDiv:
           immSize = FastUInt8(Support::min<uint32_t>(size, 4));
           if (Support::isInt8(immValue) && !(options & Inst::kOptionLongForm))
             immSize = 1;
+          else if (immValue == 128 && x86CanNegateArithImm(instId, options, _encodingOptions))
+            x86NegateArithImm(opReg, immValue, immSize);
         }
 
         // Short form - AL, AX, EAX, RAX.
@@ -1101,6 +1531,8 @@ CaseX86M_GPB_MulDiv:
 
         if (Support::isInt8(immValue) && !(options & Inst::kOptionLongForm))
           immSize = 1;
+        else if (immValue == 128 && memSize != 1 && x86CanNegateArithImm(instId, options, _encodingOptions))
+          x86NegateArithImm(opReg, immValue, immSize);
 
         opcode += memSize != 1 ? (immSize != 1 ? 1 : 3) : 0;
         opcode.addPrefixBySize(memSize);
@@ -1696,6 +2128,17 @@ CaseX86M_GPB_MulDiv:
           // 64-bit immediate in 64-bit mode is allowed.
           immValue = o1.as<Imm>().value();
 
+          // Zero the register by `xor r32, r32` (or `xor r16, r16`) if flags don't matter.
+          const uint32_t kXorZeroOptions = kEncodingOptionOptimizeForSize | kEncodingOptionIgnoreFlags;
+          if ((_encodingOptions & kXorZeroOptions) == kXorZeroOptions && !(options & Inst::kOptionLongForm) &&
+              (immSize == 2 ? uint16_t(immValue) : immSize == 4 ? uint32_t(immValue) : uint64_t(immValue)) == 0) {
+            opcode = 0x31;
+            opcode.addPrefixBySize(Support::min<uint32_t>(immSize, 4));
+            rbReg = opReg;
+            immSize = 0;
+            goto EmitX86R;
+          }
+
           // Optimize the instruction size by using a 32-bit immediate if possible.
           if (immSize == 8 && !(options & Inst::kOptionLongForm)) {
             if (Support::isUInt32(immValue) && hasEncodingOption(kEncodingOptionOptimizeForSize)) {
@@ -2112,23 +2555,33 @@ CaseX86PushPop_Gp:
       opReg = opcode.extractModO();
 
       if (isign3 == ENC_OPS2(Reg, Imm)) {
-        opcode.addArithBySize(o0.size());
+        uint32_t size = o0.size();
         rbReg = o0.id();
 
-        if (o0.size() == 1) {
+        if (size == 1) {
           FIXUP_GPB(o0, rbReg);
           immValue = o1.as<Imm>().valueAs<uint8_t>();
           immSize = 1;
         }
         else {
           immValue = o1.as<Imm>().value();
-          immSize = FastUInt8(Support::min<uint32_t>(o0.size(), 4));
+          immSize = FastUInt8(Support::min<uint32_t>(size, 4));
+
+          // Narrow to `test r8, imm8`, which sets the same flags if the immediate
+          // is not negative as a byte. SPL|BPL|SIL|DIL require 64-bit mode.
+          if (x86CanNarrowTestImm(immValue, options, _encodingOptions) && (rbReg < 4 || is64Bit())) {
+            FIXUP_GPB(o0, rbReg);
+            size = 1;
+            immSize = 1;
+          }
         }
 
+        opcode.addArithBySize(size);
+
         // Short form - AL, AX, EAX, RAX.
         if (rbReg == 0 && !(options & Inst::kOptionLongForm)) {
           opcode &= Opcode::kPP_66 | Opcode::kW;
-          opcode |= 0xA8 + (o0.size() != 1);
+          opcode |= 0xA8 + (size != 1);
           goto EmitX86Op;
         }
 
@@ -2136,14 +2589,19 @@ CaseX86PushPop_Gp:
       }
 
       if (isign3 == ENC_OPS2(Mem, Imm)) {
-        if (ASMJIT_UNLIKELY(o0.size() == 0))
+        uint32_t memSize = o0.size();
+        if (ASMJIT_UNLIKELY(memSize == 0))
           goto AmbiguousOperandSize;
 
-        opcode.addArithBySize(o0.size());
-        rmRel = &o0;
-
         immValue = o1.as<Imm>().value();
-        immSize = FastUInt8(Support::min<uint32_t>(o0.size(), 4));
+
+        // Narrow to `test m8, imm8`, the first byte of the operand is the lowest one.
+        if (x86CanNarrowTestImm(immValue, options, _encodingOptions))
+          memSize = 1;
+
+        opcode.addArithBySize(memSize);
+        rmRel = &o0;
+        immSize = FastUInt8(Support::min<uint32_t>(memSize, 4));
         goto EmitX86M;
       }
       break;
@@ -3031,8 +3489,15 @@ CaseVexRmi:
 CaseVexRvm:
       if (isign3 == ENC_OPS3(Reg, Reg, Reg)) {
 CaseVexRvm_R:
-        opReg = x86PackRegAndVvvvv(o0.id(), o1.id());
+        opReg = o1.id();
         rbReg = o2.id();
+
+        // Only registers encoded in ModRM.rm require VEX3 (REX.B), so a high
+        // register of a commutative instruction is moved to VEX.vvvv instead.
+        if (rbReg >= 8 && opReg < 8 && hasEncodingOption(kEncodingOptionOptimizeForSize) && x86IsCommutativeVex(instId))
+          std::swap(opReg, rbReg);
+
+        opReg = x86PackRegAndVvvvv(o0.id(), opReg);
         goto EmitVexEvexR;
       }
 
@@ -4761,12 +5226,17 @@ EmitRel:
     OffsetFormat of;
     of.resetToDataValue(relSize);
 
-    LabelLink* link = _code->newLabelLink(label, _section->id(), offset, relOffset, of);
-    if (ASMJIT_UNLIKELY(!link))
-      goto OutOfMemory;
-
-    if (re)
+    if (re) {
+      LabelLink* link = _code->newLabelLink(label, _section->id(), offset, relOffset, of);
+      if (ASMJIT_UNLIKELY(!link))
+        goto OutOfMemory;
       link->relocId = re->id();
+    }
+    else {
+      // Links without a relocation are stored in a packed form.
+      if (ASMJIT_UNLIKELY(_code->addLabelLink(label, _section->id(), offset, relOffset, of) != kErrorOk))
+        goto OutOfMemory;
+    }
 
     // Emit dummy zeros, must be patched later when the reference becomes known.
     writer.emitZeros(relSize);
@@ -4829,6 +5299,48 @@ Failed:
 #endif
 }
 
+// ============================================================================
+// [asmjit::x86::Assembler - Emit (Batch)]
+// ============================================================================
+
+Error Assembler::_emitBatch(const InstRecord* records, size_t count) {
+  // Logging and validation require the generic path for each instruction.
+  if (ASMJIT_UNLIKELY(!_code || forcedInstOptions()))
+    return Base::_emitBatch(records, count);
+
+  // Reserve the space for the whole batch once. Each instruction is at most
+  // 15 bytes long, so there are always at least 16 bytes left before encoding
+  // the next one, which is what the fast path requires.
+  if (ASMJIT_UNLIKELY(count > SIZE_MAX / 16))
+    return reportError(DebugUtils::errored(kErrorOutOfMemory));
+
+  X86BufferWriter writer(this);
+  ASMJIT_PROPAGATE(writer.ensureSpace(this, count * 16));
+
+  resetInstOptions();
+  resetExtraReg();
+
+  for (size_t i = 0; i < count; i++) {
+    const InstRecord& record = records[i];
+    const Operand_* op = record.operands();
+
+    uint32_t instId = record.id();
+    if (instId < Inst::_kIdCount && !record.options() && !record.hasExtraReg()) {
+      uint32_t fastIndex = x86FastInstIndex[instId];
+      if (fastIndex && x86EmitFast(this, x86FastInstTable[fastIndex], instId, op[0], op[1], op[2], op + 3))
+        continue;
+    }
+
+    // Everything else goes through `_emit()`, which resets the options and
+    // extra register after the instruction is emitted.
+    setInstOptions(record.options());
+    setExtraReg(record.extraReg());
+    ASMJIT_PROPAGATE(_emit(instId, op[0], op[1], op[2], op + 3));
+  }
+
+  return kErrorOk;
+}
+
 // ============================================================================
 // [asmjit::x86::Assembler - Align]
 // ============================================================================
@@ -716,6 +716,7 @@ public:
   //! \{
 
   ASMJIT_API Error _emit(uint32_t instId, const Operand_& o0, const Operand_& o1, const Operand_& o2, const Operand_* opExt) override;
+  ASMJIT_API Error _emitBatch(const InstRecord* records, size_t count) override;
 
   //! \}
   //! \endcond
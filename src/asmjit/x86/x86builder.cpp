@@ -27,6 +27,10 @@
 #include "../x86/x86assembler.h"
 #include "../x86/x86builder.h"
 
+#if defined(ASMJIT_TEST)
+  #include "../core/jitruntime.h"
+#endif
+
 ASMJIT_BEGIN_SUB_NAMESPACE(x86)
 
 // ============================================================================
@@ -45,6 +49,12 @@ Builder::~Builder() noexcept {}
 
 Error Builder::finalize() {
   ASMJIT_PROPAGATE(runPasses());
+
+  if (hasEncodingOption(kEncodingOptionRelaxBranches)) {
+    Assembler layoutAssembler;
+    ASMJIT_PROPAGATE(relaxBranches(&layoutAssembler));
+  }
+
   Assembler a(_code);
   a.addEncodingOptions(encodingOptions());
   a.addValidationOptions(validationOptions());
@@ -63,6 +73,196 @@ Error Builder::onAttach(CodeHolder* code) noexcept {
   return Base::onAttach(code);
 }
 
+// ============================================================================
+// [asmjit::x86::Builder - Unit]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+// Code is only executed if the host can run it.
+#if ASMJIT_ARCH_X86 && !defined(ASMJIT_NO_JIT)
+  #define ASMJIT_X86_BUILDER_TEST_JIT
+#endif
+
+static Environment Builder_testEnvironment() noexcept {
+#if ASMJIT_ARCH_X86
+  return hostEnvironment();
+#else
+  return Environment(Environment::kArchX64);
+#endif
+}
+
+// Adds the code to a runtime and calls it as `int f(void)`, returns `expected`
+// if the host cannot execute the code.
+static int Builder_testRun(CodeHolder& code, int expected) noexcept {
+#if defined(ASMJIT_X86_BUILDER_TEST_JIT)
+  typedef int (*Func)(void);
+  DebugUtils::unused(expected);
+
+  JitRuntime rt;
+  Func fn;
+  EXPECT(rt.add(&fn, &code) == kErrorOk);
+
+  int result = fn();
+  rt.release(fn);
+  return result;
+#else
+  DebugUtils::unused(code);
+  return expected;
+#endif
+}
+
+// Emits a chain of forward jumps over dead code of different sizes, some of
+// them followed by alignment, and returns the sum of all targets reached. The
+// end of the chain is reached through an embedded label and the result also
+// includes a label delta, so both depend on the relaxed layout.
+static int Builder_makeBranchChain(Builder& cb) noexcept {
+  constexpr int kJumpCount = 48;
+
+  Label L_first = cb.newLabel();
+  Label L_tail = cb.newLabel();
+  Label L_ptr = cb.newLabel();
+  Label L_delta = cb.newLabel();
+
+  int sum = 0;
+  cb.xor_(eax, eax);
+  cb.mov(ecx, 1);
+  cb.bind(L_first);
+
+  for (int i = 0; i < kJumpCount; i++) {
+    Label L_next = cb.newLabel();
+    cb.test(ecx, ecx);
+    if (i & 1)
+      cb.jnz(L_next);
+    else
+      cb.jmp(L_next);
+
+    // Dead code, which would corrupt the result if reached.
+    int deadCount = (i % 3 == 0) ? 30 : 2;
+    for (int j = 0; j < deadCount; j++)
+      cb.add(eax, 100000);
+
+    if (i % 5 == 0)
+      cb.align(kAlignCode, 16);
+
+    cb.bind(L_next);
+    cb.add(eax, i);
+    sum += i;
+  }
+
+  cb.jmp(ptr(L_ptr));
+  cb.int3();
+
+  cb.bind(L_tail);
+  cb.add(eax, dword_ptr(L_delta));
+  cb.ret();
+
+  cb.align(kAlignData, 8);
+  cb.bind(L_ptr);
+  cb.embedLabel(L_tail);
+  cb.bind(L_delta);
+  cb.embedLabelDelta(L_tail, L_first, 4);
+
+  EXPECT(cb.finalize() == kErrorOk);
+
+  CodeHolder* code = cb.code();
+  return sum + int(code->labelOffset(L_tail) - code->labelOffset(L_first));
+}
+
+UNIT(x86_builder) {
+  INFO("x86::Builder - kEncodingOptionRelaxBranches");
+  {
+    size_t codeSize[2] {};
+
+    for (uint32_t relax = 0; relax < 2; relax++) {
+      CodeHolder code;
+      code.init(Builder_testEnvironment());
+
+      Builder cb(&code);
+      if (relax)
+        cb.addEncodingOptions(BaseEmitter::kEncodingOptionRelaxBranches);
+
+      int expected = Builder_makeBranchChain(cb);
+      codeSize[relax] = code.codeSize();
+
+      int result = Builder_testRun(code, expected);
+      EXPECT(result == expected, "Function (relax=%u) returned %d, expected %d", relax, result, expected);
+    }
+
+    EXPECT(codeSize[1] < codeSize[0], "Relaxed code (%zu bytes) must be smaller than %zu bytes", codeSize[1], codeSize[0]);
+  }
+
+  INFO("x86::Builder - kEncodingOptionRelaxBranches with an alignment between a branch and its target");
+  {
+    // Relaxing the first jump moves the second one, which changes the padding
+    // of the alignment so its target goes out of the range of a short jump.
+    for (uint32_t nopCount = 125; nopCount <= 126; nopCount++) {
+      CodeHolder code;
+      code.init(Builder_testEnvironment());
+
+      Builder cb(&code);
+      cb.addEncodingOptions(BaseEmitter::kEncodingOptionRelaxBranches);
+
+      Label L1 = cb.newLabel();
+      Label L2 = cb.newLabel();
+
+      cb.jmp(L2);
+      cb.bind(L2);
+      cb.jmp(L1);
+      for (uint32_t i = 0; i < nopCount; i++)
+        cb.db(0x90);
+      cb.align(kAlignCode, 4);
+      cb.bind(L1);
+      cb.mov(eax, 42);
+      cb.ret();
+
+      EXPECT(cb.finalize() == kErrorOk, "Failed to finalize with %u NOPs", nopCount);
+
+      // The first jump is short, the second one must stay long.
+      const CodeBuffer& buf = code.textSection()->buffer();
+      EXPECT(buf[0] == 0xEB && buf[2] == 0xE9);
+      EXPECT(code.labelOffset(L1) % 4 == 0);
+      EXPECT(Builder_testRun(code, 42) == 42);
+    }
+  }
+
+  INFO("x86::Builder - layoutTo() marks short forms that are out of range");
+  {
+    CodeHolder code;
+    code.init(Environment(Environment::kArchX64));
+
+    Builder cb(&code);
+    Label L_near = cb.newLabel();
+    Label L_far = cb.newLabel();
+
+    cb.short_().jmp(L_far);
+    cb.short_().jmp(L_near);
+    cb.bind(L_near);
+    for (uint32_t i = 0; i < 200; i++)
+      cb.db(0x90);
+    cb.bind(L_far);
+    cb.short_().jmp(L_near);
+    cb.ret();
+
+    BuilderLayoutEntry entries[4];
+    size_t count = 0;
+    for (BaseNode* node = cb.firstNode(); node; node = node->next())
+      if (node->isInst())
+        entries[count++].reset(node);
+    EXPECT(count == 4);
+
+    CodeHolder layoutCode;
+    Assembler layoutAssembler;
+    EXPECT(cb.layoutTo(&layoutCode, &layoutAssembler, entries, count) == kErrorOk);
+
+    EXPECT(entries[0].hasFlag(BuilderLayoutEntry::kFlagShortFormOutOfRange));
+    EXPECT(!entries[1].hasFlag(BuilderLayoutEntry::kFlagShortFormOutOfRange));
+    EXPECT(entries[2].hasFlag(BuilderLayoutEntry::kFlagShortFormOutOfRange));
+    EXPECT(!entries[3].hasFlag(BuilderLayoutEntry::kFlagShortFormOutOfRange));
+    EXPECT(cb.finalize() == kErrorInvalidDisplacement);
+  }
+}
+#endif
+
 ASMJIT_END_SUB_NAMESPACE
 
 #endif // ASMJIT_BUILD_X86 && !ASMJIT_NO_BUILDER
@@ -46,6 +46,12 @@ Compiler::~Compiler() noexcept {}
 
 Error Compiler::finalize() {
   ASMJIT_PROPAGATE(runPasses());
+
+  if (hasEncodingOption(kEncodingOptionRelaxBranches)) {
+    Assembler layoutAssembler;
+    ASMJIT_PROPAGATE(relaxBranches(&layoutAssembler));
+  }
+
   Assembler a(_code);
   a.addEncodingOptions(encodingOptions());
   a.addValidationOptions(validationOptions());
@@ -72,6 +78,40 @@ Error Compiler::onAttach(CodeHolder* code) noexcept {
   return kErrorOk;
 }
 
+// ============================================================================
+// [asmjit::x86::Compiler - Unit]
+// ============================================================================
+
+#if defined(ASMJIT_TEST)
+UNIT(x86_compiler) {
+  INFO("x86::Compiler - memoryUsage()");
+  {
+    CodeHolder code;
+    code.init(Environment(Environment::kArchX64));
+
+    Compiler cc(&code);
+    Gp a = cc.newInt32("a");
+    Gp b = cc.newInt32("b");
+
+    cc.addFunc(FuncSignatureT<int, int, int>(CallConv::kIdHost));
+    cc.setArg(0, a);
+    cc.setArg(1, b);
+    cc.add(a, b);
+    cc.ret(a);
+    cc.endFunc();
+
+    EXPECT(cc.finalize() == kErrorOk);
+
+    // The compiler holds its nodes and passes use their own zone.
+    MemoryUsage usage;
+    cc.memoryUsage(&usage);
+    EXPECT(usage.categories[MemoryUsage::kCategoryEmitterZones].usedSize > 0);
+    EXPECT(usage.categories[MemoryUsage::kCategoryPassZones].reservedSize > 0);
+    EXPECT(usage.total.reservedSize >= usage.total.usedSize);
+  }
+}
+#endif
+
 ASMJIT_END_SUB_NAMESPACE
 
 #endif // ASMJIT_BUILD_X86 && !ASMJIT_NO_COMPILER
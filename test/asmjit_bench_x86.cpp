@@ -28,6 +28,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "asmjit_test_opcode.h"
@@ -124,6 +125,21 @@ namespace BenchUtils {
       printf("Speed: N/A");
     printf("\n");
   }
+
+  // A simple xorshift32 generator, which is good enough to generate random sizes.
+  class Random {
+  public:
+    inline explicit Random(uint32_t seed) noexcept : state(seed ? seed : 0x1F0A2BE7u) {}
+
+    inline uint32_t next() noexcept {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return state;
+    }
+
+    uint32_t state;
+  };
 }
 
 // ============================================================================
@@ -131,6 +147,79 @@ namespace BenchUtils {
 // ============================================================================
 
 #ifdef ASMJIT_BUILD_X86
+// Generates a mix of the most common instruction forms (GP arithmetic, loads,
+// stores, jumps, and AVX2 arithmetic), which dominate typical JIT output.
+static void generateCommonForms(x86::Assembler& a) noexcept {
+  using namespace x86;
+
+  bool is64Bit = a.is64Bit();
+  Gp base = is64Bit ? Gp(rsi) : Gp(esi);
+  Gp index = is64Bit ? Gp(rdx) : Gp(edx);
+
+  Label L_loop = a.newLabel();
+  Label L_skip = a.newLabel();
+  a.bind(L_loop);
+
+  for (uint32_t i = 0; i < 64; i++) {
+    int32_t disp = int32_t(i * 32);
+
+    a.mov(eax, dword_ptr(base, disp));
+    a.add(eax, ecx);
+    a.sub(ebx, dword_ptr(base, index, 2, disp));
+    a.xor_(edi, eax);
+    a.cmp(eax, ebx);
+    a.jne(L_skip);
+    a.mov(dword_ptr(base, disp + 4), eax);
+    a.lea(edi, ptr(base, index, 3, 8));
+    a.vmovdqu(ymm0, ptr(base, disp));
+    a.vpaddd(ymm1, ymm0, ymm2);
+    a.vpxor(ymm3, ymm1, ptr(base, index, 0, disp));
+    a.vmovdqu(ptr(base, disp), ymm3);
+    a.test(eax, ecx);
+    a.jz(L_loop);
+  }
+
+  a.bind(L_skip);
+  a.ret();
+}
+
+// Generates the same forms as `generateCommonForms()`, but replays them as a
+// template of instruction records by using `emitBatch()`.
+static void generateCommonFormsBatch(x86::Assembler& a) noexcept {
+  using namespace x86;
+
+  bool is64Bit = a.is64Bit();
+  Gp base = is64Bit ? Gp(rsi) : Gp(esi);
+  Gp index = is64Bit ? Gp(rdx) : Gp(edx);
+
+  Label L_loop = a.newLabel();
+  Label L_skip = a.newLabel();
+  a.bind(L_loop);
+
+  const InstRecord records[] = {
+    InstRecord(Inst::kIdMov, eax, dword_ptr(base, 32)),
+    InstRecord(Inst::kIdAdd, eax, ecx),
+    InstRecord(Inst::kIdSub, ebx, dword_ptr(base, index, 2, 32)),
+    InstRecord(Inst::kIdXor, edi, eax),
+    InstRecord(Inst::kIdCmp, eax, ebx),
+    InstRecord(Inst::kIdJne, L_skip),
+    InstRecord(Inst::kIdMov, dword_ptr(base, 36), eax),
+    InstRecord(Inst::kIdLea, edi, ptr(base, index, 3, 8)),
+    InstRecord(Inst::kIdVmovdqu, ymm0, ptr(base, 32)),
+    InstRecord(Inst::kIdVpaddd, ymm1, ymm0, ymm2),
+    InstRecord(Inst::kIdVpxor, ymm3, ymm1, ptr(base, index, 0, 32)),
+    InstRecord(Inst::kIdVmovdqu, ptr(base, 32), ymm3),
+    InstRecord(Inst::kIdTest, eax, ecx),
+    InstRecord(Inst::kIdJz, L_loop)
+  };
+
+  for (uint32_t i = 0; i < 64; i++)
+    a.emitBatch(records, ASMJIT_ARRAY_SIZE(records));
+
+  a.bind(L_skip);
+  a.ret();
+}
+
 static void benchX86(uint32_t arch) noexcept {
   CodeHolder code;
 
@@ -143,6 +232,14 @@ static void benchX86(uint32_t arch) noexcept {
     asmtest::generateOpcodes(a.as<x86::Emitter>());
   });
 
+  BenchUtils::bench<x86::Assembler>(code, arch, "[common]", [](x86::Assembler& a) {
+    generateCommonForms(a);
+  });
+
+  BenchUtils::bench<x86::Assembler>(code, arch, "[batch]", [](x86::Assembler& a) {
+    generateCommonFormsBatch(a);
+  });
+
 #ifndef ASMJIT_NO_BUILDER
   BenchUtils::bench<x86::Builder>(code, arch, "[no-asm]", [](x86::Builder& cb) {
     asmtest::generateOpcodes(cb.as<x86::Emitter>());
@@ -167,11 +264,165 @@ static void benchX86(uint32_t arch) noexcept {
 }
 #endif
 
+#ifndef ASMJIT_NO_JIT
+static void benchJitAllocator() noexcept {
+  using namespace BenchUtils;
+
+  static const size_t liveCounts[] = { 100, 1000, 10000, 100000 };
+  static constexpr uint32_t kNumOperations = 100000;
+  static constexpr uint32_t kNumAllocatorRepeats = 5;
+
+  for (size_t liveCount : liveCounts) {
+    JitAllocator allocator;
+    Random rnd((uint32_t)liveCount);
+    Performance perf;
+
+    void** ptrs = static_cast<void**>(malloc(liveCount * sizeof(void*)));
+    if (!ptrs)
+      return;
+
+    void* rw;
+    for (size_t i = 0; i < liveCount; i++)
+      allocator.alloc(&ptrs[i], &rw, (rnd.next() % 1024) + 8);
+
+    // Measure how long it takes to release a random live allocation and to
+    // allocate a new one while keeping the number of live allocations fixed.
+    for (uint32_t r = 0; r < kNumAllocatorRepeats; r++) {
+      perf.start();
+      for (uint32_t i = 0; i < kNumOperations; i++) {
+        size_t index = rnd.next() % liveCount;
+        allocator.release(ptrs[index]);
+        allocator.alloc(&ptrs[index], &rw, (rnd.next() % 1024) + 8);
+      }
+      perf.end();
+    }
+
+    JitAllocator::Statistics stats = allocator.statistics();
+    printf("[JitAllocator] Live:%7u | Blocks:%5u | Time:%6u [ms] | Speed: %8.1f [ns/release+alloc]\n",
+           unsigned(liveCount),
+           unsigned(stats.blockCount()),
+           perf.best,
+           double(perf.best) * 1e6 / double(kNumOperations));
+
+    free(ptrs);
+  }
+}
+#endif
+
+// Node and key used to compare `ZoneHash` and `ZoneFlatHash`, keys are
+// strings like label names.
+struct BenchHashNode : public ZoneHashNode {
+  inline BenchHashNode(uint32_t hashCode, const char* name) noexcept
+    : ZoneHashNode(hashCode),
+      _name(name) {}
+
+  const char* _name;
+};
+
+struct BenchHashKey {
+  inline explicit BenchHashKey(const char* name) noexcept
+    : _name(name),
+      _hashCode(Support::hashString(name, strlen(name))) {}
+
+  inline uint32_t hashCode() const noexcept { return _hashCode; }
+  inline bool matches(const BenchHashNode* node) const noexcept { return strcmp(node->_name, _name) == 0; }
+
+  const char* _name;
+  uint32_t _hashCode;
+};
+
+template<typename HashT>
+static void benchHashTable(const char* hashName, char (*names)[16], const BenchHashKey* keys, const uint32_t* order, uint32_t count) noexcept {
+  using namespace BenchUtils;
+
+  static constexpr uint32_t kNumHashRepeats = 10;
+  static constexpr uint32_t kNumLookups = 4000000;
+
+  Performance insertPerf;
+  Performance lookupPerf;
+  Performance randomPerf;
+  uint32_t found = 0;
+
+  for (uint32_t r = 0; r < kNumHashRepeats; r++) {
+    Zone zone(65536 - Zone::kBlockOverhead);
+    ZoneAllocator allocator(&zone);
+    HashT hash;
+
+    insertPerf.start();
+    for (uint32_t i = 0; i < count; i++)
+      hash.insert(&allocator, zone.newT<BenchHashNode>(keys[i].hashCode(), names[i]));
+    insertPerf.end();
+
+    // Half of the lookups miss, which is what happens when a label is checked
+    // for existence before it's created.
+    lookupPerf.start();
+    for (uint32_t i = 0, index = 0; i < kNumLookups; i++) {
+      found += hash.get(keys[index]) != nullptr;
+      if (++index == count * 2u)
+        index = 0;
+    }
+    lookupPerf.end();
+
+    randomPerf.start();
+    for (uint32_t i = 0, index = 0; i < kNumLookups; i++) {
+      found += hash.get(keys[order[index]]) != nullptr;
+      if (++index == count * 2u)
+        index = 0;
+    }
+    randomPerf.end();
+  }
+
+  printf("[%-12s] Names:%7u | Insert:%4u [ms] | Lookup: %6.1f [ns] | Random lookup: %6.1f [ns] (%u found)\n",
+         hashName,
+         unsigned(count),
+         insertPerf.best,
+         double(lookupPerf.best) * 1e6 / double(kNumLookups),
+         double(randomPerf.best) * 1e6 / double(kNumLookups),
+         unsigned(found / (kNumHashRepeats * 2u)));
+}
+
+static void benchZoneHash() noexcept {
+  static const uint32_t nameCounts[] = { 100, 1000, 10000, 100000 };
+
+  for (uint32_t count : nameCounts) {
+    // The second half of names is never inserted.
+    char (*names)[16] = static_cast<char (*)[16]>(malloc(size_t(count) * 2u * 16u));
+    BenchHashKey* keys = static_cast<BenchHashKey*>(malloc(size_t(count) * 2u * sizeof(BenchHashKey)));
+    uint32_t* order = static_cast<uint32_t*>(malloc(size_t(count) * 2u * sizeof(uint32_t)));
+
+    if (names && keys && order) {
+      BenchUtils::Random rnd(count);
+      for (uint32_t i = 0; i < count * 2u; i++) {
+        snprintf(names[i], 16, "L_row%u", unsigned(i));
+        new(&keys[i]) BenchHashKey(names[i]);
+
+        // Random lookup order (Fisher-Yates shuffle).
+        uint32_t j = rnd.next() % (i + 1u);
+        order[i] = order[j];
+        order[j] = i;
+      }
+
+      benchHashTable<ZoneHash<BenchHashNode>>("ZoneHash", names, keys, order, count);
+      benchHashTable<ZoneFlatHash<BenchHashNode>>("ZoneFlatHash", names, keys, order, count);
+    }
+
+    free(order);
+    free(keys);
+    free(names);
+  }
+}
+
 int main() {
+  benchZoneHash();
+
 #ifdef ASMJIT_BUILD_X86
   benchX86(Environment::kArchX86);
   benchX86(Environment::kArchX64);
 #endif
 
+#ifndef ASMJIT_NO_JIT
+  benchJitAllocator();
+#endif
+
   return 0;
 }
@@ -30,6 +30,7 @@
 #include <asmjit/x86.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "cmdline.h"
 #include "asmjit_test_opcode.h"
@@ -64,6 +65,454 @@ struct TestErrorHandler : public ErrorHandler {
 
 typedef void (*VoidFunc)(void);
 
+// ============================================================================
+// [Encoding Checks]
+// ============================================================================
+
+// Copy of the `.text` section, used to compare machine code of different emitters.
+struct CodeCopy {
+  uint8_t* data = nullptr;
+  size_t size = 0;
+
+  ~CodeCopy() { free(data); }
+
+  bool assign(const CodeBuffer& buf) {
+    free(data);
+    data = static_cast<uint8_t*>(malloc(buf.size()));
+    size = buf.size();
+    if (data)
+      memcpy(data, buf.data(), buf.size());
+    return data != nullptr;
+  }
+
+  bool equals(const CodeCopy& other) const {
+    return data && other.data && size == other.size && memcmp(data, other.data, size) == 0;
+  }
+};
+
+// Emitter used by `encode()`.
+enum EncodeMode : uint32_t {
+  kEncodeAssembler,       // x86::Assembler.
+  kEncodeAssemblerLogged, // x86::Assembler with a logger, which disables its fast path.
+  kEncodeBuilder,         // x86::Builder.
+  kEncodeBuilderCompact   // x86::Builder with compact instruction storage.
+};
+
+typedef void (*GenerateFunc)(x86::Emitter* e, const OpcodeDumpInfo& info);
+
+static void generateAll(x86::Emitter* e, const OpcodeDumpInfo& info) {
+  asmtest::generateOpcodes(e, info.useRex1, info.useRex2);
+}
+
+// Emits instructions handled by the fast path of x86::Assembler with many
+// operand combinations.
+static void generateFastPathForms(x86::Emitter* e, const OpcodeDumpInfo& info) {
+  static const uint32_t gpInsts[] = {
+    x86::Inst::kIdAdd, x86::Inst::kIdOr, x86::Inst::kIdAdc, x86::Inst::kIdSbb, x86::Inst::kIdAnd,
+    x86::Inst::kIdSub, x86::Inst::kIdXor, x86::Inst::kIdCmp, x86::Inst::kIdMov, x86::Inst::kIdTest,
+    x86::Inst::kIdLea
+  };
+
+  static const uint32_t vecInsts[] = {
+    x86::Inst::kIdVpaddd, x86::Inst::kIdVpaddq, x86::Inst::kIdVpxor, x86::Inst::kIdVpsubb,
+    x86::Inst::kIdVpcmpeqd, x86::Inst::kIdVaddps, x86::Inst::kIdVmulpd, x86::Inst::kIdVxorps,
+    x86::Inst::kIdVmovdqu, x86::Inst::kIdVmovdqa, x86::Inst::kIdVmovups, x86::Inst::kIdVmovapd
+  };
+
+  static const int32_t disps[] = { 0, 1, -128, 127, 128, -129, 0x12345 };
+
+  bool is64Bit = Environment::is64Bit(info.arch);
+  uint32_t regCount = is64Bit ? 16 : 8;
+  uint32_t gpSizes = is64Bit ? 2 : 1;
+
+  Label L_back = e->newLabel();
+  Label L_forward = e->newLabel();
+  e->bind(L_back);
+
+  for (uint32_t instId : gpInsts) {
+    for (uint32_t s = 0; s < gpSizes; s++) {
+      for (uint32_t i = 0; i < regCount; i++) {
+        x86::Gp r0 = s ? x86::Gp(x86::gpq(i)) : x86::Gp(x86::gpd(i));
+
+        for (uint32_t j = 0; j < regCount; j++) {
+          x86::Gp r1 = s ? x86::Gp(x86::gpq(j)) : x86::Gp(x86::gpd(j));
+          e->emit(instId, r0, r1);
+
+          for (int32_t disp : disps) {
+            x86::Mem m = is64Bit ? x86::ptr(x86::gpq(j), disp) : x86::ptr(x86::gpd(j), disp);
+            x86::Mem mi = is64Bit ? x86::ptr(x86::gpq(j), x86::gpq(i), j & 3, disp) : x86::ptr(x86::gpd(j), x86::gpd(i), j & 3, disp);
+            e->emit(instId, r0, m);
+            e->emit(instId, m, r0);
+            e->emit(instId, r0, mi);
+            e->emit(instId, mi, r0);
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t instId : vecInsts) {
+    for (uint32_t i = 0; i < regCount; i++) {
+      for (uint32_t j = 0; j < regCount; j++) {
+        x86::Xmm x0 = x86::xmm(i);
+        x86::Ymm y0 = x86::ymm(j);
+        x86::Mem m = is64Bit ? x86::ptr(x86::gpq(j), x86::gpq(i), 2, int32_t(j * 64)) : x86::ptr(x86::gpd(j), int32_t(j * 64));
+
+        e->emit(instId, x0, x86::xmm(j));
+        e->emit(instId, y0, x86::ymm(i));
+        e->emit(instId, x0, x86::xmm(j), x86::xmm(regCount - 1 - i));
+        e->emit(instId, y0, x86::ymm(i), x86::ymm(regCount - 1 - j));
+        e->emit(instId, x0, m);
+        e->emit(instId, m, y0);
+        e->emit(instId, x0, x86::xmm(j), m);
+      }
+    }
+  }
+
+  // Jumps to a bound label (short and near) and to a label bound later.
+  for (uint32_t instId = x86::Inst::kIdJa; instId <= x86::Inst::kIdJz; instId++) {
+    // There is no form of 'jecxz' that could reach `L_forward`.
+    if (instId == x86::Inst::kIdJecxz)
+      continue;
+
+    e->emit(instId, L_back);
+    e->emit(instId, L_forward);
+
+    Label L_near = e->newLabel();
+    e->bind(L_near);
+    e->emit(instId, L_near);
+  }
+
+  e->bind(L_forward);
+  e->ret();
+}
+
+// Fills `records` with a template that mixes forms handled by the fast path
+// with forms that require the generic encoder (immediates, options, extra
+// registers), and returns the number of records.
+static size_t makeBatchRecords(InstRecord* records, uint32_t arch, const Label& target) {
+  using namespace x86;
+
+  bool is64Bit = Environment::is64Bit(arch);
+  Gp base = is64Bit ? rsi : esi;
+  Gp index = is64Bit ? rdx : edx;
+
+  size_t n = 0;
+  records[n++] = InstRecord(Inst::kIdMov, eax, dword_ptr(base, 16));
+  records[n++] = InstRecord(Inst::kIdAdd, eax, ecx);
+  records[n++] = InstRecord(Inst::kIdSub, ebx, dword_ptr(base, index, 2, 128));
+  records[n++] = InstRecord(Inst::kIdAdd, eax, 1000);
+  records[n++] = InstRecord(Inst::kIdCmp, eax, ebx);
+  records[n++] = InstRecord(Inst::kIdJne, target);
+  records[n++] = InstRecord(Inst::kIdLea, edi, ptr(base, index, 3, -8));
+  records[n++] = InstRecord(Inst::kIdVmovdqu, ymm0, ptr(base, 64));
+  records[n++] = InstRecord(Inst::kIdVpaddd, ymm1, ymm0, ymm2);
+  records[n++] = InstRecord(Inst::kIdVpxor, xmm3, xmm1, ptr(base, index));
+  records[n++] = InstRecord(Inst::kIdVshufps, xmm4, xmm3, xmm2, 0x1B);
+  records[n] = InstRecord(Inst::kIdVaddps, zmm0, zmm1, zmm2);
+  records[n].setExtraReg(k1);
+  records[n].addOptions(Inst::kOptionZMask);
+  n++;
+  records[n] = InstRecord(Inst::kIdMovs, byte_ptr(is64Bit ? rdi : edi), byte_ptr(base));
+  records[n].setExtraReg(is64Bit ? rcx : ecx);
+  records[n].addOptions(Inst::kOptionRep);
+  n++;
+  records[n] = InstRecord(Inst::kIdJmp, target);
+  records[n].addOptions(Inst::kOptionLongForm);
+  n++;
+  records[n++] = InstRecord(Inst::kIdVmovdqu, ptr(base, 64), ymm1);
+  records[n++] = InstRecord(Inst::kIdTest, eax, ecx);
+  records[n++] = InstRecord(Inst::kIdJz, target);
+  return n;
+}
+
+// Emits records made by `makeBatchRecords()` many times, either by emitBatch()
+// or one by one by emitInst().
+static void generateRecords(x86::Emitter* e, const OpcodeDumpInfo& info, bool batch) {
+  constexpr uint32_t kRepeatCount = 200;
+
+  Label target = e->newLabel();
+  InstRecord records[32];
+  size_t n = makeBatchRecords(records, info.arch, target);
+
+  for (uint32_t k = 0; k < kRepeatCount; k++) {
+    if (k == kRepeatCount / 2)
+      e->bind(target);
+
+    if (batch) {
+      e->emitBatch(records, n);
+    }
+    else {
+      for (size_t j = 0; j < n; j++)
+        e->emitInst(records[j], records[j].operands(), records[j].opCount());
+    }
+  }
+}
+
+static void generateBatch(x86::Emitter* e, const OpcodeDumpInfo& info) { generateRecords(e, info, true); }
+static void generateBatchSerial(x86::Emitter* e, const OpcodeDumpInfo& info) { generateRecords(e, info, false); }
+
+// Encodes instructions emitted by `generate` and copies the machine code to
+// `out`. If `usage` is not null it receives the memory used by the emitter
+// before the code was serialized.
+static Error encode(CodeCopy& out, const OpcodeDumpInfo& info, GenerateFunc generate, uint32_t mode, uint32_t encodingOptions = 0, MemoryUsage* usage = nullptr) {
+  CodeHolder code;
+  code.init(Environment(info.arch));
+
+#ifndef ASMJIT_NO_LOGGING
+  StringLogger logger;
+  if (mode == kEncodeAssemblerLogged)
+    code.setLogger(&logger);
+#else
+  if (mode == kEncodeAssemblerLogged)
+    return DebugUtils::errored(kErrorInvalidState);
+#endif
+
+  if (mode == kEncodeAssembler || mode == kEncodeAssemblerLogged) {
+    x86::Assembler a(&code);
+    a.addEncodingOptions(encodingOptions);
+    generate(a.as<x86::Emitter>(), info);
+
+    if (usage)
+      a.memoryUsage(usage);
+  }
+  else {
+#ifndef ASMJIT_NO_BUILDER
+    x86::Builder cb(&code);
+    cb.addEncodingOptions(encodingOptions);
+    cb.setCompactInstStorage(mode == kEncodeBuilderCompact);
+    generate(cb.as<x86::Emitter>(), info);
+
+    if (usage)
+      cb.memoryUsage(usage);
+    ASMJIT_PROPAGATE(cb.finalize());
+#else
+    return DebugUtils::errored(kErrorInvalidState);
+#endif
+  }
+
+  ASMJIT_PROPAGATE(code.flatten());
+  ASMJIT_PROPAGATE(code.resolveUnresolvedLinks());
+
+  if (!out.assign(code.textSection()->buffer()))
+    return DebugUtils::errored(kErrorOutOfMemory);
+  return kErrorOk;
+}
+
+// Returns memory used by nodes of a builder.
+static size_t nodeMemoryOf(const MemoryUsage& usage) {
+  return usage.categories[MemoryUsage::kCategoryEmitterZones].usedSize +
+         usage.categories[MemoryUsage::kCategoryEmitterAllocator].usedSize;
+}
+
+// Verifies that x86::Builder, with and without compact instruction storage,
+// produces the same machine code as x86::Assembler.
+static uint32_t checkBuilder(const OpcodeDumpInfo& info, const CodeCopy& ref) {
+#ifndef ASMJIT_NO_BUILDER
+  uint32_t nFailed = 0;
+  size_t nodeMemory[2] {};
+
+  for (uint32_t i = 0; i < 2; i++) {
+    CodeCopy copy;
+    MemoryUsage usage;
+    Error err = encode(copy, info, generateAll, i ? kEncodeBuilderCompact : kEncodeBuilder, 0, &usage);
+
+    if (err || !copy.equals(ref)) {
+      printf("  Machine code generated by x86::Builder%s doesn't match x86::Assembler\n", i ? " (compact)" : "");
+      nFailed++;
+    }
+    nodeMemory[i] = nodeMemoryOf(usage);
+  }
+
+  if (nodeMemory[1] >= nodeMemory[0]) {
+    printf("  Compact instruction storage doesn't decrease node memory (%zu >= %zu bytes)\n", nodeMemory[1], nodeMemory[0]);
+    nFailed++;
+  }
+
+  return nFailed;
+#else
+  (void)info;
+  (void)ref;
+  return 0;
+#endif
+}
+
+// Verifies that the fast path of x86::Assembler produces the same machine code
+// as the generic encoder, which is used if a logger is attached.
+static uint32_t checkFastPath(const OpcodeDumpInfo& info, const CodeCopy& ref) {
+#ifndef ASMJIT_NO_LOGGING
+  uint32_t nFailed = 0;
+
+  CodeCopy logged;
+  if (encode(logged, info, generateAll, kEncodeAssemblerLogged) != kErrorOk || !logged.equals(ref)) {
+    printf("  Machine code generated by the fast path doesn't match\n");
+    nFailed++;
+  }
+
+  // Fast path forms don't depend on REX options.
+  if (info.useRex1 || info.useRex2)
+    return nFailed;
+
+  for (uint32_t optimizeForSize = 0; optimizeForSize < 2; optimizeForSize++) {
+    uint32_t encodingOptions = optimizeForSize ? uint32_t(BaseEmitter::kEncodingOptionOptimizeForSize) : 0u;
+    CodeCopy copy[2];
+
+    Error err = encode(copy[0], info, generateFastPathForms, kEncodeAssembler, encodingOptions);
+    if (!err)
+      err = encode(copy[1], info, generateFastPathForms, kEncodeAssemblerLogged, encodingOptions);
+
+    if (err || !copy[0].equals(copy[1])) {
+      printf("  Machine code of fast path forms doesn't match (optimizeForSize=%u)\n", optimizeForSize);
+      nFailed++;
+    }
+  }
+
+  return nFailed;
+#else
+  (void)info;
+  (void)ref;
+  return 0;
+#endif
+}
+
+// Verifies that emitBatch() of x86::Assembler and x86::Builder produces the
+// same machine code as emitting the records one by one.
+static uint32_t checkEmitBatch(const OpcodeDumpInfo& info) {
+  // Records don't depend on REX options.
+  if (info.useRex1 || info.useRex2)
+    return 0;
+
+  CodeCopy ref;
+  if (encode(ref, info, generateBatchSerial, kEncodeAssembler) != kErrorOk) {
+    printf("  Failed to emit instruction records\n");
+    return 1;
+  }
+
+  uint32_t nFailed = 0;
+  for (uint32_t mode : { kEncodeAssembler, kEncodeBuilder }) {
+#ifdef ASMJIT_NO_BUILDER
+    if (mode == kEncodeBuilder)
+      continue;
+#endif
+
+    CodeCopy copy;
+    if (encode(copy, info, generateBatch, mode) != kErrorOk || !copy.equals(ref)) {
+      printf("  Machine code generated by %s::emitBatch() doesn't match\n", mode == kEncodeAssembler ? "Assembler" : "Builder");
+      nFailed++;
+    }
+  }
+
+  // An invalid instruction stops the batch, everything before it must be emitted.
+  CodeHolder code;
+  code.init(Environment(info.arch));
+  x86::Assembler a(&code);
+
+  InstRecord records[3] = {
+    InstRecord(x86::Inst::kIdAdd, x86::eax, x86::ecx),
+    InstRecord(x86::Inst::kIdAdd, x86::eax, x86::xmm0),
+    InstRecord(x86::Inst::kIdAdd, x86::eax, x86::ecx)
+  };
+
+  Error err = a.emitBatch(records, 3);
+  if (err == kErrorOk || a.offset() != 2) {
+    printf("  Invalid instruction in a batch wasn't handled properly (err=%s, offset=%zu)\n",
+           DebugUtils::errorAsString(err), a.offset());
+    nFailed++;
+  }
+
+  return nFailed;
+}
+
+// Verifies that optimizing for size decreases the code size and that all
+// instructions are still encodable.
+static uint32_t checkOptimizeForSize(const OpcodeDumpInfo& info, const CodeCopy& ref) {
+  static const uint32_t kEncodingOptions[2] = {
+    BaseEmitter::kEncodingOptionOptimizeForSize,
+    BaseEmitter::kEncodingOptionOptimizeForSize | BaseEmitter::kEncodingOptionIgnoreFlags
+  };
+
+  CodeCopy copy[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    if (encode(copy[i], info, generateAll, kEncodeAssembler, kEncodingOptions[i]) != kErrorOk) {
+      printf("  Failed to encode instructions optimized for size (options=0x%X)\n", kEncodingOptions[i]);
+      return 1;
+    }
+  }
+
+  if (copy[0].size >= ref.size || copy[1].size > copy[0].size) {
+    printf("  Optimizing for size doesn't decrease the code size (%zu, %zu, %zu bytes)\n", ref.size, copy[0].size, copy[1].size);
+    return 1;
+  }
+
+  return 0;
+}
+
+// Encoding of a single X64 instruction by default, when optimized for size,
+// and when optimized for size while ignoring flags.
+struct SizeOptimizationCase {
+  GenerateFunc generate;
+  const char* expected[3];
+};
+
+static const SizeOptimizationCase sizeOptimizationCases[] = {
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->test(x86::ecx, 1); }, { "F7C101000000", "F6C101", "F6C101" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->test(x86::esi, 0x10); }, { "F7C610000000", "40F6C610", "40F6C610" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->test(x86::eax, 0x80); }, { "A980000000", "A980000000", "A980000000" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->test(x86::rax, 1); }, { "48A901000000", "A801", "A801" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->test(x86::dword_ptr(x86::rdi), 1); }, { "F70701000000", "F60701", "F60701" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->vpaddd(x86::xmm0, x86::xmm1, x86::xmm8); }, { "C4C171FEC0", "C5B9FEC1", "C5B9FEC1" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->vpsubd(x86::xmm0, x86::xmm1, x86::xmm8); }, { "C4C171FAC0", "C4C171FAC0", "C4C171FAC0" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->mov(x86::ecx, 0); }, { "B900000000", "B900000000", "31C9" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->mov(x86::r8, 0); }, { "49C7C000000000", "41B800000000", "4531C0" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->add(x86::ecx, 128); }, { "81C180000000", "81C180000000", "83E980" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->sub(x86::rax, 128); }, { "482D80000000", "482D80000000", "4883C080" } },
+  { [](x86::Emitter* e, const OpcodeDumpInfo&) { e->add(x86::dword_ptr(x86::rdi), 128); }, { "810780000000", "810780000000", "832F80" } }
+};
+
+static uint32_t checkSizeOptimizationCases() {
+  static const uint32_t kEncodingOptions[3] = {
+    0,
+    BaseEmitter::kEncodingOptionOptimizeForSize,
+    BaseEmitter::kEncodingOptionOptimizeForSize | BaseEmitter::kEncodingOptionIgnoreFlags
+  };
+
+  OpcodeDumpInfo info { Environment::kArchX64, false, false };
+  uint32_t nFailed = 0;
+
+  for (const SizeOptimizationCase& c : sizeOptimizationCases) {
+    for (uint32_t i = 0; i < 3; i++) {
+      CodeCopy copy;
+      char hex[64] {};
+
+      if (encode(copy, info, c.generate, kEncodeAssembler, kEncodingOptions[i]) == kErrorOk)
+        for (size_t j = 0; j < copy.size && j < 31; j++)
+          snprintf(hex + j * 2, 3, "%02X", copy.data[j]);
+
+      if (strcmp(hex, c.expected[i]) != 0) {
+        printf("  Encoding %s doesn't match %s (options=0x%X)\n", hex, c.expected[i], kEncodingOptions[i]);
+        nFailed++;
+      }
+    }
+  }
+
+  return nFailed;
+}
+
+static uint32_t checkEncodings(const OpcodeDumpInfo& info) {
+  CodeCopy ref;
+  if (encode(ref, info, generateAll, kEncodeAssembler) != kErrorOk) {
+    printf("  Failed to encode instructions by x86::Assembler\n");
+    return 1;
+  }
+
+  uint32_t nFailed = 0;
+  nFailed += checkBuilder(info, ref);
+  nFailed += checkFastPath(info, ref);
+  nFailed += checkEmitBatch(info);
+  nFailed += checkOptimizeForSize(info, ref);
+  return nFailed;
+}
+
 int main(int argc, char* argv[]) {
   CmdLine cmdLine(argc, argv);
   TestErrorHandler eh;
@@ -77,6 +526,7 @@ int main(int argc, char* argv[]) {
   };
 
   bool quiet = cmdLine.hasArg("--quiet");
+  uint32_t nFailed = 0;
 
   for (uint32_t i = 0; i < ASMJIT_ARRAY_SIZE(infoList); i++) {
     const OpcodeDumpInfo& info = infoList[i];
@@ -109,7 +559,14 @@ int main(int argc, char* argv[]) {
       Error err = runtime.add(&p, &code);
       if (err == kErrorOk) p();
     }
+
+    nFailed += checkEncodings(info);
   }
 
-  return 0;
+  nFailed += checkSizeOptimizationCases();
+
+  if (nFailed)
+    printf("Failure:\n  %u %s failed\n", nFailed, nFailed == 1 ? "check" : "checks");
+
+  return nFailed ? 1 : 0;
 }
@@ -102,7 +102,7 @@ static void makeCompiledFunc(x86::Compiler* cc) noexcept {
 }
 #endif
 
-static uint32_t testFunc(JitRuntime& rt, uint32_t emitterType) noexcept {
+static uint32_t testFunc(JitRuntime& rt, uint32_t emitterType, bool compactInstStorage = false) noexcept {
 #ifndef ASMJIT_NO_LOGGING
   FileLogger logger(stdout);
   logger.setIndentation(FormatOptions::kIndentationCode, 2);
@@ -126,8 +126,9 @@ static uint32_t testFunc(JitRuntime& rt, uint32_t emitterType) noexcept {
 
 #ifndef ASMJIT_NO_BUILDER
     case BaseEmitter::kTypeBuilder: {
-      printf("Using x86::Builder:\n");
+      printf("Using x86::Builder%s:\n", compactInstStorage ? " (compact)" : "");
       x86::Builder cb(&code);
+      cb.setCompactInstStorage(compactInstStorage);
       makeRawFunc(cb.as<x86::Emitter>());
 
       err = cb.finalize();
@@ -141,8 +142,9 @@ static uint32_t testFunc(JitRuntime& rt, uint32_t emitterType) noexcept {
 
 #ifndef ASMJIT_NO_COMPILER
     case BaseEmitter::kTypeCompiler: {
-      printf("Using x86::Compiler:\n");
+      printf("Using x86::Compiler%s:\n", compactInstStorage ? " (compact)" : "");
       x86::Compiler cc(&code);
+      cc.setCompactInstStorage(compactInstStorage);
       makeCompiledFunc(&cc);
 
       err = cc.finalize();
@@ -177,6 +179,49 @@ static uint32_t testFunc(JitRuntime& rt, uint32_t emitterType) noexcept {
   return !(out[0] == 5 && out[1] == 8 && out[2] == 4 && out[3] == 9);
 }
 
+// Signature of functions generated by `testBatch()`.
+typedef int (*ConstFunc)(void);
+
+static uint32_t testBatch(JitRuntime& rt) noexcept {
+  printf("Using JitRuntime::addBatch():\n");
+
+  constexpr size_t kFuncCount = 8;
+  CodeHolder codes[kFuncCount];
+  CodeHolder* codePtrs[kFuncCount];
+
+  for (size_t i = 0; i < kFuncCount; i++) {
+    // Code holders created in bulk recycle their zone blocks.
+    codes[i].setBlockSource(ZoneBlockPool::global());
+    codes[i].init(rt.environment());
+    codePtrs[i] = &codes[i];
+
+    x86::Assembler a(&codes[i]);
+    a.mov(x86::eax, int(i * 100));
+    a.ret();
+  }
+
+  void* funcs[kFuncCount];
+  Error err = rt.addBatch(funcs, codePtrs, kFuncCount);
+
+  if (err) {
+    printf("JitRuntime::addBatch() failed: %s\n", DebugUtils::errorAsString(err));
+    return 1;
+  }
+
+  uint32_t nFailed = 0;
+  for (size_t i = 0; i < kFuncCount; i++) {
+    int result = ptr_as_func<ConstFunc>(funcs[i])();
+    if (result != int(i * 100)) {
+      printf("Function #%u returned %d, expected %d\n", unsigned(i), result, int(i * 100));
+      nFailed = 1;
+    }
+  }
+
+  printf("Result = %s\n\n", nFailed ? "Failed" : "Ok");
+  rt.release(funcs[0]);
+  return nFailed;
+}
+
 int main() {
   printf("AsmJit X86 Emitter Test\n\n");
 
@@ -187,12 +232,16 @@ int main() {
 
 #ifndef ASMJIT_NO_BUILDER
   nFailed += testFunc(rt, BaseEmitter::kTypeBuilder);
+  nFailed += testFunc(rt, BaseEmitter::kTypeBuilder, true);
 #endif
 
 #ifndef ASMJIT_NO_COMPILER
   nFailed += testFunc(rt, BaseEmitter::kTypeCompiler);
+  nFailed += testFunc(rt, BaseEmitter::kTypeCompiler, true);
 #endif
 
+  nFailed += testBatch(rt);
+
   if (!nFailed)
     printf("Success:\n  All tests passed\n");
   else
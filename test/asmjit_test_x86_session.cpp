@@ -0,0 +1,197 @@
+// AsmJit - Machine code generation for C++
+//
+//  * Official AsmJit Home Page: https://asmjit.com
+//  * Official Github Repository: https://github.com/asmjit/asmjit
+//
+// Copyright (c) 2008-2020 The AsmJit Authors
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+// ----------------------------------------------------------------------------
+// This test verifies that a warm `CodeSession<x86::Compiler>` generates and
+// adds functions to `JitRuntime` without allocating any heap memory. Heap
+// allocations are counted by replacing malloc() and friends, which is only
+// done with glibc and only if the test is not instrumented by a sanitizer.
+// ----------------------------------------------------------------------------
+
+#include <asmjit/core.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+  #define ASMJIT_TEST_SANITIZED
+#elif defined(__has_feature)
+  #if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer)
+    #define ASMJIT_TEST_SANITIZED
+  #endif
+#endif
+
+#if defined(ASMJIT_BUILD_X86) && ASMJIT_ARCH_X86 && !defined(ASMJIT_NO_JIT) && !defined(ASMJIT_NO_COMPILER) && \
+    defined(__GLIBC__) && !defined(ASMJIT_TEST_SANITIZED)
+
+#include <asmjit/x86.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace asmjit;
+
+// ============================================================================
+// [Allocation Counter]
+// ============================================================================
+
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* p, size_t size);
+  void __libc_free(void* p);
+}
+
+static bool allocCounterEnabled;
+static size_t allocCount;
+
+extern "C" void* malloc(size_t size) {
+  if (allocCounterEnabled)
+    allocCount++;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  if (allocCounterEnabled)
+    allocCount++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+  if (allocCounterEnabled)
+    allocCount++;
+  return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p) {
+  __libc_free(p);
+}
+
+// ============================================================================
+// [Test]
+// ============================================================================
+
+// Signature of the generated function.
+typedef int (*SumFunc)(const int* array, int count);
+
+// Generates a function that sums `count` integers of `array` and adds `bias`.
+static Error generateSum(x86::Compiler& cc, int bias) noexcept {
+  x86::Gp array = cc.newIntPtr("array");
+  x86::Gp count = cc.newInt32("count");
+  x86::Gp sum = cc.newInt32("sum");
+  x86::Gp i = cc.newIntPtr("i");
+
+  Label loop = cc.newLabel();
+  Label done = cc.newLabel();
+
+  cc.addFunc(FuncSignatureT<int, const int*, int>(CallConv::kIdHost));
+  cc.setArg(0, array);
+  cc.setArg(1, count);
+
+  cc.mov(sum, bias);
+  cc.xor_(i, i);
+  cc.test(count, count);
+  cc.jz(done);
+
+  cc.bind(loop);
+  cc.add(sum, x86::dword_ptr(array, i, 2));
+  cc.inc(i);
+  cc.dec(count);
+  cc.jnz(loop);
+
+  cc.bind(done);
+  cc.ret(sum);
+  cc.endFunc();
+
+  return cc.finalize();
+}
+
+// Generates, adds, executes, and releases a single function.
+static bool runIteration(JitRuntime& rt, CodeSession<x86::Compiler>& session, int bias) noexcept {
+  static const int array[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+  Error err = session.begin(rt.environment());
+  if (!err)
+    err = generateSum(session.emitter(), bias);
+
+  SumFunc fn = nullptr;
+  if (!err)
+    err = rt.add(&fn, &session.code());
+  session.end();
+
+  if (err) {
+    printf("Iteration %d failed: %s\n", bias, DebugUtils::errorAsString(err));
+    return false;
+  }
+
+  int result = fn(array, 8);
+  rt.release(fn);
+
+  if (result != 36 + bias) {
+    printf("Iteration %d returned %d, expected %d\n", bias, result, 36 + bias);
+    return false;
+  }
+
+  return true;
+}
+
+int main() {
+  printf("AsmJit X86 Session Test\n\n");
+
+  constexpr int kWarmupCount = 8;
+  constexpr int kIterationCount = 1000;
+
+  JitRuntime rt;
+  CodeSession<x86::Compiler> session(ZoneBlockPool::global());
+
+  for (int i = 0; i < kWarmupCount; i++)
+    if (!runIteration(rt, session, i))
+      return 1;
+
+  allocCount = 0;
+  allocCounterEnabled = true;
+
+  bool ok = true;
+  for (int i = 0; i < kIterationCount && ok; i++)
+    ok = runIteration(rt, session, i);
+
+  allocCounterEnabled = false;
+  if (!ok)
+    return 1;
+
+  printf("Iterations  = %d\n", kIterationCount);
+  printf("Allocations = %zu\n\n", allocCount);
+
+  if (allocCount != 0) {
+    printf("Failure:\n  A warm session must not allocate memory\n");
+    return 1;
+  }
+
+  printf("Success:\n  All tests passed\n");
+  return 0;
+}
+#else
+#include <stdio.h>
+
+int main() {
+  printf("AsmJit X86 Session Test is disabled on this configuration\n\n");
+  return 0;
+}
+#endif